@@ -0,0 +1,147 @@
+// Benchmark suite for the two pipeline stages.
+// Times DFGProcessor::loadConfig and generateAssembly, RISC_V_Assembler::parse_instruction and
+// assemble, and the combined-memory writer on small, medium and huge synthetic configurations,
+// and writes the results as JSON so runs can be compared between commits.
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/config_generator.h"
+#include "../src/dfg_processor.h"
+#include "../src/risc_v_assembler.h"
+
+struct BenchConfig {
+    std::string name;
+    GeneratorOptions options;
+    int repetitions;
+};
+
+// Silence the tools' progress output while a phase is timed
+struct QuietOutput {
+    std::streambuf* saved;
+    QuietOutput() : saved(std::cout.rdbuf(nullptr)) {}
+    ~QuietOutput() { std::cout.rdbuf(saved); }
+};
+
+// Best wall time of a phase over the repetitions, in milliseconds
+double time_phase(int repetitions, const std::function<void()>& setup, const std::function<void()>& phase) {
+    double best = 0;
+    for (int r = 0; r < repetitions; r++) {
+        setup();
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            QuietOutput quiet;
+            phase();
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        if (r == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    std::string output = "build/bench.json";
+    std::string only;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--output=", 0) == 0) {
+            output = arg.substr(9);
+        } else if (arg.rfind("--only=", 0) == 0) {
+            only = arg.substr(7);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--output=bench.json] [--only=small|medium|huge]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Seeded synthetic configurations: {seed, pes, pes_per_cluster, instructions, hwl_depth, functions}
+    std::vector<BenchConfig> configs = {
+        {"small", {1, 16, 1, 10, 3, 0}, 5},
+        {"medium", {1, 256, 16, 64, 3, 2}, 3},
+        {"huge", {1, 4096, 256, 256, 3, 4}, 1},
+    };
+    std::string work = (std::filesystem::temp_directory_path() / "yac_bench").string() + "/";
+
+    std::ostringstream json;
+    json << "{\n  \"benchmarks\": [";
+    bool first = true;
+    for (const auto& config : configs) {
+        if (!only.empty() && config.name != only) continue;
+        std::string dir = work + config.name + "/";
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+        std::string yaml_path = dir + "config.yaml";
+        std::ofstream(yaml_path) << generate_config(config.options);
+
+        std::unique_ptr<DFGProcessor> processor;
+        auto fresh = [&]() { processor = std::make_unique<DFGProcessor>(dir); };
+        auto loaded = [&]() { fresh(); QuietOutput quiet; processor->loadConfig(yaml_path); };
+
+        double load_ms = time_phase(config.repetitions, fresh, [&]() { processor->loadConfig(yaml_path); });
+        double generate_ms = time_phase(config.repetitions, loaded, [&]() { processor->generateAssembly(); });
+
+        // The generated files are the assembler's input
+        std::vector<std::pair<int, std::string>> files;
+        for (int pe = 0; pe < config.options.pes; pe++) {
+            files.push_back({pe, dir + "pe" + std::to_string(pe) + "_assembly.s"});
+        }
+
+        // parse_instruction on the resolved instruction mix of one program per PE
+        std::vector<std::string> lines = {"psrf.lw x1, 0(x18)", "psrf.lw x2, 1(x19)", "mul x1, x1, x2",
+                                          "addi x5, x5, 7", "add x3, x3, x1", "psrf.sw x3, 2(x20)",
+                                          "ppsrf.addi v0, v0, 10", "corf.addi c1, c0, 4", "hwlrf.lui L1, 1234"};
+        size_t parsed = static_cast<size_t>(config.options.pes) * config.options.instructions_per_pe;
+        RISC_V_Assembler parser;
+        double parse_ms = time_phase(config.repetitions, []() {}, [&]() {
+            for (size_t i = 0; i < parsed; i++) parser.parse_instruction(lines[i % lines.size()]);
+        });
+
+        CombinedMemory combined;
+        double assemble_ms = time_phase(config.repetitions, [&]() { combined = CombinedMemory(); }, [&]() {
+            RISC_V_Assembler assembler;
+            for (const auto& [pe, path] : files) {
+                std::string base = dir + "pe" + std::to_string(pe) + "_binary";
+                std::map<int, std::vector<MemWord>> overlay_entries;
+                assembler.assemble(path, base + ".bin", pe, base + ".mem", &combined.pe_entries[pe],
+                                   &overlay_entries);
+                for (auto& [phase, entries] : overlay_entries) {
+                    combined.overlay_entries[phase][pe] = std::move(entries);
+                }
+            }
+        });
+        size_t words = 0;
+        for (const auto& [pe, entries] : combined.pe_entries) words += entries.size();
+
+        MemFormat format;
+        double write_ms = time_phase(config.repetitions, []() {}, [&]() { combined.write(dir, format, std::cout, std::cerr); });
+
+        std::cout << config.name << ": " << config.options.pes << " PEs, " << words << " words | loadConfig "
+                  << load_ms << " ms, generateAssembly " << generate_ms << " ms, parse_instruction "
+                  << parse_ms << " ms (" << parsed << "), assemble " << assemble_ms << " ms, combined write "
+                  << write_ms << " ms" << std::endl;
+
+        json << (first ? "" : ",") << "\n    {\"name\": \"" << config.name << "\", \"pes\": " << config.options.pes
+             << ", \"instructions_per_pe\": " << config.options.instructions_per_pe << ", \"words\": " << words
+             << ", \"repetitions\": " << config.repetitions << ",\n     \"ms\": {\"loadConfig\": " << load_ms
+             << ", \"generateAssembly\": " << generate_ms << ", \"parse_instruction\": " << parse_ms
+             << ", \"assemble\": " << assemble_ms << ", \"combined_write\": " << write_ms << "}}";
+        first = false;
+        std::filesystem::remove_all(dir);
+    }
+    json << "\n  ]\n}\n";
+
+    std::ofstream out(output);
+    if (!out) {
+        std::cerr << "Error: Cannot write " << output << std::endl;
+        return 1;
+    }
+    out << json.str();
+    std::cout << "Results written to " << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+// Parse throughput of the stage-1 input formats.
+// Writes synthetic configurations as YAML, JSON and binary, times DFGProcessor::loadConfig on
+// each (file parse included) and checks that every format generates the same assembly.
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../src/config_generator.h"
+#include "../src/dfg_processor.h"
+
+// Silence the processor's progress output while a configuration loads
+struct QuietOutput {
+    std::streambuf* saved;
+    QuietOutput() : saved(std::cout.rdbuf(nullptr)) {}
+    ~QuietOutput() { std::cout.rdbuf(saved); }
+};
+
+int main(int argc, char* argv[]) {
+    int repetitions = argc > 1 ? std::stoi(argv[1]) : 3;
+
+    // {seed, pes, pes_per_cluster, instructions, hwl_depth, functions}
+    struct Size {
+        std::string name;
+        GeneratorOptions options;
+    };
+    std::vector<Size> sizes = {{"medium", {1, 256, 16, 64, 3, 2}}, {"huge", {1, 4096, 256, 256, 3, 4}}};
+    std::string work = (std::filesystem::temp_directory_path() / "yac_config_parse").string() + "/";
+    std::filesystem::remove_all(work);
+    std::filesystem::create_directories(work);
+
+    int failures = 0;
+    for (const auto& size : sizes) {
+        std::string base = work + size.name;
+        std::ofstream(base + ".yaml") << generate_config(size.options);
+        DFGProcessor().convertConfig(base + ".yaml", base + ".json");
+        DFGProcessor().convertConfig(base + ".yaml", base + ".yacb");
+        long long instructions = static_cast<long long>(size.options.pes_per_cluster) * size.options.instructions_per_pe;
+        std::cout << size.name << ": " << size.options.pes_per_cluster << " programs, " << instructions
+                  << " instructions" << std::endl;
+        std::cout << "format        bytes   loadConfig ms      MB/s   Minstr/s" << std::endl;
+
+        double yaml_ms = 0;
+        std::vector<std::string> reference;
+        for (const std::string format : {"yaml", "json", "yacb"}) {
+            std::string path = base + "." + format;
+            double best = 0;
+            std::unique_ptr<DFGProcessor> processor;
+            for (int r = 0; r < repetitions; r++) {
+                processor = std::make_unique<DFGProcessor>(work);
+                QuietOutput quiet;
+                auto t0 = std::chrono::steady_clock::now();
+                processor->loadConfig(path);
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+                if (r == 0 || ms < best) best = ms;
+            }
+            if (format == "yaml") yaml_ms = best;
+
+            // The model must not depend on the format: compare the code of one cluster's PEs
+            std::vector<std::string> assembly;
+            {
+                QuietOutput quiet;
+                processor->libraryAssembly();
+                for (int pe = 0; pe < size.options.pes_per_cluster; pe++) {
+                    assembly.push_back(processor->generatePEAssembly(pe));
+                }
+            }
+            if (format == "yaml") reference = assembly;
+            bool identical = assembly == reference;
+            if (!identical) failures++;
+
+            double bytes = static_cast<double>(std::filesystem::file_size(path));
+            char row[160];
+            std::snprintf(row, sizeof(row), "%-6s %12.0f %15.1f %9.1f %10.2f  (%.1fx)%s", format.c_str(), bytes, best,
+                          bytes / 1e3 / best, instructions / 1e3 / best, yaml_ms / best,
+                          identical ? "" : "  DIFFERENT ASSEMBLY");
+            std::cout << row << std::endl;
+        }
+    }
+    std::filesystem::remove_all(work);
+    return failures == 0 ? 0 : 1;
+}
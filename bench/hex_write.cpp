@@ -0,0 +1,101 @@
+// Throughput of the hex output paths used by the .bin/.mem writers.
+// Formats N words (default 100M) as one 8-digit hex word per line and writes them to
+// /dev/null, so the numbers measure formatting and buffering rather than the disk.
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/mem_format.h"
+
+// Run one path and print its throughput; baselines may run on fewer words
+void measure(const std::string& name, size_t words, const std::function<void(std::ostream&, size_t)>& run) {
+    std::ofstream sink("/dev/null", std::ios::binary);
+    auto t0 = std::chrono::steady_clock::now();
+    run(sink, words);
+    sink.flush();
+    auto t1 = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(t1 - t0).count();
+    double bytes = static_cast<double>(words) * 9;
+    char row[160];
+    std::snprintf(row, sizeof(row), "%-34s %11zu words %8.3f s %9.1f Mwords/s %7.2f GB/s", name.c_str(), words,
+                  seconds, words / seconds / 1e6, bytes / seconds / 1e9);
+    std::cout << row << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoull(argv[1]) : 100000000ULL;
+    std::vector<uint32_t> words(count);
+    uint32_t state = 2463534242u;
+    for (auto& word : words) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        word = state;
+    }
+    size_t baseline = std::min<size_t>(count, 2000000);
+
+    std::cout << "Formatting " << count << " words (" << count * 9 / 1000000 << " MB of hex)" << std::endl;
+
+    // Previous assembler path: binary string -> stoul -> stringstream, std::endl per line
+    measure("stringstream + stoul + endl", baseline, [&](std::ostream& out, size_t n) {
+        for (size_t i = 0; i < n; i++) {
+            std::string binary = std::bitset<32>(words[i]).to_string();
+            std::stringstream ss;
+            ss << std::setfill('0') << std::setw(8) << std::hex << std::stoul(binary, nullptr, 2);
+            out << ss.str() << std::endl;
+        }
+    });
+
+    measure("snprintf per word", baseline, [&](std::ostream& out, size_t n) {
+        char text[16];
+        for (size_t i = 0; i < n; i++) {
+            int len = std::snprintf(text, sizeof(text), "%08x\n", words[i]);
+            out.write(text, len);
+        }
+    });
+
+    measure("HexOutput LUT (put_hex)", count, [&](std::ostream& out, size_t n) {
+        HexOutput hex(out, 8 << 20);
+        for (size_t i = 0; i < n; i++) {
+            hex.put_hex(words[i]);
+            hex.put('\n');
+        }
+    });
+
+#ifdef __SSE2__
+    const char* paired = "HexOutput SSE2 (put_hex_lines)";
+#else
+    const char* paired = "HexOutput LUT pairs (put_hex_lines)";
+#endif
+    measure(paired, count, [&](std::ostream& out, size_t n) {
+        HexOutput hex(out, 8 << 20);
+        hex.put_hex_lines(words.data(), n, 1);
+    });
+
+    measure("MemWriter burst (write_run)", count, [&](std::ostream& out, size_t n) {
+        MemFormat format;
+        format.burst = true;
+        MemWriter writer(out, format);
+        writer.write_run(0, words.data(), n);
+    });
+
+    // Reference: copying the same number of output bytes from a prepared buffer
+    std::vector<char> source(8 << 20, 'a');
+    measure("memcpy reference", count, [&](std::ostream& out, size_t n) {
+        std::vector<char> block(source.size());
+        for (size_t done = 0; done < n * 9; done += block.size()) {
+            size_t len = std::min(block.size(), n * 9 - done);
+            std::memcpy(block.data(), source.data(), len);
+            out.write(block.data(), static_cast<std::streamsize>(len));
+        }
+    });
+    return 0;
+}
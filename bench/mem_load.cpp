@@ -0,0 +1,103 @@
+// Load-time comparison of the .mem layouts written by MemWriter.
+// Writes the same synthetic image in the per-line format and in burst format with several
+// words-per-line settings, then loads each file with a $readmemh-style reader.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/mem_format.h"
+
+// $readmemh semantics: whitespace-separated hex words at consecutive addresses, "@addr"
+// moves the load address and "//" starts a comment
+size_t readmemh(const std::string& path, std::vector<uint32_t>& memory) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    const std::string text = ss.str();
+
+    size_t loaded = 0;
+    uint32_t address = 0;
+    for (size_t i = 0; i < text.size();) {
+        char c = text[i];
+        if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+            i++;
+        } else if (c == '/' && i + 1 < text.size() && text[i + 1] == '/') {
+            while (i < text.size() && text[i] != '\n') i++;
+        } else {
+            bool is_address = (c == '@');
+            if (is_address) i++;
+            uint32_t value = 0;
+            for (; i < text.size(); i++) {
+                char h = text[i];
+                int nibble = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+                             (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+                if (nibble < 0) break;
+                value = (value << 4) | static_cast<uint32_t>(nibble);
+            }
+            if (is_address) {
+                address = value;
+            } else {
+                if (address >= memory.size()) memory.resize(address + 1);
+                memory[address++] = value;
+                loaded++;
+            }
+        }
+    }
+    return loaded;
+}
+
+int main(int argc, char* argv[]) {
+    // Default image: 4096 blocks of 1024 words laid out like PE images (4M words)
+    int pes = argc > 1 ? std::stoi(argv[1]) : 4096;
+    std::vector<MemWord> words;
+    for (int pe = 0; pe < pes; pe++) {
+        uint32_t base = static_cast<uint32_t>(pe) << 10;
+        for (uint32_t i = 0; i < 1024; i++) {
+            words.push_back({base | i, (static_cast<uint32_t>(pe) * 2654435761u) ^ (i * 40503u)});
+        }
+    }
+
+    struct Layout {
+        std::string name;
+        MemFormat format;
+    };
+    std::vector<Layout> layouts = {{"line", {false, 1, false}}, {"burst x1", {true, 1, false}},
+                                   {"burst x4", {true, 4, false}}, {"burst x8", {true, 8, false}},
+                                   {"burst x16", {true, 16, false}}};
+
+    std::cout << "Image: " << words.size() << " words" << std::endl;
+    std::cout << "layout       bytes        write ms   load ms" << std::endl;
+    double line_load_ms = 0;
+    for (const auto& layout : layouts) {
+        std::string path = "/tmp/mem_load_bench.mem";
+        auto t0 = std::chrono::steady_clock::now();
+        {
+            std::ofstream out(path);
+            MemWriter writer(out, layout.format);
+            writer.write(words);
+        }
+        auto t1 = std::chrono::steady_clock::now();
+        std::vector<uint32_t> memory;
+        size_t loaded = readmemh(path, memory);
+        auto t2 = std::chrono::steady_clock::now();
+
+        std::ifstream sized(path, std::ios::binary | std::ios::ate);
+        double write_ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        double load_ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+        if (layout.name == "line") line_load_ms = load_ms;
+        char row[128];
+        std::snprintf(row, sizeof(row), "%-10s %12lld %11.1f %9.1f  (%.2fx)", layout.name.c_str(),
+                      static_cast<long long>(sized.tellg()), write_ms, load_ms, line_load_ms / load_ms);
+        std::cout << row << std::endl;
+        if (loaded != words.size()) {
+            std::cerr << "Error: loaded " << loaded << " of " << words.size() << " words" << std::endl;
+            return 1;
+        }
+        std::remove(path.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+# Assembly for PE13 (Cluster 13)
+# Generated with PSRF, HWL and function support
+.text
+.global _start
+
+_start:
+    # Base address loading section for cluster 13
+    # Loading x18 with address 0x34C8 (13512)
+    li x18, 13512
+
+    # Loading x19 with address 0x4E20 (20000)
+    li x19, 20000
+
+    # Loading x20 with address 0xD044 (53316)
+    li x20, 53316
+
+    # Preload section for PSRF variables and coefficients
+    # Using var=0 (registers 0-5)
+    ppsrf.addi v0, v0, 10
+    ppsrf.addi v1, v0, 12
+    corf.addi c0, c0, 256
+    corf.addi c1, c0, 4
+    # Using var=1 (registers 6-11)
+    ppsrf.addi v6, v6, 12
+    ppsrf.addi v7, v6, 11
+    corf.addi c6, c6, 256
+    corf.addi c7, c6, 4
+    # Using var=2 (registers 12-17)
+    ppsrf.addi v12, v12, 10
+    ppsrf.addi v13, v12, 11
+    corf.addi c12, c12, 256
+    corf.addi c13, c12, 4
+    # Using var=2 (registers 12-17)
+    ppsrf.addi v12, v12, 10
+    ppsrf.addi v13, v12, 11
+    corf.addi c12, c12, 256
+    corf.addi c13, c12, 4
+
+    # ========== Execution Section Begin ==========
+    # hwl_imm_1 = ((2 << 23) + (10 << 17) + (10 << 12) + 4
+    # Original pc_start=2, pc_stop=12, delay=0
+    hwlrf.li L1, hwl0_start, hwl0_stop, 10, 4
+hwl0_start:
+    # hwl_imm_2 = ((4 << 23) + (8 << 17) + (11 << 12) + 64
+    # Original pc_start=4, pc_stop=12, delay=0
+    hwlrf.li L2, hwl1_start, hwl1_stop, 11, 64
+hwl1_start:
+    # hwl_imm_3 = ((6 << 23) + (6 << 17) + (12 << 12) + 64
+    # Original pc_start=6, pc_stop=12, delay=0
+    hwlrf.li L3, hwl2_start, hwl2_stop, 12, 64
+hwl2_start:
+    psrf.lw x1, 0(x18)
+    psrf.lw x2, 1(x19)
+    psrf.lw x3, 2(x20)
+    mul x1, x1, x2
+    add x3, x3, x1
+    psrf.sw x3, 2(x20)
+hwl0_stop:
+hwl1_stop:
+hwl2_stop:
+    add x3, x0, x0
+    # End of program
+    ret
@@ -0,0 +1 @@
+#define YAC_SOURCE_HASH "1df8beef6c73e455"
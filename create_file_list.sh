@@ -8,6 +8,7 @@ INPUT_DIR="build"
 OUTPUT_DIR="./test"
 OUTPUT_FILE="assembly_files.txt"
 PATTERN="pe*_assembly.s"
+LIBRARY_PATTERN="cluster*_library.s"
 
 # Function to show usage
 show_usage() {
@@ -17,6 +18,7 @@ show_usage() {
     echo "  -d, --dir DIRECTORY    Input directory to search (default: build)"
     echo "  -o, --output FILE      Output file list name (default: assembly_files.txt)"
     echo "  -p, --pattern PATTERN File pattern to match (default: pe*_assembly.s)"
+    echo "  -l, --library PATTERN Shared function library pattern (default: cluster*_library.s)"
     echo "  -h, --help             Show this help message"
     echo ""
     echo "Examples:"
@@ -43,6 +45,10 @@ while [[ $# -gt 0 ]]; do
             PATTERN="$2"
             shift 2
             ;;
+        -l|--library)
+            LIBRARY_PATTERN="$2"
+            shift 2
+            ;;
         -h|--help)
             show_usage
             exit 0
@@ -69,8 +75,9 @@ ABS_INPUT_DIR=$(realpath "$INPUT_DIR")
 echo "Searching for files matching pattern: $PATTERN"
 echo "In directory: $ABS_INPUT_DIR"
 
-# Create the file list with full paths
+# Create the file list with full paths (PE images first, then shared libraries)
 find "$ABS_INPUT_DIR" -name "$PATTERN" -type f | sort > "$OUTPUT_FILE"
+find "$ABS_INPUT_DIR" -name "$LIBRARY_PATTERN" -type f | sort >> "$OUTPUT_FILE"
 
 # Check if any files were found
 if [[ ! -s "$OUTPUT_FILE" ]]; then
@@ -0,0 +1,329 @@
+#include "autotuner.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "null_stream.h"
+
+// Set the node at a dotted path ("hardware_config.data_dup", "scheduling.pe_assignments.0.
+// instructions.1.iterations"); numeric parts index sequences and missing maps are created.
+void set_config_path(YAML::Node root, const std::string& path, const YAML::Node& value) {
+    std::vector<std::string> parts;
+    std::stringstream stream(path);
+    for (std::string part; std::getline(stream, part, '.');) parts.push_back(part);
+    if (parts.empty()) throw std::runtime_error("Empty configuration path");
+
+    YAML::Node node = root;
+    for (size_t i = 0; i + 1 < parts.size(); i++) {
+        bool index = !parts[i].empty() && std::all_of(parts[i].begin(), parts[i].end(), ::isdigit);
+        if (index && node.IsSequence()) {
+            size_t at = std::stoul(parts[i]);
+            if (at >= node.size()) throw std::runtime_error("Configuration path " + path + " indexes past the sequence");
+            node.reset(node[at]);
+            continue;
+        }
+        if (!node[parts[i]]) node[parts[i]] = YAML::Node(YAML::NodeType::Map);
+        node.reset(node[parts[i]]);
+    }
+    const std::string& last = parts.back();
+    if (!last.empty() && std::all_of(last.begin(), last.end(), ::isdigit) && node.IsSequence()) {
+        size_t at = std::stoul(last);
+        if (at >= node.size()) throw std::runtime_error("Configuration path " + path + " indexes past the sequence");
+        node[at] = YAML::Clone(value);
+    } else {
+        node[last] = YAML::Clone(value);
+    }
+}
+
+std::string yaml_text(const YAML::Node& node) {
+    YAML::Emitter emitter;
+    emitter << YAML::Flow << node;
+    return emitter.c_str();
+}
+
+// Run work(i) for i in [0, count) on up to jobs threads. Work items log to their own
+// NullStream rather than std::cout.
+void run_parallel(size_t count, int jobs, const std::function<void(size_t)>& work) {
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < std::max(1, std::min(jobs, static_cast<int>(count))); t++) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < count; i = next++) work(i);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+double Autotuner::space_size() const {
+    double size = 1;
+    for (const auto& parameter : parameters) size *= parameter.values.size();
+    return size;
+}
+
+std::vector<int> Autotuner::random_choice() {
+    std::vector<int> choice;
+    for (const auto& parameter : parameters) choice.push_back(pick(static_cast<int>(parameter.values.size())));
+    return choice;
+}
+
+TunePoint Autotuner::evaluate(const std::vector<int>& choice, const YAML::Node& config) const {
+    TunePoint point;
+    point.choice = choice;
+    try {
+        NullStream quiet;
+        DFGProcessor processor("");
+        processor.setLog(quiet);
+        processor.loadConfig(config, kernel_path);
+        point.estimate = processor.estimateSchedule();
+        point.valid = point.estimate.active_pes > 0;
+        if (!point.valid) point.error = "no active PEs";
+    } catch (const std::exception& e) {
+        point.error = e.what();
+    }
+    return point;
+}
+
+// Evaluate the choices that are not cached yet; returns how many were new
+int Autotuner::evaluate_batch(const std::vector<std::vector<int>>& choices) {
+    std::vector<std::vector<int>> fresh;
+    std::set<std::vector<int>> seen;
+    for (const auto& choice : choices) {
+        if (cache.count(choice) > 0 || !seen.insert(choice).second) {
+            cache_hits++;
+            continue;
+        }
+        fresh.push_back(choice);
+    }
+    // Candidates are built here: yaml-cpp nodes are not safe to share between threads
+    std::vector<YAML::Node> configs;
+    std::vector<TunePoint> points(fresh.size());
+    for (size_t i = 0; i < fresh.size(); i++) {
+        try {
+            configs.push_back(candidate(fresh[i]));
+        } catch (const std::exception& e) {
+            configs.push_back(YAML::Node());
+            points[i].choice = fresh[i];
+            points[i].error = e.what();
+        }
+    }
+    run_parallel(fresh.size(), jobs, [&](size_t i) {
+        if (!configs[i].IsNull()) points[i] = evaluate(fresh[i], configs[i]);
+    });
+    for (auto& point : points) cache[point.choice] = point;
+    return static_cast<int>(fresh.size());
+}
+
+bool Autotuner::better(const TunePoint& a, const TunePoint& b) {
+    if (a.valid != b.valid) return a.valid;
+    if (a.estimate.cycles != b.estimate.cycles) return a.estimate.cycles < b.estimate.cycles;
+    return a.estimate.imem_words < b.estimate.imem_words;
+}
+
+bool Autotuner::dominates(const TunePoint& a, const TunePoint& b) {
+    return a.estimate.cycles <= b.estimate.cycles && a.estimate.imem_words <= b.estimate.imem_words &&
+           (a.estimate.cycles < b.estimate.cycles || a.estimate.imem_words < b.estimate.imem_words);
+}
+
+// Evaluated points ordered best first
+std::vector<const TunePoint*> Autotuner::ranked() const {
+    std::vector<const TunePoint*> points;
+    for (const auto& [choice, point] : cache) points.push_back(&point);
+    std::sort(points.begin(), points.end(), [](const TunePoint* a, const TunePoint* b) { return better(*a, *b); });
+    return points;
+}
+
+void Autotuner::search_random() {
+    int stalls = 0;
+    while (static_cast<int>(cache.size()) < budget && stalls < 8) {
+        std::vector<std::vector<int>> batch;
+        for (int i = 0; i < std::max(jobs, 1) && static_cast<int>(cache.size() + batch.size()) < budget; i++) {
+            batch.push_back(random_choice());
+        }
+        stalls = evaluate_batch(batch) == 0 ? stalls + 1 : 0;
+    }
+}
+
+// Steady generations: tournament selection over the ranked points, uniform crossover and
+// one-gene mutation; a generation that finds nothing new is retried a few times
+void Autotuner::search_evolutionary() {
+    std::vector<std::vector<int>> initial;
+    for (int i = 0; i < std::min(population, budget); i++) initial.push_back(random_choice());
+    evaluate_batch(initial);
+
+    int stalls = 0;
+    while (static_cast<int>(cache.size()) < budget && stalls < 8) {
+        std::vector<const TunePoint*> points = ranked();
+        auto tournament = [&]() {
+            int a = pick(static_cast<int>(points.size())), b = pick(static_cast<int>(points.size()));
+            return points[std::min(a, b)]->choice;
+        };
+        std::vector<std::vector<int>> children;
+        int room = budget - static_cast<int>(cache.size());
+        for (int i = 0; i < std::min(population, room); i++) {
+            std::vector<int> mother = tournament(), father = tournament();
+            std::vector<int> child(parameters.size());
+            for (size_t g = 0; g < parameters.size(); g++) child[g] = pick(2) ? mother[g] : father[g];
+            size_t gene = pick(static_cast<int>(parameters.size()));
+            child[gene] = pick(static_cast<int>(parameters[gene].values.size()));
+            children.push_back(child);
+        }
+        stalls = evaluate_batch(children) == 0 ? stalls + 1 : 0;
+    }
+}
+
+Autotuner::Autotuner(const std::string& kernel_path, int jobs, uint32_t seed)
+    : kernel(YAML::LoadFile(kernel_path)), kernel_path(kernel_path), jobs(jobs), rng(seed) {
+    YAML::Node tune = kernel["autotune"];
+    if (!tune) throw std::runtime_error(kernel_path + " has no autotune section");
+    if (tune["strategy"]) strategy = tune["strategy"].as<std::string>();
+    if (strategy != "random" && strategy != "evolutionary") {
+        throw std::runtime_error("Unknown autotune strategy: " + strategy);
+    }
+    if (tune["budget"]) budget = tune["budget"].as<int>();
+    if (tune["population"]) population = std::max(2, tune["population"].as<int>());
+    for (const auto& entry : tune["parameters"]) {
+        TuneParameter parameter{entry.first.as<std::string>(), {}};
+        for (const auto& value : entry.second) parameter.values.push_back(value);
+        if (parameter.values.empty()) throw std::runtime_error("Parameter " + parameter.path + " has no values");
+        parameters.push_back(parameter);
+    }
+    if (parameters.empty()) throw std::runtime_error("autotune section has no parameters");
+}
+
+// Kernel configuration with the chosen knob values and without the autotune section
+YAML::Node Autotuner::candidate(const std::vector<int>& choice) const {
+    YAML::Node config = YAML::Clone(kernel);
+    config.remove("autotune");
+    for (size_t i = 0; i < parameters.size(); i++) {
+        set_config_path(config, parameters[i].path, parameters[i].values[choice[i]]);
+    }
+    return config;
+}
+
+void Autotuner::run() {
+    // Spaces that fit the budget are enumerated outright
+    if (space_size() <= budget) {
+        std::vector<std::vector<int>> all(1, std::vector<int>());
+        for (const auto& parameter : parameters) {
+            std::vector<std::vector<int>> next;
+            for (const auto& prefix : all) {
+                for (int v = 0; v < static_cast<int>(parameter.values.size()); v++) {
+                    next.push_back(prefix);
+                    next.back().push_back(v);
+                }
+            }
+            all = next;
+        }
+        strategy = "exhaustive";
+        evaluate_batch(all);
+    } else if (strategy == "random") {
+        search_random();
+    } else {
+        search_evolutionary();
+    }
+}
+
+// Points not dominated in (cycles, IMEM words), by increasing cycles
+std::vector<const TunePoint*> Autotuner::pareto() const {
+    std::vector<const TunePoint*> front;
+    for (const TunePoint* point : ranked()) {
+        if (!point->valid) continue;
+        bool dominated = std::any_of(cache.begin(), cache.end(), [&](const auto& other) {
+            return other.second.valid && dominates(other.second, *point);
+        });
+        if (!dominated && (front.empty() || front.back()->estimate.imem_words != point->estimate.imem_words ||
+                           front.back()->estimate.cycles != point->estimate.cycles)) {
+            front.push_back(point);
+        }
+    }
+    return front;
+}
+
+const TunePoint* Autotuner::best() const {
+    std::vector<const TunePoint*> points = ranked();
+    return points.empty() || !points.front()->valid ? nullptr : points.front();
+}
+
+std::string Autotuner::describe(const std::vector<int>& choice) const {
+    std::string text;
+    for (size_t i = 0; i < parameters.size(); i++) {
+        text += (i > 0 ? ", " : "") + parameters[i].path + "=" + yaml_text(parameters[i].values[choice[i]]);
+    }
+    return text;
+}
+
+// Write the best configuration and the JSON report; print the Pareto front
+bool Autotuner::write(const std::string& output_folder) {
+    const TunePoint* winner = best();
+    if (winner == nullptr) {
+        errors() << "Error: No valid configuration among " << cache.size() << " evaluated" << std::endl;
+        for (const auto& [choice, point] : cache) errors() << "  " << describe(choice) << ": " << point.error << std::endl;
+        return false;
+    }
+
+    std::string tuned_path = output_folder + "tuned.yaml";
+    std::ofstream tuned(tuned_path);
+    if (!tuned) {
+        errors() << "Error: Cannot write " << tuned_path << std::endl;
+        return false;
+    }
+    YAML::Emitter emitter;
+    emitter << candidate(winner->choice);
+    tuned << "# Tuned by autotuner: " << describe(winner->choice) << "\n" << emitter.c_str() << "\n";
+
+    auto point_json = [&](std::ostream& out, const TunePoint& point) {
+        out << "{\"parameters\": {";
+        for (size_t i = 0; i < parameters.size(); i++) {
+            std::string value = yaml_text(parameters[i].values[point.choice[i]]);
+            out << (i > 0 ? ", " : "") << "\"" << parameters[i].path << "\": \"" << value << "\"";
+        }
+        out << "}, \"valid\": " << (point.valid ? "true" : "false");
+        if (point.valid) {
+            out << ", \"cycles\": " << point.estimate.cycles << ", \"total_cycles\": " << point.estimate.total_cycles
+                << ", \"imem_words\": " << point.estimate.imem_words << ", \"active_pes\": " << point.estimate.active_pes;
+        } else {
+            std::string error = point.error;
+            std::replace(error.begin(), error.end(), '"', '\'');
+            out << ", \"error\": \"" << error << "\"";
+        }
+        out << "}";
+    };
+    std::vector<const TunePoint*> front = pareto();
+    std::string report_path = output_folder + "autotune_report.json";
+    std::ofstream report(report_path);
+    if (!report) {
+        errors() << "Error: Cannot write " << report_path << std::endl;
+        return false;
+    }
+    report << "{\n  \"strategy\": \"" << strategy << "\",\n  \"evaluated\": " << cache.size()
+           << ",\n  \"cache_hits\": " << cache_hits << ",\n  \"best\": ";
+    point_json(report, *winner);
+    report << ",\n  \"pareto\": [";
+    for (size_t i = 0; i < front.size(); i++) {
+        report << (i > 0 ? "," : "") << "\n    ";
+        point_json(report, *front[i]);
+    }
+    report << "\n  ],\n  \"points\": [";
+    bool first = true;
+    for (const TunePoint* point : ranked()) {
+        report << (first ? "" : ",") << "\n    ";
+        point_json(report, *point);
+        first = false;
+    }
+    report << "\n  ]\n}\n";
+
+    log() << "Evaluated " << cache.size() << " configurations (" << strategy << ", " << cache_hits
+          << " cache hits)" << std::endl;
+    log() << "Pareto front (cycles vs IMEM words):" << std::endl;
+    for (const TunePoint* point : front) {
+        log() << "  " << point->estimate.cycles << " cycles, " << point->estimate.imem_words << " words: "
+              << describe(point->choice) << std::endl;
+    }
+    log() << "Best: " << winner->estimate.cycles << " cycles, " << winner->estimate.imem_words
+          << " IMEM words; written to " << tuned_path << std::endl;
+    log() << "Report written to " << report_path << std::endl;
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef AUTOTUNER_H
+#define AUTOTUNER_H
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include "dfg_processor.h"
+
+void set_config_path(YAML::Node root, const std::string& path, const YAML::Node& value);
+
+std::string yaml_text(const YAML::Node& node);
+
+void run_parallel(size_t count, int jobs, const std::function<void(size_t)>& work);
+
+// One knob of the search space: a configuration path and the values it may take
+struct TuneParameter {
+    std::string path;
+    std::vector<YAML::Node> values;
+};
+
+struct TunePoint {
+    std::vector<int> choice;  // Value index per parameter
+    bool valid = false;
+    std::string error;        // Why the configuration was rejected
+    ScheduleEstimate estimate;
+};
+
+// Searches schedule knobs of one kernel against the cycle model. The kernel YAML carries an
+// autotune section:
+//
+//   autotune:
+//     strategy: evolutionary      # random or evolutionary
+//     budget: 64                  # distinct configurations to evaluate
+//     parameters:
+//       hardware_config.data_dup: [1, 2, 4]
+//       delay_start: [[0, 0, 0, 0], [0, 1, 2, 3]]
+//
+// Candidates are evaluated in parallel and cached by their choice vector, so a point the
+// search proposes again costs nothing. The best configuration has the fewest cycles (then
+// the smallest IMEM image). The report lists every point and the cycles/IMEM Pareto front.
+class Autotuner {
+private:
+    YAML::Node kernel;
+    std::string kernel_path;
+    std::vector<TuneParameter> parameters;
+    std::string strategy = "evolutionary";
+    int budget = 64;
+    int population = 16;
+    int jobs = 1;
+    std::mt19937 rng;
+    std::map<std::vector<int>, TunePoint> cache;
+    int cache_hits = 0;
+    std::ostream* log_stream = &std::cout;
+    std::ostream* error_stream = &std::cerr;
+
+    std::ostream& log() const { return *log_stream; }
+    std::ostream& errors() const { return *error_stream; }
+
+    int pick(int n) { return static_cast<int>(rng() % static_cast<uint32_t>(n)); }
+
+    double space_size() const;
+    std::vector<int> random_choice();
+    TunePoint evaluate(const std::vector<int>& choice, const YAML::Node& config) const;
+    int evaluate_batch(const std::vector<std::vector<int>>& choices);
+    static bool better(const TunePoint& a, const TunePoint& b);
+    static bool dominates(const TunePoint& a, const TunePoint& b);
+    std::vector<const TunePoint*> ranked() const;
+    void search_random();
+    void search_evolutionary();
+
+public:
+    Autotuner(const std::string& kernel_path, int jobs, uint32_t seed);
+    void setStrategy(const std::string& name) { strategy = name; }
+    void setBudget(int evaluations) { budget = evaluations; }
+    // Send the summary and error messages somewhere other than stdout/stderr
+    void setLog(std::ostream& out, std::ostream& err) { log_stream = &out; error_stream = &err; }
+
+    YAML::Node candidate(const std::vector<int>& choice) const;
+    void run();
+    std::vector<const TunePoint*> pareto() const;
+    const TunePoint* best() const;
+    std::string describe(const std::vector<int>& choice) const;
+    bool write(const std::string& output_folder);
+};
+
+#endif // AUTOTUNER_H
@@ -0,0 +1,48 @@
+#include <iostream>
+#include <thread>
+#include "autotuner.h"
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    std::string strategy;
+    int budget = 0;
+    uint32_t seed = 1;
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--strategy=", 0) == 0) {
+            strategy = arg.substr(11);
+        } else if (arg.rfind("--budget=", 0) == 0) {
+            budget = std::stoi(arg.substr(9));
+        } else if (arg.rfind("--seed=", 0) == 0) {
+            seed = static_cast<uint32_t>(std::stoul(arg.substr(7)));
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            jobs = std::stoi(arg.substr(7));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <kernel.yaml> [output_folder] [options]" << std::endl;
+        std::cerr << "  kernel.yaml: Configuration with an autotune section" << std::endl;
+        std::cerr << "  output_folder: Where tuned.yaml and autotune_report.json go (default: build/)" << std::endl;
+        std::cerr << "  --strategy=random|evolutionary: Overrides autotune.strategy" << std::endl;
+        std::cerr << "  --budget=N: Overrides autotune.budget" << std::endl;
+        std::cerr << "  --seed=N: Search seed (default: 1)" << std::endl;
+        std::cerr << "  --jobs=N: Parallel evaluations (default: hardware threads)" << std::endl;
+        return 1;
+    }
+    std::string output_folder = positional.size() >= 2 ? positional[1] : "build/";
+    if (output_folder.back() != '/') output_folder += '/';
+
+    try {
+        Autotuner tuner(positional[0], jobs, seed);
+        if (!strategy.empty()) tuner.setStrategy(strategy);
+        if (budget > 0) tuner.setBudget(budget);
+        tuner.run();
+        return tuner.write(output_folder) ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
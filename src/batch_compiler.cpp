@@ -0,0 +1,340 @@
+#include "batch_compiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <glob.h>
+#include "config_formats.h"
+#include "dfg_processor.h"
+#include "null_stream.h"
+#include "yac.h"
+
+// Expand batch inputs into configuration paths, in order and without repeats. An input is a
+// configuration file, a directory (its .yaml, .yml, .json and .yacb files), a glob pattern or
+// @list: a file naming one input per line (blank lines and # comments are skipped).
+std::vector<std::string> expand_batch_inputs(const std::vector<std::string>& inputs) {
+    std::vector<std::string> paths;
+    std::set<std::string> seen;
+    auto add = [&](const std::string& path) {
+        std::error_code error;
+        std::string canonical = std::filesystem::weakly_canonical(path, error).string();
+        if (seen.insert(error ? path : canonical).second) paths.push_back(path);
+    };
+    std::vector<std::string> pending(inputs.rbegin(), inputs.rend());
+    while (!pending.empty()) {
+        std::string input = pending.back();
+        pending.pop_back();
+        if (!input.empty() && input[0] == '@') {
+            std::ifstream list(input.substr(1));
+            if (!list) throw std::runtime_error("Cannot open batch list: " + input.substr(1));
+            std::vector<std::string> lines;
+            std::string line;
+            while (std::getline(list, line)) {
+                line.erase(0, line.find_first_not_of(" \t\r"));
+                line.erase(line.find_last_not_of(" \t\r") + 1);
+                if (!line.empty() && line[0] != '#') lines.push_back(line);
+            }
+            pending.insert(pending.end(), lines.rbegin(), lines.rend());
+        } else if (std::filesystem::is_directory(input)) {
+            std::vector<std::string> files;
+            for (const auto& entry : std::filesystem::directory_iterator(input)) {
+                std::string extension = entry.path().extension().string();
+                if (entry.is_regular_file() &&
+                    (extension == ".yaml" || extension == ".yml" || extension == ".json" || extension == ".yacb")) {
+                    files.push_back(entry.path().string());
+                }
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto& file : files) add(file);
+        } else if (input.find_first_of("*?[") != std::string::npos) {
+            glob_t matches;
+            int status = glob(input.c_str(), 0, nullptr, &matches);
+            if (status == GLOB_NOMATCH) throw std::runtime_error("No configuration matches " + input);
+            if (status != 0) throw std::runtime_error("Cannot expand " + input);
+            for (size_t i = 0; i < matches.gl_pathc; i++) add(matches.gl_pathv[i]);
+            globfree(&matches);
+        } else {
+            if (!std::filesystem::is_regular_file(input)) throw std::runtime_error("Cannot open input file: " + input);
+            add(input);
+        }
+    }
+    return paths;
+}
+
+std::string BatchCompiler::quoted(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += ' ';
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+// Output folder per configuration: its file name without extension, numbered on a clash
+void BatchCompiler::assignOutputFolders() {
+    std::set<std::string> used;
+    for (auto& result : results) {
+        std::string stem = std::filesystem::path(result.config).stem().string();
+        std::string name = stem;
+        for (int n = 2; !used.insert(name).second; n++) name = stem + "_" + std::to_string(n);
+        result.output_folder = output_root + name + "/";
+    }
+}
+
+// Write and assemble one image; counts its entries
+void BatchCompiler::encode(RISC_V_Assembler& assembler, std::ostringstream& errors, const std::string& folder,
+                           const std::string& source_name, const std::string& base, int number, const std::string& source,
+                           CombinedMemory& combined, std::vector<MemWord>& entries, uint64_t& words) {
+    {
+        std::ofstream out(folder + source_name);
+        out << source;
+    }
+    std::map<int, std::vector<MemWord>> overlays;
+    errors.str("");
+    if (assembler.assemble(folder + source_name, folder + base + ".bin", number, folder + base + ".mem", &entries,
+                           &overlays) != 0) {
+        std::string message = errors.str();
+        while (!message.empty() && message.back() == '\n') message.pop_back();
+        throw std::runtime_error(source_name + ": " + (message.empty() ? "does not assemble" : message));
+    }
+    words += entries.size();
+    for (const auto& [phase, overlay] : overlays) {
+        words += overlay.size();
+        combined.overlay_entries[phase][number] = overlay;
+    }
+}
+
+// Both stages of make test for one configuration, in process
+void BatchCompiler::compile(BatchResult& result, const YAML::Node& config, bool binary, RISC_V_Assembler& assembler,
+                            std::ostream& progress) {
+    std::ostringstream errors;
+    std::filesystem::create_directories(result.output_folder);
+    DFGProcessor processor(result.output_folder);
+    processor.setLog(progress);
+    if (binary) {
+        processor.loadConfig(result.config);
+    } else {
+        processor.loadConfig(config, result.config);
+    }
+    assembler.set_log(progress, errors);
+    assembler.set_imem_capacity(processor.imemExecutionWords(), processor.imemPreloadWords());
+    assembler.set_rvc(rvc);
+
+    CombinedMemory combined;
+    for (const auto& [cluster, source] : processor.libraryAssembly()) {
+        std::string name = "cluster" + std::to_string(cluster) + "_library";
+        encode(assembler, errors, result.output_folder, name + ".s", name, cluster, source, combined,
+               combined.library_entries[cluster], result.words);
+        result.libraries++;
+    }
+    for (int pe = 0; pe < processor.totalPEs(); pe++) {
+        std::string source = processor.generatePEAssembly(pe);
+        if (source.empty()) continue;
+        encode(assembler, errors, result.output_folder, "pe" + std::to_string(pe) + "_assembly.s",
+               "pe" + std::to_string(pe) + "_binary", pe, source, combined, combined.pe_entries[pe], result.words);
+        result.pes++;
+    }
+    processor.generateDataImages();
+    errors.str("");
+    if (!combined.write(result.output_folder, MemFormat(), progress, errors)) {
+        std::string message = errors.str();
+        while (!message.empty() && message.back() == '\n') message.pop_back();
+        throw std::runtime_error(message.empty() ? "Cannot write " + result.output_folder + "combined_memory.mem"
+                                                 : message);
+    }
+}
+
+int BatchCompiler::countFiles(const std::string& folder) {
+    int files = 0;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(folder, error)) {
+        if (entry.is_regular_file()) files++;
+    }
+    return files;
+}
+
+// Give a duplicate the outputs of the configuration it matches
+void BatchCompiler::copyOutputs(const BatchResult& owner, BatchResult& result) {
+    result.duplicate_of = owner.config;
+    result.pes = owner.pes;
+    result.libraries = owner.libraries;
+    result.words = owner.words;
+    if (!owner.ok) {
+        result.error = owner.error;
+        return;
+    }
+    try {
+        std::filesystem::create_directories(result.output_folder);
+        for (const auto& entry : std::filesystem::directory_iterator(owner.output_folder)) {
+            if (!entry.is_regular_file()) continue;
+            std::string target = result.output_folder + entry.path().filename().string();
+            if (entry.path().extension() != ".reloc") {
+                std::filesystem::copy_file(entry.path(), target, std::filesystem::copy_options::overwrite_existing);
+                continue;
+            }
+            // Relocation files name their source in the header line
+            std::ifstream in(entry.path());
+            std::stringstream text;
+            text << in.rdbuf();
+            std::string contents = text.str();
+            size_t at = contents.find(owner.output_folder);
+            if (at != std::string::npos && at < contents.find('\n')) {
+                contents.replace(at, owner.output_folder.size(), result.output_folder);
+            }
+            std::ofstream(target) << contents;
+        }
+        result.files = countFiles(result.output_folder);
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+}
+
+void BatchCompiler::process(size_t index, RISC_V_Assembler& assembler, std::ostream& progress) {
+    BatchResult& result = results[index];
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    YAML::Node config;
+    std::string key;
+    ConfigFormat format = ConfigFormat::Yaml;
+    try {
+        format = detect_config_format(result.config);
+        if (format == ConfigFormat::Binary) {
+            MappedFile file(result.config);
+            key = "binary\n" + std::string(reinterpret_cast<const char*>(file.data), file.size);
+        } else {
+            config = format == ConfigFormat::Json ? load_json_file(result.config) : YAML::LoadFile(result.config);
+            key = yac::normalized_config(config);
+            if (config["data_images"]) {
+                key += "\n" + std::filesystem::weakly_canonical(result.config).parent_path().string();
+            }
+        }
+    } catch (const std::exception& e) {
+        result.error = e.what();
+        result.ms = elapsed();
+        return;
+    }
+
+    const BatchResult* finished_owner = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = groups.find(key);
+        if (found == groups.end()) {
+            groups[key].owner = index;
+        } else if (!found->second.done) {
+            found->second.followers.push_back(index);  // Completed by the owner
+            return;
+        } else {
+            finished_owner = &results[found->second.owner];  // No longer written to
+        }
+    }
+    if (finished_owner != nullptr) {
+        copyOutputs(*finished_owner, result);
+        result.ms = elapsed();
+        return;
+    }
+
+    try {
+        compile(result, config, format == ConfigFormat::Binary, assembler, progress);
+        result.files = countFiles(result.output_folder);
+        result.ok = true;
+    } catch (const std::exception& e) {
+        result.error = e.what();
+    }
+    result.ms = elapsed();
+
+    std::vector<size_t> followers;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Group& group = groups[key];
+        group.done = true;
+        followers.swap(group.followers);
+    }
+    for (size_t follower : followers) {
+        auto copy_start = std::chrono::steady_clock::now();
+        copyOutputs(result, results[follower]);
+        results[follower].ms =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - copy_start).count();
+    }
+}
+
+BatchCompiler::BatchCompiler(const std::vector<std::string>& configs, const std::string& output_root, int jobs, bool rvc)
+    : output_root(output_root), jobs(jobs), rvc(rvc) {
+    for (const auto& config : configs) {
+        BatchResult result;
+        result.config = config;
+        results.push_back(result);
+    }
+    assignOutputFolders();
+}
+
+// Compile every configuration, print one line each and write the manifest; the number of failures
+int BatchCompiler::run() {
+    auto start = std::chrono::steady_clock::now();
+    std::filesystem::create_directories(output_root);
+    std::atomic<size_t> next{0};
+    int threads = std::max(1, std::min(jobs, static_cast<int>(results.size())));
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            RISC_V_Assembler assembler;  // Tables built once per worker
+            NullStream quiet;            // Progress messages; results are reported at the end
+            for (size_t i = next++; i < results.size(); i = next++) process(i, assembler, quiet);
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    int failures = 0, duplicates = 0;
+    for (const auto& result : results) {
+        char timing[32];
+        std::snprintf(timing, sizeof(timing), "%.1f ms", result.ms);
+        log() << (result.ok ? "OK   " : "FAIL ") << result.config << " -> " << result.output_folder << ": ";
+        if (!result.ok) {
+            log() << result.error;
+        } else if (!result.duplicate_of.empty()) {
+            log() << "copied from " << result.duplicate_of;
+        } else {
+            log() << result.pes << " PEs, " << result.libraries << " libraries, " << result.words << " words";
+        }
+        log() << " (" << timing << ")" << std::endl;
+        if (!result.ok) failures++;
+        if (!result.duplicate_of.empty()) duplicates++;
+    }
+
+    std::ofstream manifest(output_root + "batch_manifest.json");
+    manifest << "{\n  \"jobs\": " << threads << ",\n  \"configs\": " << results.size()
+             << ",\n  \"succeeded\": " << results.size() - failures << ",\n  \"failed\": " << failures
+             << ",\n  \"duplicates\": " << duplicates << ",\n  \"wall_ms\": " << wall_ms << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchResult& result = results[i];
+        manifest << (i > 0 ? "," : "") << "\n    {\"config\": " << quoted(result.config)
+                 << ", \"output\": " << quoted(result.output_folder) << ", \"status\": \""
+                 << (result.ok ? "ok" : "failed") << "\", \"ms\": " << result.ms << ", \"pes\": " << result.pes
+                 << ", \"libraries\": " << result.libraries << ", \"instruction_words\": " << result.words
+                 << ", \"files\": " << result.files;
+        if (!result.duplicate_of.empty()) manifest << ", \"duplicate_of\": " << quoted(result.duplicate_of);
+        if (!result.ok) manifest << ", \"error\": " << quoted(result.error);
+        manifest << "}";
+    }
+    manifest << "\n  ]\n}\n";
+
+    log() << "Batch: " << results.size() - failures << "/" << results.size() << " configurations compiled ("
+          << duplicates << " duplicates copied) in " << static_cast<long long>(wall_ms) << " ms on " << threads
+          << " threads; manifest " << output_root << "batch_manifest.json" << std::endl;
+    return failures;
+}
@@ -0,0 +1,74 @@
+#ifndef BATCH_COMPILER_H
+#define BATCH_COMPILER_H
+
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include "risc_v_assembler.h"
+
+// Result of one configuration of a batch
+struct BatchResult {
+    std::string config;
+    std::string output_folder;
+    bool ok = false;
+    std::string error;
+    std::string duplicate_of;  // Configuration whose outputs were copied
+    double ms = 0;
+    int pes = 0;
+    int libraries = 0;
+    uint64_t words = 0;        // Instruction memory entries over all images and overlays
+    int files = 0;
+};
+
+std::vector<std::string> expand_batch_inputs(const std::vector<std::string>& inputs);
+
+// yac --batch: compiles many configurations in one process, each into its own output folder
+// with the files of make test. Worker threads take configurations from a shared queue and keep
+// their assembler, so its tables are built once per worker rather than once per file.
+// Configurations are deduplicated as the kernel cache keys them (normalized text, plus the
+// folder when data_images paths are resolved against it): the first one is compiled and its
+// outputs are copied for the others. batch_manifest.json in the output root summarizes the run.
+class BatchCompiler {
+private:
+    // Configurations sharing one normalized text
+    struct Group {
+        size_t owner = 0;
+        bool done = false;
+        std::vector<size_t> followers;  // Waiting for the owner's outputs
+    };
+
+    std::vector<BatchResult> results;
+    std::string output_root;
+    int jobs;
+    bool rvc;
+    std::mutex mutex;
+    std::map<std::string, Group> groups;
+    std::ostream* log_stream = &std::cout;
+
+    std::ostream& log() const { return *log_stream; }
+
+    static std::string quoted(const std::string& text);
+    void assignOutputFolders();
+    static void encode(RISC_V_Assembler& assembler, std::ostringstream& errors, const std::string& folder,
+                       const std::string& source_name, const std::string& base, int number, const std::string& source,
+                       CombinedMemory& combined, std::vector<MemWord>& entries, uint64_t& words);
+    void compile(BatchResult& result, const YAML::Node& config, bool binary, RISC_V_Assembler& assembler,
+                 std::ostream& progress);
+    static int countFiles(const std::string& folder);
+    void copyOutputs(const BatchResult& owner, BatchResult& result);
+    void process(size_t index, RISC_V_Assembler& assembler, std::ostream& progress);
+
+public:
+    BatchCompiler(const std::vector<std::string>& configs, const std::string& output_root, int jobs, bool rvc = false);
+    const std::vector<BatchResult>& batchResults() const { return results; }
+    // Send the per-configuration lines and the summary somewhere other than stdout
+    void setLog(std::ostream& out) { log_stream = &out; }
+
+    int run();
+};
+
+#endif // BATCH_COMPILER_H
@@ -0,0 +1,302 @@
+#include "compile_server.h"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "config_formats.h"
+
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t got = recv(fd, data, size, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        data += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool write_frame(int fd, const std::string& payload) {
+    uint32_t size = htonl(static_cast<uint32_t>(payload.size()));
+    return write_all(fd, reinterpret_cast<const char*>(&size), 4) && write_all(fd, payload.data(), payload.size());
+}
+
+// False at the end of the stream, on a read error or for an oversized frame
+bool read_frame(int fd, std::string& payload) {
+    uint32_t size = 0;
+    if (!read_all(fd, reinterpret_cast<char*>(&size), 4)) return false;
+    size = ntohl(size);
+    if (size > COMPILE_MAX_FRAME) return false;
+    payload.resize(size);
+    return size == 0 || read_all(fd, &payload[0], size);
+}
+
+std::string request_payload(const CompileRequest& request) {
+    return "COMPILE format=" + request.format + " reply=" + request.reply + " rvc=" + (request.rvc ? "1" : "0") +
+           "\n" + request.config;
+}
+
+bool parse_request(const std::string& payload, CompileRequest& request, std::string& error) {
+    size_t end = payload.find('\n');
+    if (end == std::string::npos) {
+        error = "request has no header line";
+        return false;
+    }
+    std::istringstream header(payload.substr(0, end));
+    std::string word;
+    header >> word;
+    if (word != "COMPILE") {
+        error = "unknown request '" + word + "'";
+        return false;
+    }
+    while (header >> word) {
+        size_t equals = word.find('=');
+        std::string key = word.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : word.substr(equals + 1);
+        if (key == "format") {
+            request.format = value;
+        } else if (key == "reply") {
+            request.reply = value;
+        } else if (key == "rvc") {
+            request.rvc = value == "1";
+        } else {
+            error = "unknown request field '" + key + "'";
+            return false;
+        }
+    }
+    request.config = payload.substr(end + 1);
+    return true;
+}
+
+std::atomic<bool>& CompileServer::stop_flag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+std::string CompileServer::handle(const std::string& payload, yac::Compiler& compiler) {
+    CompileRequest request;
+    std::string error;
+    if (!parse_request(payload, request, error)) return "ERROR " + error + "\n";
+    if (request.format != "yaml" && request.format != "json" && request.format != "yacb") {
+        return "ERROR unsupported config format '" + request.format + "'\n";
+    }
+    if (request.reply != "images" && request.reply != "manifest") {
+        return "ERROR unknown reply '" + request.reply + "'\n";
+    }
+    if (request.reply == "manifest" && cache == nullptr) return "ERROR manifest replies need --cache\n";
+
+    yac::Options options;
+    options.rvc = request.rvc;
+    try {
+        if (request.format == "yacb") {
+            // Read in place from the request; the bytes are the cache key
+            yac::Kernel kernel = cache != nullptr ? cache->compile_binary(request.config, options, &compiler)
+                                                  : compiler.compile_binary(request.config.data(),
+                                                                            request.config.size(), options);
+            if (request.reply == "manifest") return "OK " + cache->binary_entry_path(request.config, options) + "\n";
+            return "OK\n" + yac::encode(kernel);
+        }
+        YAML::Node config;
+        try {
+            config = request.format == "json" ? parse_json(request.config.data(), request.config.size())
+                                              : YAML::Load(request.config);
+        } catch (const std::runtime_error& e) {  // JSON and YAML::Exception syntax errors
+            throw yac::Error(e.what());
+        }
+        yac::Kernel kernel = cache != nullptr ? cache->compile(config, options, &compiler)
+                                              : compiler.compile(config, options);
+        if (request.reply == "manifest") return "OK " + cache->entry_path(config, options) + "\n";
+        return "OK\n" + yac::encode(kernel);
+    } catch (const std::exception& e) {
+        std::string message = e.what();
+        for (char& c : message) {
+            if (c == '\n') c = ' ';
+        }
+        return "ERROR " + message + "\n";
+    }
+}
+
+void CompileServer::serve_connection(int fd, yac::Compiler& compiler) {
+    std::string payload;
+    while (read_frame(fd, payload)) {
+        std::string reply = handle(payload, compiler);
+        (reply.rfind("OK", 0) == 0 ? served : failed)++;
+        if (!write_frame(fd, reply)) break;
+    }
+    close(fd);
+}
+
+void CompileServer::worker() {
+    yac::Compiler compiler;
+    for (;;) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [&]() { return stopping || !pending.empty(); });
+            if (pending.empty()) return;
+            fd = pending.front();
+            pending.pop_front();
+        }
+        space.notify_one();
+        serve_connection(fd, compiler);
+    }
+}
+
+CompileServer::CompileServer(const std::string& socket_path, int jobs, int queue_limit, const std::string& cache_dir,
+                             uint64_t cache_bytes)
+    : socket_path(socket_path), jobs(std::max(1, jobs)), queue_limit(static_cast<size_t>(std::max(1, queue_limit))) {
+    if (!cache_dir.empty()) cache.reset(new yac::Cache(cache_dir, cache_bytes));
+}
+
+CompileServer::~CompileServer() {
+    if (listen_fd >= 0) close(listen_fd);
+}
+
+// Serve until SIGINT or SIGTERM; returns the process exit code
+int CompileServer::run() {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        errors() << "Error: socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    // A socket file nobody answers on is left over from a server that died
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) {
+        close(probe);
+        errors() << "Error: a server is already listening on " << socket_path << std::endl;
+        return 1;
+    }
+    close(probe);
+    unlink(socket_path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 || bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listen_fd, static_cast<int>(queue_limit)) != 0) {
+        errors() << "Error: cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    stop_flag() = false;
+    std::signal(SIGPIPE, SIG_IGN);
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < jobs; t++) workers.emplace_back([this]() { worker(); });
+    log() << "Serving on " << socket_path << " with " << jobs << " workers, queue " << queue_limit
+          << (cache != nullptr ? ", cached" : "") << std::endl;
+
+    while (!stop_flag()) {
+        // Backpressure: while the queue is full, new clients wait in the listen backlog
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (pending.size() >= queue_limit) {
+                space.wait_for(guard, std::chrono::milliseconds(200), [&]() { return pending.size() < queue_limit; });
+                continue;
+            }
+        }
+        pollfd listener = {listen_fd, POLLIN, 0};
+        if (poll(&listener, 1, 200) <= 0) continue;
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) continue;
+        // A client that stays silent gives its worker back after the idle timeout
+        timeval idle = {idle_seconds, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &idle, sizeof(idle));
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            pending.push_back(fd);
+        }
+        ready.notify_one();
+    }
+
+    // Finish the queued connections, then stop
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path.c_str());
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers) worker.join();
+    log() << "Served " << served << " requests (" << failed << " failed)";
+    if (cache != nullptr) {
+        yac::Cache::Stats stats = cache->stats();
+        log() << ", cache " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions
+              << " evictions";
+    }
+    log() << std::endl;
+    return 0;
+}
+
+std::string CompileClient::request(const CompileRequest& request) {
+    std::string reply;
+    if (!write_frame(fd, request_payload(request)) || !read_frame(fd, reply)) {
+        throw yac::Error("compile server closed the connection");
+    }
+    size_t end = reply.find('\n');
+    std::string status = reply.substr(0, end);
+    if (status.rfind("ERROR ", 0) == 0) throw yac::Error(status.substr(6));
+    if (status.rfind("OK", 0) != 0 || end == std::string::npos) throw yac::Error("malformed reply from server");
+    return reply;
+}
+
+CompileClient::CompileClient(const std::string& socket_path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) throw yac::Error("socket path too long: " + socket_path);
+    std::strcpy(address.sun_path, socket_path.c_str());
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        if (fd >= 0) close(fd);
+        throw yac::Error("no compile server on " + socket_path + " (start one with yac --serve)");
+    }
+}
+
+CompileClient::~CompileClient() {
+    if (fd >= 0) close(fd);
+}
+
+// format is "yaml", "json" or "yacb" (config holds the bytes of a binary configuration)
+yac::Kernel CompileClient::compile(const std::string& config, bool rvc, const std::string& format) {
+    CompileRequest compile_request;
+    compile_request.format = format;
+    compile_request.rvc = rvc;
+    compile_request.config = config;
+    std::string reply = request(compile_request);
+    yac::Kernel kernel;
+    if (!yac::decode(reply.substr(reply.find('\n') + 1), kernel)) throw yac::Error("malformed images from server");
+    return kernel;
+}
+
+// Path of the server's cache entry holding the kernel's manifest and images
+std::string CompileClient::compile_manifest(const std::string& config, bool rvc, const std::string& format) {
+    CompileRequest compile_request;
+    compile_request.format = format;
+    compile_request.reply = "manifest";
+    compile_request.rvc = rvc;
+    compile_request.config = config;
+    std::string reply = request(compile_request);
+    return reply.substr(3, reply.find('\n') - 3);
+}
@@ -0,0 +1,116 @@
+#ifndef COMPILE_SERVER_H
+#define COMPILE_SERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "yac.h"
+
+// Compile requests and replies travel over a Unix stream socket as frames: a 4-byte payload
+// length in network byte order, then the payload. A request is one header line followed by the
+// configuration:
+//
+//   COMPILE format=yaml reply=images rvc=0\n<configuration YAML>
+//
+// format=json sends the configuration as JSON text instead and format=yacb as the bytes of a
+// binary configuration, which the server reads in place (see config_formats.h).
+//
+// reply=images answers "OK\n" followed by yac::encode(kernel). reply=manifest answers
+// "OK <path>\n" with the server's cache entry for the kernel (its JSON manifest and images).
+// Failures answer "ERROR <message>\n". A connection may carry any number of requests.
+
+const uint32_t COMPILE_MAX_FRAME = 64u << 20;
+
+inline std::string default_socket_path() { return "/tmp/yac-" + std::to_string(getuid()) + ".sock"; }
+
+bool write_all(int fd, const char* data, size_t size);
+
+bool read_all(int fd, char* data, size_t size);
+
+bool write_frame(int fd, const std::string& payload);
+
+bool read_frame(int fd, std::string& payload);
+
+struct CompileRequest {
+    std::string format = "yaml";  // Encoding of the configuration
+    std::string reply = "images"; // images or manifest
+    bool rvc = false;
+    std::string config;
+};
+
+std::string request_payload(const CompileRequest& request);
+
+bool parse_request(const std::string& payload, CompileRequest& request, std::string& error);
+
+// The yac --serve daemon. Worker threads each keep a yac::Compiler (and so a built assembler)
+// and share one yac::Cache when a cache directory is given. The acceptor queues at most
+// queue_limit connections; while the queue is full it stops accepting, so further clients
+// wait in the socket backlog instead of piling up in memory. A connection holds its worker
+// until the client closes it or sends nothing for idle_seconds.
+class CompileServer {
+private:
+    std::string socket_path;
+    int jobs;
+    size_t queue_limit;
+    std::unique_ptr<yac::Cache> cache;
+    int listen_fd = -1;
+    static const int idle_seconds = 30;
+
+    std::mutex lock;
+    std::condition_variable ready;  // A connection was queued
+    std::condition_variable space;  // A worker took a connection off the queue
+    std::deque<int> pending;
+    bool stopping = false;
+    std::atomic<uint64_t> served{0};
+    std::atomic<uint64_t> failed{0};
+    std::ostream* log_stream = &std::cout;
+    std::ostream* error_stream = &std::cerr;
+
+    std::ostream& log() const { return *log_stream; }
+    std::ostream& errors() const { return *error_stream; }
+
+    static std::atomic<bool>& stop_flag();
+
+    static void on_signal(int) { stop_flag() = true; }
+
+    std::string handle(const std::string& payload, yac::Compiler& compiler);
+    void serve_connection(int fd, yac::Compiler& compiler);
+    void worker();
+
+public:
+    CompileServer(const std::string& socket_path, int jobs, int queue_limit, const std::string& cache_dir,
+                  uint64_t cache_bytes);
+
+    ~CompileServer();
+
+    // Send status and error messages somewhere other than stdout/stderr
+    void set_log(std::ostream& out, std::ostream& err) { log_stream = &out; error_stream = &err; }
+
+    int run();
+};
+
+// Client side of the compile socket; one connection for any number of requests
+class CompileClient {
+private:
+    int fd = -1;
+
+    std::string request(const CompileRequest& request);
+
+public:
+    explicit CompileClient(const std::string& socket_path);
+
+    ~CompileClient();
+    CompileClient(const CompileClient&) = delete;
+    CompileClient& operator=(const CompileClient&) = delete;
+
+    yac::Kernel compile(const std::string& config, bool rvc = false, const std::string& format = "yaml");
+    std::string compile_manifest(const std::string& config, bool rvc = false, const std::string& format = "yaml");
+};
+
+#endif // COMPILE_SERVER_H
@@ -0,0 +1,414 @@
+#include "config_formats.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+    fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error("Cannot open input file: " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Cannot map input file: " + path);
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const unsigned char*>(mapped);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) munmap(const_cast<unsigned char*>(data), size);
+    if (fd >= 0) close(fd);
+}
+
+// Binary files are recognized by their magic, JSON files by the .json extension
+ConfigFormat detect_config_format(const std::string& path) {
+    char magic[8] = {};
+    std::ifstream in(path, std::ios::binary);
+    if (in.read(magic, sizeof(magic)) && std::memcmp(magic, BINARY_CONFIG_MAGIC, sizeof(magic)) == 0) {
+        return ConfigFormat::Binary;
+    }
+    if (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0) return ConfigFormat::Json;
+    return ConfigFormat::Yaml;
+}
+
+[[noreturn]] void JsonParser::fail(const std::string& message) const {
+    int line = 1, column = 1;
+    for (const char* p = begin; p < at && p < end; p++) {
+        if (*p == '\n') {
+            line++;
+            column = 1;
+        } else {
+            column++;
+        }
+    }
+    throw std::runtime_error("JSON: " + message + " at line " + std::to_string(line) + ", column " +
+                             std::to_string(column));
+}
+
+void JsonParser::skip_space() {
+    while (at < end && (*at == ' ' || *at == '\n' || *at == '\r' || *at == '\t')) at++;
+}
+
+void JsonParser::expect(char c) {
+    skip_space();
+    if (at >= end || *at != c) fail(std::string("expected '") + c + "'");
+    at++;
+}
+
+void JsonParser::append_utf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xC0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+        out += static_cast<char>(0xE0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (code >> 18));
+        out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+}
+
+uint32_t JsonParser::hex4() {
+    if (end - at < 4) fail("truncated \\u escape");
+    uint32_t code = 0;
+    for (int i = 0; i < 4; i++, at++) {
+        char h = *at;
+        int nibble = (h >= '0' && h <= '9') ? h - '0' : (h >= 'a' && h <= 'f') ? h - 'a' + 10 :
+                     (h >= 'A' && h <= 'F') ? h - 'A' + 10 : -1;
+        if (nibble < 0) fail("bad \\u escape");
+        code = (code << 4) | static_cast<uint32_t>(nibble);
+    }
+    return code;
+}
+
+std::string JsonParser::string() {
+    expect('"');
+    std::string out;
+    while (true) {
+        // Copy the run up to the next quote or escape in one step
+        const char* run = at;
+        while (at < end && *at != '"' && *at != '\\') {
+            if (static_cast<unsigned char>(*at) < 0x20) fail("control character in string");
+            at++;
+        }
+        out.append(run, at);
+        if (at >= end) fail("unterminated string");
+        if (*at++ == '"') return out;
+        if (at >= end) fail("unterminated escape");
+        char c = *at++;
+        switch (c) {
+            case '"': out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/': out += '/'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                uint32_t code = hex4();
+                if (code >= 0xD800 && code < 0xDC00 && end - at >= 6 && at[0] == '\\' && at[1] == 'u') {
+                    at += 2;
+                    uint32_t low = hex4();
+                    if (low < 0xDC00 || low > 0xDFFF) fail("bad surrogate pair");
+                    code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default: fail(std::string("bad escape '\\") + c + "'");
+        }
+    }
+}
+
+// A number, true, false or null. Numbers follow the JSON grammar:
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+YAML::Node JsonParser::literal() {
+    const char* start = at;
+    auto digit = [&]() { return at < end && *at >= '0' && *at <= '9'; };
+    auto digits = [&](const char* what) {
+        if (!digit()) fail(std::string("expected a digit ") + what);
+        while (digit()) at++;
+    };
+    if (*at == '-') at++;
+    if (digit()) {
+        if (*at++ != '0') {
+            while (digit()) at++;
+        }
+        if (at < end && *at == '.') {
+            at++;
+            digits("after '.'");
+        }
+        if (at < end && (*at == 'e' || *at == 'E')) {
+            at++;
+            if (at < end && (*at == '+' || *at == '-')) at++;
+            digits("in the exponent");
+        }
+        return YAML::Node(std::string(start, at));
+    }
+    auto word = [&](const char* text) {
+        size_t n = std::strlen(text);
+        if (static_cast<size_t>(end - at) >= n && std::memcmp(at, text, n) == 0) {
+            at += n;
+            return true;
+        }
+        return false;
+    };
+    if (word("true")) return YAML::Node("true");
+    if (word("false")) return YAML::Node("false");
+    if (word("null")) return YAML::Node(YAML::NodeType::Null);
+    fail("unexpected character");
+}
+
+YAML::Node JsonParser::value(int depth) {
+    if (depth > 256) fail("nesting too deep");
+    skip_space();
+    if (at >= end) fail("unexpected end of input");
+    if (*at == '{') {
+        at++;
+        YAML::Node map(YAML::NodeType::Map);
+        skip_space();
+        if (at < end && *at == '}') {
+            at++;
+            return map;
+        }
+        while (true) {
+            std::string key = string();
+            expect(':');
+            map.force_insert(key, value(depth + 1));
+            skip_space();
+            if (at < end && *at == ',') {
+                at++;
+                continue;
+            }
+            expect('}');
+            return map;
+        }
+    }
+    if (*at == '[') {
+        at++;
+        YAML::Node sequence(YAML::NodeType::Sequence);
+        skip_space();
+        if (at < end && *at == ']') {
+            at++;
+            return sequence;
+        }
+        while (true) {
+            sequence.push_back(value(depth + 1));
+            skip_space();
+            if (at < end && *at == ',') {
+                at++;
+                continue;
+            }
+            expect(']');
+            return sequence;
+        }
+    }
+    if (*at == '"') return YAML::Node(string());
+    return literal();
+}
+
+YAML::Node JsonParser::parse() {
+    YAML::Node root = value(0);
+    skip_space();
+    if (at != end) fail("trailing characters");
+    return root;
+}
+
+YAML::Node load_json_file(const std::string& path) {
+    MappedFile file(path);
+    return parse_json(reinterpret_cast<const char*>(file.data), file.size);
+}
+
+// Write a YAML node as JSON. Scalars that are JSON numbers or booleans are written bare, all
+// others as strings, so parse_json gives back the same scalar text.
+void write_json(std::ostream& out, const YAML::Node& node) {
+    auto is_number = [](const std::string& text) {
+        size_t i = text[0] == '-' ? 1 : 0;
+        if (i >= text.size() || text[i] < '0' || text[i] > '9') return false;
+        if (text[i] == '0' && i + 1 < text.size() && text[i + 1] >= '0' && text[i + 1] <= '9') return false;
+        while (i < text.size() && text[i] >= '0' && text[i] <= '9') i++;
+        if (i < text.size() && text[i] == '.') {
+            if (++i >= text.size() || text[i] < '0' || text[i] > '9') return false;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9') i++;
+        }
+        if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+            if (++i < text.size() && (text[i] == '+' || text[i] == '-')) i++;
+            if (i >= text.size() || text[i] < '0' || text[i] > '9') return false;
+            while (i < text.size() && text[i] >= '0' && text[i] <= '9') i++;
+        }
+        return i == text.size();
+    };
+    auto quoted = [&](const std::string& text) {
+        out << '"';
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (c == '\n') {
+                out << "\\n";
+            } else if (c == '\t') {
+                out << "\\t";
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escape[8];
+                std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                out << escape;
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    };
+
+    switch (node.Type()) {
+        case YAML::NodeType::Map: {
+            out << '{';
+            bool first = true;
+            for (const auto& entry : node) {
+                out << (first ? "" : ",");
+                quoted(entry.first.Scalar());
+                out << ':';
+                write_json(out, entry.second);
+                first = false;
+            }
+            out << '}';
+            break;
+        }
+        case YAML::NodeType::Sequence: {
+            out << '[';
+            for (size_t i = 0; i < node.size(); i++) {
+                out << (i > 0 ? "," : "");
+                write_json(out, node[i]);
+            }
+            out << ']';
+            break;
+        }
+        case YAML::NodeType::Scalar: {
+            const std::string& text = node.Scalar();
+            if (!text.empty() && (text == "true" || text == "false" || is_number(text))) {
+                out << text;
+            } else {
+                quoted(text);
+            }
+            break;
+        }
+        default:
+            out << "null";
+    }
+}
+
+// Offset of a string, stored once however often it is used
+uint32_t BinaryConfigWriter::string(const std::string& text) {
+    auto found = string_offsets.find(text);
+    if (found != string_offsets.end()) return found->second;
+    uint32_t offset = static_cast<uint32_t>(strings.size());
+    strings.append(text).push_back('\0');
+    string_offsets[text] = offset;
+    return offset;
+}
+
+void BinaryConfigWriter::write(const std::string& path, const std::string& config_json) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) throw std::runtime_error("Cannot write " + path);
+    auto padded = [](size_t bytes) { return (bytes + 3) & ~size_t(3); };
+    BinaryConfigHeader header;
+    std::memcpy(header.magic, BINARY_CONFIG_MAGIC, sizeof(header.magic));
+    header.byte_order = BINARY_CONFIG_BYTE_ORDER;
+    header.config_bytes = static_cast<uint32_t>(config_json.size());
+    header.string_bytes = static_cast<uint32_t>(strings.size());
+    header.program_count = static_cast<uint32_t>(programs.size());
+    header.instruction_count = static_cast<uint32_t>(instructions.size());
+    header.pair_count = static_cast<uint32_t>(pairs.size());
+    header.register_count = static_cast<uint32_t>(registers.size());
+    const char zeros[4] = {};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(config_json.data(), config_json.size());
+    out.write(zeros, padded(config_json.size()) - config_json.size());
+    out.write(strings.data(), strings.size());
+    out.write(zeros, padded(strings.size()) - strings.size());
+    out.write(reinterpret_cast<const char*>(programs.data()), programs.size() * sizeof(ProgramRecord));
+    out.write(reinterpret_cast<const char*>(instructions.data()), instructions.size() * sizeof(InstructionRecord));
+    out.write(reinterpret_cast<const char*>(pairs.data()), pairs.size() * sizeof(PairRecord));
+    out.write(reinterpret_cast<const char*>(registers.data()), registers.size() * sizeof(uint32_t));
+    if (!out) throw std::runtime_error("Cannot write " + path);
+}
+
+BinaryConfigReader::BinaryConfigReader(const std::string& path) : file(new MappedFile(path)) {
+    open(file->data, file->size, path);
+}
+
+BinaryConfigReader::BinaryConfigReader(const char* data, size_t size, const std::string& name) {
+    open(reinterpret_cast<const unsigned char*>(data), size, name);
+}
+
+// Locate the sections of data and check every reference between them
+void BinaryConfigReader::open(const unsigned char* data, size_t size, const std::string& name) {
+    auto fail = [&](const std::string& message) {
+        throw std::runtime_error("Binary config " + name + ": " + message);
+    };
+    if (size < sizeof(BinaryConfigHeader) || std::memcmp(data, BINARY_CONFIG_MAGIC, sizeof(BINARY_CONFIG_MAGIC)) != 0) {
+        fail("not a YACBIN1 file");
+    }
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint32_t) != 0) fail("buffer is not 4-byte aligned");
+    header = reinterpret_cast<const BinaryConfigHeader*>(data);
+    if (header->byte_order != BINARY_CONFIG_BYTE_ORDER) fail("written on a host of the other byte order");
+    auto padded = [](uint64_t bytes) { return (bytes + 3) & ~uint64_t(3); };
+    uint64_t at = sizeof(BinaryConfigHeader);
+    config_text = reinterpret_cast<const char*>(data + at);
+    at += padded(header->config_bytes);
+    strings = reinterpret_cast<const char*>(data + at);
+    at += padded(header->string_bytes);
+    programs = reinterpret_cast<const ProgramRecord*>(data + at);
+    at += uint64_t(header->program_count) * sizeof(ProgramRecord);
+    instructions = reinterpret_cast<const InstructionRecord*>(data + at);
+    at += uint64_t(header->instruction_count) * sizeof(InstructionRecord);
+    pairs = reinterpret_cast<const PairRecord*>(data + at);
+    at += uint64_t(header->pair_count) * sizeof(PairRecord);
+    registers = reinterpret_cast<const uint32_t*>(data + at);
+    at += uint64_t(header->register_count) * sizeof(uint32_t);
+    if (at != size) fail("section sizes do not match the file size");
+    if (header->string_bytes > 0 && strings[header->string_bytes - 1] != '\0') fail("unterminated string table");
+
+    // Every reference must stay inside its section
+    auto string_ok = [&](uint32_t offset) { return offset < header->string_bytes; };
+    for (uint32_t p = 0; p < header->program_count; p++) {
+        const ProgramRecord& program = programs[p];
+        if (uint64_t(program.first_instruction) + program.instruction_count > header->instruction_count ||
+            uint64_t(program.first_register) + program.register_count > header->register_count) {
+            fail("program " + std::to_string(p) + " is out of range");
+        }
+    }
+    for (uint32_t i = 0; i < header->instruction_count; i++) {
+        const InstructionRecord& instr = instructions[i];
+        for (uint32_t offset : {instr.operation, instr.format, instr.ra1, instr.ra2, instr.rd,
+                                instr.base_address, instr.target}) {
+            if (!string_ok(offset)) fail("instruction " + std::to_string(i) + " has a bad string offset");
+        }
+        if (uint64_t(instr.first_psrf_var) + instr.psrf_var_count > header->pair_count ||
+            uint64_t(instr.first_coefficient) + instr.coefficient_count > header->pair_count) {
+            fail("instruction " + std::to_string(i) + " is out of range");
+        }
+    }
+    for (uint32_t i = 0; i < header->pair_count; i++) {
+        if (!string_ok(pairs[i].key)) fail("pair " + std::to_string(i) + " has a bad string offset");
+    }
+    for (uint32_t i = 0; i < header->register_count; i++) {
+        if (!string_ok(registers[i])) fail("register " + std::to_string(i) + " has a bad string offset");
+    }
+}
@@ -0,0 +1,185 @@
+#ifndef CONFIG_FORMATS_H
+#define CONFIG_FORMATS_H
+
+// Input formats of stage 1 besides YAML, for machine-generated configurations:
+//
+// JSON (.json): the YAML document written as JSON, read by a built-in parser into the same
+// YAML::Node tree yaml-cpp would build. Scalars keep their text, so every value converts as
+// it does from YAML.
+//
+// Binary (.yacb): the configuration with the instruction lists of scheduling.pe_assignments
+// taken out as JSON, followed by those programs as flat arrays of fixed-size records, already
+// in the processor's parsed form. All fields are 32-bit words in the byte order of the host
+// that wrote the file, which the header records; readers reject files of the other order. The
+// file is mapped and read in place:
+//
+//   BinaryConfigHeader
+//   config        config_bytes of JSON. The instruction lists of pe_assignments entries without
+//                 a template are removed; everything else is unchanged
+//   strings       string_bytes of NUL-terminated strings. Records refer to a string by its
+//                 byte offset
+//   programs      program_count ProgramRecords, one per pe_assignments entry without a
+//                 template, in order
+//   instructions  instruction_count InstructionRecords, each program's instructions in order
+//   pairs         pair_count PairRecords: psrf_var and coefficients entries
+//   registers     register_count string offsets: the memory base registers each program needs
+//
+// Each section starts on a 4-byte boundary. dfg_processor --convert=out.json|out.yacb writes
+// either format from a YAML or JSON configuration.
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+
+// Read-only memory mapping of an input file; pages are faulted in on demand so data
+// images can be built from inputs larger than RAM
+struct MappedFile {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    int fd = -1;
+
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+enum class ConfigFormat { Yaml, Json, Binary };
+
+constexpr char BINARY_CONFIG_MAGIC[8] = {'Y', 'A', 'C', 'B', 'I', 'N', '1', '\0'};
+constexpr uint32_t BINARY_CONFIG_BYTE_ORDER = 0x01020304;  // Reads back as 0x04030201 on the other order
+
+ConfigFormat detect_config_format(const std::string& path);
+
+// Recursive-descent JSON parser producing YAML nodes. Numbers, true and false become scalars
+// with their literal text and null becomes a null node, as in a YAML document.
+class JsonParser {
+private:
+    const char* begin;
+    const char* at;
+    const char* end;
+
+    [[noreturn]] void fail(const std::string& message) const;
+    void skip_space();
+    void expect(char c);
+    static void append_utf8(std::string& out, uint32_t code);
+    uint32_t hex4();
+    std::string string();
+    YAML::Node literal();
+    YAML::Node value(int depth);
+
+public:
+    JsonParser(const char* text, size_t size) : begin(text), at(text), end(text + size) {}
+
+    YAML::Node parse();
+};
+
+inline YAML::Node parse_json(const char* text, size_t size) { return JsonParser(text, size).parse(); }
+
+YAML::Node load_json_file(const std::string& path);
+
+void write_json(std::ostream& out, const YAML::Node& node);
+
+struct BinaryConfigHeader {
+    char magic[8];
+    uint32_t byte_order;  // BINARY_CONFIG_BYTE_ORDER as the writer stored it
+    uint32_t config_bytes;
+    uint32_t string_bytes;
+    uint32_t program_count;
+    uint32_t instruction_count;
+    uint32_t pair_count;
+    uint32_t register_count;
+};
+
+struct ProgramRecord {
+    int32_t pe_id;
+    uint32_t first_instruction;
+    uint32_t instruction_count;
+    uint32_t flags;           // PROGRAM_* bits
+    uint32_t first_register;  // Into the registers section
+    uint32_t register_count;
+};
+
+constexpr uint32_t PROGRAM_PSRF_MEM = 1;  // Has psrf-mem-type instructions
+constexpr uint32_t PROGRAM_MEM = 2;       // Has mem-type instructions
+constexpr uint32_t PROGRAM_HWL = 4;       // Has hardware loops
+
+// One parsed instruction. String fields are offsets into the strings section.
+struct InstructionRecord {
+    uint32_t operation;
+    uint32_t format;
+    uint32_t ra1;
+    uint32_t ra2;
+    uint32_t rd;
+    uint32_t base_address;
+    uint32_t target;
+    int32_t imm;
+    int32_t address;
+    int32_t offset;
+    int32_t var;
+    uint32_t flags;  // INSTRUCTION_* bits
+    int32_t loop_id;
+    int32_t pc_start;
+    int32_t pc_stop;
+    int32_t hwl_index;
+    int32_t iterations;
+    uint32_t first_psrf_var;  // Into the pairs section
+    uint32_t psrf_var_count;
+    uint32_t first_coefficient;
+    uint32_t coefficient_count;
+};
+
+constexpr uint32_t INSTRUCTION_VAR = 1;  // var is set
+constexpr uint32_t INSTRUCTION_HWL = 2;  // loop_id..iterations describe a hardware loop
+
+struct PairRecord {
+    uint32_t key;  // String offset (v0..v5, c0..c5)
+    int32_t value;
+};
+
+// Collects the sections of a binary configuration
+class BinaryConfigWriter {
+private:
+    std::string strings;
+    std::map<std::string, uint32_t> string_offsets;
+
+public:
+    std::vector<ProgramRecord> programs;
+    std::vector<InstructionRecord> instructions;
+    std::vector<PairRecord> pairs;
+    std::vector<uint32_t> registers;
+
+    uint32_t string(const std::string& text);
+    void write(const std::string& path, const std::string& config_json);
+};
+
+// Binary configuration read in place from a mapped file or a caller's buffer; the sections
+// are checked on open
+class BinaryConfigReader {
+private:
+    std::unique_ptr<MappedFile> file;  // Null when reading a caller's buffer
+    const BinaryConfigHeader* header = nullptr;
+    const char* config_text = nullptr;
+    const char* strings = nullptr;
+
+    void open(const unsigned char* data, size_t size, const std::string& name);
+
+public:
+    const ProgramRecord* programs = nullptr;
+    const InstructionRecord* instructions = nullptr;
+    const PairRecord* pairs = nullptr;
+    const uint32_t* registers = nullptr;
+
+    explicit BinaryConfigReader(const std::string& path);
+    // The buffer must stay unchanged while the reader is used; name labels errors
+    BinaryConfigReader(const char* data, size_t size, const std::string& name);
+    uint32_t program_count() const { return header->program_count; }
+    const char* string(uint32_t offset) const { return strings + offset; }
+    YAML::Node config() const { return parse_json(config_text, header->config_bytes); }
+};
+
+#endif // CONFIG_FORMATS_H
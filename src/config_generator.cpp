@@ -0,0 +1,130 @@
+#include "config_generator.h"
+#include <algorithm>
+#include <stdexcept>
+
+// One ADDI, ADD or MUL on temporaries; indent is that of the list item
+void ConfigGenerator::arithmetic(std::ostream& out, const std::string& indent) {
+    const std::string field = "\n" + indent + "  ";
+    int kind = pick(3);
+    if (kind == 0) {
+        out << indent << "- operation: ADDI" << field << "rd: " << temp() << field << "ra1: " << temp() << field
+            << "imm: " << pick(2048) << field << "format: i-type\n";
+    } else {
+        out << indent << "- operation: " << (kind == 1 ? "ADD" : "MUL") << field << "rd: " << temp() << field
+            << "ra1: " << temp() << field << "ra2: " << temp() << field << "format: r-type\n";
+    }
+}
+
+void ConfigGenerator::psrf_access(const std::string& op, const std::string& reg, int group, const std::vector<int>& loop_indices) {
+    yaml << "    - operation: " << op << "\n      ra1: " << reg << "\n      base_address: x" << 18 + group
+         << "\n      format: psrf-mem-type\n      var: " << group << "\n      psrf_var: {";
+    for (int v = 0; v < 6; v++) {
+        int index = v < options.psrf_vars && !loop_indices.empty() ? loop_indices[pick(static_cast<int>(loop_indices.size()))] : 0;
+        yaml << (v > 0 ? ", " : "") << "v" << v << ": " << index;
+    }
+    yaml << "}\n      coefficients: {";
+    for (int c = 0; c < 6; c++) {
+        int coefficient = c == 0 ? 256 : c < options.psrf_vars ? 1 << (2 * pick(5)) : 0;
+        yaml << (c > 0 ? ", " : "") << "c" << c << ": " << coefficient;
+    }
+    yaml << "}\n      offset: 0\n";
+}
+
+void ConfigGenerator::program(const std::vector<int>& loop_indices) {
+    const int depth = static_cast<int>(loop_indices.size());
+    const int calls = std::min(options.functions, options.instructions_per_pe);
+    int remaining = options.instructions_per_pe - calls;
+
+    // The loop nest and its body, when the program has room for a load and a store
+    int body = 0;
+    if (depth > 0 && remaining >= depth + options.var_groups + 1) {
+        // Every loop spans its inner setup words and the body: pc_stop - 2 must fit 6 bits
+        body = std::min(remaining - depth, 65 - 2 * depth);
+        remaining -= depth + body;
+        for (int level = 0; level < depth; level++) {
+            yaml << "    - operation: HWL\n      format: hwl-type\n      loop_id: " << level + 1
+                 << "\n      pc_start: " << 2 * (level + 1) << "\n      pc_stop: " << 2 * depth + body - 1
+                 << "\n      hwl_index: " << loop_indices[level] << "\n      iterations: " << (4 << pick(5))
+                 << "\n";
+        }
+        for (int group = 0; group < options.var_groups; group++) {
+            psrf_access("psrf.lw", "x" + std::to_string(group + 1), group, loop_indices);
+        }
+        for (int i = options.var_groups; i < body - 1; i++) arithmetic(yaml);
+        psrf_access("psrf.sw", "x" + std::to_string(options.var_groups + 1), options.var_groups - 1,
+                    loop_indices);
+    }
+
+    // Straight-line tail with the calls spread evenly over it
+    int tail = remaining + calls;
+    int call = 0;
+    for (int i = 0; i < tail; i++) {
+        if (call < calls && i * calls / std::max(tail, 1) >= call) {
+            yaml << "    - operation: JAL\n      rd: x26\n      target: fn" << call
+                 << "\n      address: 0\n      format: j-type\n";
+            call++;
+        } else {
+            arithmetic(yaml);
+        }
+    }
+}
+
+ConfigGenerator::ConfigGenerator(const GeneratorOptions& options) : options(options), rng(options.seed) {
+    if (options.pes < 1 || options.pes_per_cluster < 1 || options.pes % options.pes_per_cluster != 0) {
+        throw std::runtime_error("pes must be a positive multiple of pes_per_cluster");
+    }
+    if (options.instructions_per_pe < 1) throw std::runtime_error("instructions_per_pe must be positive");
+    if (options.hwl_depth < 0 || options.hwl_depth > 7) throw std::runtime_error("hwl_depth must be 0-7");
+    if (options.functions < 0) throw std::runtime_error("functions must not be negative");
+    if (options.var_groups < 1 || options.var_groups > 5) throw std::runtime_error("var_groups must be 1-5");
+    if (options.psrf_vars < 0 || options.psrf_vars > 6) throw std::runtime_error("psrf_vars must be 0-6");
+    if (options.data_dup != 1 && options.data_dup != 2 && options.data_dup != 4) {
+        throw std::runtime_error("data_dup must be 1, 2 or 4");
+    }
+}
+
+std::string ConfigGenerator::generate() {
+    const int clusters = options.pes / options.pes_per_cluster;
+    const int slice = 1024;  // psrf_mem_offset of every region
+    const int spacing = std::max(20000, slice * clusters);
+
+    yaml << "# Synthetic configuration: seed " << options.seed << ", " << options.pes << " PEs, "
+         << options.instructions_per_pe << " instructions per PE\n";
+    yaml << "mem_config:\n";
+    for (int group = 0; group < options.var_groups; group++) {
+        yaml << "  x" << 18 + group << ": " << 200 + group * spacing << "\n";
+    }
+    yaml << "hardware_config:\n  total_pes: " << options.pes << "\n  data_dup: " << options.data_dup
+         << "\n  clusters:\n    count: " << clusters << "\n    pes_per_cluster: " << options.pes_per_cluster
+         << "\n  psrf_mem_offset:\n";
+    for (int group = 0; group < options.var_groups; group++) {
+        yaml << "    x" << 18 + group << "_offset: " << slice << "\n";
+    }
+    yaml << "scheduling:\n  minimum_pes_required: " << options.pes_per_cluster << "\n  pe_assignments:\n";
+
+    std::vector<int> loop_indices;
+    for (int level = 0; level < options.hwl_depth; level++) loop_indices.push_back(10 + level);
+    for (int pe = 0; pe < options.pes_per_cluster; pe++) {
+        yaml << "  - pe_id: " << pe << "\n    instructions:\n";
+        program(loop_indices);
+    }
+
+    if (options.functions > 0) {
+        yaml << "functions:\n";
+        for (int f = 0; f < options.functions; f++) {
+            yaml << "  fn" << f << ":\n    address: 0\n    pe_assignments:\n";
+            // Every base PE shares the body, so cluster placement can link a single copy
+            std::ostringstream body;
+            int length = 2 + pick(4);
+            for (int i = 0; i < length; i++) arithmetic(body, "      ");
+            for (int pe = 0; pe < options.pes_per_cluster; pe++) {
+                yaml << "    - pe_id: " << pe << "\n      instructions:\n" << body.str();
+            }
+        }
+    }
+    return yaml.str();
+}
+
+std::string generate_config(const GeneratorOptions& options) {
+    return ConfigGenerator(options).generate();
+}
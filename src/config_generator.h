@@ -0,0 +1,51 @@
+#ifndef CONFIG_GENERATOR_H
+#define CONFIG_GENERATOR_H
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Parameters of a synthetic configuration. Every base PE of a cluster gets its own program;
+// the same seed always produces the same YAML.
+struct GeneratorOptions {
+    uint32_t seed = 1;
+    int pes = 16;                  // total_pes
+    int pes_per_cluster = 1;       // base PEs, each with its own program
+    int instructions_per_pe = 16;  // YAML instructions per program, HWL and calls included
+    int hwl_depth = 3;             // Nesting depth of the hardware loop nest (0-7)
+    int functions = 0;             // Functions defined for every base PE and called once each
+    int var_groups = 3;            // psrf var groups used by the loop body (1-5)
+    int psrf_vars = 2;             // Loop variables per psrf access (0-6)
+    int data_dup = 1;              // 1, 2 or 4
+};
+
+// Emits YAML configurations for scaling tests. The loop body holds one psrf.lw per var group,
+// a multiply-accumulate chain and a psrf.sw; the rest of the program is straight-line code
+// with the function calls spread over it. Generated programs satisfy the HWL field limits
+// (6-bit loop range, 5-bit loop index), so every configuration assembles.
+class ConfigGenerator {
+private:
+    GeneratorOptions options;
+    std::mt19937 rng;
+    std::ostringstream yaml;
+
+    // mt19937 output is fixed by the standard, unlike the distributions, so configurations are
+    // reproducible across standard libraries
+    int pick(int n) { return static_cast<int>(rng() % static_cast<uint32_t>(n)); }
+
+    std::string temp() { return "x" + std::to_string(1 + pick(15)); }
+
+    void arithmetic(std::ostream& out, const std::string& indent = "    ");
+    void psrf_access(const std::string& op, const std::string& reg, int group, const std::vector<int>& loop_indices);
+    void program(const std::vector<int>& loop_indices);
+
+public:
+    explicit ConfigGenerator(const GeneratorOptions& options);
+    std::string generate();
+};
+
+std::string generate_config(const GeneratorOptions& options);
+
+#endif // CONFIG_GENERATOR_H
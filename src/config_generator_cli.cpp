@@ -0,0 +1,81 @@
+#include <fstream>
+#include <iostream>
+#include "config_generator.h"
+
+int main(int argc, char* argv[]) {
+    GeneratorOptions options;
+    std::string output_file;
+    // Integer options and the fields they set
+    const std::pair<const char*, int*> flags[] = {
+        {"--pes=", &options.pes},
+        {"--pes-per-cluster=", &options.pes_per_cluster},
+        {"--instructions=", &options.instructions_per_pe},
+        {"--hwl-depth=", &options.hwl_depth},
+        {"--functions=", &options.functions},
+        {"--var-groups=", &options.var_groups},
+        {"--psrf-vars=", &options.psrf_vars},
+        {"--data-dup=", &options.data_dup},
+    };
+    try {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool matched = false;
+            if (arg.rfind("--seed=", 0) == 0) {
+                options.seed = static_cast<uint32_t>(std::stoul(arg.substr(7)));
+                matched = true;
+            }
+            for (const auto& [flag, field] : flags) {
+                std::string prefix = flag;
+                if (arg.rfind(prefix, 0) == 0) {
+                    *field = std::stoi(arg.substr(prefix.size()));
+                    matched = true;
+                }
+            }
+            if (!matched && arg.rfind("--", 0) != 0 && output_file.empty()) {
+                output_file = arg;
+                matched = true;
+            }
+            if (!matched) throw std::runtime_error("Unknown argument: " + arg);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        output_file.clear();
+    }
+    if (output_file.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <output.yaml> [options]" << std::endl;
+        std::cerr << "  output.yaml: Configuration to write ('-' for standard output)" << std::endl;
+        std::cerr << "  --seed=N: Random seed (default: 1)" << std::endl;
+        std::cerr << "  --pes=N: total_pes (default: 16)" << std::endl;
+        std::cerr << "  --pes-per-cluster=N: Base PEs with their own program (default: 1)" << std::endl;
+        std::cerr << "  --instructions=N: Instructions per PE, HWL and calls included (default: 16)" << std::endl;
+        std::cerr << "  --hwl-depth=N: Hardware loop nesting depth, 0-7 (default: 3)" << std::endl;
+        std::cerr << "  --functions=N: Functions called from every program (default: 0)" << std::endl;
+        std::cerr << "  --var-groups=N: psrf var groups in the loop body, 1-5 (default: 3)" << std::endl;
+        std::cerr << "  --psrf-vars=N: Loop variables per psrf access, 0-6 (default: 2)" << std::endl;
+        std::cerr << "  --data-dup=N: data_dup, 1, 2 or 4 (default: 1)" << std::endl;
+        return 1;
+    }
+
+    std::string yaml;
+    try {
+        yaml = generate_config(options);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (output_file == "-") {
+        std::cout << yaml;
+        return 0;
+    }
+    std::ofstream out(output_file);
+    if (!out) {
+        std::cerr << "Error: Cannot create output file: " << output_file << std::endl;
+        return 1;
+    }
+    out << yaml;
+    std::cout << "Generated " << output_file << ": " << options.pes << " PEs, " << options.pes_per_cluster
+              << " programs of " << options.instructions_per_pe << " instructions, seed " << options.seed
+              << std::endl;
+    return 0;
+}
@@ -1,884 +1,2834 @@
-#include <iostream>
+#include "dfg_processor.h"
 #include <fstream>
-#include <vector>
-#include <string>
-#include <map>
-#include <set>
-#include <yaml-cpp/yaml.h>
-#include <optional>
 #include <cmath>
 #include <bitset>
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <filesystem>
+#include "mem_format.h"
+#include "profiler.h"
+#include "graph_partitioner.h"
 
-struct HardwareLoop {
-    int loop_id;
-    int pc_start;
-    int pc_stop;
-    int hwl_index;
-    int iterations;
-};
-
-struct Instruction {
-    std::string operation;
-    std::string ra1;
-    std::string ra2;
-    std::string rd;      // Add destination register field
-    std::string base_address;  // Changed to string for register-based addressing
-    std::string format;
-    std::map<std::string, int> coefficients;  // Now using c0-c5
-    std::optional<int> var;                   // Used for register offset calculation
-    std::map<std::string, int> psrf_var;      // Now using v0-v5 with integer values
-    std::optional<HardwareLoop> hwl;  // New field for hardware loop info
-    int imm;                  // Immediate value for I-type instructions
-    std::string target;       // Added for JAL target
-    int address;              // Added for JAL target address
-    int offset;               // Added for memory offset
-};
-
-struct PEAssignment {
-    int pe_id;
-    std::vector<Instruction> instructions;
-    bool has_psrf_mem_type;  // Flag to indicate if PE needs preload section
-    bool has_mem_type;      // Flag to indicate if PE needs preload section
-    std::set<std::string> required_base_registers;  // Track which base registers are needed
-    bool has_hwl;  // New flag for hardware loop
-};
-
-class DFGProcessor {
-private:
-    std::vector<PEAssignment> pe_assignments;
-    std::map<std::string, int> mem_config;  // Memory configuration
-    std::map<std::string, int> mem_offsets; // Memory offsets for each register
-    std::map<std::string, int> function_addresses;  // Store function addresses
-    std::map<std::string, std::map<int, PEAssignment>> function_pe_assignments;  // Store function PE assignments
-    int total_pes;
-    int clusters_count;
-    int pes_per_cluster;
-    int minimum_pes_required;
-    int data_dup;
-    std::map<int, int> hwl_imm_values;  // Map to store hardware loop immediate values
-    std::string output_folder;
-    std::vector<int> delay_start;  // Array to store delay values for each PE
-
-    // Helper function to get cluster number from PE ID
-    int getClusterNumber(int pe_id) {
-        return pe_id / pes_per_cluster;
-    }
-
-    // Helper function to calculate base address for a specific cluster
-    int calculateClusterBaseAddress(const std::string& reg, int cluster_num, int data_dup, int pe_id) {
-        int base_addr = mem_config[reg];
-        std::string offset_key = reg + "_offset";
+// Helper function to get cluster number from PE ID
+int DFGProcessor::getClusterNumber(int pe_id) {
+    return pe_id / pes_per_cluster;
+}
+
+// Helper function to calculate base address for a specific cluster
+int DFGProcessor::calculateClusterBaseAddress(const std::string& reg, int cluster_num, int data_dup, int pe_id) {
+    int base_addr = mem_config[reg];
+    std::string offset_key = reg + "_offset";
+    
+    if (mem_offsets.count(offset_key) > 0 && mem_offsets[offset_key] != 0) {
+        if (data_dup == 2) {
+            if (pe_id > 15) {
+                return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  100000;
+            } else {
+                return base_addr + (mem_offsets[offset_key] * cluster_num);
+            }
+        } else if (data_dup == 4) {
+            if (pe_id > 15 && pe_id < 31) {
+                return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  100000;
+            } else if (pe_id > 31 && pe_id < 47) {
+                return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  200000;
+            } else if (pe_id > 47 && pe_id < 63) {
+                return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  300000;
+            } else {
+                return base_addr + (mem_offsets[offset_key] * cluster_num);
+            }
+        } else {
+            return base_addr + (mem_offsets[offset_key] * cluster_num);
+        }
+    }
+    return base_addr;   
+}
+
+// Helper function to generate LUI and ADDI for large immediates
+std::pair<int, int> DFGProcessor::calculateLuiAddiValues(int value) {
+    // RISC-V ADDI range is -2048 to 2047 (12-bit signed immediate)
+    // RISC-V LUI loads the immediate value into the upper 20 bits (bits 31:12)
+    
+    // If the value fits within ADDI range, use 0 for LUI and the value for ADDI
+    if (value >= -2048 && value <= 2047) {
+        return {0, value};
+    }
+    
+    // Extract lower 12 bits preserving the sign
+    int lower12 = value & 0xFFF;
+    
+    // If the lower 12 bits represent a negative value (bit 11 is set)
+    // we need to adjust the upper bits
+    int upper20;
+    if (lower12 & 0x800) {
+        // Sign extension is happening, need to add 1 to upper bits
+        // and keep the lower bits as they are
+        upper20 = ((value >> 12) & 0xFFFFF) + 1;
+    } else {
+        // No sign extension, just use the upper 20 bits as is
+        upper20 = (value >> 12) & 0xFFFFF;
+    }
+    
+    return {upper20, lower12};
+}
+
+std::string DFGProcessor::generateBaseAddressLoading(int pe_id, int data_dup) {
+    std::string result = "    # Base address loading section for cluster " + 
+                        std::to_string(getClusterNumber(pe_id)) + "\n";
+    
+    int cluster_num = getClusterNumber(pe_id);
+    
+    // For each required base register in memory config
+    for (const auto& [reg, base_value] : mem_config) {
+        if (base_value != 0) {  // Only process non-null values
+            int cluster_addr = calculateClusterBaseAddress(reg, cluster_num, data_dup, pe_id);
+            
+            std::stringstream ss;
+            ss << "    # Loading " << reg << " with address 0x" 
+               << std::hex << std::uppercase << cluster_addr 
+               << std::dec << " (" << cluster_addr << ")\n";
+            result += ss.str();
+            
+            // The assembler expands li into the shortest addi/lui sequence
+            result += "    li " + reg + ", " + std::to_string(cluster_addr) + "\n";
+            result += "\n";
+        }
+    }
+    
+    return result;
+}
+
+std::string DFGProcessor::generatePreloadSection(const std::vector<Instruction>& instructions) {
+    std::string preload;
+    bool has_psrf = false;
+    bool has_mem_type = false;
+    preload += "    # Preload section for PSRF variables and coefficients\n";
+    
+    // Generate PSRF variable loads
+    for (const auto& instr : instructions) {
+        if (instr.format == "psrf-mem-type") {
+            has_psrf = true;
+            int var_value = 0;
+            
+            // Get the var value for this instruction
+            if (instr.var.has_value()) {
+                var_value = instr.var.value();
+            }
+            
+            // Calculate register base for this var value
+            int reg_base = var_value * 6;  // var=0: 0-5, var=1: 6-11, var=2: 12-17
+            
+            // Add a comment indicating which var group we're using
+            preload += "    # Using var=" + std::to_string(var_value) + 
+                      " (registers " + std::to_string(reg_base) + "-" + 
+                      std::to_string(reg_base+5) + ")\n";
+            
+            for (const auto& [var_key, value] : instr.psrf_var) {
+                if (value != 0) {  // Only generate for non-zero values
+                    // Extract the register number from the key (e.g., v0 -> 0)
+                    int base_reg = std::stoi(var_key.substr(1));
+                    // Calculate the actual register number based on var value
+                    int reg_num = reg_base + base_reg;
+                    
+      
+                    // Use the first register of the group as source
+                    preload += "    ppsrf.addi v" + std::to_string(reg_num) + 
+                            ", v" + std::to_string(reg_base) + 
+                            ", " + std::to_string(value) + "\n";
+                }
+            }
+            
+            // Generate coefficient loads with corf.addi
+            for (const auto& [coef_key, value] : instr.coefficients) {
+                if (value != 0) {  // Only generate for non-zero values
+                    // Extract the register number from the key (e.g., c0 -> 0)
+                    int base_reg = std::stoi(coef_key.substr(1));
+                    // Calculate the actual register number based on var value
+                    int reg_num = reg_base + base_reg;
+                    
+                    if (value > 4095) { 
+                        // corf.addi range is 0 to 4095. 
+                        // If negative, we need to sign extend the value
+                        // Use the first register of the group as source
+                        preload += "    corf.lui c" + std::to_string(reg_num) + 
+                                ", " + std::to_string(value >> 12) + "\n";
+                        preload += "    corf.addi c" + std::to_string(reg_num) + 
+                                ", c" + std::to_string(reg_base) + 
+                                ", " + std::to_string(value & 0xFFF) + "\n";
+                    } else {
+                    // Use the first register of the group as source
+                    preload += "    corf.addi c" + std::to_string(reg_num) + 
+                              ", c" + std::to_string(reg_base) + 
+                              ", " + std::to_string(value) + "\n";
+                    }
+                }
+            }
+            
+        } 
+        // else if (instr.format == "mem-type") {
+        //     has_mem_type = true;
+        //     preload += "    # Memory offset: " + std::to_string(instr.offset) + "\n";
+        //     preload += "    addi " + instr.ra1 + ", " + instr.base_address + ", " + std::to_string(instr.offset) + "\n";
+        // }   
+    }
+    
+    if (!has_psrf && !has_mem_type) return "";
+    
+    preload += "\n";
+    log() << "Preload section: " << preload << std::endl;
+    return preload;
+}
+
+// Helper function to get the delay_start padding for a PE
+int DFGProcessor::getDelayStart(int pe_id) {
+    if (pe_id >= 0 && static_cast<size_t>(pe_id) < delay_start.size()) {
+        return delay_start[pe_id];
+    }
+    return 0;
+}
+
+// When a label is given the loop bounds are emitted as <label>_start/<label>_stop
+// symbols placed on the loop's first and last instruction, and the assembler packs
+// the immediate; otherwise the immediate is packed here from the numeric pcs.
+std::string DFGProcessor::generateHWLInstructions(const Instruction& instr, int hwl_count, int delay,
+                                                  const std::string& label) {
+    if (!instr.hwl.has_value()) return "";
+
+    const auto& hwl = instr.hwl.value();
+    
+    // Adjust pc_start and pc_stop by adding the delay
+    int adjusted_pc_start = hwl.pc_start + delay;
+    int adjusted_pc_stop = hwl.pc_stop - adjusted_pc_start;
+    
+    uint32_t imm = calculateHWLImmediate(hwl, delay);
+    auto [upper, lower] = splitHWLImmediate(imm);
+
+    std::string result = "";
+    
+    // Add comment showing the immediate value calculation with delay adjustment
+    result += "    # hwl_imm_" + std::to_string(hwl_count) + " = ";
+    result += "((" + std::to_string(adjusted_pc_start) + " << 23) + ";
+    result += "(" + std::to_string(adjusted_pc_stop) + " << 17) + ";
+    result += "(" + std::to_string(hwl.hwl_index) + " << 12) + ";
+    result += std::to_string(hwl.iterations) + "\n";
+    result += "    # Original pc_start=" + std::to_string(hwl.pc_start) + 
+             ", pc_stop=" + std::to_string(hwl.pc_stop) + 
+             ", delay=" + std::to_string(delay) + "\n";
+
+    if (!label.empty()) {
+        result += "    hwlrf.li L" + std::to_string(hwl.loop_id) + ", " + label + "_start, " + label + "_stop, " +
+                  std::to_string(hwl.hwl_index) + ", " + std::to_string(hwl.iterations) + "\n";
+        return result;
+    }
+
+    // Generate HWL instructions with adjusted immediate values
+    result += "    hwlrf.lui L" + std::to_string(hwl.loop_id) + ", " + std::to_string(upper) + "\n";
+    result += "    hwlrf.addi L" + std::to_string(hwl.loop_id) + ", L" + std::to_string(hwl.loop_id);
+    result += ", " + std::to_string(lower) + "\n";
+
+    return result;
+}
+
+std::string DFGProcessor::generateInstructionCode(const Instruction& instr, int& hwl_count, int delay) {
+    // Handle hardware loop instructions
+    if (instr.format == "hwl-type") {
+        return generateHWLInstructions(instr, ++hwl_count, delay);
+    }
+
+    // Handle memory operations (both PSRF and normal)
+    if (instr.operation == "LW" || instr.operation == "lw" || 
+        instr.operation == "SW" || instr.operation == "sw" || 
+        instr.operation == "LB" || instr.operation == "lb" || 
+        instr.operation == "LH" || instr.operation == "lh" || 
+        instr.operation == "LBU" || instr.operation == "lbu" ||
+        instr.operation == "LHU" || instr.operation == "lhu" ||
+        instr.operation == "SB" || instr.operation == "sb" ||
+        instr.operation == "SH" || instr.operation == "sh" || 
+        instr.operation == "psrf.lw" || 
+        instr.operation == "psrf.lb" || 
+        instr.operation == "psrf.sw" ||
+        instr.operation == "psrf.sb" || 
+        instr.operation == "psrf.zd.lw" ) {
+    
+        // Generate appropriate instruction based on format and operation
+        if (instr.format == "psrf-mem-type") {
+            std::string var_str = "";
+            if (instr.var.has_value()) {
+                var_str = ", " + std::to_string(instr.var.value());
+            }
+            
+            if (instr.operation == "psrf.lw") {
+                return "    psrf.lw " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "psrf.sw") {
+                return "    psrf.sw " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "psrf.lb") {
+                return "    psrf.lb " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "psrf.sb") {
+                return "    psrf.sb " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "psrf.zd.lw") {
+                return "    psrf.zd.lw " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
+            }
+        } else {
+            // Normal memory operations
+            if (instr.operation == "LW" || instr.operation == "lw") {
+                return "    lw " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "SW" || instr.operation == "sw") {
+                return "    sw " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "LB" || instr.operation == "lb") {
+                return "    lb " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "LH" || instr.operation == "lh") {
+                return "    lh " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "LBU" || instr.operation == "lbu") {
+                return "    lbu " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "LHU" || instr.operation == "lhu") {
+                return "    lhu " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "SB" || instr.operation == "sb") {
+                return "    sb " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            } else if (instr.operation == "SH" || instr.operation == "sh") {
+                return "    sh " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+            }
+        }
+    } 
+    // Handle I-type instructions
+    else if (instr.format == "i-type"  || 
+            instr.operation == "ADDI"  || instr.operation == "addi"  || 
+            instr.operation == "SLTI"  || instr.operation == "slti"  || 
+            instr.operation == "XORI"  || instr.operation == "xori"  || 
+            instr.operation == "SLTIU" || instr.operation == "sltiu" || 
+            instr.operation == "SLTI"  || instr.operation == "slti"  || 
+            instr.operation == "ORI"   || instr.operation == "ori"   || 
+            instr.operation == "ANDI"  || instr.operation == "andi"  ||
+            instr.operation == "SLLI"  || instr.operation == "slli"  || 
+            instr.operation == "SRLI"  || instr.operation == "srli"  || 
+            instr.operation == "SRAI"  || instr.operation == "srai"  || 
+            instr.operation == "JALR"  || instr.operation == "jalr") 
+        {
         
-        if (mem_offsets.count(offset_key) > 0 && mem_offsets[offset_key] != 0) {
-            if (data_dup == 2) {
-                if (pe_id > 15) {
-                    return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  100000;
-                } else {
-                    return base_addr + (mem_offsets[offset_key] * cluster_num);
+        // For ADDI instructions
+        if (instr.operation == "ADDI") {
+            if (instr.imm > 2047 || instr.imm < -2048) {
+                // For large immediates, we need to use LUI + ADDI
+                auto [lui_val, addi_val] = calculateLuiAddiValues(instr.imm);
+                
+                // Convert addi_val to signed 12-bit value if it exceeds range
+                if (addi_val & 0x800) {
+                    // Sign extend to print as negative number
+                    addi_val = addi_val | 0xFFFFF000;
                 }
-            } else if (data_dup == 4) {
-                if (pe_id > 15 && pe_id < 31) {
-                    return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  100000;
-                } else if (pe_id > 31 && pe_id < 47) {
-                    return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  200000;
-                } else if (pe_id > 47 && pe_id < 63) {
-                    return base_addr + (mem_offsets[offset_key] * (cluster_num)) +  300000;
+                
+                std::string result = "";
+                // Add comment explaining the LUI+ADDI sequence
+                result += "    # Loading immediate " + std::to_string(instr.imm) + 
+                         " using LUI+ADDI: " + std::to_string(lui_val) + " << 12 + " + 
+                         std::to_string(addi_val) + " = " + 
+                         std::to_string((lui_val << 12) + addi_val) + "\n";
+                
+                if (lui_val != 0) {
+                    result += "    lui " + instr.rd + ", " + std::to_string(lui_val) + "\n";
+                    result += "    addi " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(addi_val) + "\n";
                 } else {
-                    return base_addr + (mem_offsets[offset_key] * cluster_num);
+                    result += "    addi " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+                }
+                return result;
+            } else {
+                return "    addi " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+            }
+        }
+        // Handle JALR instruction
+        else if (instr.operation == "JALR") {
+            return "    jalr " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+        }
+        else if (instr.operation == "SLLI"  || instr.operation == "slli"  || 
+                 instr.operation == "SRLI"  || instr.operation == "srli"  || 
+                 instr.operation == "SRAI"  || instr.operation == "srai"  ) {
+            std::string op = instr.operation;
+            std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+            return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+        }
+        // Handle other I-type instructions
+        else {
+            std::string op = instr.operation;
+            std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+            return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+        }
+    }
+    // Handle R-type operations
+    else if (instr.format == "r-type" || 
+            instr.operation == "ADD" || instr.operation == "SUB" || 
+            instr.operation == "SLL" || instr.operation == "SLT" || 
+            instr.operation == "SLTU" || instr.operation == "XOR" || 
+            instr.operation == "SRL" || instr.operation == "SRA" || 
+            instr.operation == "OR" || instr.operation == "AND" || 
+            instr.operation == "MUL") {
+        
+        std::string op = instr.operation;
+        std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+        return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + instr.ra2 + "\n";
+    }
+    // Handle B-type instructions
+    else if (instr.operation == "BEQ" || instr.operation == "BNE" || 
+            instr.operation == "BLT" || instr.operation == "BGE" || 
+            instr.operation == "BLTU" || instr.operation == "BGEU") {
+        
+        std::string op = instr.operation;
+        std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+        return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+    // Handle U-type instructions
+    else if (instr.operation == "LUI" || instr.operation == "AUIPC") {
+        std::string op = instr.operation;
+        std::transform(op.begin(), op.end(), op.begin(), ::tolower);
+        return "    " + op + " " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+    // Handle J-type instructions (JAL)
+    else if (instr.operation == "JAL" || instr.operation == "jal") {
+        // For function calls, use the provided address
+        log() << "instr.target: " << instr.target << std::endl;
+        if (!instr.target.empty()) {
+            return "    jal " + instr.rd + ", " + std::to_string(instr.address) + "  # Call " + instr.target + "\n";
+        }
+        // For regular jumps, use the immediate
+        return "    jal " + instr.rd + ", " + std::to_string(instr.imm) + "  # Call somewhere\n";
+    }
+
+    // Handle B-type instructions  
+    else if (instr.operation == "BGE" || instr.operation == "bge") {
+        return "    bge " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+    else if (instr.operation == "BLT" || instr.operation == "blt") {
+        return "    blt " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }   
+    else if (instr.operation == "BLTU" || instr.operation == "bltu") {
+        return "    bltu " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+    else if (instr.operation == "BNE" || instr.operation == "bne") {
+        return "    bne " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    } 
+    else if (instr.operation == "BEQ" || instr.operation == "beq") {
+        return "    beq " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+    else if (instr.operation == "BGEU" || instr.operation == "bgeu") {
+        return "    bgeu " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+
+    
+
+    // Handle special instructions
+    else if (instr.operation == "RET") {
+        return "    ret\n";
+    }
+    else if (instr.operation == "NOP" || instr.operation == "nop") {
+        return "    nop\n";
+    }
+    
+    return "    # Unknown instruction: " + instr.operation + " (format: " + instr.format + ")\n";
+}
+
+// Helper function to calculate hardware loop immediate value
+uint32_t DFGProcessor::calculateHWLImmediate(const HardwareLoop& hwl, int delay) {
+    uint32_t imm = 0;
+    imm |= (static_cast<uint32_t>(hwl.pc_start + delay & 0x1FF) << 23);  //  9 bits pc_start
+    imm |= (static_cast<uint32_t>((hwl.pc_stop - hwl.pc_start) & 0x3F) << 17);   // 6 bits pc_stop
+    imm |= (static_cast<uint32_t>(hwl.hwl_index & 0x1F) << 12); // 5 bits hwl_index
+    imm |= (static_cast<uint32_t>(hwl.iterations & 0xFFF));     // 12 bits iterations
+    return imm;
+}
+
+// Helper function to split immediate into upper and lower parts
+std::pair<uint32_t, uint32_t> DFGProcessor::splitHWLImmediate(uint32_t imm) {
+    uint32_t upper = (imm >> 12) & 0xFFFFF;  // Upper 20 bits
+    uint32_t lower = imm & 0xFFF;            // Lower 12 bits
+    if (lower & 0x800) {  // If the highest bit of lower part is 1
+        upper += 1;       // Add 1 to upper to handle sign extension
+    }
+    return {upper, lower};
+}
+
+// Count the instruction words a block of generated assembly will occupy.
+// Mirrors the assembler's line filter: comments, directives and labels take no space.
+int DFGProcessor::countInstructionWords(const std::string& text) {
+    std::vector<int> words{0};    // Word count per open .rept block
+    std::vector<int> repeats{1};
+    std::istringstream iss(text);
+    std::string line;
+    while (std::getline(iss, line)) {
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) continue;
+        if (line.compare(first, 6, ".rept ") == 0) {
+            repeats.push_back(std::stoi(line.substr(first + 6)));
+            words.push_back(0);
+            continue;
+        }
+        if (line.compare(first, 5, ".endr") == 0 && words.size() > 1) {
+            int block = words.back() * repeats.back();
+            words.pop_back();
+            repeats.pop_back();
+            words.back() += block;
+            continue;
+        }
+        char c = line[first];
+        if (c == '#' || c == '.' || c == '_' || line.find(':') != std::string::npos) continue;
+        if (line.compare(first, 9, "hwlrf.li ") == 0) {
+            words.back() += 2;
+        } else if (line.compare(first, 3, "li ") == 0) {
+            words.back() += liWords(std::stoi(line.substr(line.find(',') + 1)));
+        } else {
+            words.back() += 1;
+        }
+    }
+    return words.front();
+}
+
+// Words the assembler emits for `li`: addi for 12-bit values, lui alone when the
+// low 12 bits are zero, lui + addi otherwise
+int DFGProcessor::liWords(int value) {
+    if (value >= -2048 && value <= 2047) return 1;
+    return (value & 0xFFF) == 0 ? 1 : 2;
+}
+
+// Generate the function bodies assigned to a PE
+std::string DFGProcessor::generateFunctionSections(int pe, int& hwl_count, int delay) {
+    std::string result;
+    if (function_pe_assignments.empty()) return result;
+
+    result += "\n    # ========== Function Sections ==========\n";
+    for (const auto& func : function_pe_assignments) {
+        const std::string& func_name = func.first;
+        const auto& pe_assigns = func.second;
+
+        if (pe_assigns.find(pe) != pe_assigns.end()) {
+            const PEAssignment& func_assignment = pe_assigns.at(pe);
+
+            // Add function label
+            std::stringstream ss;
+            ss << "\n" << func_name << ":\n";
+            ss << "    # Function " << func_name << " (address: 0x"
+               << std::hex << function_addresses[func_name] << std::dec << ")\n";
+            result += ss.str();
+
+            for (const auto& instr : func_assignment.instructions) {
+                result += generateInstructionCode(instr, hwl_count, delay);
+            }
+
+            // Add return instruction if not already present
+            if (func_assignment.instructions.empty() ||
+                func_assignment.instructions.back().operation != "JALR") {
+                result += "    jalr x0, x26, 0  # Return from function\n";
+            }
+        }
+    }
+    return result;
+}
+
+// Link identical function bodies once per cluster and write the shared library images.
+// Bodies are compared by their generated text, so copies of a function that differ
+// between PEs are kept apart while identical bodies under different names are merged.
+void DFGProcessor::buildFunctionLibraries() {
+    function_libraries.clear();
+    if (function_placement != "cluster" || function_pe_assignments.empty()) return;
+
+    std::map<int, std::map<std::string, int>> body_index;  // cluster -> body text -> index
+    for (int pe = 0; pe < total_pes; pe++) {
+        int cluster = getClusterNumber(pe);
+        for (const auto& [func_name, pe_assigns] : function_pe_assignments) {
+            auto it = pe_assigns.find(pe);
+            if (it == pe_assigns.end()) continue;
+
+            const PEAssignment& func_assignment = it->second;
+            std::string body;
+            int hwl_count = 0;
+            for (const auto& instr : func_assignment.instructions) {
+                body += generateInstructionCode(instr, hwl_count, 0);
+            }
+            if (func_assignment.instructions.empty() ||
+                func_assignment.instructions.back().operation != "JALR") {
+                body += "    jalr x0, x26, 0  # Return from function\n";
+            }
+
+            FunctionLibrary& library = function_libraries[cluster];
+            int words = countInstructionWords(body);
+            library.per_pe_words += words;
+            auto found = body_index[cluster].find(body);
+            if (found == body_index[cluster].end()) {
+                int index = static_cast<int>(library.bodies.size());
+                body_index[cluster][body] = index;
+                library.bodies.push_back(body);
+                library.labels.push_back(func_name + (index > 0 ? "_" + std::to_string(index) : ""));
+                library.offsets.push_back(library.words);
+                library.words += words;
+                library.symbols[{func_name, pe}] = index;
+            } else {
+                library.symbols[{func_name, pe}] = found->second;
+            }
+        }
+    }
+
+    // The hardware must map the region the library is stored in into every PE's window
+    if (!function_libraries.empty() && function_library_region == 0) {
+        throw std::runtime_error("function_library placement 'cluster' needs hardware_config.function_library.region: "
+                                 "the instruction memory address the hardware maps into the window of every PE "
+                                 "of a cluster");
+    }
+
+    // Place every cluster's library at the same execution word so PE windows stay uniform
+    int max_words = 0;
+    for (const auto& [cluster, library] : function_libraries) {
+        max_words = std::max(max_words, library.words);
+    }
+    int base = function_library_base >= 0 ? function_library_base : imem_execution_words - max_words;
+    if (base < 0 || base + max_words > imem_execution_words) {
+        throw std::runtime_error("Shared function library (" + std::to_string(max_words) +
+                                 " words at word " + std::to_string(base) + ") does not fit the " +
+                                 std::to_string(imem_execution_words) + "-word execution window");
+    }
+
+    for (auto& [cluster, library] : function_libraries) {
+        library.base_word = base;
+
+        std::ostringstream text;
+        text << "# Shared function library for cluster " << cluster << "\n";
+        text << "# Stored in the code region at 0x" << std::hex << function_library_region << std::dec
+             << ", mapped at execution word " << base << " of every PE in the cluster\n";
+        text << ".text\n";
+        text << ".library " << cluster << " " << base << " 0x" << std::hex << function_library_region << std::dec
+             << "\n";
+        text << "    # ========== Execution Section Begin ==========\n";
+        for (size_t i = 0; i < library.bodies.size(); i++) {
+            text << "\n" << library.labels[i] << ":\n";
+            text << "    # Word " << base + library.offsets[i] << ", used by";
+            for (const auto& [key, index] : library.symbols) {
+                if (index == static_cast<int>(i)) {
+                    text << " " << key.first << "@PE" << key.second;
+                }
+            }
+            text << "\n" << library.bodies[i];
+        }
+        library.text = text.str();
+
+        log() << "Cluster " << cluster << " function library: " << library.bodies.size()
+              << " bodies, " << library.words << " words at word " << base
+              << " (per-PE copies: " << library.per_pe_words << " words, saved "
+              << library.per_pe_words - library.words << " words)" << std::endl;
+    }
+}
+
+// Generate a call into the cluster's shared library; the assembler resolves the
+// symbol (declared with .set in the PE header) PC-relative from the call site
+std::string DFGProcessor::generateLibraryCall(const Instruction& instr, int pe) {
+    const FunctionLibrary& library = function_libraries.at(getClusterNumber(pe));
+    int index = library.symbols.at({instr.target, pe});
+    return "    jal " + instr.rd + ", " + library.labels[index] + "  # Call " + instr.target +
+           " (shared word " + std::to_string(library.base_word + library.offsets[index]) + ")\n";
+}
+
+// Generate the .set declarations for the library symbols a PE can call
+std::string DFGProcessor::generateLibrarySymbols(int pe) {
+    std::string result;
+    auto it = function_libraries.find(getClusterNumber(pe));
+    if (it == function_libraries.end()) return result;
+    const FunctionLibrary& library = it->second;
+    std::set<int> used;
+    for (const auto& [key, index] : library.symbols) {
+        if (key.second == pe && used.insert(index).second) {
+            result += ".set " + library.labels[index] + ", " +
+                      std::to_string(library.base_word + library.offsets[index]) + "\n";
+        }
+    }
+    return result;
+}
+
+// Check whether a JAL targets a function body emitted into this PE's own image
+bool DFGProcessor::isLocalCall(const Instruction& instr, int pe) {
+    if (instr.target.empty() || (instr.operation != "JAL" && instr.operation != "jal")) return false;
+    auto it = function_pe_assignments.find(instr.target);
+    return it != function_pe_assignments.end() && it->second.count(pe) > 0;
+}
+
+// Check whether a JAL resolves into the cluster's shared library
+bool DFGProcessor::isLibraryCall(const Instruction& instr, int pe) {
+    if (instr.target.empty() || (instr.operation != "JAL" && instr.operation != "jal")) return false;
+    auto it = function_libraries.find(getClusterNumber(pe));
+    return it != function_libraries.end() && it->second.symbols.count({instr.target, pe}) > 0;
+}
+
+// Execution words a single instruction occupies
+int DFGProcessor::instructionWords(const Instruction& instr) {
+    int hwl_count = 0;
+    return countInstructionWords(generateInstructionCode(instr, hwl_count, 0));
+}
+
+// Execution word offset of each instruction (one extra entry for the end of the program)
+std::vector<int> DFGProcessor::instructionPositions(const std::vector<Instruction>& instructions) {
+    std::vector<int> position(instructions.size() + 1, 0);
+    for (size_t i = 0; i < instructions.size(); i++) {
+        position[i + 1] = position[i] + instructionWords(instructions[i]);
+    }
+    return position;
+}
+
+// Cycle model: how many times each instruction executes, from the product of the
+// iteration counts of every hardware loop whose pc range covers it
+std::vector<long long> DFGProcessor::dynamicCounts(const std::vector<Instruction>& instructions,
+                                                   const std::vector<int>& position) {
+    std::vector<long long> counts(instructions.size(), 1);
+    for (const auto& loop : instructions) {
+        if (!loop.hwl.has_value()) continue;
+        for (size_t i = 0; i < instructions.size(); i++) {
+            if (position[i] >= loop.hwl->pc_start && position[i] <= loop.hwl->pc_stop) {
+                counts[i] *= std::max(loop.hwl->iterations, 1);
+            }
+        }
+    }
+    return counts;
+}
+
+// Shift hardware loop pcs after replacing the instruction(s) at word `at` with code
+// that is `delta` words longer. A loop ending at the replaced code grows to cover it.
+void DFGProcessor::rebaseLoops(std::vector<Instruction>& instructions, int at, int delta) {
+    for (auto& instr : instructions) {
+        if (!instr.hwl.has_value()) continue;
+        if (instr.hwl->pc_start > at) instr.hwl->pc_start += delta;
+        if (instr.hwl->pc_stop >= at) instr.hwl->pc_stop += delta;
+    }
+}
+
+// Check that every hardware loop of a program fits the hwlrf pc fields
+bool DFGProcessor::loopsFit(const std::vector<Instruction>& instructions, int delay) {
+    for (const auto& instr : instructions) {
+        if (!instr.hwl.has_value()) continue;
+        if (instr.hwl->pc_start + delay > 0x1FF || instr.hwl->pc_stop - instr.hwl->pc_start > 0x3F) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Check whether an instruction transfers control (and so cannot move into or out of a body)
+bool DFGProcessor::isControlFlow(const Instruction& instr) {
+    std::string op = instr.operation;
+    std::transform(op.begin(), op.end(), op.begin(), ::toupper);
+    return instr.hwl.has_value() || op == "JAL" || op == "JALR" || op == "RET" ||
+           op == "BEQ" || op == "BNE" || op == "BLT" || op == "BGE" || op == "BLTU" || op == "BGEU";
+}
+
+// PEs that run the program stored at pe_assignments[base_pe]
+std::vector<int> DFGProcessor::pesForAssignment(int base_pe) {
+    std::vector<int> pes;
+    for (int pe = 0; pe < total_pes; pe++) {
+        if (pe % pes_per_cluster == base_pe) pes.push_back(pe);
+    }
+    return pes;
+}
+
+// Instructions of a program. A templated program is expanded into scratch, so only one
+// expansion is alive at a time however many PEs share the template.
+const std::vector<Instruction>& DFGProcessor::instructionsOf(const PEAssignment& assignment, std::vector<Instruction>& scratch) {
+    if (!assignment.source || !assignment.instructions.empty()) return assignment.instructions;
+    scratch = assignment.source->body.instructions;
+    for (const auto& binding : assignment.source->bindings) {
+        auto value = assignment.arguments.find(binding.parameter);
+        if (value != assignment.arguments.end()) {
+            setInstructionField(scratch[binding.instruction], binding.field, value->second);
+        }
+    }
+    Profiler::count("template_expansions", 1);
+    return scratch;
+}
+
+bool DFGProcessor::hasProgram(const PEAssignment& assignment) const {
+    return !assignment.instructions.empty() || (assignment.source && !assignment.source->body.instructions.empty());
+}
+
+// Expand a templated program into its instructions for a pass that may rewrite them
+void DFGProcessor::expandProgram(size_t base_pe) {
+    PEAssignment& assignment = pe_assignments[base_pe];
+    if (!assignment.source || !assignment.instructions.empty()) return;
+    std::vector<Instruction> expanded;
+    instructionsOf(assignment, expanded);
+    assignment.instructions = std::move(expanded);
+}
+
+// After such a pass: a rewritten program no longer follows its template; an unchanged one
+// drops the expansion again
+void DFGProcessor::settleProgram(size_t base_pe, bool rewritten) {
+    PEAssignment& assignment = pe_assignments[base_pe];
+    if (!assignment.source) return;
+    if (rewritten) {
+        assignment.source.reset();
+        assignment.arguments.clear();
+    } else {
+        std::vector<Instruction>().swap(assignment.instructions);
+    }
+}
+
+// Inline function bodies at JAL sites where the call overhead outweighs the IMEM cost.
+// A site is only inlined when every PE sharing the program has the same body.
+// Returns whether the program changed.
+bool DFGProcessor::inlineCalls(size_t base_pe) {
+    std::vector<Instruction>& program = pe_assignments[base_pe].instructions;
+    std::vector<int> pes = pesForAssignment(static_cast<int>(base_pe));
+    if (pes.empty()) return false;
+    bool rewritten = false;
+    std::set<std::string> inlined_functions;  // Functions with at least one inlined call site
+    int max_delay = 0;
+    for (int pe : pes) max_delay = std::max(max_delay, getDelayStart(pe));
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::vector<int> position = instructionPositions(program);
+        std::vector<long long> counts = dynamicCounts(program, position);
+
+        for (size_t i = 0; i < program.size(); i++) {
+            const Instruction& site = program[i];
+            if (site.target.empty() || (site.operation != "JAL" && site.operation != "jal")) continue;
+            auto func = function_pe_assignments.find(site.target);
+            if (func == function_pe_assignments.end()) continue;
+
+            // Every PE running this program must carry the same straight-line body
+            std::string body_text;
+            const std::vector<Instruction>* body = nullptr;
+            bool uniform = true;
+            for (int pe : pes) {
+                auto it = func->second.find(pe);
+                if (it == func->second.end()) { uniform = false; break; }
+                std::string text;
+                int hwl_count = 0;
+                for (const auto& instr : it->second.instructions) {
+                    text += generateInstructionCode(instr, hwl_count, 0);
+                }
+                if (body == nullptr) {
+                    body = &it->second.instructions;
+                    body_text = text;
+                } else if (text != body_text) {
+                    uniform = false;
+                    break;
+                }
+            }
+            if (!uniform || body == nullptr) continue;
+
+            std::vector<Instruction> inlined(*body);
+            if (!inlined.empty() && inlined.back().operation == "JALR") inlined.pop_back();
+            bool straight_line = true;
+            int body_words = 0;
+            for (const auto& instr : inlined) {
+                if (isControlFlow(instr)) straight_line = false;
+                body_words += instructionWords(instr);
+            }
+            if (!straight_line) continue;
+
+            // Each call pays the jump, the return and a refill after both
+            long long saved_cycles = counts[i] * (2 + 2 * call_penalty);
+            int delta = body_words - 1;
+            bool small = body_words <= inline_max_body_words;
+            bool hot = counts[i] >= inline_min_hot_count &&
+                       max_delay + position.back() + delta + 1 <= imem_execution_words;
+            if (!small && !hot) continue;
+
+            std::vector<Instruction> candidate = program;
+            rebaseLoops(candidate, position[i], delta);
+            candidate.erase(candidate.begin() + i);
+            candidate.insert(candidate.begin() + i, inlined.begin(), inlined.end());
+            if (!loopsFit(candidate, max_delay)) continue;
+
+            log() << "Inlined " << site.target << " into PE program " << base_pe << " at execution word "
+                      << position[i] << " (executed " << counts[i] << " times, saves " << saved_cycles
+                      << " cycles, " << (delta >= 0 ? "+" : "") << delta << " words)" << std::endl;
+            inlined_functions.insert(site.target);
+            program = std::move(candidate);
+            changed = true;
+            rewritten = true;
+            break;
+        }
+    }
+
+    // Drop the bodies of inlined functions once nothing on these PEs can reach them any more:
+    // no call by name from the program or another function, and no jal to their address
+    for (const std::string& name : inlined_functions) {
+        auto func = function_pe_assignments.find(name);
+        if (func == function_pe_assignments.end()) continue;
+        auto address = function_addresses.find(name);
+        auto calls = [&](const std::vector<Instruction>& instructions) {
+            for (const auto& instr : instructions) {
+                if (instr.operation != "JAL" && instr.operation != "jal") continue;
+                if (instr.target == name) return true;
+                if (instr.target.empty() && address != function_addresses.end() && instr.imm == address->second) {
+                    return true;
+                }
+            }
+            return false;
+        };
+        bool reachable = calls(program);
+        for (const auto& [other, other_pes] : function_pe_assignments) {
+            if (other == name) continue;
+            for (int pe : pes) {
+                auto body = other_pes.find(pe);
+                if (body != other_pes.end() && calls(body->second.instructions)) reachable = true;
+            }
+        }
+        if (reachable) continue;
+        for (int pe : pes) func->second.erase(pe);
+        if (func->second.empty()) function_pe_assignments.erase(func);
+    }
+    return rewritten;
+}
+
+// Outline repeated straight-line sequences outside hardware loops into functions
+// while the program does not fit the execution window. Outlined code runs once
+// per call, so the only cost is the added jump and return. Returns whether the program changed.
+bool DFGProcessor::outlineSequences(size_t base_pe) {
+    std::vector<Instruction>& program = pe_assignments[base_pe].instructions;
+    std::vector<int> pes = pesForAssignment(static_cast<int>(base_pe));
+    if (pes.empty()) return false;
+    int max_delay = 0;
+    for (int pe : pes) max_delay = std::max(max_delay, getDelayStart(pe));
+
+    // x26 is the return link of outlined calls
+    for (const auto& instr : program) {
+        if (instr.rd == "x26" || instr.ra1 == "x26" || instr.ra2 == "x26") return false;
+    }
+
+    int outlined = 0;
+    while (true) {
+        std::vector<int> position = instructionPositions(program);
+        int function_words = 0;
+        for (const auto& [name, pe_assigns] : function_pe_assignments) {
+            auto it = pe_assigns.find(pes.front());
+            if (it == pe_assigns.end()) continue;
+            for (const auto& instr : it->second.instructions) function_words += instructionWords(instr);
+            function_words += 1;
+        }
+        if (max_delay + position.back() + function_words + 1 <= imem_execution_words) return outlined > 0;
+
+        // Instructions eligible for outlining: straight-line code outside every loop range
+        std::vector<bool> eligible(program.size(), true);
+        std::vector<std::string> text(program.size());
+        for (size_t i = 0; i < program.size(); i++) {
+            int hwl_count = 0;
+            text[i] = generateInstructionCode(program[i], hwl_count, 0);
+            if (isControlFlow(program[i])) eligible[i] = false;
+            for (const auto& loop : program) {
+                if (loop.hwl.has_value() && position[i] >= loop.hwl->pc_start &&
+                    position[i] <= loop.hwl->pc_stop) {
+                    eligible[i] = false;
+                }
+            }
+        }
+
+        // Pick the repeated sequence with the largest word saving
+        int best_saving = 0;
+        size_t best_length = 0;
+        std::vector<size_t> best_sites;
+        for (int length = outline_min_length; length <= outline_max_length; length++) {
+            std::map<std::string, std::vector<size_t>> occurrences;
+            for (size_t i = 0; i + length <= program.size(); i++) {
+                std::string key;
+                bool ok = true;
+                for (size_t j = i; j < i + length && ok; j++) {
+                    ok = eligible[j];
+                    key += text[j];
+                }
+                if (!ok) continue;
+                auto& sites = occurrences[key];
+                if (sites.empty() || sites.back() + length <= i) sites.push_back(i);
+            }
+            for (const auto& [key, sites] : occurrences) {
+                if (sites.size() < 2) continue;
+                int words = countInstructionWords(key);
+                // Each site shrinks to one jal; the body is stored once with its return
+                int saving = static_cast<int>(sites.size()) * (words - 1) - (words + 1);
+                if (saving > best_saving) {
+                    best_saving = saving;
+                    best_length = length;
+                    best_sites = sites;
+                }
+            }
+        }
+        if (best_saving <= 0) return outlined > 0;
+
+        std::string name = "outlined_" + std::to_string(base_pe) + "_" + std::to_string(outlined++);
+        std::vector<Instruction> body(program.begin() + best_sites.front(),
+                                      program.begin() + best_sites.front() + best_length);
+        int body_words = position[best_sites.front() + best_length] - position[best_sites.front()];
+        Instruction ret;
+        ret.operation = "JALR";
+        ret.format = "i-type";
+        ret.rd = "x0";
+        ret.ra1 = "x26";
+        ret.ra2 = "null";
+        ret.imm = 0;
+        ret.address = 0;
+        ret.offset = 0;
+        body.push_back(ret);
+
+        Instruction call = ret;
+        call.operation = "JAL";
+        call.format = "j-type";
+        call.rd = "x26";
+        call.ra1 = "null";
+        call.target = name;
+
+        // Replace sites back to front so earlier positions stay valid
+        for (auto it = best_sites.rbegin(); it != best_sites.rend(); ++it) {
+            rebaseLoops(program, position[*it] + 1, -(body_words - 1));
+            program.erase(program.begin() + *it, program.begin() + *it + best_length);
+            program.insert(program.begin() + *it, call);
+        }
+
+        PEAssignment func_assignment;
+        func_assignment.has_psrf_mem_type = false;
+        func_assignment.has_mem_type = false;
+        func_assignment.has_hwl = false;
+        func_assignment.instructions = body;
+        for (int pe : pes) {
+            func_assignment.pe_id = pe;
+            function_pe_assignments[name][pe] = func_assignment;
+        }
+        function_addresses[name] = 0;
+
+        log() << "Outlined " << best_sites.size() << " copies of a " << body_words << "-word sequence from PE program "
+                  << base_pe << " into " << name << " (saves " << best_saving << " words)" << std::endl;
+    }
+}
+
+// Check that a hardware loop still fits the hwlrf immediate fields once placed
+void DFGProcessor::checkHWLFields(const HardwareLoop& hwl, int delay, int pe) {
+    if (hwl.pc_start + delay > 0x1FF || hwl.pc_start + delay < 0) {
+        throw std::runtime_error("PE " + std::to_string(pe) + ": HWL L" + std::to_string(hwl.loop_id) +
+                                 " pc_start " + std::to_string(hwl.pc_start + delay) +
+                                 " does not fit the 9-bit pc_start field");
+    }
+    if (hwl.pc_stop - hwl.pc_start > 0x3F || hwl.pc_stop < hwl.pc_start) {
+        throw std::runtime_error("PE " + std::to_string(pe) + ": HWL L" + std::to_string(hwl.loop_id) +
+                                 " body " + std::to_string(hwl.pc_start) + ".." + std::to_string(hwl.pc_stop) +
+                                 " does not fit the 6-bit pc_stop field");
+    }
+}
+
+// Split the execution instructions of a PE into overlay segments that each fit
+// the execution window. A segment boundary may not fall between a HWL setup
+// instruction and the end of its loop body, since the loop registers are
+// programmed relative to the overlay that is resident when the loop runs.
+std::vector<DFGProcessor::OverlaySegment> DFGProcessor::planOverlays(const std::vector<Instruction>& instructions, const std::vector<int>& words,
+                                                                     int first_capacity, int capacity, int pe) {
+    size_t n = instructions.size();
+
+    // Execution word offset of each instruction
+    std::vector<int> position(n + 1, 0);
+    for (size_t i = 0; i < n; i++) {
+        position[i + 1] = position[i] + words[i];
+    }
+
+    // A boundary before instruction i is legal unless it splits a hardware loop
+    std::vector<bool> legal(n + 1, true);
+    for (size_t h = 0; h < n; h++) {
+        const auto& instr = instructions[h];
+        if (!instr.hwl.has_value()) continue;
+        for (size_t i = h + 1; i <= n && position[i] <= instr.hwl->pc_stop; i++) {
+            legal[i] = false;
+        }
+    }
+
+    std::vector<OverlaySegment> segments;
+    size_t begin = 0;
+    while (begin < n) {
+        int cap = segments.empty() ? first_capacity : capacity;
+        size_t end = begin;
+        size_t last_legal = begin;
+        while (end < n && position[end + 1] - position[begin] <= cap) {
+            end++;
+            if (legal[end]) last_legal = end;
+        }
+        if (end == n) {
+            last_legal = n;
+        }
+        if (last_legal == begin) {
+            throw std::runtime_error("PE " + std::to_string(pe) + ": instructions starting at execution word " +
+                                     std::to_string(position[begin]) + " cannot be split into an overlay of " +
+                                     std::to_string(cap) + " words without breaking a hardware loop");
+        }
+        segments.push_back({begin, last_legal, position[begin], position[last_legal] - position[begin]});
+        begin = last_legal;
+    }
+    return segments;
+}
+
+// Overlay phases of a PE's execution image. A later phase is loaded over the earlier one, so
+// every phase carries its own copy of the function bodies and the terminating ret
+// (fixed_words); the first also holds the delay nops. A program that fits is one phase.
+std::vector<DFGProcessor::OverlaySegment> DFGProcessor::layoutExecution(const std::vector<Instruction>& program, const std::vector<int>& words,
+                                                                        int fixed_words, int delay, int window, int pe) {
+    int program_words = 0;
+    for (int w : words) program_words += w;
+    if (delay + program_words + fixed_words <= window) {
+        return {{0, program.size(), 0, program_words}};
+    }
+    int first_capacity = window - fixed_words - delay;
+    int capacity = window - fixed_words;
+    if (first_capacity <= 0 || capacity <= 0) {
+        throw std::runtime_error("PE " + std::to_string(pe) + ": function bodies and delay padding (" +
+                                 std::to_string(fixed_words + delay) + " words) leave no room in the " +
+                                 std::to_string(window) + "-word execution window");
+    }
+    return planOverlays(program, words, first_capacity, capacity, pe);
+}
+
+// Words loaded into the execution window over all phases of an image
+int DFGProcessor::executionWords(const std::vector<OverlaySegment>& segments, int fixed_words, int delay) {
+    int total = delay;
+    for (const auto& segment : segments) total += segment.words + fixed_words;
+    return total;
+}
+
+// Read one instruction of the YAML format; flags what the owning program needs
+Instruction DFGProcessor::parseInstruction(const YAML::Node& instr, PEAssignment& pe_assignment) {
+    Instruction instruction;
+    instruction.operation = instr["operation"].as<std::string>();
+    instruction.format = instr["format"].as<std::string>();
+    
+    // Handle hardware loop instructions
+    if (instruction.format == "hwl-type") {
+        pe_assignment.has_hwl = true;
+        HardwareLoop hwl;
+        hwl.loop_id = instr["loop_id"].as<int>();
+        hwl.pc_start = instr["pc_start"].as<int>();
+        hwl.pc_stop = instr["pc_stop"].as<int>();
+        hwl.hwl_index = instr["hwl_index"].as<int>();
+        hwl.iterations = instr["iterations"].as<int>();
+        instruction.hwl = hwl;
+    }
+    
+    // Handle register assignments
+    instruction.ra1 = "null";
+    instruction.ra2 = "null";
+    instruction.rd = "null";
+    if (instr["ra1"] && !instr["ra1"].IsNull()) {
+        instruction.ra1 = instr["ra1"].as<std::string>();
+    }
+    if (instr["ra2"] && !instr["ra2"].IsNull()) {
+        instruction.ra2 = instr["ra2"].as<std::string>();
+    }
+    if (instr["rd"] && !instr["rd"].IsNull()) {
+        instruction.rd = instr["rd"].as<std::string>();
+    }
+
+    // Handle immediate value for I-type instructions
+    instruction.imm = 0;  // Default value
+    if (instr["imm"] && !instr["imm"].IsNull()) {
+        instruction.imm = instr["imm"].as<int>();
+    }
+    
+    // Set operation to uppercase for standard operations if needed
+    if (instruction.format == "i-type" || instruction.format == "r-type") {
+        instruction.operation = instruction.operation;
+        // Make sure operation is uppercase for standard operations
+        if (instruction.operation == "addi" || instruction.operation == "add" ||
+            instruction.operation == "mul" || instruction.operation == "lw" ||
+            instruction.operation == "sw") {
+            // Convert to uppercase for internal processing
+            std::string upper_op = instruction.operation;
+            std::transform(upper_op.begin(), upper_op.end(), upper_op.begin(), ::toupper);
+            instruction.operation = upper_op;
+        }
+    }
+    
+    // Handle base address
+    if (instr["base_address"] && !instr["base_address"].IsNull()) {
+        instruction.base_address = instr["base_address"].as<std::string>();
+        if (instruction.format == "psrf-mem-type" || instruction.format == "mem-type") {
+            pe_assignment.required_base_registers.insert(instruction.base_address);
+        }
+    }
+
+    // Load var field for psrf-mem-type
+    if (instruction.format == "psrf-mem-type") {
+        pe_assignment.has_psrf_mem_type = true;
+        if (instr["var"] && !instr["var"].IsNull()) {
+            instruction.var = instr["var"].as<int>();
+        }
+
+        // Load psrf_var values
+        if (instr["psrf_var"] && !instr["psrf_var"].IsNull()) {
+            auto psrf_vars = instr["psrf_var"];
+            for (const auto& var : psrf_vars) {
+                instruction.psrf_var[var.first.as<std::string>()] = var.second.as<int>();
+            }
+        }
+
+        // Load coefficients
+        if (instr["coefficients"] && !instr["coefficients"].IsNull()) {
+            auto coeffs = instr["coefficients"];
+            for (const auto& coeff : coeffs) {
+                instruction.coefficients[coeff.first.as<std::string>()] = coeff.second.as<int>();
+            }
+        }
+    }
+
+    if (instruction.format == "mem-type") {
+        pe_assignment.has_mem_type = true;
+    }
+    
+    // Load target field for JAL instructions
+    if (instr["target"] && !instr["target"].IsNull()) {
+        instruction.target = instr["target"].as<std::string>();
+    }
+
+    // Load address field for JAL instructions
+    if (instr["address"] && !instr["address"].IsNull()) {
+        instruction.address = instr["address"].as<int>();
+    }
+
+    // Load offset field for memory operations
+    if (instr["offset"] && !instr["offset"].IsNull()) {
+        instruction.offset = instr["offset"].as<int>();
+    }
+    return instruction;
+}
+
+// Set one field of a parsed instruction from its YAML text, as parseInstruction reads it
+void DFGProcessor::setInstructionField(Instruction& instruction, const std::string& field, const std::string& value) {
+    YAML::Node node(value);
+    size_t dot = field.find('.');
+    if (field == "operation") {
+        instruction.operation = value;
+        if ((instruction.format == "i-type" || instruction.format == "r-type") &&
+            (value == "addi" || value == "add" || value == "mul" || value == "lw" || value == "sw")) {
+            std::transform(instruction.operation.begin(), instruction.operation.end(),
+                           instruction.operation.begin(), ::toupper);
+        }
+    } else if (field == "ra1") {
+        instruction.ra1 = value;
+    } else if (field == "ra2") {
+        instruction.ra2 = value;
+    } else if (field == "rd") {
+        instruction.rd = value;
+    } else if (field == "base_address") {
+        instruction.base_address = value;
+    } else if (field == "target") {
+        instruction.target = value;
+    } else if (field == "var") {
+        instruction.var = node.as<int>();
+    } else if (field == "imm") {
+        instruction.imm = node.as<int>();
+    } else if (field == "address") {
+        instruction.address = node.as<int>();
+    } else if (field == "offset") {
+        instruction.offset = node.as<int>();
+    } else if (dot != std::string::npos && field.substr(0, dot) == "psrf_var") {
+        instruction.psrf_var[field.substr(dot + 1)] = node.as<int>();
+    } else if (dot != std::string::npos && field.substr(0, dot) == "coefficients") {
+        instruction.coefficients[field.substr(dot + 1)] = node.as<int>();
+    } else if (instruction.hwl.has_value() && field == "loop_id") {
+        instruction.hwl->loop_id = node.as<int>();
+    } else if (instruction.hwl.has_value() && field == "pc_start") {
+        instruction.hwl->pc_start = node.as<int>();
+    } else if (instruction.hwl.has_value() && field == "pc_stop") {
+        instruction.hwl->pc_stop = node.as<int>();
+    } else if (instruction.hwl.has_value() && field == "hwl_index") {
+        instruction.hwl->hwl_index = node.as<int>();
+    } else if (instruction.hwl.has_value() && field == "iterations") {
+        instruction.hwl->iterations = node.as<int>();
+    } else {
+        throw std::runtime_error("Field " + field + " cannot be a template parameter");
+    }
+}
+
+// Parse a scheduling.templates entry. Fields whose value is "$name" are bound to the
+// parameter name and parsed with its default, or a placeholder when it has none.
+std::shared_ptr<PETemplate> DFGProcessor::parseTemplate(const std::string& name, const YAML::Node& node) {
+    auto templ = std::make_shared<PETemplate>();
+    templ->name = name;
+    if (node["parameters"]) {
+        for (const auto& parameter : node["parameters"]) {
+            std::optional<std::string> value;
+            if (!parameter.second.IsNull()) value = parameter.second.as<std::string>();
+            templ->parameters[parameter.first.as<std::string>()] = value;
+        }
+    }
+    PEAssignment& body = templ->body;
+    body.pe_id = -1;
+    body.has_psrf_mem_type = false;
+    body.has_mem_type = false;
+    body.has_hwl = false;
+
+    for (const auto& instr : node["instructions"]) {
+        YAML::Node resolved = YAML::Clone(instr);
+        size_t index = body.instructions.size();
+        // Substitute the default of a "$name" scalar and remember the field it came from
+        auto bind = [&](YAML::Node value, const std::string& field) {
+            if (!value.IsScalar()) return;
+            std::string text = value.Scalar();
+            if (text.size() < 2 || text[0] != '$') return;
+            std::string parameter = text.substr(1);
+            auto declared = templ->parameters.find(parameter);
+            if (declared == templ->parameters.end()) {
+                throw std::runtime_error("Template " + name + " uses undeclared parameter $" + parameter);
+            }
+            if (field == "format") {
+                throw std::runtime_error("Template " + name + ": format cannot be a template parameter");
+            }
+            templ->bindings.push_back({index, field, parameter});
+            value = declared->second.value_or("0");
+        };
+        std::vector<std::string> keys;
+        for (const auto& field : resolved) keys.push_back(field.first.as<std::string>());
+        for (const auto& key : keys) {
+            if (resolved[key].IsMap()) {
+                for (const auto& nested : resolved[key]) bind(nested.second, key + "." + nested.first.as<std::string>());
+            } else {
+                bind(resolved[key], key);
+            }
+        }
+        body.instructions.push_back(parseInstruction(resolved, body));
+    }
+
+    // Memory base registers that every user of the template needs
+    std::set<size_t> bound_bases;
+    for (const auto& binding : templ->bindings) {
+        if (binding.field == "base_address") bound_bases.insert(binding.instruction);
+    }
+    for (size_t i = 0; i < body.instructions.size(); i++) {
+        const Instruction& instr = body.instructions[i];
+        if ((instr.format == "psrf-mem-type" || instr.format == "mem-type") && bound_bases.count(i) == 0 &&
+            !instr.base_address.empty()) {
+            templ->fixed_base_registers.insert(instr.base_address);
+        }
+    }
+    Profiler::count("instructions_loaded", body.instructions.size());
+    return templ;
+}
+
+// PE assignment that runs a template with overrides for some of its parameters
+PEAssignment DFGProcessor::templatedAssignment(const YAML::Node& assignment,
+                                               const std::map<std::string, std::shared_ptr<PETemplate>>& templates) {
+    PEAssignment pe_assignment;
+    pe_assignment.pe_id = assignment["pe_id"].as<int>();
+    std::string name = assignment["template"].as<std::string>();
+    std::string where = "PE assignment " + std::to_string(pe_assignment.pe_id) + ": ";
+    auto found = templates.find(name);
+    if (found == templates.end()) throw std::runtime_error(where + "unknown template " + name);
+    if (assignment["instructions"]) throw std::runtime_error(where + "give either template or instructions, not both");
+    const PETemplate& templ = *found->second;
+    pe_assignment.source = found->second;
+    pe_assignment.has_psrf_mem_type = templ.body.has_psrf_mem_type;
+    pe_assignment.has_mem_type = templ.body.has_mem_type;
+    pe_assignment.has_hwl = templ.body.has_hwl;
+
+    if (assignment["overrides"]) {
+        for (const auto& entry : assignment["overrides"]) {
+            std::string parameter = entry.first.as<std::string>();
+            if (templ.parameters.count(parameter) == 0) {
+                throw std::runtime_error(where + "template " + name + " has no parameter " + parameter);
+            }
+            pe_assignment.arguments[parameter] = entry.second.IsNull() ? "null" : entry.second.as<std::string>();
+        }
+    }
+    for (const auto& [parameter, value] : templ.parameters) {
+        if (!value.has_value() && pe_assignment.arguments.count(parameter) == 0) {
+            throw std::runtime_error(where + "template " + name + " needs a value for parameter " + parameter);
+        }
+    }
+
+    // Check each override against the fields it sets, without expanding the program
+    pe_assignment.required_base_registers = templ.fixed_base_registers;
+    for (const auto& binding : templ.bindings) {
+        auto value = pe_assignment.arguments.find(binding.parameter);
+        Instruction probe = templ.body.instructions[binding.instruction];
+        if (value != pe_assignment.arguments.end()) {
+            try {
+                setInstructionField(probe, binding.field, value->second);
+            } catch (const YAML::Exception&) {
+                throw std::runtime_error(where + "parameter " + binding.parameter + " = " + value->second +
+                                         " is not a valid " + binding.field);
+            }
+        }
+        if (binding.field == "base_address" && (probe.format == "psrf-mem-type" || probe.format == "mem-type")) {
+            pe_assignment.required_base_registers.insert(probe.base_address);
+        }
+    }
+    return pe_assignment;
+}
+
+// Programs of a binary configuration, exactly as parseInstruction built them when it was written
+std::vector<PEAssignment> DFGProcessor::binaryPrograms(const BinaryConfigReader& reader) {
+    std::vector<PEAssignment> programs(reader.program_count());
+    for (uint32_t p = 0; p < reader.program_count(); p++) {
+        const ProgramRecord& record = reader.programs[p];
+        PEAssignment& program = programs[p];
+        program.pe_id = record.pe_id;
+        program.has_psrf_mem_type = (record.flags & PROGRAM_PSRF_MEM) != 0;
+        program.has_mem_type = (record.flags & PROGRAM_MEM) != 0;
+        program.has_hwl = (record.flags & PROGRAM_HWL) != 0;
+        for (uint32_t r = 0; r < record.register_count; r++) {
+            program.required_base_registers.insert(reader.string(reader.registers[record.first_register + r]));
+        }
+        program.instructions.resize(record.instruction_count);
+        for (uint32_t i = 0; i < record.instruction_count; i++) {
+            const InstructionRecord& fields = reader.instructions[record.first_instruction + i];
+            Instruction& instr = program.instructions[i];
+            instr.operation = reader.string(fields.operation);
+            instr.format = reader.string(fields.format);
+            instr.ra1 = reader.string(fields.ra1);
+            instr.ra2 = reader.string(fields.ra2);
+            instr.rd = reader.string(fields.rd);
+            instr.base_address = reader.string(fields.base_address);
+            instr.target = reader.string(fields.target);
+            instr.imm = fields.imm;
+            instr.address = fields.address;
+            instr.offset = fields.offset;
+            if (fields.flags & INSTRUCTION_VAR) instr.var = fields.var;
+            if (fields.flags & INSTRUCTION_HWL) {
+                instr.hwl = HardwareLoop{fields.loop_id, fields.pc_start, fields.pc_stop, fields.hwl_index,
+                                         fields.iterations};
+            }
+            for (uint32_t k = 0; k < fields.psrf_var_count; k++) {
+                const PairRecord& pair = reader.pairs[fields.first_psrf_var + k];
+                instr.psrf_var.emplace_hint(instr.psrf_var.end(), reader.string(pair.key), pair.value);
+            }
+            for (uint32_t k = 0; k < fields.coefficient_count; k++) {
+                const PairRecord& pair = reader.pairs[fields.first_coefficient + k];
+                instr.coefficients.emplace_hint(instr.coefficients.end(), reader.string(pair.key), pair.value);
+            }
+        }
+    }
+    return programs;
+}
+
+bool DFGProcessor::isStore(const Instruction& instr) {
+    std::string op = instr.operation;
+    std::transform(op.begin(), op.end(), op.begin(), ::toupper);
+    return op == "SW" || op == "SH" || op == "SB" || op == "PSRF.SW" || op == "PSRF.SB";
+}
+
+// Partition a dataflow graph (nodes = operations, inputs = values) across the base PEs and
+// build their pe_assignments. Values consumed on another PE are stored to a slot of the
+// exchange region by the producer and loaded by the consumer; loads are padded with nops so
+// they issue after the store when the PEs run in lockstep, and every loop body is padded to
+// the same length so iterations stay aligned.
+void DFGProcessor::loadDataflowGraph(YAML::Node config) {
+    YAML::Node graph_conf = config["scheduling"]["dataflow_graph"];
+    int pes = graph_conf["pes"] ? graph_conf["pes"].as<int>() : pes_per_cluster;
+    pes = std::max(1, std::min({pes, pes_per_cluster, minimum_pes_required + 1}));
+    std::string exchange_base = graph_conf["exchange_base"] ? graph_conf["exchange_base"].as<std::string>() : "x25";
+
+    // Nodes in topological order; stores produce no value
+    std::vector<Instruction> nodes;
+    std::vector<std::string> ids;
+    std::map<std::string, int> index;
+    PartitionGraph graph;
+    PEAssignment flags;
+    for (const auto& node : graph_conf["nodes"]) {
+        std::string id = node["id"].as<std::string>();
+        if (index.count(id) > 0) throw std::runtime_error("dataflow_graph: duplicate node " + id);
+        Instruction instr = parseInstruction(node, flags);
+        std::vector<int> inputs;
+        for (const auto& input : node["inputs"]) {
+            auto it = index.find(input.as<std::string>());
+            if (it == index.end()) {
+                throw std::runtime_error("dataflow_graph: node " + id + " uses " + input.as<std::string>() +
+                                         " before it is defined");
+            }
+            inputs.push_back(it->second);
+        }
+        index[id] = static_cast<int>(nodes.size());
+        ids.push_back(id);
+        nodes.push_back(instr);
+        graph.weight.push_back(instructionWords(instr));
+        graph.inputs.push_back(inputs);
+    }
+
+    GraphPartition partition = partition_graph(graph, pes);
+    log() << "Partitioned dataflow graph of " << nodes.size() << " nodes across " << pes << " PEs ("
+              << (partition.exhaustive ? "exhaustive search" : "greedy + refinement") << "): lockstep schedule "
+              << partition.makespan << " cycles, " << partition.traffic << " cross-PE values" << std::endl;
+
+    auto isLoad = [](const Instruction& instr) {
+        return instr.format == "psrf-mem-type" || instr.format == "mem-type";
+    };
+    auto blank = []() {
+        Instruction instr;
+        instr.ra1 = instr.ra2 = instr.rd = "null";
+        instr.imm = 0;
+        instr.address = 0;
+        instr.offset = 0;
+        return instr;
+    };
+
+    // Exchange slots of the values that cross PEs
+    std::map<int, int> slot;
+    for (size_t n = 0; n < nodes.size(); n++) {
+        for (int input : graph.inputs[n]) {
+            if (partition.part[input] != partition.part[n] && slot.count(input) == 0) {
+                int next = static_cast<int>(slot.size());
+                slot[input] = next;
+            }
+        }
+    }
+    if (!slot.empty() && mem_config.count(exchange_base) == 0) {
+        throw std::runtime_error("dataflow_graph: exchange base " + exchange_base + " has no mem_config address");
+    }
+    if (slot.size() * 4 > 2048) {
+        throw std::runtime_error("dataflow_graph: " + std::to_string(slot.size()) +
+                                 " cross-PE values exceed the 512 exchange slots a 12-bit offset reaches");
+    }
+
+    // Lockstep schedule: one word per cycle on every PE
+    struct Step {
+        Instruction instr;
+        std::string def;                // Value written
+        std::vector<std::string> uses;  // Values read
+    };
+    std::vector<std::vector<Step>> programs(pes);
+    std::vector<int> time(pes, 0);
+    std::vector<int> nops(pes, 0);
+    std::map<int, int> store_time;
+    std::vector<std::set<int>> received(pes);
+    auto emit = [&](int pe, const Step& step) {
+        programs[pe].push_back(step);
+        time[pe] += instructionWords(step.instr);
+    };
+    auto nop = [&]() {
+        Step step{blank(), "", {}};
+        step.instr.operation = "ADDI";
+        step.instr.format = "i-type";
+        step.instr.rd = "x0";
+        step.instr.ra1 = "x0";
+        return step;
+    };
+    for (size_t n = 0; n < nodes.size(); n++) {
+        int pe = partition.part[n];
+        for (int input : graph.inputs[n]) {
+            if (partition.part[input] == pe || received[pe].count(input) > 0) continue;
+            for (; time[pe] <= store_time[input]; nops[pe]++) emit(pe, nop());
+            Step load{blank(), ids[input], {}};
+            load.instr.operation = "LW";
+            load.instr.format = "mem-type";
+            load.instr.base_address = exchange_base;
+            load.instr.offset = slot[input] * 4;
+            emit(pe, load);
+            received[pe].insert(input);
+        }
+
+        Step step{nodes[n], isStore(nodes[n]) ? "" : ids[n], {}};
+        for (int input : graph.inputs[n]) step.uses.push_back(ids[input]);
+        emit(pe, step);
+
+        if (slot.count(static_cast<int>(n)) > 0) {
+            Step store{blank(), "", {ids[n]}};
+            store.instr.operation = "SW";
+            store.instr.format = "mem-type";
+            store.instr.base_address = exchange_base;
+            store.instr.offset = slot[static_cast<int>(n)] * 4;
+            store_time[static_cast<int>(n)] = time[pe];
+            emit(pe, store);
+        }
+    }
+
+    // Hardware loop nest around every PE's partition; bodies padded to the same length
+    std::vector<std::pair<int, int>> loops;  // (hwl_index, iterations)
+    for (const auto& loop : graph_conf["loops"]) {
+        loops.push_back({loop["hwl_index"].as<int>(), loop["iterations"].as<int>()});
+    }
+    int depth = static_cast<int>(loops.size());
+    int body = *std::max_element(time.begin(), time.end());
+    if (depth > 0) {
+        for (int pe = 0; pe < pes; pe++) {
+            for (; time[pe] < body; nops[pe]++) emit(pe, nop());
+        }
+    }
+
+    pe_assignments.clear();
+    YAML::Node assignments_node;
+    for (int pe = 0; pe < pes_per_cluster; pe++) {
+        PEAssignment assignment;
+        assignment.pe_id = pe;
+        assignment.has_psrf_mem_type = false;
+        assignment.has_mem_type = false;
+        assignment.has_hwl = depth > 0 && pe < pes;
+        if (pe < pes) {
+            for (int level = 0; level < depth; level++) {
+                Instruction hwl = blank();
+                hwl.operation = "HWL";
+                hwl.format = "hwl-type";
+                hwl.hwl = HardwareLoop{level + 1, 2 * (level + 1), 2 * depth + body - 1, loops[level].first,
+                                       loops[level].second};
+                assignment.instructions.push_back(hwl);
+            }
+
+            // Values become virtual registers; allocateRegisters maps them without spilling
+            for (auto& step : programs[pe]) {
+                Instruction& instr = step.instr;
+                std::string dest = step.def.empty() ? "" : "%" + step.def;
+                std::vector<std::string> sources;
+                for (const auto& value : step.uses) sources.push_back("%" + value);
+                if (isLoad(instr)) {
+                    // Loads write ra1, stores read it
+                    instr.ra1 = dest.empty() ? (sources.empty() ? "x0" : sources[0]) : dest;
+                } else if (!dest.empty() || !sources.empty()) {
+                    instr.rd = dest.empty() ? "x0" : dest;
+                    instr.ra1 = sources.size() > 0 ? sources[0] : "x0";
+                    if (instr.format == "r-type") instr.ra2 = sources.size() > 1 ? sources[1] : "x0";
+                }
+                if (instr.format == "psrf-mem-type") assignment.has_psrf_mem_type = true;
+                if (instr.format == "mem-type") assignment.has_mem_type = true;
+                if (isLoad(instr)) assignment.required_base_registers.insert(instr.base_address);
+                assignment.instructions.push_back(instr);
+            }
+            log() << "Dataflow PE " << pe << ": " << programs[pe].size() << " instructions, " << time[pe]
+                      << " words, " << nops[pe] << " of them nops" << std::endl;
+        }
+        Profiler::count("instructions_loaded", assignment.instructions.size());
+        pe_assignments.push_back(assignment);
+
+        YAML::Node assignment_node;
+        assignment_node["pe_id"] = pe;
+        assignment_node["instructions"] = YAML::Node(YAML::NodeType::Sequence);
+        for (const auto& instr : assignment.instructions) assignment_node["instructions"].push_back(instructionNode(instr));
+        assignments_node.push_back(assignment_node);
+    }
+
+    partitioned = true;
+    partitioned_config = YAML::Clone(config);
+    partitioned_config["scheduling"].remove("dataflow_graph");
+    partitioned_config["scheduling"]["pe_assignments"] = assignments_node;
+}
+
+// YAML form of an instruction, as read by parseInstruction
+YAML::Node DFGProcessor::instructionNode(const Instruction& instr) {
+    YAML::Node node;
+    node["operation"] = instr.operation;
+    node["format"] = instr.format;
+    if (instr.hwl.has_value()) {
+        node["loop_id"] = instr.hwl->loop_id;
+        node["pc_start"] = instr.hwl->pc_start;
+        node["pc_stop"] = instr.hwl->pc_stop;
+        node["hwl_index"] = instr.hwl->hwl_index;
+        node["iterations"] = instr.hwl->iterations;
+        return node;
+    }
+    if (instr.rd != "null") node["rd"] = instr.rd;
+    if (instr.ra1 != "null") node["ra1"] = instr.ra1;
+    if (instr.ra2 != "null") node["ra2"] = instr.ra2;
+    if (instr.format == "i-type") node["imm"] = instr.imm;
+    if (!instr.base_address.empty()) node["base_address"] = instr.base_address;
+    if (instr.var.has_value()) node["var"] = instr.var.value();
+    for (const auto& [key, value] : instr.psrf_var) node["psrf_var"][key] = value;
+    for (const auto& [key, value] : instr.coefficients) node["coefficients"][key] = value;
+    if (instr.format == "mem-type" || instr.format == "psrf-mem-type") node["offset"] = instr.offset;
+    if (!instr.target.empty()) {
+        node["target"] = instr.target;
+        node["address"] = instr.address;
+    }
+    return node;
+}
+
+// Inlining, outlining and library placement, done once before code is generated or estimated
+void DFGProcessor::optimizeCalls() {
+    if (calls_optimized) return;
+    calls_optimized = true;
+    ScopedTimer timer("optimize_calls");
+    for (size_t base_pe = 0; base_pe < pe_assignments.size(); base_pe++) {
+        if (!inline_enabled && !outline_enabled) break;
+        expandProgram(base_pe);
+        bool rewritten = false;
+        if (inline_enabled) rewritten = inlineCalls(base_pe) || rewritten;
+        if (outline_enabled) rewritten = outlineSequences(base_pe) || rewritten;
+        settleProgram(base_pe, rewritten);
+    }
+    buildFunctionLibraries();
+}
+
+// Register fields of an instruction, each flagged true when the instruction writes it
+std::vector<std::pair<std::string*, bool>> DFGProcessor::registerOperands(Instruction& instr) {
+    std::string op = instr.operation;
+    std::transform(op.begin(), op.end(), op.begin(), ::toupper);
+    if (instr.format == "hwl-type") return {};
+    if (instr.format == "psrf-mem-type" || instr.format == "mem-type") return {{&instr.ra1, !isStore(instr)}};
+    if (op == "LUI" || op == "AUIPC") return {{&instr.ra1, true}};
+    if (op == "JAL") return {{&instr.rd, true}};
+    if (op == "BEQ" || op == "BNE" || op == "BLT" || op == "BGE" || op == "BLTU" || op == "BGEU") {
+        return {{&instr.rd, false}, {&instr.ra1, false}};
+    }
+    return {{&instr.ra1, false}, {&instr.ra2, false}, {&instr.rd, true}};
+}
+
+// Temporaries a virtual register may take: x1-x17 and x27-x31, minus the physical
+// registers the program names itself. x0, the base registers x18-x25 and the link x26
+// are never handed out; v, c and L registers live in the PSRF, CORF and HWL files.
+std::vector<std::string> DFGProcessor::allocatablePool(std::vector<Instruction>& instructions) {
+    std::set<std::string> named;
+    for (auto& instr : instructions) {
+        for (const auto& [field, def] : registerOperands(instr)) named.insert(*field);
+        if (isVirtualRegister(instr.base_address)) {
+            throw std::runtime_error("base_address " + instr.base_address + " must be a physical base register");
+        }
+    }
+    std::vector<std::string> pool;
+    for (int r = 1; r <= 31; r++) {
+        std::string reg = "x" + std::to_string(r);
+        if ((r <= 17 || r >= 27) && named.count(reg) == 0) pool.push_back(reg);
+    }
+    return pool;
+}
+
+// Allocation ops for a program; calls clobber every register their callee writes
+std::vector<AllocationOp> DFGProcessor::allocationOps(std::vector<Instruction>& instructions,
+                                                      const std::map<std::string, std::set<std::string>>& clobbers) {
+    std::vector<long long> counts = dynamicCounts(instructions, instructionPositions(instructions));
+    std::vector<AllocationOp> ops(instructions.size());
+    for (size_t i = 0; i < instructions.size(); i++) {
+        for (const auto& [field, def] : registerOperands(instructions[i])) {
+            if (!isVirtualRegister(*field)) continue;
+            (def ? ops[i].defs : ops[i].uses).push_back(*field);
+        }
+        auto callee = clobbers.find(instructions[i].target);
+        if (!instructions[i].target.empty() && callee != clobbers.end()) ops[i].clobbers = callee->second;
+        ops[i].count = counts[i];
+    }
+    return ops;
+}
+
+// Instruction index ranges of the hardware loop bodies
+std::vector<AllocationLoop> DFGProcessor::allocationLoops(const std::vector<Instruction>& instructions) {
+    std::vector<int> position = instructionPositions(instructions);
+    std::vector<AllocationLoop> loops;
+    for (const auto& loop : instructions) {
+        if (!loop.hwl.has_value()) continue;
+        AllocationLoop range{-1, -1};
+        for (size_t i = 0; i < instructions.size(); i++) {
+            if (position[i] < loop.hwl->pc_start || position[i] > loop.hwl->pc_stop) continue;
+            if (range.first < 0) range.first = static_cast<int>(i);
+            range.last = static_cast<int>(i);
+        }
+        if (range.first >= 0) loops.push_back(range);
+    }
+    return loops;
+}
+
+// Replace virtual registers by their allocation. Spilled uses are reloaded into a scratch
+// register before the instruction and spilled defs stored after it, at frame_offset plus
+// four bytes per slot from spill_base; hardware loop pcs are moved over the inserted words.
+void DFGProcessor::rewriteRegisters(PEAssignment& assignment, const RegisterAllocation& allocation, int frame_offset) {
+    std::vector<Instruction>& program = assignment.instructions;
+    auto spill = [&](const std::string& op, const std::string& reg, const std::string& value) {
+        Instruction instr;
+        instr.operation = op;
+        instr.format = "mem-type";
+        instr.ra1 = reg;
+        instr.ra2 = instr.rd = "null";
+        instr.base_address = spill_base;
+        instr.imm = 0;
+        instr.address = 0;
+        instr.offset = frame_offset + allocation.spill_slot.at(value) * 4;
+        return instr;
+    };
+
+    std::vector<Instruction> rewritten;
+    std::vector<std::pair<size_t, size_t>> group;  // Old instruction -> [first, last] new index
+    for (auto& instr : program) {
+        size_t first = rewritten.size();
+        std::vector<Instruction> stores;
+        std::map<std::string, std::string> scratch;  // Spilled value -> scratch register
+        auto operands = registerOperands(instr);
+        for (const auto& [field, def] : operands) {
+            if (def || !isVirtualRegister(*field)) continue;
+            std::string value = *field;
+            if (allocation.spill_slot.count(value) == 0) {
+                *field = allocation.assignment.at(value);
+            } else {
+                if (scratch.count(value) == 0) {
+                    std::string reg = allocation.scratch[scratch.size()];
+                    scratch[value] = reg;
+                    rewritten.push_back(spill("LW", reg, value));
+                }
+                *field = scratch[value];
+            }
+        }
+        for (const auto& [field, def] : operands) {
+            if (!def || !isVirtualRegister(*field)) continue;
+            std::string value = *field;
+            if (allocation.spill_slot.count(value) == 0) {
+                *field = allocation.assignment.at(value);
+            } else {
+                std::string reg = scratch.count(value) > 0 ? scratch[value] : allocation.scratch[0];
+                *field = reg;
+                stores.push_back(spill("SW", reg, value));
+            }
+        }
+        rewritten.push_back(instr);
+        rewritten.insert(rewritten.end(), stores.begin(), stores.end());
+        group.push_back({first, rewritten.size() - 1});
+    }
+    if (allocation.spill_slot.empty()) {
+        program = rewritten;
+        return;
+    }
+
+    std::vector<int> old_position = instructionPositions(program);
+    std::vector<int> new_position = instructionPositions(rewritten);
+    for (auto& instr : rewritten) {
+        if (!instr.hwl.has_value()) continue;
+        HardwareLoop& hwl = instr.hwl.value();
+        size_t start = 0, stop = 0;
+        for (size_t i = 0; i < program.size(); i++) {
+            if (old_position[i] < hwl.pc_start) start = i + 1;
+            if (old_position[i] <= hwl.pc_stop) stop = i;
+        }
+        hwl.pc_start = new_position[group[std::min(start, group.size() - 1)].first];
+        hwl.pc_stop = new_position[group[stop].second + 1] - 1;
+        if (hwl.pc_stop - hwl.pc_start > 63) {
+            throw std::runtime_error("PE " + std::to_string(assignment.pe_id) + ": hardware loop " +
+                                     std::to_string(hwl.loop_id) + " spans " +
+                                     std::to_string(hwl.pc_stop - hwl.pc_start + 1) +
+                                     " words after spilling, more than the 64 its pc range encodes");
+        }
+    }
+    program = rewritten;
+    assignment.has_mem_type = true;
+    assignment.required_base_registers.insert(spill_base);
+}
+
+// Linear-scan allocation of the virtual registers in functions and PE programs. Functions
+// are allocated first, without spilling, so calls know which registers they clobber. Each
+// base PE gets its own frame of spill slots in the spill_base region.
+void DFGProcessor::allocateRegisters() {
+    bool any = false;
+    auto scan = [&](std::vector<Instruction>& instructions) {
+        for (auto& instr : instructions) {
+            for (const auto& [field, def] : registerOperands(instr)) any = any || isVirtualRegister(*field);
+        }
+    };
+    for (size_t base_pe = 0; base_pe < pe_assignments.size() && !any; base_pe++) {
+        expandProgram(base_pe);
+        scan(pe_assignments[base_pe].instructions);
+        settleProgram(base_pe, false);
+    }
+    for (auto& [name, pe_assigns] : function_pe_assignments) {
+        for (auto& [pe, assignment] : pe_assigns) scan(assignment.instructions);
+    }
+    if (!any) return;
+    ScopedTimer timer("allocate_registers");
+
+    std::map<std::string, std::set<std::string>> clobbers;
+    for (auto& [name, pe_assigns] : function_pe_assignments) {
+        for (auto& [pe, assignment] : pe_assigns) {
+            std::vector<Instruction>& body = assignment.instructions;
+            RegisterAllocation allocation =
+                allocate_registers(allocationOps(body, {}), allocationLoops(body), allocatablePool(body));
+            if (!allocation.spill_slot.empty()) {
+                throw std::runtime_error("Function " + name + " needs more registers than are free; functions cannot spill");
+            }
+            rewriteRegisters(assignment, allocation, 0);
+            for (auto& instr : body) {
+                for (const auto& [field, def] : registerOperands(instr)) {
+                    if (def) clobbers[name].insert(*field);
                 }
-            } else {
-                return base_addr + (mem_offsets[offset_key] * cluster_num);
             }
         }
-        return base_addr;   
     }
 
-    // Helper function to generate LUI and ADDI for large immediates
-    std::pair<int, int> calculateLuiAddiValues(int value) {
-        // RISC-V ADDI range is -2048 to 2047 (12-bit signed immediate)
-        // RISC-V LUI loads the immediate value into the upper 20 bits (bits 31:12)
-        
-        // If the value fits within ADDI range, use 0 for LUI and the value for ADDI
-        if (value >= -2048 && value <= 2047) {
-            return {0, value};
+    int frame = 0;
+    for (size_t base_pe = 0; base_pe < pe_assignments.size(); base_pe++) {
+        // Allocation rewrites every program, so templated ones are expanded for good
+        expandProgram(base_pe);
+        settleProgram(base_pe, true);
+        std::vector<Instruction>& program = pe_assignments[base_pe].instructions;
+        RegisterAllocation allocation = allocate_registers(allocationOps(program, clobbers),
+                                                           allocationLoops(program), allocatablePool(program));
+        if (!allocation.spill_slot.empty() && partitioned) {
+            throw std::runtime_error("dataflow_graph: PE " + std::to_string(base_pe) +
+                                     " needs more live values than free registers; spill code would break the lockstep schedule");
         }
-        
-        // Extract lower 12 bits preserving the sign
-        int lower12 = value & 0xFFF;
-        
-        // If the lower 12 bits represent a negative value (bit 11 is set)
-        // we need to adjust the upper bits
-        int upper20;
-        if (lower12 & 0x800) {
-            // Sign extension is happening, need to add 1 to upper bits
-            // and keep the lower bits as they are
-            upper20 = ((value >> 12) & 0xFFFFF) + 1;
-        } else {
-            // No sign extension, just use the upper 20 bits as is
-            upper20 = (value >> 12) & 0xFFFFF;
+        if (!allocation.spill_slot.empty() && spill_base.empty()) {
+            throw std::runtime_error("PE " + std::to_string(base_pe) + " spills " +
+                                     std::to_string(allocation.spill_slot.size()) +
+                                     " values; set register_allocation.spill_base to a mem_config register");
         }
-        
-        return {upper20, lower12};
+        frame = std::max(frame, static_cast<int>(allocation.spill_slot.size()));
+        register_allocations[static_cast<int>(base_pe)] = allocation;
+    }
+    if (frame * static_cast<int>(pe_assignments.size()) * 4 > 2048) {
+        throw std::runtime_error("Spill frames of " + std::to_string(frame) + " words for " +
+                                 std::to_string(pe_assignments.size()) +
+                                 " PEs exceed the 2048 bytes a 12-bit offset reaches");
     }
 
-    std::string generateBaseAddressLoading(int pe_id, int data_dup) {
-        std::string result = "    # Base address loading section for cluster " + 
-                            std::to_string(getClusterNumber(pe_id)) + "\n";
-        
-        int cluster_num = getClusterNumber(pe_id);
-        
-        // For each required base register in memory config
-        for (const auto& [reg, base_value] : mem_config) {
-            if (base_value != 0) {  // Only process non-null values
-                int cluster_addr = calculateClusterBaseAddress(reg, cluster_num, data_dup, pe_id);
-                auto [lui_val, addi_val] = calculateLuiAddiValues(cluster_addr);
-                
-                // Convert addi_val to signed 12-bit value if it exceeds range
-                if (addi_val & 0x800) {
-                    // Sign extend to print as negative number
-                    addi_val = addi_val | 0xFFFFF000;
-                }
-                
-                std::stringstream ss;
-                ss << "    # Loading " << reg << " with address 0x" 
-                   << std::hex << std::uppercase << cluster_addr 
-                   << std::dec << " (" << cluster_addr << ")\n";
-                
-                // Add explanation of the LUI+ADDI sequence for large values
-                if (lui_val != 0) {
-                    if (addi_val < 0) {
-                        ss << "    # Using lui " << lui_val << " and addi " << addi_val 
-                           << " to create " << (lui_val << 12) + addi_val << "\n";
-                    } else {
-                        ss << "    # Using lui " << lui_val << " and addi " << addi_val 
-                           << " to create " << (lui_val << 12) + addi_val << "\n";
-                    }
-                }
-                
-                result += ss.str();
-                
-                if (lui_val != 0) {
-                    result += "    lui " + reg + ", " + std::to_string(lui_val) + "\n";
-                }
-                if (addi_val != 0 || lui_val != 0) {  // Always include ADDI after LUI
-                    result += "    addi " + reg + ", " + reg + ", " + std::to_string(addi_val) + "\n";
+    for (auto& [base_pe, allocation] : register_allocations) {
+        rewriteRegisters(pe_assignments[base_pe], allocation, base_pe * frame * 4);
+        log() << "Register allocation PE " << base_pe << ": " << allocation.assignment.size() +
+                         allocation.spill_slot.size() << " virtual registers in " << allocation.registers_used
+                  << " physical, " << allocation.spill_slot.size() << " spilled (" << allocation.spill_loads
+                  << " reloads, " << allocation.spill_stores << " stores, spill cost "
+                  << allocation.spill_cost << " dynamic accesses)" << std::endl;
+        Profiler::count("spilled_values", allocation.spill_slot.size());
+    }
+}
+
+// Add the operations of a straight-line sequence, each executed counts[i] times
+void DFGProcessor::countOperations(const std::vector<Instruction>& instructions, const std::vector<long long>& counts,
+                                   PerformanceCounts& result) {
+    for (size_t i = 0; i < instructions.size(); i++) {
+        const Instruction& instr = instructions[i];
+        std::string op = instr.operation;
+        std::transform(op.begin(), op.end(), op.begin(), ::toupper);
+        long long count = counts[i];
+        result.cycles += count * instructionWords(instr);
+
+        // Memory operations move their access width to or from the base register's region
+        int width = 0;
+        bool load = false;
+        if (op == "LW" || op == "PSRF.LW" || op == "PSRF.ZD.LW") { width = 4; load = true; }
+        else if (op == "LH" || op == "LHU") { width = 2; load = true; }
+        else if (op == "LB" || op == "LBU" || op == "PSRF.LB") { width = 1; load = true; }
+        else if (op == "SW" || op == "PSRF.SW") width = 4;
+        else if (op == "SH") width = 2;
+        else if (op == "SB" || op == "PSRF.SB") width = 1;
+        if (width > 0) {
+            (load ? result.loads : result.stores) += count;
+            result.region_bytes[instr.base_address.empty() ? "unknown" : instr.base_address] += count * width;
+            continue;
+        }
+
+        if (op == "MUL" || op == "MULH" || op == "MULHU" || op == "MULHSU") {
+            result.muls += count;
+            // A multiply counts as a MAC when the next instruction accumulates its product
+            if (i + 1 < instructions.size()) {
+                const Instruction& next = instructions[i + 1];
+                std::string next_op = next.operation;
+                std::transform(next_op.begin(), next_op.end(), next_op.begin(), ::toupper);
+                if (next_op == "ADD" && (next.ra1 == instr.rd || next.ra2 == instr.rd)) {
+                    result.macs += count;
                 }
-                result += "\n";
             }
+        } else if (op == "ADD" || op == "ADDI" || op == "SUB") {
+            result.adds += count;
+        } else if (instr.format == "r-type" || instr.format == "i-type") {
+            result.other_alu += count;
         }
-        
-        return result;
     }
+}
 
-    std::string generatePreloadSection(const PEAssignment& pe_assignment) {
-        std::string preload;
-        bool has_psrf = false;
-        bool has_mem_type = false;
-        preload += "    # Preload section for PSRF variables and coefficients\n";
-        
-        // Generate PSRF variable loads
-        for (const auto& instr : pe_assignment.instructions) {
-            if (instr.format == "psrf-mem-type") {
-                has_psrf = true;
-                int var_value = 0;
-                
-                // Get the var value for this instruction
-                if (instr.var.has_value()) {
-                    var_value = instr.var.value();
-                }
-                
-                // Calculate register base for this var value
-                int reg_base = var_value * 6;  // var=0: 0-5, var=1: 6-11, var=2: 12-17
-                
-                // Add a comment indicating which var group we're using
-                preload += "    # Using var=" + std::to_string(var_value) + 
-                          " (registers " + std::to_string(reg_base) + "-" + 
-                          std::to_string(reg_base+5) + ")\n";
-                
-                for (const auto& [var_key, value] : instr.psrf_var) {
-                    if (value != 0) {  // Only generate for non-zero values
-                        // Extract the register number from the key (e.g., v0 -> 0)
-                        int base_reg = std::stoi(var_key.substr(1));
-                        // Calculate the actual register number based on var value
-                        int reg_num = reg_base + base_reg;
-                        
-          
-                        // Use the first register of the group as source
-                        preload += "    ppsrf.addi v" + std::to_string(reg_num) + 
-                                ", v" + std::to_string(reg_base) + 
-                                ", " + std::to_string(value) + "\n";
-                    }
-                }
-                
-                // Generate coefficient loads with corf.addi
-                for (const auto& [coef_key, value] : instr.coefficients) {
-                    if (value != 0) {  // Only generate for non-zero values
-                        // Extract the register number from the key (e.g., c0 -> 0)
-                        int base_reg = std::stoi(coef_key.substr(1));
-                        // Calculate the actual register number based on var value
-                        int reg_num = reg_base + base_reg;
-                        
-                        if (value > 4095) { 
-                            // corf.addi range is 0 to 4095. 
-                            // If negative, we need to sign extend the value
-                            // Use the first register of the group as source
-                            preload += "    corf.lui c" + std::to_string(reg_num) + 
-                                    ", " + std::to_string(value >> 12) + "\n";
-                            preload += "    corf.addi c" + std::to_string(reg_num) + 
-                                    ", c" + std::to_string(reg_base) + 
-                                    ", " + std::to_string(value & 0xFFF) + "\n";
-                        } else {
-                        // Use the first register of the group as source
-                        preload += "    corf.addi c" + std::to_string(reg_num) + 
-                                  ", c" + std::to_string(reg_base) + 
-                                  ", " + std::to_string(value) + "\n";
-                        }
-                    }
-                }
-                
-            } 
-            // else if (instr.format == "mem-type") {
-            //     has_mem_type = true;
-            //     preload += "    # Memory offset: " + std::to_string(instr.offset) + "\n";
-            //     preload += "    addi " + instr.ra1 + ", " + instr.base_address + ", " + std::to_string(instr.offset) + "\n";
-            // }   
-        }
-        
-        if (!has_psrf && !has_mem_type) return "";
-        
-        preload += "\n";
-        std::cout << "Preload section: " << preload << std::endl;
-        return preload;
+// Dynamic operation counts of a PE: the program's hardware loop nest multiplies each
+// instruction, and called function bodies run as often as their call site
+DFGProcessor::PerformanceCounts DFGProcessor::performanceCounts(int pe) {
+    PerformanceCounts result;
+    std::vector<Instruction> scratch;
+    const std::vector<Instruction>& program = instructionsOf(pe_assignments[pe % pes_per_cluster], scratch);
+    std::vector<int> position = instructionPositions(program);
+    std::vector<long long> counts = dynamicCounts(program, position);
+    countOperations(program, counts, result);
+    result.cycles += getDelayStart(pe);
+
+    for (size_t i = 0; i < program.size(); i++) {
+        const Instruction& site = program[i];
+        if (site.target.empty() || (site.operation != "JAL" && site.operation != "jal")) continue;
+        result.calls += counts[i];
+        result.cycles += counts[i] * 2 * call_penalty;
+        auto func = function_pe_assignments.find(site.target);
+        if (func == function_pe_assignments.end() || func->second.count(pe) == 0) continue;
+        const std::vector<Instruction>& body = func->second.at(pe).instructions;
+        countOperations(body, std::vector<long long>(body.size(), counts[i]), result);
+        if (body.empty() || body.back().operation != "JALR") result.cycles += counts[i];  // Return
     }
+    return result;
+}
 
-    std::string generateHWLInstructions(const Instruction& instr, int hwl_count, int pe_id) {
-        if (!instr.hwl.has_value()) return "";
+void DFGProcessor::writeCounts(std::ostream& out, const PerformanceCounts& counts) {
+    double intensity = counts.bytes() > 0 ? static_cast<double>(counts.ops()) / counts.bytes() : 0;
+    out << "\"macs\": " << counts.macs << ", \"muls\": " << counts.muls << ", \"adds\": " << counts.adds
+        << ", \"other_alu\": " << counts.other_alu << ", \"loads\": " << counts.loads << ", \"stores\": "
+        << counts.stores << ", \"calls\": " << counts.calls << ", \"cycles\": " << counts.cycles
+        << ", \"bytes\": {";
+    bool first = true;
+    for (const auto& [reg, bytes] : counts.region_bytes) {
+        out << (first ? "" : ", ") << "\"" << reg << "\": " << bytes;
+        first = false;
+    }
+    out << "}, \"arithmetic_intensity\": " << intensity;
+}
 
-        const auto& hwl = instr.hwl.value();
-        
-        // Get the delay value for this PE
-        int delay = 0;
-        if (pe_id < delay_start.size()) {
-            delay = delay_start[pe_id];
-        }
-        
-        // Adjust pc_start and pc_stop by adding the delay
-        int adjusted_pc_start = hwl.pc_start + delay;
-        int adjusted_pc_stop = hwl.pc_stop - adjusted_pc_start;
-        
-        uint32_t imm = calculateHWLImmediate(hwl, delay);
-        auto [upper, lower] = splitHWLImmediate(imm);
+// Load a configuration file: YAML, JSON (.json) or the binary format of config_formats.h
+void DFGProcessor::loadConfig(const std::string& yaml_file) {
+    ConfigFormat format = detect_config_format(yaml_file);
+    if (format == ConfigFormat::Binary) {
+        loadConfig(BinaryConfigReader(yaml_file), yaml_file);
+        return;
+    }
+    YAML::Node config;
+    {
+        ScopedTimer timer("parse_config");
+        config = format == ConfigFormat::Json ? load_json_file(yaml_file) : YAML::LoadFile(yaml_file);
+    }
+    loadConfig(config, yaml_file);
+}
 
-        std::string result = "";
-        
-        // Add comment showing the immediate value calculation with delay adjustment
-        result += "    # hwl_imm_" + std::to_string(hwl_count) + " = ";
-        result += "((" + std::to_string(adjusted_pc_start) + " << 23) + ";
-        result += "(" + std::to_string(adjusted_pc_stop) + " << 17) + ";
-        result += "(" + std::to_string(hwl.hwl_index) + " << 12) + ";
-        result += std::to_string(hwl.iterations) + "\n";
-        result += "    # Original pc_start=" + std::to_string(hwl.pc_start) + 
-                 ", pc_stop=" + std::to_string(hwl.pc_stop) + 
-                 ", delay=" + std::to_string(delay) + "\n";
-
-        // Generate HWL instructions with adjusted immediate values
-        result += "    hwlrf.lui L" + std::to_string(hwl.loop_id) + ", " + std::to_string(upper) + "\n";
-        result += "    hwlrf.addi L" + std::to_string(hwl.loop_id) + ", L" + std::to_string(hwl.loop_id);
-        result += ", " + std::to_string(lower) + "\n";
+// Load a binary configuration from a reader over a file or a memory buffer; yaml_file is
+// the path data_images are resolved against
+void DFGProcessor::loadConfig(const BinaryConfigReader& reader, const std::string& yaml_file) {
+    std::vector<PEAssignment> programs;
+    YAML::Node config;
+    {
+        ScopedTimer timer("parse_config");
+        programs = binaryPrograms(reader);
+        config = reader.config();
+    }
+    loadConfig(config, yaml_file, &programs);
+}
 
-        return result;
+// Write a YAML or JSON configuration as JSON, or in the binary format when output_file ends
+// in .yacb. The programs are parsed for the binary format; nothing else is loaded.
+void DFGProcessor::convertConfig(const std::string& input_file, const std::string& output_file) {
+    auto ends_with = [&](const std::string& suffix) {
+        return output_file.size() >= suffix.size() &&
+               output_file.compare(output_file.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    ConfigFormat format = detect_config_format(input_file);
+    if (format == ConfigFormat::Binary) throw std::runtime_error("Only YAML and JSON configurations can be converted");
+    YAML::Node config = format == ConfigFormat::Json ? load_json_file(input_file) : YAML::LoadFile(input_file);
+    if (ends_with(".json")) {
+        std::ofstream out(output_file);
+        write_json(out, config);
+        out << "\n";
+        if (!out) throw std::runtime_error("Cannot write " + output_file);
+        return;
     }
+    if (!ends_with(".yacb")) throw std::runtime_error("Conversion output must end in .json or .yacb: " + output_file);
 
-    std::string generateInstructionCode(const Instruction& instr, int& hwl_count, int pe_id) {
-        // Handle hardware loop instructions
-        if (instr.format == "hwl-type") {
-            return generateHWLInstructions(instr, ++hwl_count, pe_id);
-        }
-
-        // Handle memory operations (both PSRF and normal)
-        if (instr.operation == "LW" || instr.operation == "lw" || 
-            instr.operation == "SW" || instr.operation == "sw" || 
-            instr.operation == "LB" || instr.operation == "lb" || 
-            instr.operation == "LH" || instr.operation == "lh" || 
-            instr.operation == "LBU" || instr.operation == "lbu" ||
-            instr.operation == "LHU" || instr.operation == "lhu" ||
-            instr.operation == "SB" || instr.operation == "sb" ||
-            instr.operation == "SH" || instr.operation == "sh" || 
-            instr.operation == "psrf.lw" || 
-            instr.operation == "psrf.lb" || 
-            instr.operation == "psrf.sw" ||
-            instr.operation == "psrf.sb" || 
-            instr.operation == "psrf.zd.lw" ) {
-        
-            // Generate appropriate instruction based on format and operation
-            if (instr.format == "psrf-mem-type") {
-                std::string var_str = "";
+    BinaryConfigWriter writer;
+    YAML::Node stripped = YAML::Clone(config);
+    if (config["scheduling"] && config["scheduling"]["pe_assignments"]) {
+        // New entries rather than edits in place: YAML aliases share one node between entries
+        YAML::Node entries(YAML::NodeType::Sequence);
+        for (const auto& assignment : config["scheduling"]["pe_assignments"]) {
+            if (assignment["template"]) {
+                entries.push_back(YAML::Clone(assignment));
+                continue;
+            }
+            YAML::Node entry(YAML::NodeType::Map);
+            for (const auto& field : assignment) {
+                if (field.first.as<std::string>() != "instructions") entry[field.first] = YAML::Clone(field.second);
+            }
+            entries.push_back(entry);
+
+            PEAssignment program;
+            program.pe_id = assignment["pe_id"].as<int>();
+            program.has_psrf_mem_type = false;
+            program.has_mem_type = false;
+            program.has_hwl = false;
+            for (const auto& instr : assignment["instructions"]) {
+                program.instructions.push_back(parseInstruction(instr, program));
+            }
+
+            ProgramRecord record = {};
+            record.pe_id = program.pe_id;
+            record.flags = (program.has_psrf_mem_type ? PROGRAM_PSRF_MEM : 0) |
+                           (program.has_mem_type ? PROGRAM_MEM : 0) | (program.has_hwl ? PROGRAM_HWL : 0);
+            record.first_instruction = static_cast<uint32_t>(writer.instructions.size());
+            record.instruction_count = static_cast<uint32_t>(program.instructions.size());
+            record.first_register = static_cast<uint32_t>(writer.registers.size());
+            record.register_count = static_cast<uint32_t>(program.required_base_registers.size());
+            for (const auto& reg : program.required_base_registers) writer.registers.push_back(writer.string(reg));
+            writer.programs.push_back(record);
+
+            for (const auto& instr : program.instructions) {
+                InstructionRecord fields = {};
+                fields.operation = writer.string(instr.operation);
+                fields.format = writer.string(instr.format);
+                fields.ra1 = writer.string(instr.ra1);
+                fields.ra2 = writer.string(instr.ra2);
+                fields.rd = writer.string(instr.rd);
+                fields.base_address = writer.string(instr.base_address);
+                fields.target = writer.string(instr.target);
+                fields.imm = instr.imm;
+                fields.address = instr.address;
+                fields.offset = instr.offset;
                 if (instr.var.has_value()) {
-                    var_str = ", " + std::to_string(instr.var.value());
-                }
-                
-                if (instr.operation == "psrf.lw") {
-                    return "    psrf.lw " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "psrf.sw") {
-                    return "    psrf.sw " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "psrf.lb") {
-                    return "    psrf.lb " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "psrf.sb") {
-                    return "    psrf.sb " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "psrf.zd.lw") {
-                    return "    psrf.zd.lw " + instr.ra1 + var_str + "(" + instr.base_address + ")\n";
+                    fields.flags |= INSTRUCTION_VAR;
+                    fields.var = instr.var.value();
                 }
-            } else {
-                // Normal memory operations
-                if (instr.operation == "LW" || instr.operation == "lw") {
-                    return "    lw " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "SW" || instr.operation == "sw") {
-                    return "    sw " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "LB" || instr.operation == "lb") {
-                    return "    lb " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "LH" || instr.operation == "lh") {
-                    return "    lh " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "LBU" || instr.operation == "lbu") {
-                    return "    lbu " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "LHU" || instr.operation == "lhu") {
-                    return "    lhu " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "SB" || instr.operation == "sb") {
-                    return "    sb " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
-                } else if (instr.operation == "SH" || instr.operation == "sh") {
-                    return "    sh " + instr.ra1 + ", " + std::to_string(instr.offset) + "(" + instr.base_address + ")\n";
+                if (instr.hwl.has_value()) {
+                    fields.flags |= INSTRUCTION_HWL;
+                    fields.loop_id = instr.hwl->loop_id;
+                    fields.pc_start = instr.hwl->pc_start;
+                    fields.pc_stop = instr.hwl->pc_stop;
+                    fields.hwl_index = instr.hwl->hwl_index;
+                    fields.iterations = instr.hwl->iterations;
                 }
+                fields.first_psrf_var = static_cast<uint32_t>(writer.pairs.size());
+                fields.psrf_var_count = static_cast<uint32_t>(instr.psrf_var.size());
+                for (const auto& [key, value] : instr.psrf_var) writer.pairs.push_back({writer.string(key), value});
+                fields.first_coefficient = static_cast<uint32_t>(writer.pairs.size());
+                fields.coefficient_count = static_cast<uint32_t>(instr.coefficients.size());
+                for (const auto& [key, value] : instr.coefficients) writer.pairs.push_back({writer.string(key), value});
+                writer.instructions.push_back(fields);
             }
-        } 
-        // Handle I-type instructions
-        else if (instr.format == "i-type"  || 
-                instr.operation == "ADDI"  || instr.operation == "addi"  || 
-                instr.operation == "SLTI"  || instr.operation == "slti"  || 
-                instr.operation == "XORI"  || instr.operation == "xori"  || 
-                instr.operation == "SLTIU" || instr.operation == "sltiu" || 
-                instr.operation == "SLTI"  || instr.operation == "slti"  || 
-                instr.operation == "ORI"   || instr.operation == "ori"   || 
-                instr.operation == "ANDI"  || instr.operation == "andi"  ||
-                instr.operation == "SLLI"  || instr.operation == "slli"  || 
-                instr.operation == "SRLI"  || instr.operation == "srli"  || 
-                instr.operation == "SRAI"  || instr.operation == "srai"  || 
-                instr.operation == "JALR"  || instr.operation == "jalr") 
-            {
-            
-            // For ADDI instructions
-            if (instr.operation == "ADDI") {
-                if (instr.imm > 2047 || instr.imm < -2048) {
-                    // For large immediates, we need to use LUI + ADDI
-                    auto [lui_val, addi_val] = calculateLuiAddiValues(instr.imm);
-                    
-                    // Convert addi_val to signed 12-bit value if it exceeds range
-                    if (addi_val & 0x800) {
-                        // Sign extend to print as negative number
-                        addi_val = addi_val | 0xFFFFF000;
-                    }
-                    
-                    std::string result = "";
-                    // Add comment explaining the LUI+ADDI sequence
-                    result += "    # Loading immediate " + std::to_string(instr.imm) + 
-                             " using LUI+ADDI: " + std::to_string(lui_val) + " << 12 + " + 
-                             std::to_string(addi_val) + " = " + 
-                             std::to_string((lui_val << 12) + addi_val) + "\n";
-                    
-                    if (lui_val != 0) {
-                        result += "    lui " + instr.rd + ", " + std::to_string(lui_val) + "\n";
-                        result += "    addi " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(addi_val) + "\n";
-                    } else {
-                        result += "    addi " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-                    }
-                    return result;
-                } else {
-                    return "    addi " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-                }
+        }
+        stripped["scheduling"]["pe_assignments"] = entries;
+    }
+    std::ostringstream json;
+    write_json(json, stripped);
+    writer.write(output_file, json.str());
+}
+
+// Load an already parsed configuration; yaml_file only anchors relative data_images paths.
+// programs holds the already parsed programs of a binary configuration, one per
+// pe_assignments entry without a template.
+void DFGProcessor::loadConfig(YAML::Node config, const std::string& yaml_file, std::vector<PEAssignment>* programs) {
+    ScopedTimer timer("load_config");
+
+    // Load memory configuration
+    if (config["mem_config"]) {
+        auto mem_conf = config["mem_config"];
+        for (const auto& entry : mem_conf) {
+            std::string reg = entry.first.as<std::string>();
+            if (!entry.second.IsNull()) {
+                mem_config[reg] = entry.second.as<int>();
             }
-            // Handle JALR instruction
-            else if (instr.operation == "JALR") {
-                return "    jalr " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-            }
-            else if (instr.operation == "SLLI"  || instr.operation == "slli"  || 
-                     instr.operation == "SRLI"  || instr.operation == "srli"  || 
-                     instr.operation == "SRAI"  || instr.operation == "srai"  ) {
-                std::string op = instr.operation;
-                std::transform(op.begin(), op.end(), op.begin(), ::tolower);
-                return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-            }
-            // Handle other I-type instructions
-            else {
-                std::string op = instr.operation;
-                std::transform(op.begin(), op.end(), op.begin(), ::tolower);
-                return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-            }
-        }
-        // Handle R-type operations
-        else if (instr.format == "r-type" || 
-                instr.operation == "ADD" || instr.operation == "SUB" || 
-                instr.operation == "SLL" || instr.operation == "SLT" || 
-                instr.operation == "SLTU" || instr.operation == "XOR" || 
-                instr.operation == "SRL" || instr.operation == "SRA" || 
-                instr.operation == "OR" || instr.operation == "AND" || 
-                instr.operation == "MUL") {
-            
-            std::string op = instr.operation;
-            std::transform(op.begin(), op.end(), op.begin(), ::tolower);
-            return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + instr.ra2 + "\n";
         }
-        // Handle B-type instructions
-        else if (instr.operation == "BEQ" || instr.operation == "BNE" || 
-                instr.operation == "BLT" || instr.operation == "BGE" || 
-                instr.operation == "BLTU" || instr.operation == "BGEU") {
-            
-            std::string op = instr.operation;
-            std::transform(op.begin(), op.end(), op.begin(), ::tolower);
-            return "    " + op + " " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    }
+
+    // Load delay_start array if present
+    if (config["delay_start"]) {
+        auto delay_array = config["delay_start"];
+        delay_start.clear();  // Clear any existing values
+        for (const auto& delay : delay_array) {
+            delay_start.push_back(delay.as<int>());
         }
-        // Handle U-type instructions
-        else if (instr.operation == "LUI" || instr.operation == "AUIPC") {
-            std::string op = instr.operation;
-            std::transform(op.begin(), op.end(), op.begin(), ::tolower);
-            return "    " + op + " " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+        log() << "Loaded delay_start values: ";
+        for (int delay : delay_start) {
+            log() << delay << " ";
         }
-        // Handle J-type instructions (JAL)
-        else if (instr.operation == "JAL" || instr.operation == "jal") {
-            // For function calls, use the provided address
-            std::cout << "instr.target: " << instr.target << std::endl;
-            if (!instr.target.empty()) {
-                return "    jal " + instr.rd + ", " + std::to_string(instr.address) + "  # Call " + instr.target + "\n";
+        log() << std::endl;
+    } else {
+        // Initialize with zeros if not present
+        delay_start.resize(64, 0);  // Support up to 64 PEs
+    }
+
+    // Load memory offsets
+    if (config["hardware_config"]["psrf_mem_offset"]) {
+        auto offset_conf = config["hardware_config"]["psrf_mem_offset"];
+        for (const auto& entry : offset_conf) {
+            std::string offset_key = entry.first.as<std::string>();
+            if (!entry.second.IsNull()) {
+                mem_offsets[offset_key] = entry.second.as<int>();
             }
-            // For regular jumps, use the immediate
-            return "    jal " + instr.rd + ", " + std::to_string(instr.imm) + "  # Call somewhere\n";
         }
+    }
 
-        // Handle B-type instructions  
-        else if (instr.operation == "BGE" || instr.operation == "bge") {
-            return "    bge " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-        }
-        else if (instr.operation == "BLT" || instr.operation == "blt") {
-            return "    blt " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-        }   
-        else if (instr.operation == "BLTU" || instr.operation == "bltu") {
-            return "    bltu " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+    // Load hardware configuration
+    total_pes = config["hardware_config"]["total_pes"].as<int>();
+    clusters_count = config["hardware_config"]["clusters"]["count"].as<int>();
+    pes_per_cluster = config["hardware_config"]["clusters"]["pes_per_cluster"].as<int>();
+    minimum_pes_required = config["scheduling"]["minimum_pes_required"].as<int>();
+    data_dup = config["hardware_config"]["data_dup"].as<int>();
+
+    // Load function placement if present
+    if (config["hardware_config"]["function_library"]) {
+        auto library_conf = config["hardware_config"]["function_library"];
+        if (library_conf["placement"]) {
+            function_placement = library_conf["placement"].as<std::string>();
+            if (function_placement != "per_pe" && function_placement != "cluster") {
+                throw std::runtime_error("Unknown function_library placement: " + function_placement);
+            }
         }
-        else if (instr.operation == "BNE" || instr.operation == "bne") {
-            return "    bne " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
-        } 
-        else if (instr.operation == "BEQ" || instr.operation == "beq") {
-            return "    beq " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+        if (library_conf["base"] && !library_conf["base"].IsNull()) {
+            function_library_base = library_conf["base"].as<int>();
         }
-        else if (instr.operation == "BGEU" || instr.operation == "bgeu") {
-            return "    bgeu " + instr.rd + ", " + instr.ra1 + ", " + std::to_string(instr.imm) + "\n";
+        if (library_conf["region"] && !library_conf["region"].IsNull()) {
+            std::string region = library_conf["region"].as<std::string>();
+            unsigned long value = 0;
+            try {
+                value = std::stoul(region, nullptr, 0);
+            } catch (const std::exception&) {
+                throw std::runtime_error("Invalid function_library region: " + region);
+            }
+            if (value == 0 || (value & LIBRARY_REGION_MASK) != 0 || value > 0xFFFFFFFFul) {
+                throw std::runtime_error("function_library region " + region +
+                                         " must be a nonzero multiple of 0x40000 (above the PE address bits)");
+            }
+            function_library_region = static_cast<uint32_t>(value);
         }
+    }
 
-        
-
-        // Handle special instructions
-        else if (instr.operation == "RET") {
-            return "    ret\n";
+    // Load call optimization settings if present
+    if (config["optimization"]) {
+        auto opt_conf = config["optimization"];
+        if (opt_conf["inline"]) {
+            auto inline_conf = opt_conf["inline"];
+            inline_enabled = !inline_conf["enabled"] || inline_conf["enabled"].as<bool>();
+            if (inline_conf["max_body_words"]) inline_max_body_words = inline_conf["max_body_words"].as<int>();
+            if (inline_conf["min_hot_count"]) inline_min_hot_count = inline_conf["min_hot_count"].as<long long>();
+            if (inline_conf["call_penalty"]) call_penalty = inline_conf["call_penalty"].as<int>();
         }
-        else if (instr.operation == "NOP" || instr.operation == "nop") {
-            return "    nop\n";
+        if (opt_conf["outline"]) {
+            auto outline_conf = opt_conf["outline"];
+            outline_enabled = !outline_conf["enabled"] || outline_conf["enabled"].as<bool>();
+            if (outline_conf["min_length"]) outline_min_length = outline_conf["min_length"].as<int>();
+            if (outline_conf["max_length"]) outline_max_length = outline_conf["max_length"].as<int>();
         }
-        
-        return "    # Unknown instruction: " + instr.operation + " (format: " + instr.format + ")\n";
     }
 
-    // Helper function to calculate hardware loop immediate value
-    uint32_t calculateHWLImmediate(const HardwareLoop& hwl, int delay) {
-        uint32_t imm = 0;
-        imm |= (static_cast<uint32_t>(hwl.pc_start + delay & 0x1FF) << 23);  //  9 bits pc_start
-        imm |= (static_cast<uint32_t>((hwl.pc_stop - hwl.pc_start) & 0x3F) << 17);   // 6 bits pc_stop
-        imm |= (static_cast<uint32_t>(hwl.hwl_index & 0x1F) << 12); // 5 bits hwl_index
-        imm |= (static_cast<uint32_t>(hwl.iterations & 0xFFF));     // 12 bits iterations
-        return imm;
+    // Load performance report settings if present
+    if (config["report"]) {
+        auto report_conf = config["report"];
+        report_enabled = !report_conf["enabled"] || report_conf["enabled"].as<bool>();
+        if (report_conf["peak_ops_per_cycle"]) report_peak_ops = report_conf["peak_ops_per_cycle"].as<double>();
+        if (report_conf["peak_bytes_per_cycle"]) report_peak_bytes = report_conf["peak_bytes_per_cycle"].as<double>();
+        if (report_peak_ops <= 0 || report_peak_bytes <= 0) {
+            throw std::runtime_error("report peak rates must be positive");
+        }
     }
 
-    // Helper function to split immediate into upper and lower parts
-    std::pair<uint32_t, uint32_t> splitHWLImmediate(uint32_t imm) {
-        uint32_t upper = (imm >> 12) & 0xFFFFF;  // Upper 20 bits
-        uint32_t lower = imm & 0xFFF;            // Lower 12 bits
-        if (lower & 0x800) {  // If the highest bit of lower part is 1
-            upper += 1;       // Add 1 to upper to handle sign extension
+    // Load instruction memory capacity if present
+    if (config["hardware_config"]["imem"]) {
+        auto imem_conf = config["hardware_config"]["imem"];
+        if (imem_conf["execution_words"]) {
+            imem_execution_words = imem_conf["execution_words"].as<int>();
+        }
+        if (imem_conf["preload_words"]) {
+            imem_preload_words = imem_conf["preload_words"].as<int>();
         }
-        return {upper, lower};
     }
 
-public:
-    DFGProcessor() : output_folder("build/") {}
-    DFGProcessor(const std::string& output_folder) : output_folder(output_folder) {}
-
-    void loadConfig(const std::string& yaml_file) {
-        YAML::Node config = YAML::LoadFile(yaml_file);
-
-        // Load memory configuration
-        if (config["mem_config"]) {
-            auto mem_conf = config["mem_config"];
-            for (const auto& entry : mem_conf) {
-                std::string reg = entry.first.as<std::string>();
-                if (!entry.second.IsNull()) {
-                    mem_config[reg] = entry.second.as<int>();
-                }
+    // Load data image inputs if present; relative paths are resolved against the YAML file
+    if (config["data_images"]) {
+        auto data_conf = config["data_images"];
+        if (data_conf["format"]) {
+            data_image_format = data_conf["format"].as<std::string>();
+            if (data_image_format != "mem" && data_image_format != "bin") {
+                throw std::runtime_error("Unknown data_images format: " + data_image_format);
             }
         }
-
-        // Load delay_start array if present
-        if (config["delay_start"]) {
-            auto delay_array = config["delay_start"];
-            delay_start.clear();  // Clear any existing values
-            for (const auto& delay : delay_array) {
-                delay_start.push_back(delay.as<int>());
-            }
-            std::cout << "Loaded delay_start values: ";
-            for (int delay : delay_start) {
-                std::cout << delay << " ";
+        if (data_conf["words_per_line"]) {
+            data_words_per_line = data_conf["words_per_line"].as<int>();
+        }
+        std::filesystem::path yaml_dir = std::filesystem::path(yaml_file).parent_path();
+        for (const auto& entry : data_conf["inputs"]) {
+            std::string reg = entry.first.as<std::string>();
+            std::filesystem::path input = entry.second.as<std::string>();
+            if (mem_config.count(reg) == 0) {
+                throw std::runtime_error("data_images input " + reg + " has no mem_config base address");
             }
-            std::cout << std::endl;
-        } else {
-            // Initialize with zeros if not present
-            delay_start.resize(64, 0);  // Support up to 64 PEs
+            data_inputs[reg] = (input.is_relative() ? yaml_dir / input : input).string();
         }
+    }
 
-        // Load memory offsets
-        if (config["hardware_config"]["psrf_mem_offset"]) {
-            auto offset_conf = config["hardware_config"]["psrf_mem_offset"];
-            for (const auto& entry : offset_conf) {
-                std::string offset_key = entry.first.as<std::string>();
-                if (!entry.second.IsNull()) {
-                    mem_offsets[offset_key] = entry.second.as<int>();
-                }
+    // Load PE templates and assignments
+    std::map<std::string, std::shared_ptr<PETemplate>> templates;
+    if (config["scheduling"]["templates"]) {
+        for (const auto& entry : config["scheduling"]["templates"]) {
+            std::string name = entry.first.as<std::string>();
+            templates[name] = parseTemplate(name, entry.second);
+        }
+    }
+    auto assignments = config["scheduling"]["pe_assignments"];
+    size_t next_program = 0;
+    for (const auto& assignment : assignments) {
+        if (assignment["template"]) {
+            pe_assignments.push_back(templatedAssignment(assignment, templates));
+            continue;
+        }
+        if (programs != nullptr) {
+            if (next_program >= programs->size()) {
+                throw std::runtime_error("Binary config has fewer programs than pe_assignments entries");
             }
+            pe_assignments.push_back(std::move((*programs)[next_program++]));
+            Profiler::count("instructions_loaded", pe_assignments.back().instructions.size());
+            continue;
+        }
+        PEAssignment pe_assignment;
+        pe_assignment.pe_id = assignment["pe_id"].as<int>();
+        pe_assignment.has_psrf_mem_type = false;
+        pe_assignment.has_mem_type = false;
+        pe_assignment.has_hwl = false;
+        
+        for (const auto& instr : assignment["instructions"]) {
+            pe_assignment.instructions.push_back(parseInstruction(instr, pe_assignment));
+        }
+        Profiler::count("instructions_loaded", pe_assignment.instructions.size());
+        pe_assignments.push_back(pe_assignment);
+    }
+    if (programs != nullptr && next_program != programs->size()) {
+        throw std::runtime_error("Binary config has more programs than pe_assignments entries");
+    }
+    if (config["scheduling"]["dataflow_graph"]) {
+        if (assignments.size() > 0) {
+            throw std::runtime_error("scheduling: give either pe_assignments or dataflow_graph, not both");
         }
+        loadDataflowGraph(config);
+    }
 
-        // Load hardware configuration
-        total_pes = config["hardware_config"]["total_pes"].as<int>();
-        clusters_count = config["hardware_config"]["clusters"]["count"].as<int>();
-        pes_per_cluster = config["hardware_config"]["clusters"]["pes_per_cluster"].as<int>();
-        minimum_pes_required = config["scheduling"]["minimum_pes_required"].as<int>();
-        data_dup = config["hardware_config"]["data_dup"].as<int>();
+    // Register allocation settings if present
+    if (config["register_allocation"] && config["register_allocation"]["spill_base"]) {
+        spill_base = config["register_allocation"]["spill_base"].as<std::string>();
+        if (mem_config.count(spill_base) == 0) {
+            throw std::runtime_error("register_allocation spill_base " + spill_base + " has no mem_config address");
+        }
+    }
 
-        // Load PE assignments
-        auto assignments = config["scheduling"]["pe_assignments"];
-        for (const auto& assignment : assignments) {
-            PEAssignment pe_assignment;
-            pe_assignment.pe_id = assignment["pe_id"].as<int>();
-            pe_assignment.has_psrf_mem_type = false;
-            pe_assignment.has_mem_type = false;
-            pe_assignment.has_hwl = false;
+    // Load function definitions
+    if (config["functions"]) {
+        auto functions = config["functions"];
+        for (const auto& func : functions) {
+            std::string func_name = func.first.as<std::string>();
+            int func_address = func.second["address"].as<int>();
             
-            for (const auto& instr : assignment["instructions"]) {
-                Instruction instruction;
-                instruction.operation = instr["operation"].as<std::string>();
-                instruction.format = instr["format"].as<std::string>();
-                
-                // Handle hardware loop instructions
-                if (instruction.format == "hwl-type") {
-                    pe_assignment.has_hwl = true;
-                    HardwareLoop hwl;
-                    hwl.loop_id = instr["loop_id"].as<int>();
-                    hwl.pc_start = instr["pc_start"].as<int>();
-                    hwl.pc_stop = instr["pc_stop"].as<int>();
-                    hwl.hwl_index = instr["hwl_index"].as<int>();
-                    hwl.iterations = instr["iterations"].as<int>();
-                    instruction.hwl = hwl;
-                }
+            // Store function address for later use
+            function_addresses[func_name] = func_address;
+            
+            // Process PE assignments for this function
+            auto pe_assigns = func.second["pe_assignments"];
+            for (const auto& pe_assign : pe_assigns) {
+                int pe_id = pe_assign["pe_id"].as<int>();
+                PEAssignment func_pe_assignment;
+                func_pe_assignment.pe_id = pe_id;
+                func_pe_assignment.has_psrf_mem_type = false;
+                func_pe_assignment.has_hwl = false;
                 
-                // Handle register assignments
-                instruction.ra1 = "null";
-                instruction.ra2 = "null";
-                instruction.rd = "null";
-                if (instr["ra1"] && !instr["ra1"].IsNull()) {
-                    instruction.ra1 = instr["ra1"].as<std::string>();
-                }
-                if (instr["ra2"] && !instr["ra2"].IsNull()) {
-                    instruction.ra2 = instr["ra2"].as<std::string>();
-                }
-                if (instr["rd"] && !instr["rd"].IsNull()) {
-                    instruction.rd = instr["rd"].as<std::string>();
-                }
+                for (const auto& instr : pe_assign["instructions"]) {
+                    Instruction instruction;
+                    instruction.operation = instr["operation"].as<std::string>();
+                    instruction.format = instr["format"].as<std::string>();
+                    
+                    // Handle register assignments
+                    instruction.ra1 = "null";
+                    instruction.ra2 = "null";
+                    instruction.rd = "null";
+                    if (instr["ra1"] && !instr["ra1"].IsNull()) {
+                        instruction.ra1 = instr["ra1"].as<std::string>();
+                    }
+                    if (instr["ra2"] && !instr["ra2"].IsNull()) {
+                        instruction.ra2 = instr["ra2"].as<std::string>();
+                    }
+                    if (instr["rd"] && !instr["rd"].IsNull()) {
+                        instruction.rd = instr["rd"].as<std::string>();
+                    }
 
-                // Handle immediate value for I-type instructions
-                instruction.imm = 0;  // Default value
-                if (instr["imm"] && !instr["imm"].IsNull()) {
-                    instruction.imm = instr["imm"].as<int>();
-                }
-                
-                // Set operation to uppercase for standard operations if needed
-                if (instruction.format == "i-type" || instruction.format == "r-type") {
-                    instruction.operation = instruction.operation;
-                    // Make sure operation is uppercase for standard operations
-                    if (instruction.operation == "addi" || instruction.operation == "add" ||
-                        instruction.operation == "mul" || instruction.operation == "lw" ||
-                        instruction.operation == "sw") {
-                        // Convert to uppercase for internal processing
+                    // Handle immediate value for I-type instructions
+                    instruction.imm = 0;
+                    if (instr["imm"] && !instr["imm"].IsNull()) {
+                        instruction.imm = instr["imm"].as<int>();
+                    }
+                    
+                    // Set operation to uppercase for standard operations
+                    if (instruction.format == "i-type" || instruction.format == "r-type") {
                         std::string upper_op = instruction.operation;
                         std::transform(upper_op.begin(), upper_op.end(), upper_op.begin(), ::toupper);
                         instruction.operation = upper_op;
                     }
+                    
+                    func_pe_assignment.instructions.push_back(instruction);
                 }
-                
-                // Handle base address
-                if (instr["base_address"] && !instr["base_address"].IsNull()) {
-                    instruction.base_address = instr["base_address"].as<std::string>();
-                    if (instruction.format == "psrf-mem-type" || instruction.format == "mem-type") {
-                        pe_assignment.required_base_registers.insert(instruction.base_address);
-                    }
-                }
+                log() << "PE " << pe_id << " Function PE assignment: " << func_pe_assignment.instructions.size() << std::endl;
+                // Store function PE assignment
+                function_pe_assignments[func_name][pe_id] = func_pe_assignment;
+            }
+        }
+    }
 
-                // Load var field for psrf-mem-type
-                if (instruction.format == "psrf-mem-type") {
-                    pe_assignment.has_psrf_mem_type = true;
-                    if (instr["var"] && !instr["var"].IsNull()) {
-                        instruction.var = instr["var"].as<int>();
-                    }
+    allocateRegisters();
+}
 
-                    // Load psrf_var values
-                    if (instr["psrf_var"] && !instr["psrf_var"].IsNull()) {
-                        auto psrf_vars = instr["psrf_var"];
-                        for (const auto& var : psrf_vars) {
-                            instruction.psrf_var[var.first.as<std::string>()] = var.second.as<int>();
-                        }
-                    }
+// Locate the 32-bit little-endian payload of a raw .bin or .npy input
+std::pair<size_t, size_t> DFGProcessor::dataPayload(const MappedFile& file, const std::string& path) {
+    if (path.size() < 4 || path.substr(path.size() - 4) != ".npy") {
+        if (file.size % 4 != 0) {
+            throw std::runtime_error("Raw data input is not a whole number of 32-bit words: " + path);
+        }
+        return {0, file.size / 4};
+    }
+    if (file.size < 10 || std::memcmp(file.data, "\x93NUMPY", 6) != 0) {
+        throw std::runtime_error("Not a NumPy file: " + path);
+    }
+    int major = file.data[6];
+    size_t header_start = major >= 2 ? 12 : 10;
+    if (file.size < header_start) throw std::runtime_error("Not a NumPy file: " + path);
+    size_t header_len = file.data[8] | (file.data[9] << 8);
+    if (major >= 2) {
+        header_len |= (static_cast<size_t>(file.data[10]) << 16) | (static_cast<size_t>(file.data[11]) << 24);
+    }
+    if (header_len > file.size - header_start) throw std::runtime_error("Not a NumPy file: " + path);
+    std::string header(reinterpret_cast<const char*>(file.data) + header_start, header_len);
+    size_t descr = header.find("'descr'");
+    std::string dtype = descr == std::string::npos ? "" : header.substr(header.find('\'', descr + 7) + 1, 3);
+    if (dtype != "<i4" && dtype != "<u4" && dtype != "<f4" && dtype != "|i4" && dtype != "|u4") {
+        throw std::runtime_error("Unsupported NumPy dtype '" + dtype + "' in " + path + " (need 32-bit little-endian)");
+    }
+    if (header.find("'fortran_order': True") != std::string::npos) {
+        throw std::runtime_error("Fortran-ordered NumPy arrays are not supported: " + path);
+    }
+    size_t offset = header_start + header_len;
+    if ((file.size - offset) % 4 != 0) {
+        throw std::runtime_error("NumPy data is not a whole number of 32-bit words: " + path);
+    }
+    return {offset, (file.size - offset) / 4};
+}
 
-                    // Load coefficients
-                    if (instr["coefficients"] && !instr["coefficients"].IsNull()) {
-                        auto coeffs = instr["coefficients"];
-                        for (const auto& coeff : coeffs) {
-                            instruction.coefficients[coeff.first.as<std::string>()] = coeff.second.as<int>();
-                        }
-                    }
-                }
+// Lay the data inputs out per cluster. Registers with a psrf_mem_offset give each cluster
+// its own slice of that many words at calculateClusterBaseAddress; registers without one
+// share a single copy. data_dup replicas repeat the slices at their shifted addresses.
+std::vector<DFGProcessor::DataRegion> DFGProcessor::planDataRegions(const std::map<std::string, size_t>& input_words) {
+    std::vector<DataRegion> regions;
+    for (const auto& [reg, words] : input_words) {
+        int slice = mem_offsets.count(reg + "_offset") > 0 ? mem_offsets[reg + "_offset"] : 0;
+        std::set<int> placed;
+        for (int pe = 0; pe < total_pes; pe++) {
+            int cluster = getClusterNumber(pe);
+            int address = calculateClusterBaseAddress(reg, cluster, data_dup, pe);
+            if (!placed.insert(address).second) continue;
+            size_t first = slice > 0 ? static_cast<size_t>(slice) * cluster : 0;
+            size_t count = slice > 0 ? static_cast<size_t>(slice) : words;
+            if (first >= words) continue;
+            regions.push_back({address, reg, first, std::min(count, words - first)});
+        }
+        if (slice > 0 && static_cast<size_t>(slice) * clusters_count < words) {
+            log() << "Warning: " << reg << " input has " << words << " words but only "
+                      << static_cast<size_t>(slice) * clusters_count << " are reachable by "
+                      << clusters_count << " clusters" << std::endl;
+        }
+    }
+    std::sort(regions.begin(), regions.end(),
+              [](const DataRegion& a, const DataRegion& b) { return a.address < b.address; });
+    for (size_t i = 1; i < regions.size(); i++) {
+        const auto& prev = regions[i - 1];
+        if (static_cast<size_t>(prev.address) + prev.words > static_cast<size_t>(regions[i].address)) {
+            throw std::runtime_error("Data regions of " + prev.reg + " and " + regions[i].reg +
+                                     " overlap at word " + std::to_string(regions[i].address));
+        }
+    }
+    return regions;
+}
 
-                if (instruction.format == "mem-type") {
-                    pe_assignment.has_mem_type = true;
-                }
-                
-                // Load target field for JAL instructions
-                if (instr["target"] && !instr["target"].IsNull()) {
-                    instruction.target = instr["target"].as<std::string>();
-                }
+// Write the data-memory image (data_memory.mem or data_memory.bin), streaming each region
+// from the mapped inputs in fixed-size blocks
+void DFGProcessor::generateDataImages() {
+    if (data_inputs.empty()) return;
+    ScopedTimer timer("data_images");
 
-                // Load address field for JAL instructions
-                if (instr["address"] && !instr["address"].IsNull()) {
-                    instruction.address = instr["address"].as<int>();
-                }
+    std::map<std::string, std::unique_ptr<MappedFile>> files;
+    std::map<std::string, size_t> payload_offsets, input_words;
+    for (const auto& [reg, path] : data_inputs) {
+        files[reg] = std::make_unique<MappedFile>(path);
+        auto [offset, words] = dataPayload(*files[reg], path);
+        payload_offsets[reg] = offset;
+        input_words[reg] = words;
+        log() << "Data input " << reg << ": " << path << " (" << words << " words)" << std::endl;
+    }
+    std::vector<DataRegion> regions = planDataRegions(input_words);
 
-                // Load offset field for memory operations
-                if (instr["offset"] && !instr["offset"].IsNull()) {
-                    instruction.offset = instr["offset"].as<int>();
-                }
+    std::string filename = output_folder + "data_memory." + data_image_format;
+    std::ofstream out(filename, data_image_format == "bin" ? std::ios::binary : std::ios::out);
+    if (!out) {
+        throw std::runtime_error("Cannot create data image: " + filename);
+    }
+    MemFormat format;
+    format.burst = true;
+    format.words_per_line = data_words_per_line;
+    std::optional<MemWriter> writer;
+    if (data_image_format == "mem") {
+        out << "// Data memory image for mem_config regions\n";
+        writer.emplace(out, format);
+    }
 
-                pe_assignment.instructions.push_back(instruction);
+    size_t total_words = 0;
+    std::vector<uint32_t> block(1 << 16);
+    for (const auto& region : regions) {
+        const unsigned char* src = files[region.reg]->data + payload_offsets[region.reg] + region.first_word * 4;
+        if (data_image_format == "bin") {
+            // Dense image indexed by word address; gaps are left as file holes
+            out.seekp(static_cast<std::streamoff>(region.address) * 4);
+            out.write(reinterpret_cast<const char*>(src), static_cast<std::streamsize>(region.words * 4));
+        } else {
+            // One @address per region; the mapped input is decoded in fixed-size blocks
+            for (size_t done = 0; done < region.words; done += block.size()) {
+                size_t count = std::min(block.size(), region.words - done);
+                for (size_t w = 0; w < count; w++) {
+                    const unsigned char* word = src + (done + w) * 4;
+                    block[w] = word[0] | (word[1] << 8) | (word[2] << 16) | (static_cast<uint32_t>(word[3]) << 24);
+                }
+                writer->write_run(static_cast<uint32_t>(region.address + done), block.data(), count);
             }
-            pe_assignments.push_back(pe_assignment);
         }
+        total_words += region.words;
+        log() << "Data region " << region.reg << " words [" << region.first_word << ", "
+                  << region.first_word + region.words << ") at 0x" << std::hex << region.address
+                  << std::dec << std::endl;
+    }
+    writer.reset();
+    Profiler::count("bytes_written", static_cast<uint64_t>(out.tellp()));
+    out.close();
+    log() << "Data image written to " << filename << ": " << regions.size() << " regions, "
+              << total_words << " words" << std::endl;
+}
 
-        // Load function definitions
-        if (config["functions"]) {
-            auto functions = config["functions"];
-            for (const auto& func : functions) {
-                std::string func_name = func.first.as<std::string>();
-                int func_address = func.second["address"].as<int>();
-                
-                // Store function address for later use
-                function_addresses[func_name] = func_address;
-                
-                // Process PE assignments for this function
-                auto pe_assigns = func.second["pe_assignments"];
-                for (const auto& pe_assign : pe_assigns) {
-                    int pe_id = pe_assign["pe_id"].as<int>();
-                    PEAssignment func_pe_assignment;
-                    func_pe_assignment.pe_id = pe_id;
-                    func_pe_assignment.has_psrf_mem_type = false;
-                    func_pe_assignment.has_hwl = false;
-                    
-                    for (const auto& instr : pe_assign["instructions"]) {
-                        Instruction instruction;
-                        instruction.operation = instr["operation"].as<std::string>();
-                        instruction.format = instr["format"].as<std::string>();
-                        
-                        // Handle register assignments
-                        instruction.ra1 = "null";
-                        instruction.ra2 = "null";
-                        instruction.rd = "null";
-                        if (instr["ra1"] && !instr["ra1"].IsNull()) {
-                            instruction.ra1 = instr["ra1"].as<std::string>();
-                        }
-                        if (instr["ra2"] && !instr["ra2"].IsNull()) {
-                            instruction.ra2 = instr["ra2"].as<std::string>();
-                        }
-                        if (instr["rd"] && !instr["rd"].IsNull()) {
-                            instruction.rd = instr["rd"].as<std::string>();
-                        }
-
-                        // Handle immediate value for I-type instructions
-                        instruction.imm = 0;
-                        if (instr["imm"] && !instr["imm"].IsNull()) {
-                            instruction.imm = instr["imm"].as<int>();
-                        }
-                        
-                        // Set operation to uppercase for standard operations
-                        if (instruction.format == "i-type" || instruction.format == "r-type") {
-                            std::string upper_op = instruction.operation;
-                            std::transform(upper_op.begin(), upper_op.end(), upper_op.begin(), ::toupper);
-                            instruction.operation = upper_op;
-                        }
-                        
-                        func_pe_assignment.instructions.push_back(instruction);
-                    }
-                    std::cout << "PE " << pe_id << " Function PE assignment: " << func_pe_assignment.instructions.size() << std::endl;
-                    // Store function PE assignment
-                    function_pe_assignments[func_name][pe_id] = func_pe_assignment;
-                }
-            }
+// Write performance_report.json: per-PE and per-cluster dynamic operation counts, bytes
+// moved per base register, arithmetic intensity, load imbalance and a roofline bound.
+// Counts come from the programs as generated, after call optimization.
+void DFGProcessor::generateReport() {
+    if (!report_enabled) return;
+    ScopedTimer timer("report");
+
+    std::map<int, PerformanceCounts> pes;
+    for (int pe = 0; pe < total_pes; pe++) {
+        int base_pe = pe % pes_per_cluster;
+        if (base_pe > minimum_pes_required || static_cast<size_t>(base_pe) >= pe_assignments.size() ||
+            !hasProgram(pe_assignments[base_pe])) {
+            continue;
         }
+        pes[pe] = performanceCounts(pe);
     }
+    if (pes.empty()) return;
 
-    void generateAssembly() {
-        // Generate assembly for each PE
-        std::cout << "Generating assembly for " << total_pes << " PEs" << std::endl;
-        for (int pe = 0; pe < total_pes; pe++) {
+    // Roofline: a PE is memory bound when its intensity is below the ridge point
+    double ridge = report_peak_ops / report_peak_bytes;
+    auto bound = [&](const PerformanceCounts& counts, std::ostream& out) {
+        double compute_cycles = counts.ops() / report_peak_ops;
+        double memory_cycles = counts.bytes() / report_peak_bytes;
+        double intensity = counts.bytes() > 0 ? static_cast<double>(counts.ops()) / counts.bytes() : 0;
+        out << ", \"roofline\": {\"bound\": \"" << (compute_cycles >= memory_cycles ? "compute" : "memory")
+            << "\", \"min_cycles\": " << std::max(compute_cycles, memory_cycles)
+            << ", \"attainable_ops_per_cycle\": "
+            << (counts.bytes() > 0 ? std::min(report_peak_ops, intensity * report_peak_bytes) : report_peak_ops)
+            << "}";
+    };
 
-            int base_pe = pe % pes_per_cluster;
-            std::cout << "Base PE: " << base_pe << std::endl;
-            std::cout << "Minimum PEs required: " << minimum_pes_required << std::endl;
-            if (base_pe > minimum_pes_required) {
-                std::cout << "Skipping PE " << pe << " due to minimum PEs required" << std::endl;
-                continue;
-            }
-            const PEAssignment& assignment = pe_assignments[base_pe];
-            std::cout << "Assignment: " << assignment.instructions.size() << std::endl;
-            if (assignment.instructions.size() >= 10000 || assignment.instructions.size() == 0) {
-                std::cout << "Skipping PE " << pe << " due to large number of instructions" << std::endl;   
-                continue;
-            }  
-            std::cout << "Assignment: " << assignment.instructions.size() << std::endl;
+    std::map<int, PerformanceCounts> clusters;
+    std::map<int, long long> cluster_max_cycles;
+    PerformanceCounts total;
+    long long max_cycles = 0;
+    for (const auto& [pe, counts] : pes) {
+        clusters[getClusterNumber(pe)].add(counts);
+        cluster_max_cycles[getClusterNumber(pe)] = std::max(cluster_max_cycles[getClusterNumber(pe)], counts.cycles);
+        total.add(counts);
+        max_cycles = std::max(max_cycles, counts.cycles);
+    }
+    double mean_cycles = static_cast<double>(total.cycles) / pes.size();
+    double imbalance = mean_cycles > 0 ? max_cycles / mean_cycles : 1.0;
 
-            std::string filename = output_folder + "pe" + std::to_string(pe) + "_assembly.s";
-            std::ofstream outFile(filename);
-            
-            outFile << "# Assembly for PE" << pe << " (Cluster " << getClusterNumber(pe) << ")\n";
-            outFile << "# Generated with PSRF, HWL and function support\n";
-            outFile << ".text\n";
-            outFile << ".global _start\n\n";
-            outFile << "_start:\n";
+    std::string filename = output_folder + "performance_report.json";
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Cannot create performance report: " + filename);
+    }
+    out << "{\n  \"peak_ops_per_cycle\": " << report_peak_ops << ",\n  \"peak_bytes_per_cycle\": "
+        << report_peak_bytes << ",\n  \"ridge_point\": " << ridge << ",\n  \"active_pes\": " << pes.size()
+        << ",\n  \"max_pe_cycles\": " << max_cycles << ",\n  \"mean_pe_cycles\": " << mean_cycles
+        << ",\n  \"load_imbalance\": " << imbalance << ",\n  \"total\": {";
+    writeCounts(out, total);
+    out << "},\n  \"clusters\": {";
+    bool first = true;
+    for (const auto& [cluster, counts] : clusters) {
+        out << (first ? "" : ",") << "\n    \"" << cluster << "\": {";
+        writeCounts(out, counts);
+        out << ", \"max_pe_cycles\": " << cluster_max_cycles[cluster];
+        bound(counts, out);
+        out << "}";
+        first = false;
+    }
+    out << "\n  },\n  \"pes\": {";
+    first = true;
+    for (const auto& [pe, counts] : pes) {
+        out << (first ? "" : ",") << "\n    \"" << pe << "\": {\"cluster\": " << getClusterNumber(pe) << ", ";
+        writeCounts(out, counts);
+        bound(counts, out);
+        auto allocation = register_allocations.find(pe % pes_per_cluster);
+        if (allocation != register_allocations.end()) {
+            const RegisterAllocation& a = allocation->second;
+            out << ", \"registers\": {\"virtual\": " << a.assignment.size() + a.spill_slot.size()
+                << ", \"physical\": " << a.registers_used << ", \"spilled\": " << a.spill_slot.size()
+                << ", \"spill_loads\": " << a.spill_loads << ", \"spill_stores\": " << a.spill_stores
+                << ", \"spill_cost\": " << a.spill_cost << "}";
+        }
+        out << "}";
+        first = false;
+    }
+    out << "\n  }\n}\n";
+    out.close();
 
-            // Determine which instruction set to use based on PE number
- 
+    log() << "\nPerformance report (" << pes.size() << " PEs, peak " << report_peak_ops << " ops and "
+              << report_peak_bytes << " bytes per cycle):" << std::endl;
+    for (const auto& [cluster, counts] : clusters) {
+        double intensity = counts.bytes() > 0 ? static_cast<double>(counts.ops()) / counts.bytes() : 0;
+        log() << "  Cluster " << cluster << ": " << counts.macs << " MACs, " << counts.loads << " loads, "
+                  << counts.stores << " stores, " << counts.bytes() << " bytes, intensity " << intensity
+                  << " ops/byte, slowest PE " << cluster_max_cycles[cluster] << " cycles" << std::endl;
+    }
+    log() << "  Load imbalance (max/mean PE cycles): " << imbalance << std::endl;
+    log() << "Performance report written to " << filename << std::endl;
+}
 
-            // Generate base address loading if needed
-            if (!assignment.required_base_registers.empty()) {
-                outFile << generateBaseAddressLoading(pe, data_dup);
+// Cycle-model estimate of the schedule without writing any files: the slowest PE's cycles
+// (as in the performance report) and the largest PE image, laid out as generatePEAssembly
+// does. Shared cluster libraries count once towards the total.
+ScheduleEstimate DFGProcessor::estimateSchedule() {
+    optimizeCalls();
+    ScheduleEstimate estimate;
+    std::map<int, std::vector<int>> instruction_words;  // Base PE -> words per instruction, shared by its PEs
+    std::map<int, long long> cluster_accesses;
+    std::set<std::pair<std::string, int>> regions;  // (base register, address)
+    for (int pe = 0; pe < total_pes; pe++) {
+        int base_pe = pe % pes_per_cluster;
+        if (base_pe > minimum_pes_required || static_cast<size_t>(base_pe) >= pe_assignments.size() ||
+            !hasProgram(pe_assignments[base_pe])) {
+            continue;
+        }
+        const PEAssignment& assignment = pe_assignments[base_pe];
+        std::vector<Instruction> scratch;
+        const std::vector<Instruction>& program = instructionsOf(assignment, scratch);
+        std::vector<int>& instr_words = instruction_words[base_pe];
+        if (instr_words.empty()) {
+            std::vector<int> position = instructionPositions(program);
+            for (size_t i = 0; i < program.size(); i++) instr_words.push_back(position[i + 1] - position[i]);
+        }
+        std::string preload_text;
+        if (!assignment.required_base_registers.empty()) preload_text += generateBaseAddressLoading(pe, data_dup);
+        if (assignment.has_psrf_mem_type || assignment.has_mem_type) preload_text += generatePreloadSection(program);
+        int delay = getDelayStart(pe);
+        int window = imem_execution_words;
+        std::string function_text;
+        if (function_libraries.count(getClusterNumber(pe)) > 0) {
+            window = function_libraries[getClusterNumber(pe)].base_word;
+        } else {
+            int hwl_count = 0;
+            function_text = generateFunctionSections(pe, hwl_count, delay);
+        }
+        int fixed_words = countInstructionWords(function_text) + 1;
+        std::vector<OverlaySegment> segments = layoutExecution(program, instr_words, fixed_words, delay, window, pe);
+        int words = countInstructionWords(preload_text) + executionWords(segments, fixed_words, delay);
+        PerformanceCounts counts = performanceCounts(pe);
+        estimate.active_pes++;
+        estimate.cycles = std::max(estimate.cycles, counts.cycles);
+        estimate.total_cycles += counts.cycles;
+        estimate.imem_words = std::max(estimate.imem_words, words);
+        estimate.imem_total_words += words;
+        estimate.operations += counts.ops();
+        cluster_accesses[getClusterNumber(pe)] += counts.loads + counts.stores;
+        for (const auto& reg : assignment.required_base_registers) {
+            if (mem_config.count(reg) > 0) {
+                regions.insert({reg, calculateClusterBaseAddress(reg, getClusterNumber(pe), data_dup, pe)});
             }
+        }
+    }
+    for (const auto& [cluster, accesses] : cluster_accesses) {
+        estimate.max_cluster_accesses = std::max(estimate.max_cluster_accesses, accesses);
+        if (function_libraries.count(cluster) > 0) {
+            estimate.imem_total_words += countInstructionWords(function_libraries[cluster].text);
+        }
+    }
+    // Registers without a psrf_mem_offset share one region of unstated size
+    for (const auto& [reg, address] : regions) {
+        auto slice = mem_offsets.find(reg + "_offset");
+        if (slice != mem_offsets.end()) estimate.data_words += slice->second;
+    }
+    estimate.data_regions = static_cast<int>(regions.size());
+    return estimate;
+}
 
-            std::cout << "Assignment has psrf mem type: " << assignment.has_psrf_mem_type << std::endl;
-            std::cout << "Assignment has mem type: " << assignment.has_mem_type << std::endl;
-            // Generate preload section if needed
-            if (assignment.has_psrf_mem_type || assignment.has_mem_type) {
-                std::cout << "Generating preload section" << std::endl;
-                outFile << generatePreloadSection(assignment);
-            }
+// Assembly source of one PE's image, or an empty string for a PE without a program.
+// Needs optimizeCalls() first; writes nothing.
+std::string DFGProcessor::generatePEAssembly(int pe) {
+    int base_pe = pe % pes_per_cluster;
+    log() << "Base PE: " << base_pe << std::endl;
+    log() << "Minimum PEs required: " << minimum_pes_required << std::endl;
+    if (base_pe > minimum_pes_required) {
+        log() << "Skipping PE " << pe << " due to minimum PEs required" << std::endl;
+        return "";
+    }
+    if (static_cast<size_t>(base_pe) >= pe_assignments.size()) {
+        log() << "Skipping PE " << pe << " without an assignment" << std::endl;
+        return "";
+    }
+    const PEAssignment& assignment = pe_assignments[base_pe];
+    std::vector<Instruction> scratch;
+    const std::vector<Instruction>& program = instructionsOf(assignment, scratch);
+    log() << "Assignment: " << program.size() << std::endl;
+    if (program.size() == 0) {
+        log() << "Skipping PE " << pe << " due to empty instruction list" << std::endl;   
+        return "";
+    }  
 
+    ScopedTimer timer("generate_pe", pe);
+    Profiler::count("instructions_processed", program.size());
+    int delay = getDelayStart(pe);
 
+    // Preload image: base address loading followed by PSRF/CORF preloads
+    std::string preload_text;
+    if (!assignment.required_base_registers.empty()) {
+        preload_text += generateBaseAddressLoading(pe, data_dup);
+    }
 
-            // Add comment to mark the beginning of the execution section
-            outFile << "    # ========== Execution Section Begin ==========\n";
-            // Add delay NOPs before execution section
-            if (pe < delay_start.size() && delay_start[pe] > 0) {
-                outFile << "    # Adding " << delay_start[pe] << " NOPs for delay\n";
-                for (int i = 0; i < delay_start[pe]; i++) {
-                    outFile << "    nop\n";
-                }
-                outFile << "\n";
+    log() << "Assignment has psrf mem type: " << assignment.has_psrf_mem_type << std::endl;
+    log() << "Assignment has mem type: " << assignment.has_mem_type << std::endl;
+    if (assignment.has_psrf_mem_type || assignment.has_mem_type) {
+        log() << "Generating preload section" << std::endl;
+        preload_text += generatePreloadSection(program);
+    }
+
+    int preload_words = countInstructionWords(preload_text);
+    if (preload_words > imem_preload_words) {
+        throw std::runtime_error("PE " + std::to_string(pe) + ": preload section needs " +
+                                 std::to_string(preload_words) + " words but the preload window holds " +
+                                 std::to_string(imem_preload_words));
+    }
+
+    // Execution image: one code block per instruction, then the function bodies
+    int hwl_count = 0;  // Counter for hardware loop immediates
+    std::vector<std::string> codes;
+    std::vector<int> words;
+    std::vector<int> position;  // Execution word offset of each instruction
+    int program_words = 0;
+    for (const auto& instr : program) {
+        codes.push_back(generateInstructionCode(instr, hwl_count, delay));
+        words.push_back(countInstructionWords(codes.back()));
+        position.push_back(program_words);
+        program_words += words.back();
+    }
+    // Shared library functions live in the cluster region above the PE's own code
+    std::string function_text;
+    int window = imem_execution_words;
+    if (function_libraries.count(getClusterNumber(pe)) > 0) {
+        window = function_libraries[getClusterNumber(pe)].base_word;
+    } else {
+        function_text = generateFunctionSections(pe, hwl_count, delay);
+    }
+    int fixed_words = countInstructionWords(function_text) + 1;
+    std::vector<OverlaySegment> segments = layoutExecution(program, words, fixed_words, delay, window, pe);
+
+    std::ostringstream out;
+    out << "# Assembly for PE" << pe << " (Cluster " << getClusterNumber(pe) << ")\n";
+    out << "# Generated with PSRF, HWL and function support\n";
+    out << ".text\n";
+    out << ".global _start\n";
+    out << generateLibrarySymbols(pe) << "\n";
+    out << "_start:\n";
+    out << preload_text;
+
+    // Add comment to mark the beginning of the execution section
+    out << "    # ========== Execution Section Begin ==========\n";
+    for (size_t k = 0; k < segments.size(); k++) {
+        const OverlaySegment& segment = segments[k];
+        if (segments.size() > 1) {
+            // Every phase after the first is loaded over the previous one at a reload point
+            if (k > 0) {
+                out << "\n    # ========== Overlay " << k << " Reload Point ==========\n";
             }
-            // Generate instructions
-            int hwl_count = 0;  // Counter for hardware loop immediates
-            for (const auto& instr : assignment.instructions) {
-                outFile << generateInstructionCode(instr, hwl_count, pe);
+            out << ".overlay " << k << "\n";
+            out << "    # Overlay " << k << ": execution words " << segment.start_word << "-"
+                    << segment.start_word + segment.words - 1 << " of " << program_words << "\n";
+        }
+
+        // Add delay NOPs before execution section
+        if (k == 0 && delay > 0) {
+            out << "    # Adding " << delay << " NOPs for delay\n";
+            out << ".rept " << delay << "\n";
+            out << "    nop\n";
+            out << ".endr\n";
+            out << "\n";
+        }
+
+        // Hardware loop bounds become labels on the instructions they refer to,
+        // so the assembler resolves them wherever the code ends up
+        int overlay_delay = (k == 0) ? delay : 0;
+        std::map<size_t, std::vector<std::string>> labels_at;
+        std::set<size_t> symbolic_loops;
+        for (size_t i = segment.begin; i < segment.end; i++) {
+            const Instruction& instr = program[i];
+            if (!instr.hwl.has_value()) continue;
+            auto first = position.begin() + segment.begin;
+            auto last = position.begin() + segment.end;
+            auto start_it = std::lower_bound(first, last, instr.hwl->pc_start);
+            auto stop_it = std::lower_bound(first, last, instr.hwl->pc_stop);
+            if (start_it != last && *start_it == instr.hwl->pc_start &&
+                stop_it != last && *stop_it == instr.hwl->pc_stop) {
+                std::string label = "hwl" + std::to_string(i);
+                labels_at[start_it - position.begin()].push_back(label + "_start");
+                labels_at[stop_it - position.begin()].push_back(label + "_stop");
+                symbolic_loops.insert(i);
             }
+        }
 
-            // Generate function sections
-            if (!function_pe_assignments.empty()) {
-                outFile << "\n    # ========== Function Sections ==========\n";
-                for (const auto& func : function_pe_assignments) {
-                    const std::string& func_name = func.first;
-                    const auto& pe_assigns = func.second;
-                    
-                    if (pe_assigns.find(pe) != pe_assigns.end()) {
-                        const PEAssignment& func_assignment = pe_assigns.at(pe);
-                        
-                        // Add function label
-                        outFile << "\n" << func_name << ":\n";
-                        outFile << "    # Function " << func_name << " (address: 0x" 
-                               << std::hex << function_addresses[func_name] << std::dec << ")\n";
-                        
-                        for (const auto& instr : func_assignment.instructions) {
-                            outFile << generateInstructionCode(instr, hwl_count, pe);
-                        }
-                        
-                        // Add return instruction if not already present
-                        if (func_assignment.instructions.empty() || 
-                            func_assignment.instructions.back().operation != "JALR") {
-                            outFile << "    jalr x0, x26, 0  # Return from function\n";
-                        }
-                    }
+        // Generate instructions
+        int overlay_hwl_count = 0;
+        for (size_t i = segment.begin; i < segment.end; i++) {
+            const Instruction& instr = program[i];
+            if (labels_at.count(i) > 0) {
+                for (const auto& label : labels_at[i]) {
+                    out << label << ":\n";
                 }
             }
-
-            outFile << "    # End of program\n";
-            outFile << "    ret\n";
-            outFile.close();
-            
-            std::cout << "Generated assembly for PE" << pe << " (Cluster " << 
-                     getClusterNumber(pe) << ") in " << filename << std::endl;
+            if (isLibraryCall(instr, pe)) {
+                out << generateLibraryCall(instr, pe);
+            } else if (isLocalCall(instr, pe)) {
+                out << "    jal " << instr.rd << ", " << instr.target << "  # Call " << instr.target << "\n";
+            } else if (instr.hwl.has_value()) {
+                // Rebase the loop onto the overlay that holds it
+                Instruction rebased = instr;
+                rebased.hwl->pc_start -= segment.start_word;
+                rebased.hwl->pc_stop -= segment.start_word;
+                checkHWLFields(rebased.hwl.value(), overlay_delay, pe);
+                std::string label = symbolic_loops.count(i) > 0 ? "hwl" + std::to_string(i) : "";
+                out << generateHWLInstructions(rebased, ++overlay_hwl_count, overlay_delay, label);
+            } else {
+                out << codes[i];
+            }
         }
-    }
-};
 
-int main(int argc, char* argv[]) {
-    // Check if correct number of arguments is provided
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <yaml_file> [output_folder]" << std::endl;
-        std::cerr << "  yaml_file: Path to the YAML configuration file" << std::endl;
-        std::cerr << "  output_folder: Directory to store generated assembly files (default: 'build')" << std::endl;
-        return 1;
+        // Generate function sections
+        out << function_text;
+
+        out << "    # End of program\n";
+        out << "    ret\n";
     }
-    
-    // Parse arguments
-    std::string yaml_file = argv[1];
-    std::string output_folder = (argc >= 3) ? argv[2] : "build";
-    
-    // Ensure output folder ends with a trailing slash
-    if (!output_folder.empty() && output_folder.back() != '/') {
-        output_folder += '/';
+    log() << "IMEM layout for PE" << pe << ": preload " << preload_words << "/" << imem_preload_words
+          << " words, execution " << executionWords(segments, fixed_words, delay) << " words";
+    if (segments.size() > 1) {
+        log() << " in " << segments.size() << " overlays of at most " << window;
+    } else {
+        log() << "/" << window;
     }
-    
-    // Create output directory if it doesn't exist
-    std::string mkdir_cmd = "mkdir -p " + output_folder;
-    int dir_result = system(mkdir_cmd.c_str());
-    if (dir_result != 0) {
-        std::cerr << "Warning: Failed to create output directory: " << output_folder << std::endl;
+    log() << std::endl;
+    return out.str();
+}
+
+// Shared function library sources by cluster (cluster code placement only)
+std::map<int, std::string> DFGProcessor::libraryAssembly() {
+    optimizeCalls();
+    std::map<int, std::string> sources;
+    for (const auto& [cluster, library] : function_libraries) sources[cluster] = library.text;
+    return sources;
+}
+
+void DFGProcessor::generateAssembly() {
+    // Generate assembly for each PE
+    log() << "Generating assembly for " << total_pes << " PEs" << std::endl;
+    optimizeCalls();
+    if (partitioned) {
+        std::string path = output_folder + "partitioned_config.yaml";
+        std::ofstream out(path);
+        YAML::Emitter emitter;
+        emitter << partitioned_config;
+        out << emitter.c_str() << "\n";
+        log() << "Partitioned configuration written to " << path << std::endl;
     }
-    
-    std::cout << "Input YAML file: " << yaml_file << std::endl;
-    std::cout << "Output folder: " << output_folder << std::endl;
-    
-    DFGProcessor processor(output_folder);
-    
-    try {
-        processor.loadConfig(yaml_file);
-        processor.generateAssembly();
-        std::cout << "Assembly generation completed successfully!" << std::endl;
-    } catch (const YAML::Exception& e) {
-        std::cerr << "Error processing YAML file: " << e.what() << std::endl;
-        return 1;
-    } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
+    for (const auto& [cluster, library] : function_libraries) {
+        std::string filename = output_folder + "cluster" + std::to_string(cluster) + "_library.s";
+        std::ofstream outFile(filename);
+        outFile << library.text;
+        Profiler::count("bytes_written", library.text.size());
+        log() << "Cluster " << cluster << " function library written to " << filename << std::endl;
     }
-    
-    return 0;
-} 
\ No newline at end of file
+    for (int pe = 0; pe < total_pes; pe++) {
+        std::string text = generatePEAssembly(pe);
+        if (text.empty()) continue;
+
+        std::string filename = output_folder + "pe" + std::to_string(pe) + "_assembly.s";
+        ScopedTimer write_timer("write_assembly", pe);
+        std::ofstream outFile(filename);
+        outFile << text;
+        Profiler::count("bytes_written", text.size());
+        log() << "Generated assembly for PE" << pe << " (Cluster " << getClusterNumber(pe) << ") in " << filename
+              << std::endl;
+    }
+}
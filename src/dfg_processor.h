@@ -0,0 +1,304 @@
+#ifndef DFG_PROCESSOR_H
+#define DFG_PROCESSOR_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <yaml-cpp/yaml.h>
+#include <optional>
+#include <memory>
+#include "config_formats.h"
+#include "register_allocator.h"
+
+struct HardwareLoop {
+    int loop_id;
+    int pc_start;
+    int pc_stop;
+    int hwl_index;
+    int iterations;
+};
+
+struct Instruction {
+    std::string operation;
+    std::string ra1;
+    std::string ra2;
+    std::string rd;      // Add destination register field
+    std::string base_address;  // Changed to string for register-based addressing
+    std::string format;
+    std::map<std::string, int> coefficients;  // Now using c0-c5
+    std::optional<int> var;                   // Used for register offset calculation
+    std::map<std::string, int> psrf_var;      // Now using v0-v5 with integer values
+    std::optional<HardwareLoop> hwl;  // New field for hardware loop info
+    int imm = 0;              // Immediate value for I-type instructions
+    std::string target;       // Added for JAL target
+    int address = 0;          // Added for JAL target address
+    int offset = 0;           // Added for memory offset
+};
+
+// Cycle-model summary of a whole schedule, used to compare configurations
+struct ScheduleEstimate {
+    long long cycles = 0;        // Slowest PE, delay_start included
+    long long total_cycles = 0;  // Sum over active PEs
+    int imem_words = 0;          // Largest PE image: preload and every overlay phase with its functions
+    long long imem_total_words = 0;
+    int active_pes = 0;
+    long long operations = 0;            // Dynamic ALU operations over all PEs
+    long long max_cluster_accesses = 0;  // Dynamic loads and stores of the busiest cluster
+    long long data_words = 0;            // Data memory in per-cluster slices (psrf_mem_offset strided registers)
+    int data_regions = 0;                // Distinct base addresses the active PEs use
+};
+
+struct PETemplate;
+
+struct PEAssignment {
+    int pe_id;
+    std::vector<Instruction> instructions;
+    bool has_psrf_mem_type;  // Flag to indicate if PE needs preload section
+    bool has_mem_type;      // Flag to indicate if PE needs preload section
+    std::set<std::string> required_base_registers;  // Track which base registers are needed
+    bool has_hwl;  // New flag for hardware loop
+    // Program taken from a template; instructions stays empty and is expanded where it is used
+    std::shared_ptr<const PETemplate> source;
+    std::map<std::string, std::string> arguments;  // Template parameter -> value
+};
+
+// Instruction field whose value is a template parameter ("$name" in the YAML)
+struct TemplateBinding {
+    size_t instruction;
+    std::string field;      // ra1, var, psrf_var.v0, coefficients.c2, iterations, ...
+    std::string parameter;
+};
+
+// Program shared by the PE assignments that name it (scheduling.templates). The body is
+// parsed once with every parameter at its default; each PE keeps only its arguments.
+struct PETemplate {
+    std::string name;
+    PEAssignment body;
+    std::map<std::string, std::optional<std::string>> parameters;  // Parameter -> default (none: every user sets it)
+    std::vector<TemplateBinding> bindings;
+    std::set<std::string> fixed_base_registers;       // Memory base registers that are not parameters
+};
+
+class DFGProcessor {
+private:
+    std::vector<PEAssignment> pe_assignments;
+    std::map<std::string, int> mem_config;  // Memory configuration
+    std::map<std::string, int> mem_offsets; // Memory offsets for each register
+    std::map<std::string, int> function_addresses;  // Store function addresses
+    std::map<std::string, std::map<int, PEAssignment>> function_pe_assignments;  // Store function PE assignments
+    int total_pes;
+    int clusters_count;
+    int pes_per_cluster;
+    int minimum_pes_required;
+    int data_dup;
+    std::map<int, int> hwl_imm_values;  // Map to store hardware loop immediate values
+    std::string output_folder;
+    std::vector<int> delay_start;  // Array to store delay values for each PE
+    std::ostream* log_stream = &std::cout;  // Progress messages
+
+    std::ostream& log() { return *log_stream; }
+
+    // Instruction memory capacity per PE, in instruction words. The assembler ORs the
+    // execution index into the low address bits and uses bit 9 to select the preload
+    // window, so each section holds at most 512 words.
+    int imem_execution_words = 512;
+    int imem_preload_words = 512;
+
+    // A contiguous slice of a PE's execution instructions loaded as one overlay phase
+    struct OverlaySegment {
+        size_t begin;     // First instruction index (inclusive)
+        size_t end;       // Last instruction index (exclusive)
+        int start_word;   // Execution word offset of the first instruction in the full program
+        int words;        // Execution words used by the instructions in this segment
+    };
+
+    // Function bodies shared by the PEs of one cluster, mapped into every PE's
+    // execution window at base_word
+    struct FunctionLibrary {
+        int base_word = 0;                                   // Execution word the library is mapped at
+        int words = 0;                                       // Size of the library image
+        int per_pe_words = 0;                                // Words the bodies take when copied per PE
+        std::vector<std::string> bodies;                     // Unique body text in placement order
+        std::vector<std::string> labels;                     // Symbol of each body
+        std::vector<int> offsets;                            // Word offset of each body in the library
+        std::map<std::pair<std::string, int>, int> symbols;  // (function, pe) -> body index
+        std::string text;                                    // Assembly source of the library image
+    };
+
+    // Function placement: "per_pe" copies bodies into each PE image, "cluster" links
+    // identical bodies once per cluster into a shared code region
+    std::string function_placement = "per_pe";
+    int function_library_base = -1;  // Execution word of the shared region (-1: top of the window)
+    uint32_t function_library_region = 0;  // Address of the cluster code region (0: not configured)
+    std::map<int, FunctionLibrary> function_libraries;
+
+    // Call optimization: inline small or hot function bodies at their JAL sites, and
+    // outline repeated straight-line sequences into functions when IMEM is the limit
+    bool inline_enabled = false;
+    int inline_max_body_words = 4;       // Bodies this small are always inlined
+    long long inline_min_hot_count = 1024;  // Larger bodies are inlined at sites executed this often
+    int call_penalty = 2;                // Pipeline refill cycles after each jal and each return
+    bool outline_enabled = false;
+    int outline_min_length = 4;          // Shortest instruction sequence worth outlining
+    int outline_max_length = 16;
+
+    bool calls_optimized = false;
+
+    // Register allocation of virtual (%name) registers; spills go to words of spill_base
+    std::string spill_base;
+    std::map<int, RegisterAllocation> register_allocations;  // Base PE -> allocation
+
+    // Configuration with a dataflow graph replaced by the partitioned pe_assignments,
+    // written to partitioned_config.yaml
+    bool partitioned = false;
+    YAML::Node partitioned_config;
+
+    // Data-memory images: input arrays for the mem_config base registers, laid out per
+    // cluster at the addresses the generated code loads into those registers
+    std::map<std::string, std::string> data_inputs;  // Register -> .bin or .npy path
+    std::string data_image_format = "mem";           // "mem" ($readmemh text) or "bin" (raw words)
+    int data_words_per_line = 1;                     // Words per line of the burst .mem layout
+
+    // Static performance report: dynamic operation counts from the hardware loop nest and a
+    // roofline bound for the configured per-PE peak rates
+    bool report_enabled = false;
+    double report_peak_ops = 1.0;    // ALU operations per cycle
+    double report_peak_bytes = 4.0;  // Data-memory bytes per cycle
+
+    // Dynamic operation counts of one PE (or the sum over a cluster)
+    struct PerformanceCounts {
+        long long macs = 0;           // MULs whose product the next ADD accumulates
+        long long muls = 0;
+        long long adds = 0;           // ADD, ADDI and SUB
+        long long other_alu = 0;      // Remaining R/I-type operations
+        long long loads = 0;
+        long long stores = 0;
+        long long calls = 0;
+        long long cycles = 0;         // Single-issue estimate: executed words, delay and call penalties
+        std::map<std::string, long long> region_bytes;  // Base register -> bytes moved
+
+        long long ops() const { return muls + adds + other_alu; }
+        long long bytes() const {
+            long long total = 0;
+            for (const auto& [reg, bytes] : region_bytes) total += bytes;
+            return total;
+        }
+        void add(const PerformanceCounts& other) {
+            macs += other.macs;
+            muls += other.muls;
+            adds += other.adds;
+            other_alu += other.other_alu;
+            loads += other.loads;
+            stores += other.stores;
+            calls += other.calls;
+            cycles += other.cycles;
+            for (const auto& [reg, bytes] : other.region_bytes) region_bytes[reg] += bytes;
+        }
+    };
+
+    // A contiguous run of input words placed at a data-memory word address
+    struct DataRegion {
+        int address;        // Data-memory word address
+        std::string reg;    // Base register the region belongs to
+        size_t first_word;  // First word of the input array
+        size_t words;       // Number of words
+    };
+
+    int getClusterNumber(int pe_id);
+    int calculateClusterBaseAddress(const std::string& reg, int cluster_num, int data_dup, int pe_id);
+    std::pair<int, int> calculateLuiAddiValues(int value);
+    std::string generateBaseAddressLoading(int pe_id, int data_dup);
+    std::string generatePreloadSection(const std::vector<Instruction>& instructions);
+    int getDelayStart(int pe_id);
+    std::string generateHWLInstructions(const Instruction& instr, int hwl_count, int delay,
+                                        const std::string& label = "");
+    std::string generateInstructionCode(const Instruction& instr, int& hwl_count, int delay);
+    uint32_t calculateHWLImmediate(const HardwareLoop& hwl, int delay);
+    std::pair<uint32_t, uint32_t> splitHWLImmediate(uint32_t imm);
+    int countInstructionWords(const std::string& text);
+    int liWords(int value);
+    std::string generateFunctionSections(int pe, int& hwl_count, int delay);
+    void buildFunctionLibraries();
+    std::string generateLibraryCall(const Instruction& instr, int pe);
+    std::string generateLibrarySymbols(int pe);
+    bool isLocalCall(const Instruction& instr, int pe);
+    bool isLibraryCall(const Instruction& instr, int pe);
+    int instructionWords(const Instruction& instr);
+    std::vector<int> instructionPositions(const std::vector<Instruction>& instructions);
+    std::vector<long long> dynamicCounts(const std::vector<Instruction>& instructions,
+                                         const std::vector<int>& position);
+    void rebaseLoops(std::vector<Instruction>& instructions, int at, int delta);
+    bool loopsFit(const std::vector<Instruction>& instructions, int delay);
+    bool isControlFlow(const Instruction& instr);
+    std::vector<int> pesForAssignment(int base_pe);
+    const std::vector<Instruction>& instructionsOf(const PEAssignment& assignment, std::vector<Instruction>& scratch);
+    bool hasProgram(const PEAssignment& assignment) const;
+    void expandProgram(size_t base_pe);
+    void settleProgram(size_t base_pe, bool rewritten);
+    bool inlineCalls(size_t base_pe);
+    bool outlineSequences(size_t base_pe);
+    void checkHWLFields(const HardwareLoop& hwl, int delay, int pe);
+    std::vector<OverlaySegment> planOverlays(const std::vector<Instruction>& instructions, const std::vector<int>& words,
+                                             int first_capacity, int capacity, int pe);
+    std::vector<OverlaySegment> layoutExecution(const std::vector<Instruction>& program, const std::vector<int>& words,
+                                                int fixed_words, int delay, int window, int pe);
+    int executionWords(const std::vector<OverlaySegment>& segments, int fixed_words, int delay);
+    Instruction parseInstruction(const YAML::Node& instr, PEAssignment& pe_assignment);
+    void setInstructionField(Instruction& instruction, const std::string& field, const std::string& value);
+    std::shared_ptr<PETemplate> parseTemplate(const std::string& name, const YAML::Node& node);
+    PEAssignment templatedAssignment(const YAML::Node& assignment,
+                                     const std::map<std::string, std::shared_ptr<PETemplate>>& templates);
+    std::vector<PEAssignment> binaryPrograms(const BinaryConfigReader& reader);
+    bool isStore(const Instruction& instr);
+    void loadDataflowGraph(YAML::Node config);
+    YAML::Node instructionNode(const Instruction& instr);
+    void optimizeCalls();
+    std::vector<std::pair<std::string*, bool>> registerOperands(Instruction& instr);
+
+    static bool isVirtualRegister(const std::string& reg) { return !reg.empty() && reg[0] == '%'; }
+
+    std::vector<std::string> allocatablePool(std::vector<Instruction>& instructions);
+    std::vector<AllocationOp> allocationOps(std::vector<Instruction>& instructions,
+                                            const std::map<std::string, std::set<std::string>>& clobbers);
+    std::vector<AllocationLoop> allocationLoops(const std::vector<Instruction>& instructions);
+    void rewriteRegisters(PEAssignment& assignment, const RegisterAllocation& allocation, int frame_offset);
+    void allocateRegisters();
+    void countOperations(const std::vector<Instruction>& instructions, const std::vector<long long>& counts,
+                         PerformanceCounts& result);
+    PerformanceCounts performanceCounts(int pe);
+    void writeCounts(std::ostream& out, const PerformanceCounts& counts);
+
+public:
+    DFGProcessor() : output_folder("build/") {}
+    DFGProcessor(const std::string& output_folder) : output_folder(output_folder) {}
+
+    // Send progress messages somewhere other than stdout
+    void setLog(std::ostream& out) { log_stream = &out; }
+
+    int totalPEs() const { return total_pes; }
+    int imemExecutionWords() const { return imem_execution_words; }
+    int imemPreloadWords() const { return imem_preload_words; }
+    const std::map<std::string, std::string>& dataInputs() const { return data_inputs; }
+    int clusterOf(int pe) { return getClusterNumber(pe); }
+    // Index into scheduling.pe_assignments of the program a PE runs
+    int basePE(int pe) const { return pe % pes_per_cluster; }
+
+    void loadConfig(const std::string& yaml_file);
+    void convertConfig(const std::string& input_file, const std::string& output_file);
+    void loadConfig(YAML::Node config, const std::string& yaml_file, std::vector<PEAssignment>* programs = nullptr);
+    void loadConfig(const BinaryConfigReader& reader, const std::string& yaml_file);
+    std::pair<size_t, size_t> dataPayload(const MappedFile& file, const std::string& path);
+    std::vector<DataRegion> planDataRegions(const std::map<std::string, size_t>& input_words);
+    void generateDataImages();
+    void setReportEnabled(bool enabled) { report_enabled = enabled; }
+
+    void generateReport();
+    ScheduleEstimate estimateSchedule();
+    std::string generatePEAssembly(int pe);
+    std::map<int, std::string> libraryAssembly();
+    void generateAssembly();
+};
+
+#endif // DFG_PROCESSOR_H
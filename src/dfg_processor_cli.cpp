@@ -0,0 +1,87 @@
+#include "dfg_processor.h"
+#include "profiler.h"
+
+int main(int argc, char* argv[]) {
+    // Options may appear anywhere; the rest are positional
+    std::vector<std::string> positional;
+    std::string profile_path;
+    std::string convert_path;
+    bool report = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--profile=", 0) == 0) {
+            profile_path = arg.substr(10);
+        } else if (arg.rfind("--convert=", 0) == 0) {
+            convert_path = arg.substr(10);
+        } else if (arg == "--report") {
+            report = true;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    // Check if correct number of arguments is provided
+    if (positional.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <yaml_file> [output_folder] [--profile=out.json] [--report]" << std::endl;
+        std::cerr << "       " << argv[0] << " <yaml_file> --convert=out.json|out.yacb" << std::endl;
+        std::cerr << "  yaml_file: Path to the configuration file (YAML, JSON with a .json extension, or binary)" << std::endl;
+        std::cerr << "  output_folder: Directory to store generated assembly files (default: 'build')" << std::endl;
+        std::cerr << "  --profile=out.json: Write per-phase and per-PE timings, counters and peak RSS" << std::endl;
+        std::cerr << "  --report: Write performance_report.json with static per-PE operation counts" << std::endl;
+        std::cerr << "  --convert=PATH: Write the configuration as JSON (.json) or in the binary format (.yacb)" << std::endl;
+        return 1;
+    }
+
+    if (!convert_path.empty()) {
+        try {
+            DFGProcessor().convertConfig(positional[0], convert_path);
+            std::cout << "Wrote " << convert_path << std::endl;
+        } catch (const YAML::Exception& e) {
+            std::cerr << "Error processing YAML file: " << e.what() << std::endl;
+            return 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+    
+    // Parse arguments
+    std::string yaml_file = positional[0];
+    std::string output_folder = (positional.size() >= 2) ? positional[1] : "build";
+    
+    // Ensure output folder ends with a trailing slash
+    if (!output_folder.empty() && output_folder.back() != '/') {
+        output_folder += '/';
+    }
+    
+    // Create output directory if it doesn't exist
+    std::string mkdir_cmd = "mkdir -p " + output_folder;
+    int dir_result = system(mkdir_cmd.c_str());
+    if (dir_result != 0) {
+        std::cerr << "Warning: Failed to create output directory: " << output_folder << std::endl;
+    }
+    
+    std::cout << "Input YAML file: " << yaml_file << std::endl;
+    std::cout << "Output folder: " << output_folder << std::endl;
+    
+    ProfileSession profile(profile_path, "dfg_processor");
+    DFGProcessor processor(output_folder);
+    
+    try {
+        processor.loadConfig(yaml_file);
+        if (report) processor.setReportEnabled(true);
+        processor.generateAssembly();
+        processor.generateReport();
+        processor.generateDataImages();
+        std::cout << "Assembly generation completed successfully!" << std::endl;
+    } catch (const YAML::Exception& e) {
+        std::cerr << "Error processing YAML file: " << e.what() << std::endl;
+        return 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    return 0;
+} 
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "dse.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include "autotuner.h"
+#include "null_stream.h"
+
+bool DesignSweep::swept(const std::vector<std::string>& paths, const std::string& path) {
+    return std::find(paths.begin(), paths.end(), path) != paths.end();
+}
+
+YAML::Node DesignSweep::configuration(const YAML::Node& kernel, const HardwarePoint& point) const {
+    YAML::Node config = YAML::Clone(kernel);
+    config.remove("autotune");
+    for (const auto& [path, value] : point.values) set_config_path(config, "hardware_config." + path, value);
+    YAML::Node hardware = config["hardware_config"];
+    if (!swept(parameters, "clusters.count")) {
+        int total = hardware["total_pes"].as<int>();
+        int per_cluster = hardware["clusters"]["pes_per_cluster"].as<int>();
+        if (per_cluster < 1 || total % per_cluster != 0) {
+            throw std::runtime_error("total_pes " + std::to_string(total) + " is not a multiple of pes_per_cluster " +
+                                     std::to_string(per_cluster));
+        }
+        hardware["clusters"]["count"] = total / per_cluster;
+    }
+    return config;
+}
+
+DesignSweep::DesignSweep(const std::string& spec_path, int jobs) : jobs(jobs) {
+    YAML::Node spec = YAML::LoadFile(spec_path);
+    std::filesystem::path spec_dir = std::filesystem::path(spec_path).parent_path();
+    for (const auto& entry : spec["kernels"]) {
+        std::filesystem::path path = entry.second.as<std::string>();
+        if (path.is_relative()) path = spec_dir / path;
+        kernels[entry.first.as<std::string>()] = {path.string(), YAML::LoadFile(path.string())};
+    }
+    if (kernels.empty()) throw std::runtime_error(spec_path + " lists no kernels");
+
+    // Cartesian product of the swept values
+    std::vector<std::pair<std::string, std::vector<YAML::Node>>> axes;
+    for (const auto& entry : spec["hardware"]) {
+        std::vector<YAML::Node> values;
+        for (const auto& value : entry.second) values.push_back(value);
+        if (values.empty()) throw std::runtime_error("hardware." + entry.first.as<std::string>() + " has no values");
+        axes.push_back({entry.first.as<std::string>(), values});
+        if (axes.back().first != "banks") parameters.push_back(axes.back().first);
+    }
+    points.push_back(HardwarePoint());
+    for (const auto& [path, values] : axes) {
+        std::vector<HardwarePoint> next;
+        for (const auto& point : points) {
+            for (const auto& value : values) {
+                next.push_back(point);
+                if (path == "banks") {
+                    next.back().banks = std::max(1, value.as<int>());
+                } else {
+                    next.back().values[path] = value;
+                }
+            }
+        }
+        points = next;
+    }
+}
+
+void DesignSweep::run() {
+    // Schedules depend on the configuration text only; the bank count is applied afterwards
+    std::vector<YAML::Node> configs;
+    std::vector<std::string> kernel_paths;
+    std::vector<std::string> errors;
+    std::map<std::string, size_t> unique;  // Kernel name + configuration text -> configs index
+    std::vector<size_t> config_of;
+    for (const auto& [name, kernel] : kernels) {
+        for (const auto& point : points) {
+            SweepResult result;
+            result.kernel = name;
+            result.point = &point;
+            size_t index = configs.size();
+            try {
+                YAML::Node config = configuration(kernel.second, point);
+                std::string key = name + "\n" + yaml_text(config);
+                auto found = unique.find(key);
+                if (found != unique.end()) {
+                    index = found->second;
+                } else {
+                    unique[key] = index;
+                    configs.push_back(config);
+                    kernel_paths.push_back(kernel.first);
+                    errors.push_back("");
+                }
+            } catch (const std::exception& e) {
+                configs.push_back(YAML::Node());
+                kernel_paths.push_back(kernel.first);
+                errors.push_back(e.what());
+            }
+            config_of.push_back(index);
+            results.push_back(result);
+        }
+    }
+
+    std::vector<ScheduleEstimate> estimates(configs.size());
+    run_parallel(configs.size(), jobs, [&](size_t i) {
+        if (!errors[i].empty()) return;
+        try {
+            NullStream quiet;
+            DFGProcessor processor("");
+            processor.setLog(quiet);
+            processor.loadConfig(configs[i], kernel_paths[i]);
+            estimates[i] = processor.estimateSchedule();
+            if (estimates[i].active_pes == 0) errors[i] = "no active PEs";
+        } catch (const std::exception& e) {
+            errors[i] = e.what();
+        }
+    });
+    estimated = static_cast<int>(configs.size());
+
+    for (size_t r = 0; r < results.size(); r++) {
+        SweepResult& result = results[r];
+        size_t i = config_of[r];
+        result.error = errors[i];
+        result.valid = result.error.empty();
+        if (!result.valid) continue;
+        result.estimate = estimates[i];
+        int banks = result.point->banks;
+        result.bank_cycles = (result.estimate.max_cluster_accesses + banks - 1) / banks;
+        result.cycles = std::max(result.estimate.cycles, result.bank_cycles);
+    }
+}
+
+std::string DesignSweep::value(const SweepResult& result, const std::string& path) const {
+    auto found = result.point->values.find(path);
+    return found == result.point->values.end() ? "" : yaml_text(found->second);
+}
+
+// Write the CSV and print the table; returns false if the CSV cannot be written
+bool DesignSweep::write(const std::string& csv_path) const {
+    std::ofstream csv(csv_path);
+    if (!csv) {
+        errors() << "Error: Cannot write " << csv_path << std::endl;
+        return false;
+    }
+    csv << "kernel";
+    for (const auto& path : parameters) csv << "," << path;
+    csv << ",banks,active_pes,cycles,pe_cycles,bank_cycles,ops_per_cycle,imem_words_max,imem_words_total,"
+           "data_words,data_regions,status\n";
+
+    log() << std::left << std::setw(12) << "kernel";
+    for (const auto& path : parameters) log() << std::setw(std::max<size_t>(path.size() + 2, 8)) << path;
+    log() << std::setw(7) << "banks" << std::setw(12) << "cycles" << std::setw(10) << "ops/cyc"
+          << std::setw(10) << "IMEM max" << std::setw(12) << "IMEM total" << std::setw(12) << "data words"
+          << "status" << std::endl;
+    for (const auto& result : results) {
+        double throughput = result.cycles > 0 ? static_cast<double>(result.estimate.operations) / result.cycles : 0;
+        std::string status = result.valid ? "ok" : result.error;
+        std::replace(status.begin(), status.end(), ',', ';');
+        std::replace(status.begin(), status.end(), '\n', ' ');
+
+        csv << result.kernel;
+        for (const auto& path : parameters) csv << ",\"" << value(result, path) << "\"";
+        csv << "," << result.point->banks << "," << result.estimate.active_pes << "," << result.cycles << ","
+            << result.estimate.cycles << "," << result.bank_cycles << "," << throughput << ","
+            << result.estimate.imem_words << "," << result.estimate.imem_total_words << ","
+            << result.estimate.data_words << "," << result.estimate.data_regions << "," << status << "\n";
+
+        log() << std::setw(12) << result.kernel;
+        for (const auto& path : parameters) {
+            log() << std::setw(std::max<size_t>(path.size() + 2, 8)) << value(result, path);
+        }
+        log() << std::setw(7) << result.point->banks;
+        if (result.valid) {
+            log() << std::setw(12) << result.cycles << std::setw(10) << std::setprecision(4) << throughput
+                  << std::setw(10) << result.estimate.imem_words << std::setw(12)
+                  << result.estimate.imem_total_words << std::setw(12) << result.estimate.data_words;
+        } else {
+            log() << std::setw(56) << "-";
+        }
+        log() << status << std::endl;
+    }
+    log() << std::right << results.size() << " points, " << estimated << " schedules estimated; CSV written to "
+          << csv_path << std::endl;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef DSE_H
+#define DSE_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include "dfg_processor.h"
+
+// One hardware_config combination of the sweep
+struct HardwarePoint {
+    std::map<std::string, YAML::Node> values;  // hardware_config path -> value
+    int banks = 1;                             // Data-memory banks per cluster
+};
+
+struct SweepResult {
+    std::string kernel;
+    const HardwarePoint* point = nullptr;
+    bool valid = false;
+    std::string error;
+    ScheduleEstimate estimate;
+    long long bank_cycles = 0;  // Busiest cluster's loads and stores spread over its banks
+    long long cycles = 0;       // Slower of the PE cycle model and the bank bound
+};
+
+// Sweeps hardware_config combinations over a set of kernels. The spec file:
+//
+//   kernels:
+//     gemm: examples/dfg_gemm.yaml    # relative to the spec file
+//   hardware:                         # hardware_config paths and their values
+//     total_pes: [16, 64]
+//     clusters.pes_per_cluster: [1, 4]
+//     data_dup: [1, 2]
+//     banks: [1, 2]                   # data-memory banks per cluster (sweep only)
+//
+// clusters.count follows total_pes / pes_per_cluster unless it is swept itself. Every point
+// regenerates the schedule (dataflow graphs are partitioned again) and is estimated with the
+// cycle model on worker threads. Kernels are parsed once. Points that differ only in the bank
+// count share one schedule estimate, and identical configurations are estimated once.
+class DesignSweep {
+private:
+    std::map<std::string, std::pair<std::string, YAML::Node>> kernels;  // Name -> (path, parsed YAML)
+    std::vector<std::string> parameters;                                 // Swept paths, banks excluded
+    std::vector<HardwarePoint> points;
+    std::vector<SweepResult> results;
+    int jobs = 1;
+    int estimated = 0;
+    std::ostream* log_stream = &std::cout;
+    std::ostream* error_stream = &std::cerr;
+
+    std::ostream& log() const { return *log_stream; }
+    std::ostream& errors() const { return *error_stream; }
+
+    static bool swept(const std::vector<std::string>& paths, const std::string& path);
+    YAML::Node configuration(const YAML::Node& kernel, const HardwarePoint& point) const;
+
+public:
+    DesignSweep(const std::string& spec_path, int jobs);
+    // Send the results table and error messages somewhere other than stdout/stderr
+    void setLog(std::ostream& out, std::ostream& err) { log_stream = &out; error_stream = &err; }
+    void run();
+    std::string value(const SweepResult& result, const std::string& path) const;
+    bool write(const std::string& csv_path) const;
+};
+
+#endif // DSE_H
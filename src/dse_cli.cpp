@@ -0,0 +1,33 @@
+#include <iostream>
+#include <thread>
+#include "dse.h"
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--jobs=", 0) == 0) {
+            jobs = std::stoi(arg.substr(7));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <sweep.yaml> [output.csv] [--jobs=N]" << std::endl;
+        std::cerr << "  sweep.yaml: Kernels and the hardware_config values to sweep" << std::endl;
+        std::cerr << "  output.csv: Results table (default: build/dse.csv)" << std::endl;
+        std::cerr << "  --jobs=N: Parallel schedule estimates (default: hardware threads)" << std::endl;
+        return 1;
+    }
+    std::string csv_path = positional.size() >= 2 ? positional[1] : "build/dse.csv";
+
+    try {
+        DesignSweep sweep(positional[0], jobs);
+        sweep.run();
+        return sweep.write(csv_path) ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+}
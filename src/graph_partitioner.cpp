@@ -0,0 +1,199 @@
+#include "graph_partitioner.h"
+
+// Add (sign = 1) or remove (sign = -1) the exchange cost of one value; a value whose
+// producer is not placed yet costs nothing
+void GraphPartitioner::exchange(int value, int sign) {
+    if (part[value] < 0) return;
+    bool sent = false;
+    for (int p = 0; p < parts; p++) {
+        if (p == part[value] || uses[value][p] == 0) continue;
+        load[p] += sign;
+        traffic += sign;
+        sent = true;
+    }
+    if (sent) load[part[value]] += sign;
+}
+
+void GraphPartitioner::place(int node, int p) {
+    for (int input : graph.inputs[node]) exchange(input, -1);
+    exchange(node, -1);
+    if (part[node] >= 0) {
+        load[part[node]] -= graph.weight[node];
+        for (int input : graph.inputs[node]) uses[input][part[node]]--;
+    }
+    part[node] = p;
+    load[p] += graph.weight[node];
+    for (int input : graph.inputs[node]) uses[input][p]++;
+    exchange(node, 1);
+    for (int input : graph.inputs[node]) exchange(input, 1);
+}
+
+// Whether a value is consumed on a PE other than its producer's, so it is stored for them
+bool GraphPartitioner::sent(int value) const {
+    for (int p = 0; p < parts; p++) {
+        if (p != part[value] && uses[value][p] > 0) return true;
+    }
+    return false;
+}
+
+// Length of each PE's program in the schedule loadDataflowGraph emits for the placed nodes:
+// nodes in topological order, a received value loaded before its first use, once per PE, after
+// nops up to the cycle following its store, and a sent value stored right after its producer.
+// Returns the largest length.
+int GraphPartitioner::schedule(std::vector<int>& length) const {
+    const size_t n = graph.weight.size();
+    length.assign(parts, 0);
+    std::vector<int> store_time(n, 0);
+    std::vector<char> received(n * parts, 0);
+    for (size_t node = 0; node < n; node++) {
+        int p = part[node];
+        if (p < 0) continue;
+        for (int input : graph.inputs[node]) {
+            if (part[input] < 0 || part[input] == p || received[input * parts + p]) continue;
+            length[p] = std::max(length[p], store_time[input] + 1) + 1;
+            received[input * parts + p] = 1;
+        }
+        length[p] += graph.weight[node];
+        if (sent(static_cast<int>(node))) store_time[node] = length[p]++;
+    }
+    return *std::max_element(length.begin(), length.end());
+}
+
+bool GraphPartitioner::better(int span, int cross, int best_span, int best_cross) const {
+    return span < best_span || (span == best_span && cross < best_cross);
+}
+
+// Exhaustive search with symmetry breaking: a node may only open the next unused PE
+void GraphPartitioner::search(size_t node, int used, GraphPartition& best) {
+    if (node == graph.weight.size()) {
+        if (makespan() > best.makespan) return;
+        std::vector<int> length;
+        int span = schedule(length);
+        if (better(span, traffic, best.makespan, best.traffic)) {
+            best.part = part;
+            best.load = length;
+            best.makespan = span;
+            best.traffic = traffic;
+        }
+        return;
+    }
+    // The words of a PE never drop as more nodes are placed, and nops only add to them
+    if (makespan() > best.makespan) return;
+    for (int p = 0; p < std::min(parts, used + 1); p++) {
+        place(static_cast<int>(node), p);
+        search(node + 1, std::max(used, p + 1), best);
+        unplace(static_cast<int>(node));
+    }
+}
+
+void GraphPartitioner::unplace(int node) {
+    for (int input : graph.inputs[node]) exchange(input, -1);
+    exchange(node, -1);
+    load[part[node]] -= graph.weight[node];
+    for (int input : graph.inputs[node]) uses[input][part[node]]--;
+    part[node] = -1;
+    exchange(node, 1);
+    for (int input : graph.inputs[node]) exchange(input, 1);
+}
+
+GraphPartitioner::GraphPartitioner(const PartitionGraph& graph, int parts) : graph(graph), parts(std::max(parts, 1)) {
+    size_t n = graph.weight.size();
+    part.assign(n, -1);
+    load.assign(this->parts, 0);
+    uses.assign(n, std::vector<int>(this->parts, 0));
+}
+
+GraphPartition GraphPartitioner::run() {
+    const size_t n = graph.weight.size();
+    GraphPartition best;
+    if (n == 0) {
+        best.load.assign(parts, 0);
+        return best;
+    }
+
+    // Greedy placement in topological order: earliest lockstep finish over all PEs, then least
+    // new traffic. A value received from another PE can be loaded the cycle after its store,
+    // which follows its producer; a store added to an earlier program is charged at its end.
+    std::vector<int> time(parts, 0), finish(n, 0);
+    std::vector<char> received(n * parts, 0);
+    for (size_t node = 0; node < n; node++) {
+        int best_p = 0, best_span = 0, best_cross = 0;
+        std::vector<int> best_time;
+        for (int p = 0; p < parts; p++) {
+            place(static_cast<int>(node), p);
+            std::vector<int> next = time;
+            const std::vector<int>& inputs = graph.inputs[node];
+            for (size_t i = 0; i < inputs.size(); i++) {
+                int input = inputs[i];
+                if (part[input] == p || received[input * parts + p]) continue;
+                if (std::find(inputs.begin(), inputs.begin() + i, input) != inputs.begin() + i) continue;
+                bool stored = false;  // Already sent to another PE
+                for (int q = 0; q < parts; q++) {
+                    if (q != p && q != part[input] && uses[input][q] > 0) stored = true;
+                }
+                if (!stored) next[part[input]]++;
+                next[p] = std::max(next[p], finish[input] + 1) + 1;
+            }
+            next[p] += graph.weight[node];
+            int span = *std::max_element(next.begin(), next.end());
+            if (p == 0 || better(span, traffic, best_span, best_cross)) {
+                best_p = p;
+                best_span = span;
+                best_cross = traffic;
+                best_time = next;
+            }
+        }
+        place(static_cast<int>(node), best_p);
+        time = best_time;
+        finish[node] = time[best_p];
+        for (int input : graph.inputs[node]) {
+            if (part[input] != best_p) received[input * parts + best_p] = 1;
+        }
+    }
+
+    // Refinement: move single nodes while that lowers (schedule length, traffic). The words
+    // without nops bound the schedule from below, so most moves are rejected without it.
+    std::vector<int> length;
+    int span = schedule(length);
+    for (int pass = 0; pass < 32; pass++) {
+        bool improved = false;
+        for (size_t node = 0; node < n; node++) {
+            int from = part[node];
+            int best_p = from, best_span = span, best_cross = traffic;
+            for (int p = 0; p < parts; p++) {
+                if (p == from) continue;
+                place(static_cast<int>(node), p);
+                if (makespan() > best_span) continue;
+                int moved = schedule(length);
+                if (better(moved, traffic, best_span, best_cross)) {
+                    best_p = p;
+                    best_span = moved;
+                    best_cross = traffic;
+                }
+            }
+            place(static_cast<int>(node), best_p);
+            if (best_p != from) improved = true;
+            span = best_span;
+        }
+        if (!improved) break;
+    }
+    best.makespan = schedule(best.load);
+    best.part = part;
+    best.traffic = traffic;
+
+    // Small graphs: search every placement, bounded by the refined result
+    double combinations = 1;
+    for (size_t node = 0; node < n && combinations <= (1 << 20); node++) {
+        combinations *= std::min<size_t>(parts, node + 1);
+    }
+    if (combinations <= (1 << 20)) {
+        for (size_t node = n; node-- > 0;) unplace(static_cast<int>(node));
+        search(0, 0, best);
+        best.exhaustive = true;
+    }
+    return best;
+}
+
+GraphPartition partition_graph(const PartitionGraph& graph, int parts) {
+    return GraphPartitioner(graph, parts).run();
+}
@@ -0,0 +1,56 @@
+#ifndef GRAPH_PARTITIONER_H
+#define GRAPH_PARTITIONER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Dataflow graph to split across PEs. Node i produces one value; inputs[i] lists the nodes
+// whose values it consumes. Nodes are given in a topological order.
+struct PartitionGraph {
+    std::vector<int> weight;               // Estimated cycles of each node
+    std::vector<std::vector<int>> inputs;  // Producer nodes of each node's operands
+};
+
+// Result of a k-way partition. A value consumed on another PE costs its producer one
+// store and each consuming PE one load. The PEs run in lockstep, one word per cycle, so a
+// load waits with nops until the cycle after its store; load is the length of each PE's
+// program in that schedule, exchange and nops included.
+struct GraphPartition {
+    std::vector<int> part;   // PE of each node
+    std::vector<int> load;   // Words per PE of the lockstep schedule
+    int makespan = 0;        // Largest load
+    int traffic = 0;         // (value, consuming PE) pairs that cross PEs
+    bool exhaustive = false; // Found by exhaustive search (optimal for the cost model)
+};
+
+// Minimizes the lockstep schedule length first and cross-PE traffic second. Small graphs are
+// searched exhaustively; larger ones start from a greedy placement in topological order and
+// are refined by single-node moves that lower (makespan, traffic) until no move helps.
+class GraphPartitioner {
+private:
+    const PartitionGraph& graph;
+    int parts;
+    std::vector<int> part;
+    std::vector<int> load;                    // Words per PE without nops: a lower bound on the schedule
+    std::vector<std::vector<int>> uses;       // Value -> consumers of it on each PE
+    int traffic = 0;
+
+    void exchange(int value, int sign);
+    void place(int node, int p);
+    int makespan() const { return *std::max_element(load.begin(), load.end()); }
+    bool sent(int value) const;
+    int schedule(std::vector<int>& length) const;
+
+    bool better(int span, int cross, int best_span, int best_cross) const;
+    void search(size_t node, int used, GraphPartition& best);
+    void unplace(int node);
+
+public:
+    GraphPartitioner(const PartitionGraph& graph, int parts);
+    GraphPartition run();
+};
+
+GraphPartition partition_graph(const PartitionGraph& graph, int parts);
+
+#endif // GRAPH_PARTITIONER_H
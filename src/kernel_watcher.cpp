@@ -0,0 +1,256 @@
+#include "kernel_watcher.h"
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "yac.h"
+
+std::atomic<bool>& KernelWatcher::stop_flag() {
+    static std::atomic<bool> flag{false};
+    return flag;
+}
+
+std::filesystem::file_time_type KernelWatcher::modified(const std::string& path) {
+    std::error_code error;
+    return std::filesystem::last_write_time(path, error);
+}
+
+// Remove the files of an image's overlay phases that the new build no longer has
+void KernelWatcher::removeOverlays(const std::string& base, const WatchedImage& old, const WatchedImage& current) {
+    for (const auto& [phase, entries] : old.overlay_entries) {
+        if (current.overlay_entries.count(phase) > 0) continue;
+        std::error_code error;
+        std::filesystem::remove(output_folder + base + "_ovl" + std::to_string(phase) + ".bin", error);
+        std::filesystem::remove(output_folder + base + "_ovl" + std::to_string(phase) + ".mem", error);
+    }
+}
+
+// Write and assemble one source; false if it does not assemble
+bool KernelWatcher::encode(const std::string& source_name, const std::string& base, int number, WatchedImage& image) {
+    {
+        std::ofstream out(output_folder + source_name);
+        out << image.assembly;
+    }
+    image.entries.clear();
+    image.overlay_entries.clear();
+    return assembler.assemble(output_folder + source_name, output_folder + base + ".bin", number,
+                              output_folder + base + ".mem", &image.entries, &image.overlay_entries) == 0;
+}
+
+void KernelWatcher::rebuild() {
+    auto start = std::chrono::steady_clock::now();
+    YAML::Node config;
+    std::string binary;  // Contents of a .yacb input
+    std::string global;
+    std::vector<std::string> assignments;
+    try {
+        ConfigFormat format = detect_config_format(yaml_file);
+        if (format == ConfigFormat::Binary) {
+            // Read into memory rather than mapped, since the file may be rewritten while it is
+            // in use. Compared as a whole: any change regenerates every PE.
+            std::ifstream in(yaml_file, std::ios::binary);
+            binary.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            if (!in) throw std::runtime_error("cannot read the file");
+            global = binary;
+        } else {
+            config = format == ConfigFormat::Json ? load_json_file(yaml_file) : YAML::LoadFile(yaml_file);
+            YAML::Node rest = YAML::Clone(config);
+            if (rest["scheduling"] && rest["scheduling"]["pe_assignments"]) {
+                for (const auto& assignment : rest["scheduling"]["pe_assignments"]) {
+                    assignments.push_back(yac::normalized_config(assignment));
+                }
+                rest["scheduling"].remove("pe_assignments");
+            }
+            global = yac::normalized_config(rest);
+        }
+    } catch (const std::exception& e) {
+        errors() << "Error: " << yaml_file << ": " << e.what() << " (keeping the previous outputs)" << std::endl;
+        return;
+    }
+
+    // Model diff: which base PEs need new code
+    bool full = !built || global != global_text || assignments.size() != assignment_text.size();
+    std::set<size_t> changed;
+    for (size_t i = 0; !full && i < assignments.size(); i++) {
+        if (assignments[i] != assignment_text[i]) changed.insert(i);
+    }
+    bool inputs_changed = !built || global != global_text;
+    for (const auto& [path, time] : input_times) {
+        if (modified(path) != time) inputs_changed = true;
+    }
+    if (!full && changed.empty() && !inputs_changed) return;
+
+    DFGProcessor processor(output_folder);
+    processor.setLog(discard);
+    int regenerated = 0, encoded = 0;
+    bool segments_changed = false, failed = false;
+    try {
+        if (!binary.empty()) {
+            processor.loadConfig(BinaryConfigReader(binary.data(), binary.size(), yaml_file), yaml_file);
+        } else {
+            processor.loadConfig(config, yaml_file);
+        }
+        assembler.set_imem_capacity(processor.imemExecutionWords(), processor.imemPreloadWords());
+
+        std::map<int, std::string> library_sources = processor.libraryAssembly();
+        for (auto it = libraries.begin(); it != libraries.end();) {
+            if (library_sources.count(it->first) > 0) {
+                ++it;
+                continue;
+            }
+            std::error_code error;
+            std::string name = "cluster" + std::to_string(it->first) + "_library";
+            for (const char* suffix : {".s", ".bin", ".mem", ".reloc"}) {
+                std::filesystem::remove(output_folder + name + suffix, error);
+            }
+            it = libraries.erase(it);
+            segments_changed = true;
+        }
+        for (const auto& [cluster, source] : library_sources) {
+            if (libraries.count(cluster) > 0 && libraries[cluster].assembly == source) continue;
+            std::string name = "cluster" + std::to_string(cluster) + "_library";
+            WatchedImage image;
+            image.assembly = source;
+            if (!encode(name + ".s", name, cluster, image)) {
+                image.assembly.clear();
+                failed = true;
+            }
+            libraries[cluster] = image;
+            encoded++;
+            segments_changed = true;
+        }
+
+        for (int pe = 0; pe < processor.totalPEs(); pe++) {
+            if (!full && changed.count(static_cast<size_t>(processor.basePE(pe))) == 0) continue;
+            std::string source = processor.generatePEAssembly(pe);
+            regenerated++;
+            std::string base = "pe" + std::to_string(pe) + "_binary";
+            auto old = pes.find(pe);
+            if (source.empty()) {
+                // The PE lost its program
+                if (old != pes.end()) {
+                    removeOverlays(base, old->second, WatchedImage());
+                    for (const std::string& name : {"pe" + std::to_string(pe) + "_assembly.s", base + ".bin",
+                                                    base + ".mem", base + ".reloc"}) {
+                        std::error_code error;
+                        std::filesystem::remove(output_folder + name, error);
+                    }
+                    pes.erase(old);
+                    segments_changed = true;
+                }
+                continue;
+            }
+            if (old != pes.end() && old->second.assembly == source) continue;
+            WatchedImage image;
+            image.assembly = source;
+            if (!encode("pe" + std::to_string(pe) + "_assembly.s", base, pe, image)) {
+                image.assembly.clear();  // Retried on the next change
+                failed = true;
+            }
+            if (old != pes.end()) removeOverlays(base, old->second, image);
+            pes[pe] = image;
+            encoded++;
+            segments_changed = true;
+        }
+
+        if (inputs_changed) processor.generateDataImages();
+    } catch (const std::exception& e) {
+        errors() << "Error: " << e.what() << " (keeping the previous outputs)" << std::endl;
+        return;
+    }
+
+    if (segments_changed) {
+        CombinedMemory combined;
+        for (const auto& [pe, image] : pes) {
+            combined.pe_entries[pe] = image.entries;
+            for (const auto& [phase, entries] : image.overlay_entries) combined.overlay_entries[phase][pe] = entries;
+        }
+        for (const auto& [cluster, image] : libraries) combined.library_entries[cluster] = image.entries;
+        combined.write(output_folder, MemFormat(), log(), errors());
+    }
+
+    built = true;
+    global_text = global;
+    assignment_text = assignments;
+    input_times.clear();
+    for (const auto& [reg, path] : processor.dataInputs()) input_times[path] = modified(path);
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    log() << (failed ? "Rebuilt with errors" : "Rebuilt") << " in " << std::fixed << std::setprecision(1) << ms
+          << " ms: " << (full ? "full model" : std::to_string(changed.size()) + " changed assignments") << ", "
+          << regenerated << " PEs regenerated, " << encoded << " images re-encoded"
+          << (segments_changed ? ", combined memory rewritten" : "") << std::endl;
+    log().unsetf(std::ios::fixed);
+}
+
+KernelWatcher::KernelWatcher(const std::string& yaml_file, const std::string& output_folder)
+    : yaml_file(yaml_file), output_folder(output_folder) {
+    assembler.set_log(discard, errors());
+}
+
+// Build once, then rebuild on every change until SIGINT or SIGTERM
+int KernelWatcher::run() {
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) {
+        errors() << "Error: inotify unavailable" << std::endl;
+        return 1;
+    }
+    stop_flag() = false;
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+
+    std::map<int, std::string> watched_dirs;  // Watch descriptor -> directory
+    std::set<std::pair<std::string, std::string>> files;  // (directory, name) of every input
+    auto watch = [&]() {
+        // Directories are watched rather than files, so editors that replace the file by
+        // renaming a new one over it are still seen
+        files.clear();
+        std::vector<std::string> paths = {yaml_file};
+        for (const auto& [path, time] : input_times) paths.push_back(path);
+        for (const auto& path : paths) {
+            std::filesystem::path file(path);
+            std::string dir = file.parent_path().empty() ? "." : file.parent_path().string();
+            files.insert({dir, file.filename().string()});
+            bool known = false;
+            for (const auto& [wd, watched] : watched_dirs) known = known || watched == dir;
+            if (known) continue;
+            int wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+            if (wd >= 0) watched_dirs[wd] = dir;
+        }
+    };
+
+    rebuild();
+    watch();
+    log() << "Watching " << yaml_file << (input_times.empty() ? "" : " and its data inputs")
+          << "; outputs in " << output_folder << " (Ctrl-C stops)" << std::endl;
+
+    alignas(inotify_event) char buffer[4096];
+    while (!stop_flag()) {
+        pollfd events = {fd, POLLIN, 0};
+        if (poll(&events, 1, 200) <= 0) continue;
+        bool relevant = false;
+        // Collect the burst of events one save produces before rebuilding
+        do {
+            ssize_t size;
+            while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char* at = buffer; at < buffer + size;) {
+                    auto* event = reinterpret_cast<inotify_event*>(at);
+                    if (event->len > 0 && watched_dirs.count(event->wd) > 0 &&
+                        files.count({watched_dirs[event->wd], event->name}) > 0) {
+                        relevant = true;
+                    }
+                    at += sizeof(inotify_event) + event->len;
+                }
+            }
+        } while (poll(&events, 1, 20) > 0);
+        if (!relevant) continue;
+        rebuild();
+        watch();
+    }
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef KERNEL_WATCHER_H
+#define KERNEL_WATCHER_H
+
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "dfg_processor.h"
+#include "null_stream.h"
+#include "risc_v_assembler.h"
+
+// Output of one PE or cluster library from the last build
+struct WatchedImage {
+    std::string assembly;
+    std::vector<MemWord> entries;                        // Combined-memory segment
+    std::map<int, std::vector<MemWord>> overlay_entries;  // Phase -> segment
+};
+
+// yac --watch: rebuilds a kernel's outputs (the files of make test) whenever its YAML or a
+// data_images input changes. The parsed configuration is compared with the previous one per
+// base PE; only PEs whose assignment changed are regenerated, unless anything outside
+// scheduling.pe_assignments changed. A regenerated PE is re-encoded only if its assembly
+// differs, and combined_memory.mem is rewritten only if one of its segments did.
+class KernelWatcher {
+private:
+    std::string yaml_file;
+    std::string output_folder;
+    RISC_V_Assembler assembler;               // Tables built once for all rebuilds
+    NullStream discard;
+    std::ostream* log_stream = &std::cout;
+    std::ostream* error_stream = &std::cerr;
+
+    std::ostream& log() const { return *log_stream; }
+    std::ostream& errors() const { return *error_stream; }
+
+    bool built = false;
+    std::string global_text;                  // Everything but scheduling.pe_assignments
+    std::vector<std::string> assignment_text; // Per base PE
+    std::map<std::string, std::filesystem::file_time_type> input_times;  // Data input -> mtime
+    std::map<int, WatchedImage> pes;
+    std::map<int, WatchedImage> libraries;    // Cluster -> library
+
+    static std::atomic<bool>& stop_flag();
+
+    static void on_signal(int) { stop_flag() = true; }
+
+    static std::filesystem::file_time_type modified(const std::string& path);
+    void removeOverlays(const std::string& base, const WatchedImage& old, const WatchedImage& current);
+    bool encode(const std::string& source_name, const std::string& base, int number, WatchedImage& image);
+    void rebuild();
+
+public:
+    KernelWatcher(const std::string& yaml_file, const std::string& output_folder);
+
+    // Send rebuild reports and errors somewhere other than stdout/stderr
+    void setLog(std::ostream& out, std::ostream& err) {
+        log_stream = &out;
+        error_stream = &err;
+        assembler.set_log(discard, err);
+    }
+
+    int run();
+};
+
+#endif // KERNEL_WATCHER_H
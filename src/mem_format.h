@@ -0,0 +1,248 @@
+#ifndef MEM_FORMAT_H
+#define MEM_FORMAT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Instruction memory addresses hold the word index in bits [8:0], the preload flag in bit 9
+// and the PE number in bits [17:10]. Higher bits select a code region the hardware maps into
+// the PEs' windows, such as a cluster's shared function library.
+const uint32_t LIBRARY_REGION_MASK = 0x3FFFF;
+
+// Lower-case hex digits of every byte value, two characters per entry
+inline const char* hex_byte_table() {
+    static const struct Table {
+        char digits[512];
+        Table() {
+            const char* hex = "0123456789abcdef";
+            for (int i = 0; i < 256; i++) {
+                digits[2 * i] = hex[i >> 4];
+                digits[2 * i + 1] = hex[i & 0xF];
+            }
+        }
+    } table;
+    return table.digits;
+}
+
+// Write the 8 hex digits of a word (no terminator)
+inline void format_hex8(uint32_t word, char* dst) {
+    const char* table = hex_byte_table();
+    std::memcpy(dst, table + 2 * (word >> 24), 2);
+    std::memcpy(dst + 2, table + 2 * ((word >> 16) & 0xFF), 2);
+    std::memcpy(dst + 4, table + 2 * ((word >> 8) & 0xFF), 2);
+    std::memcpy(dst + 6, table + 2 * (word & 0xFF), 2);
+}
+
+// Write the hex digits of two words as 16 characters. With SSE2 the nibbles of both words
+// are spread and converted to ASCII in one register.
+inline void format_hex8x2(uint32_t first, uint32_t second, char* dst) {
+#ifdef __SSE2__
+    // Bytes in print order: most significant byte of each word first
+    uint64_t bytes = static_cast<uint64_t>(__builtin_bswap32(first)) |
+                     (static_cast<uint64_t>(__builtin_bswap32(second)) << 32);
+    __m128i packed = _mm_cvtsi64_si128(static_cast<long long>(bytes));
+    __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+    __m128i low = _mm_and_si128(packed, mask);
+    __m128i nibbles = _mm_unpacklo_epi8(high, low);
+    // '0' + n, plus ('a' - '0' - 10) where n > 9
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)), _mm_set1_epi8('a' - '0' - 10));
+    __m128i ascii = _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), ascii);
+#else
+    format_hex8(first, dst);
+    format_hex8(second, dst + 8);
+#endif
+}
+
+// Output buffer that formats hex digits in place and hands the stream large blocks
+class HexOutput {
+private:
+    std::ostream& out;
+    std::vector<char> buffer;
+    size_t used = 0;
+
+    void reserve(size_t bytes) {
+        if (used + bytes > buffer.size()) flush();
+    }
+
+public:
+    explicit HexOutput(std::ostream& out, size_t capacity = 1 << 20) : out(out), buffer(capacity) {}
+    ~HexOutput() { flush(); }
+    HexOutput(const HexOutput&) = delete;
+    HexOutput& operator=(const HexOutput&) = delete;
+
+    void flush() {
+        if (used > 0) out.write(buffer.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+
+    void put(char c) {
+        reserve(1);
+        buffer[used++] = c;
+    }
+
+    void put(const std::string& text) {
+        if (text.size() > buffer.size()) {
+            flush();
+            out.write(text.data(), static_cast<std::streamsize>(text.size()));
+            return;
+        }
+        reserve(text.size());
+        std::memcpy(buffer.data() + used, text.data(), text.size());
+        used += text.size();
+    }
+
+    void put_hex(uint32_t word) {
+        reserve(8);
+        format_hex8(word, buffer.data() + used);
+        used += 8;
+    }
+
+    // Words as hex, per_line to a line separated by spaces; every line ends with '\n'
+    void put_hex_lines(const uint32_t* words, size_t count, int per_line) {
+        if (per_line == 1) {
+            size_t i = 0;
+            for (; i + 2 <= count; i += 2) {
+                reserve(18);
+                char* dst = buffer.data() + used;
+                char digits[16];
+                format_hex8x2(words[i], words[i + 1], digits);
+                std::memcpy(dst, digits, 8);
+                dst[8] = '\n';
+                std::memcpy(dst + 9, digits + 8, 8);
+                dst[17] = '\n';
+                used += 18;
+            }
+            if (i < count) {
+                put_hex(words[i]);
+                put('\n');
+            }
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            put_hex(words[i]);
+            put((i + 1) % per_line == 0 || i + 1 == count ? '\n' : ' ');
+        }
+    }
+};
+
+// A word of a memory image at a word address
+struct MemWord {
+    uint32_t address;
+    uint32_t word;
+};
+
+// Layout of a $readmemh .mem file.
+//   line:  "@address word" on every line (the historical format)
+//   burst: one "@address" per contiguous region followed by raw words, words_per_line per line
+struct MemFormat {
+    bool burst = false;
+    int words_per_line = 1;
+    bool merge = false;  // Sort combined images by address and merge regions across PEs
+};
+
+// Streaming .mem writer: words are emitted in the order given and a new region is started
+// whenever the address is not the successor of the previous word
+class MemWriter {
+private:
+    HexOutput out;
+    MemFormat format;
+    bool open_region = false;
+    uint32_t next_address = 0;
+    int column = 0;
+
+    void end_line() {
+        if (column > 0) {
+            out.put('\n');
+            column = 0;
+        }
+    }
+
+    void start_region(uint32_t address) {
+        end_line();
+        out.put('@');
+        out.put_hex(address);
+        out.put('\n');
+        open_region = true;
+    }
+
+public:
+    MemWriter(std::ostream& stream, const MemFormat& format) : out(stream), format(format) {
+        if (this->format.words_per_line < 1) this->format.words_per_line = 1;
+    }
+    ~MemWriter() { end_line(); }
+
+    void write(uint32_t address, uint32_t word) {
+        if (!format.burst) {
+            out.put('@');
+            out.put_hex(address);
+            out.put(' ');
+            out.put_hex(word);
+            out.put('\n');
+            return;
+        }
+        if (!open_region || address != next_address) start_region(address);
+        if (column > 0) out.put(' ');
+        out.put_hex(word);
+        next_address = address + 1;
+        if (++column == format.words_per_line) end_line();
+    }
+
+    // A contiguous run of words starting at address
+    void write_run(uint32_t address, const uint32_t* words, size_t count) {
+        if (!format.burst || column > 0 || count == 0) {
+            for (size_t i = 0; i < count; i++) write(address + static_cast<uint32_t>(i), words[i]);
+            return;
+        }
+        if (!open_region || address != next_address) start_region(address);
+        size_t whole = count - count % format.words_per_line;
+        out.put_hex_lines(words, whole, format.words_per_line);
+        next_address = address + static_cast<uint32_t>(whole);
+        for (size_t i = whole; i < count; i++) write(address + static_cast<uint32_t>(i), words[i]);
+    }
+
+    void write(const std::vector<MemWord>& words) {
+        for (const auto& w : words) write(w.address, w.word);
+    }
+
+    // Comment lines end the current line but keep the region open
+    void comment(const std::string& text) {
+        end_line();
+        out.put("// " + text + "\n");
+    }
+};
+
+// Sort words by address, folding a word repeated at its address. A different word at an
+// address already taken is a collision: words is left as given, first and second are set to
+// the positions of the two words and false is returned.
+inline bool sort_mem_words(std::vector<MemWord>& words, size_t& first, size_t& second) {
+    std::vector<size_t> order(words.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return words[a].address < words[b].address; });
+    std::vector<MemWord> sorted;
+    sorted.reserve(words.size());
+    size_t kept = 0;
+    for (size_t i : order) {
+        if (!sorted.empty() && sorted.back().address == words[i].address) {
+            if (sorted.back().word == words[i].word) continue;
+            first = kept;
+            second = i;
+            return false;
+        }
+        sorted.push_back(words[i]);
+        kept = i;
+    }
+    words.swap(sorted);
+    return true;
+}
+
+#endif // MEM_FORMAT_H
@@ -0,0 +1,13 @@
+#ifndef NULL_STREAM_H
+#define NULL_STREAM_H
+
+#include <ostream>
+
+// Discards everything written to it. Worker threads pass their own to DFGProcessor::setLog
+// and RISC_V_Assembler::set_log rather than silencing std::cout for the whole process.
+class NullStream : public std::ostream {
+public:
+    NullStream() : std::ostream(nullptr) {}
+};
+
+#endif // NULL_STREAM_H
@@ -0,0 +1,191 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+
+// Wall and CPU time of a phase, accumulated over its calls
+struct PhaseTime {
+    uint64_t calls = 0;
+    double wall_ms = 0;
+    double cpu_ms = 0;
+};
+
+// Collects phase timings and counters for --profile. Nothing is recorded until a
+// ProfileSession enables it, so disabled timers cost a single pointer test. There is one
+// session per process: timers on every thread (verify, batch and server workers) report to
+// it, and it must outlive them.
+class Profiler {
+private:
+    std::mutex lock;
+    std::string tool;
+    std::chrono::steady_clock::time_point start;
+    std::map<std::string, PhaseTime> phases;
+    std::map<int, std::map<std::string, PhaseTime>> pe_phases;  // PE -> phase -> time
+    std::map<std::string, uint64_t> counters;
+
+    static std::atomic<Profiler*>& active_slot() {
+        static std::atomic<Profiler*> active{nullptr};
+        return active;
+    }
+
+    static double process_cpu_ms() {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3 +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+    }
+
+    static void write_phase(std::ostream& out, const PhaseTime& time) {
+        out << "{\"calls\": " << time.calls << ", \"wall_ms\": " << time.wall_ms << ", \"cpu_ms\": " << time.cpu_ms
+            << "}";
+    }
+
+public:
+    explicit Profiler(const std::string& tool) : tool(tool), start(std::chrono::steady_clock::now()) {}
+
+    // The profiler timers and counters report to, or nullptr when profiling is off
+    static Profiler* active() { return active_slot().load(std::memory_order_acquire); }
+
+    // Make profiler the process-wide target; fails if another one is already active
+    static void set_active(Profiler* profiler) {
+        Profiler* expected = nullptr;
+        if (!active_slot().compare_exchange_strong(expected, profiler, std::memory_order_acq_rel)) {
+            throw std::logic_error("A profile session is already active");
+        }
+    }
+    static void clear_active(Profiler* profiler) {
+        Profiler* expected = profiler;
+        active_slot().compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel);
+    }
+
+    // CPU time of the calling thread, so per-PE times stay meaningful under worker threads
+    static double thread_cpu_ms() {
+        timespec now;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+        return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+    }
+
+    void record(const std::string& phase, int pe, double wall_ms, double cpu_ms) {
+        std::lock_guard<std::mutex> guard(lock);
+        PhaseTime& total = phases[phase];
+        total.calls++;
+        total.wall_ms += wall_ms;
+        total.cpu_ms += cpu_ms;
+        if (pe >= 0) {
+            PhaseTime& per_pe = pe_phases[pe][phase];
+            per_pe.calls++;
+            per_pe.wall_ms += wall_ms;
+            per_pe.cpu_ms += cpu_ms;
+        }
+    }
+
+    // Add to a named counter (bytes_written, instructions, ...) if profiling is on
+    static void count(const char* counter, uint64_t amount) {
+        Profiler* profiler = active();
+        if (profiler == nullptr) return;
+        std::lock_guard<std::mutex> guard(profiler->lock);
+        profiler->counters[counter] += amount;
+    }
+
+    bool write(const std::string& path) {
+        std::lock_guard<std::mutex> guard(lock);
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::ostringstream json;
+        json << "{\n  \"tool\": \"" << tool << "\",\n  \"wall_ms\": " << wall_ms << ",\n  \"cpu_ms\": "
+             << process_cpu_ms() << ",\n  \"peak_rss_kb\": " << usage.ru_maxrss << ",\n  \"counters\": {";
+        bool first = true;
+        for (const auto& [name, value] : counters) {
+            json << (first ? "" : ",") << "\n    \"" << name << "\": " << value;
+            first = false;
+        }
+        json << "\n  },\n  \"phases\": {";
+        first = true;
+        for (const auto& [name, time] : phases) {
+            json << (first ? "" : ",") << "\n    \"" << name << "\": ";
+            write_phase(json, time);
+            first = false;
+        }
+        json << "\n  },\n  \"pes\": {";
+        first = true;
+        for (const auto& [pe, times] : pe_phases) {
+            json << (first ? "" : ",") << "\n    \"" << pe << "\": {";
+            bool first_phase = true;
+            for (const auto& [name, time] : times) {
+                json << (first_phase ? "" : ", ") << "\"" << name << "\": ";
+                write_phase(json, time);
+                first_phase = false;
+            }
+            json << "}";
+            first = false;
+        }
+        json << "\n  }\n}\n";
+
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "Error: Cannot write profile: " << path << std::endl;
+            return false;
+        }
+        out << json.str();
+        return true;
+    }
+};
+
+// Times the enclosing scope as one call of a phase, attributed to a PE when pe >= 0
+class ScopedTimer {
+private:
+    Profiler* profiler;
+    const char* phase;
+    int pe;
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start = 0;
+
+public:
+    explicit ScopedTimer(const char* phase, int pe = -1) : profiler(Profiler::active()), phase(phase), pe(pe) {
+        if (profiler == nullptr) return;
+        wall_start = std::chrono::steady_clock::now();
+        cpu_start = Profiler::thread_cpu_ms();
+    }
+    ~ScopedTimer() {
+        if (profiler == nullptr) return;
+        double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall_start).count();
+        profiler->record(phase, pe, wall_ms, Profiler::thread_cpu_ms() - cpu_start);
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+// Enables profiling for the lifetime of a tool's main and writes the JSON profile on exit.
+// An empty path leaves profiling off. Only one session may be active at a time.
+class ProfileSession {
+private:
+    std::string path;
+    Profiler profiler;
+
+public:
+    ProfileSession(const std::string& path, const std::string& tool) : path(path), profiler(tool) {
+        if (!path.empty()) Profiler::set_active(&profiler);
+    }
+    ~ProfileSession() {
+        if (path.empty()) return;
+        Profiler::clear_active(&profiler);
+        if (profiler.write(path)) std::cout << "Profile written to " << path << std::endl;
+    }
+    ProfileSession(const ProfileSession&) = delete;
+    ProfileSession& operator=(const ProfileSession&) = delete;
+};
+
+#endif // PROFILER_H
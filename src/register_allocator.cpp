@@ -0,0 +1,167 @@
+#include "register_allocator.h"
+#include <algorithm>
+#include <stdexcept>
+
+std::vector<LinearScanAllocator::Interval> LinearScanAllocator::intervals() const {
+    std::map<std::string, Interval> by_name;
+    std::map<std::string, long long> refs;
+    for (int i = 0; i < static_cast<int>(ops.size()); i++) {
+        // Operands are read before the result is written
+        for (const auto& use : ops[i].uses) {
+            auto it = by_name.find(use);
+            if (it == by_name.end()) {
+                bool in_loop = std::any_of(loops.begin(), loops.end(),
+                                           [i](const AllocationLoop& loop) { return i >= loop.first && i <= loop.last; });
+                if (!in_loop) throw std::runtime_error("virtual register " + use + " is used before it is defined");
+                by_name[use] = {use, i, i, 0, {}};
+            }
+            by_name[use].end = i;
+            refs[use] += ops[i].count;
+        }
+        for (const auto& def : ops[i].defs) {
+            if (by_name.count(def) == 0) by_name[def] = {def, i, i, 0, {}};
+            by_name[def].end = std::max(by_name[def].end, i);
+            refs[def] += ops[i].count;
+        }
+    }
+
+    // A value defined before a loop and read in it, or read in it before it is written
+    // (loop-carried), is live for the whole body; repeat until nested loops settle
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (const auto& loop : loops) {
+            for (auto& [name, interval] : by_name) {
+                bool live_in = false, referenced = false;
+                for (int i = loop.first; i <= loop.last && !referenced; i++) {
+                    bool used = std::find(ops[i].uses.begin(), ops[i].uses.end(), name) != ops[i].uses.end();
+                    bool defined = std::find(ops[i].defs.begin(), ops[i].defs.end(), name) != ops[i].defs.end();
+                    referenced = used || defined;
+                    live_in = used || (defined && interval.start < loop.first);
+                }
+                live_in = live_in || (interval.start < loop.first && interval.end >= loop.first);
+                if (!live_in) continue;
+                int start = std::min(interval.start, loop.first);
+                int end = std::max(interval.end, loop.last);
+                if (start != interval.start || end != interval.end) {
+                    interval.start = start;
+                    interval.end = end;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    std::vector<Interval> result;
+    for (auto& [name, interval] : by_name) {
+        for (int i = interval.start + 1; i < interval.end; i++) {
+            interval.forbidden.insert(ops[i].clobbers.begin(), ops[i].clobbers.end());
+        }
+        interval.weight = static_cast<double>(refs[name]) / (interval.end - interval.start + 1);
+        result.push_back(interval);
+    }
+    std::sort(result.begin(), result.end(), [](const Interval& a, const Interval& b) {
+        return a.start < b.start || (a.start == b.start && a.name < b.name);
+    });
+    return result;
+}
+
+// One linear scan over the intervals with the given registers; returns the spilled ones
+std::vector<LinearScanAllocator::Interval> LinearScanAllocator::scan(const std::vector<Interval>& sorted, const std::vector<std::string>& registers,
+                                                                     RegisterAllocation& result) const {
+    std::vector<Interval> active;  // Sorted by end
+    std::vector<Interval> spilled;
+    std::set<std::string> free(registers.begin(), registers.end());
+    auto take = [&](const Interval& interval) -> std::string {
+        // Lowest register in pool order the interval may use
+        for (const auto& reg : registers) {
+            if (free.count(reg) > 0 && interval.forbidden.count(reg) == 0) return reg;
+        }
+        return "";
+    };
+    auto activate = [&](const Interval& interval, const std::string& reg) {
+        result.assignment[interval.name] = reg;
+        free.erase(reg);
+        auto at = std::upper_bound(active.begin(), active.end(), interval,
+                                   [](const Interval& a, const Interval& b) { return a.end < b.end; });
+        active.insert(at, interval);
+    };
+
+    for (const auto& current : sorted) {
+        // Expire intervals that ended before this one starts
+        while (!active.empty() && active.front().end < current.start) {
+            free.insert(result.assignment[active.front().name]);
+            active.erase(active.begin());
+        }
+        std::string reg = take(current);
+        if (!reg.empty()) {
+            activate(current, reg);
+            continue;
+        }
+
+        // Spill the cheapest of the current interval and the active ones whose register it may take
+        auto victim = active.end();
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            if (current.forbidden.count(result.assignment[it->name]) > 0) continue;
+            if (victim == active.end() || it->weight < victim->weight) victim = it;
+        }
+        if (victim == active.end() || current.weight <= victim->weight) {
+            spilled.push_back(current);
+            continue;
+        }
+        reg = result.assignment[victim->name];
+        result.assignment.erase(victim->name);
+        spilled.push_back(*victim);
+        active.erase(victim);
+        free.insert(reg);
+        activate(current, reg);
+    }
+    return spilled;
+}
+
+LinearScanAllocator::LinearScanAllocator(const std::vector<AllocationOp>& ops, const std::vector<AllocationLoop>& loops,
+                                         const std::vector<std::string>& pool)
+    : ops(ops), loops(loops), pool(pool) {}
+
+RegisterAllocation LinearScanAllocator::run() {
+    std::vector<Interval> sorted = intervals();
+    RegisterAllocation result;
+    std::vector<Interval> spilled = scan(sorted, pool, result);
+    if (!spilled.empty()) {
+        // Spill code needs two scratch registers (both sources of an r-type); allocate again without them
+        if (pool.size() < 3) throw std::runtime_error("too few registers to spill");
+        result = RegisterAllocation();
+        result.scratch.assign(pool.end() - 2, pool.end());
+        spilled = scan(sorted, std::vector<std::string>(pool.begin(), pool.end() - 2), result);
+    }
+
+    std::sort(spilled.begin(), spilled.end(), [](const Interval& a, const Interval& b) { return a.start < b.start; });
+    for (const auto& interval : spilled) {
+        int slot = static_cast<int>(result.spill_slot.size());
+        result.spill_slot[interval.name] = slot;
+    }
+    for (const auto& op : ops) {
+        std::set<std::string> reloaded;
+        for (const auto& use : op.uses) {
+            if (result.spill_slot.count(use) > 0 && reloaded.insert(use).second) {
+                result.spill_loads++;
+                result.spill_cost += op.count;
+            }
+        }
+        for (const auto& def : op.defs) {
+            if (result.spill_slot.count(def) > 0) {
+                result.spill_stores++;
+                result.spill_cost += op.count;
+            }
+        }
+    }
+    std::set<std::string> used;
+    for (const auto& [name, reg] : result.assignment) used.insert(reg);
+    result.registers_used = static_cast<int>(used.size());
+    return result;
+}
+
+RegisterAllocation allocate_registers(const std::vector<AllocationOp>& ops,
+                                      const std::vector<AllocationLoop>& loops,
+                                      const std::vector<std::string>& pool) {
+    return LinearScanAllocator(ops, loops, pool).run();
+}
@@ -0,0 +1,68 @@
+#ifndef REGISTER_ALLOCATOR_H
+#define REGISTER_ALLOCATOR_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Register operands of one instruction of a PE program. Virtual registers are the only names
+// in uses/defs; clobbers lists the physical registers a call overwrites.
+struct AllocationOp {
+    std::vector<std::string> uses;
+    std::vector<std::string> defs;
+    std::set<std::string> clobbers;
+    long long count = 1;  // Dynamic executions, for spill weights and cost
+};
+
+// Hardware loop body as an inclusive range of op indices
+struct AllocationLoop {
+    int first;
+    int last;
+};
+
+struct RegisterAllocation {
+    std::map<std::string, std::string> assignment;  // Virtual -> physical register
+    std::map<std::string, int> spill_slot;          // Spilled virtual -> scratch word
+    std::vector<std::string> scratch;               // Physical registers reserved for spill code
+    int spill_loads = 0;                            // Reload instructions inserted
+    int spill_stores = 0;                           // Store instructions inserted
+    long long spill_cost = 0;                       // Dynamic spill loads + stores
+    int registers_used = 0;                         // Distinct physical registers assigned
+};
+
+// Linear-scan allocation (Poletto and Sarkar) over the virtual registers of a straight-line
+// program with hardware loops. A value live into a loop body stays live for the whole body, so
+// it survives every iteration. A value live across a call avoids the registers the callee
+// writes. When registers run out, the interval with the lowest dynamic references per op of
+// length is spilled. Its uses are reloaded into one of two scratch registers, which are taken
+// out of the pool. Each def is stored back.
+class LinearScanAllocator {
+private:
+    struct Interval {
+        std::string name;
+        int start;
+        int end;
+        double weight;  // Dynamic references per op of length
+        std::set<std::string> forbidden;
+    };
+
+    const std::vector<AllocationOp>& ops;
+    const std::vector<AllocationLoop>& loops;
+    std::vector<std::string> pool;
+
+    std::vector<Interval> intervals() const;
+    std::vector<Interval> scan(const std::vector<Interval>& sorted, const std::vector<std::string>& registers,
+                               RegisterAllocation& result) const;
+
+public:
+    LinearScanAllocator(const std::vector<AllocationOp>& ops, const std::vector<AllocationLoop>& loops,
+                        const std::vector<std::string>& pool);
+    RegisterAllocation run();
+};
+
+RegisterAllocation allocate_registers(const std::vector<AllocationOp>& ops,
+                                      const std::vector<AllocationLoop>& loops,
+                                      const std::vector<std::string>& pool);
+
+#endif // REGISTER_ALLOCATOR_H
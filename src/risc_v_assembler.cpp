@@ -1,378 +1,1258 @@
-#include <iostream>
+#include "risc_v_assembler.h"
 #include <fstream>
-#include <string>
-#include <vector>
-#include <map>
-#include <regex>
-#include <cstdint>
 #include <bitset>
 #include <iomanip>
 #include <sstream>
+#include <cctype>
+#include "profiler.h"
 
-struct AssembledInstruction {
-    std::string op;
-    std::string binary;
-    std::string hex;
-    bool is_execution;
-};
-
-class RISC_V_Assembler {
-private:
-    std::map<std::string, int> registers;
-    std::map<std::string, int> registers_c;
-    std::map<std::string, int> registers_p;
-    std::map<std::string, int> hwl_registers; // Hardware loop registers (L1-L7)
-    std::map<std::string, std::string> instructions;
-    std::map<std::string, std::string> funct3;
-    std::map<std::string, std::string> funct7;
-
-    // Helper function to trim whitespace from start and end of string
-    std::string trim_string(const std::string& str) {
-        size_t first = str.find_first_not_of(" \t\n\r\f\v");
-        if (std::string::npos == first) {
-            return "";
-        }
-        size_t last = str.find_last_not_of(" \t\n\r\f\v");
-        return str.substr(first, (last - first + 1));
-    }
-
-public:
-    RISC_V_Assembler() {
-        // Initialize registers
-        for (int i = 0; i < 32; i++) {
-            registers["x" + std::to_string(i)] = i;
-            registers_c["c" + std::to_string(i)] = i;  // c0-c31 map to register numbers 0-31
-            registers_p["v" + std::to_string(i)] = i;  // v0-v31 map to register numbers 0-31
-        }
-
-        // Initialize hardware loop registers (L1-L7)
-        for (int i = 1; i <= 7; i++) {
-            hwl_registers["L" + std::to_string(i)] = i;
-        }
-
-        // Initialize instructions with their opcodes
-        instructions = {
-            {"lb", "0000011"}, {"lh", "0000011"}, {"lw", "0000011"}, 
-            {"lbu", "0000011"}, {"lhu", "0000011"},
-
-            {"addi", "0010011"}, {"slli", "0010011"}, {"slti", "0010011"}, {"sltiu", "0010011"},
-            {"xori", "0010011"}, {"srli", "0010011"}, {"srai", "0010011"}, {"ori", "0010011"}, 
-            {"andi", "0010011"}, {"auipc", "0010111"}, 
-
-            {"sb", "0100011"}, {"sh", "0100011"}, {"sw", "0100011"},
-
-            {"add", "0110011"}, {"sub", "0110011"}, {"sll", "0110011"}, {"slt", "0110011"},
-            {"sltu", "0110011"}, {"xor", "0110011"}, {"srl", "0110011"}, {"sra", "0110011"},
-            {"or", "0110011"}, {"and", "0110011"}, {"mul", "0110011"}, {"lui", "0110111"}, 
-             
-            {"beq", "1100011"}, {"bne", "1100011"}, {"blt", "1100011"}, 
-            {"bge", "1100011"}, {"bltu", "1100011"}, {"bgeu", "1100011"},
-
-            {"jalr", "1100111"}, {"jal", "1101111"},
-
-            {"psrf.lw", "0000100"}, {"psrf.sw", "0100100"},
-            {"psrf.lb", "0000100"}, {"psrf.sb", "0100100"},
-            {"psrf.zd.lw", "0000100"}, 
-            {"ppsrf.addi", "0010100"}, // opcode 0x14 for ppsrf.addi
-            {"corf.addi", "0010100"}, // opcode 0x14 for corf.addi
-            {"corf.lui", "0111011"}, // opcode 0x3B for corf.lui
-            {"hwlrf.lui", "0111100"}, // Updated to 0x3C
-            {"hwlrf.addi", "0010100"}, // Updated to 0x14
-            {"ret", "0000000"},
-        };
-
-        // Initialize function 3 values for I-type instructions
-        funct3 = {
-            {"lb", "000"}, {"lh", "001"}, {"lw", "010"}, 
-            {"lbu", "100"}, {"lhu", "101"},
-
-            {"addi", "000"}, {"slli", "001"}, {"slti", "010"}, {"sltiu", "011"},
-            {"xori", "100"}, {"srli", "101"}, {"srai", "101"}, {"ori", "110"}, 
-            {"andi", "111"}, 
-
-            {"sb", "000"}, {"sh", "001"}, {"sw", "010"},
-
-            {"add", "000"}, {"sub", "000"}, {"sll", "001"}, {"slt", "010"},
-            {"sltu", "011"}, {"xor", "100"}, {"srl", "101"}, {"sra", "101"},
-            {"or", "110"}, {"and", "111"}, {"mul", "000"}, 
-             
-            {"beq", "000"}, {"bne", "001"}, {"blt", "100"}, 
-            {"bge", "101"}, {"bltu", "110"}, {"bgeu", "111"},
-
-            {"jalr", "000"}, 
-
-            {"psrf.lw", "111"}, {"psrf.lb", "000"}, {"mul", "000"},
-            {"psrf.zd.lw", "110"}, 
-            {"psrf.sw", "100"}, {"psrf.sb", "000"}, 
-            {"ppsrf.addi", "001"}, // func3=1 for ppsrf.addi
-            {"corf.addi", "000"},  // func3=0 for corf.addi
-            {"hwlrf.addi", "010"}, // Updated to func3=2
-        };
-
-        // Initialize funct7
-        funct7 = {
-            {"slli", "0000000"}, {"srli", "0000000"}, {"srai", "0100000"},
-            {"add", "0000000"}, {"sub", "0100000"}, {"sll", "0000000"}, {"slt", "0000000"},
-            {"sltu", "0000000"}, {"xor", "0000000"}, {"srl", "0000000"}, {"sra", "0100000"},
-            {"or", "0000000"}, {"and", "0000000"}, {"mul", "0000001"}, 
-        };
-    }
-
-    std::string to_binary(int num, int length) {
-        if (num < 0) {
-            num = (1 << length) + num;
-        }
-        std::stringstream ss;
-        ss << std::setfill('0') << std::setw(length) << std::bitset<32>(num).to_string().substr(32 - length);
-        return ss.str();
-    }
-
-    std::string to_hex(const std::string& binary) {
-        std::stringstream ss;
-        ss << std::setfill('0') << std::setw(8) << std::hex << std::stoul(binary, nullptr, 2);
-        return ss.str();
-    }
-
-    std::string assemble_r_type(const std::string& instruction, const std::string& rd, 
-                               const std::string& rs1, const std::string& rs2) {
-        std::string opcode = instructions[instruction];
-        std::string func3 = funct3[instruction];
-        std::string func7 = funct7[instruction];
-        std::string rd_bin = to_binary(registers[rd], 5);
-        std::string rs1_bin = to_binary(registers[rs1], 5);
-        std::string rs2_bin = "";
-        if (instruction == "slli" || instruction == "srli" || instruction == "srai") {
-            int imm = std::stoi(rs2);
-            std::string rs2_bin = to_binary(imm, 5); 
-            return func7 + rs2_bin + rs1_bin + func3 + rd_bin + opcode;
+// Helper function to trim whitespace from start and end of string
+std::string RISC_V_Assembler::trim_string(const std::string& str) {
+    size_t first = str.find_first_not_of(" \t\n\r\f\v");
+    if (std::string::npos == first) {
+        return "";
+    }
+    size_t last = str.find_last_not_of(" \t\n\r\f\v");
+    return str.substr(first, (last - first + 1));
+}
 
-        } else {
-            std::string rs2_bin = to_binary(registers[rs2], 5);
-            return func7 + rs2_bin + rs1_bin + func3 + rd_bin + opcode;
-        }
-    }
-
-    std::string assemble_i_type(const std::string& instruction, const std::string& rd, 
-                               const std::string& rs1, int imm) {
-        std::string opcode = instructions[instruction];
-        std::string func3 = funct3[instruction];
-        std::string rd_bin = to_binary(registers[rd], 5);
-        std::string rs1_bin = to_binary(registers[rs1], 5);
-        std::string imm_bin = to_binary(imm, 12);
-        std::cout << "instruction: " << instruction << std::endl;
-        std::cout << "opcode: " << opcode << std::endl; 
-        std::cout << "rd: " << rd << std::endl; 
-        std::cout << "rs1: " << rs1 << std::endl;
-        std::cout << "imm: " << imm << std::endl;
-        std::cout << "imm_bin: " << imm_bin << std::endl;
-        std::cout << "rs1_bin: " << rs1_bin << std::endl;
-        std::cout << "func3: " << func3 << std::endl;
-        std::cout << "rd_bin: " << rd_bin << std::endl;
-        std::cout << "opcode: " << opcode << std::endl;
-        std::cout << "imm_bin + rs1_bin + func3 + rd_bin + opcode: " << imm_bin + rs1_bin + func3 + rd_bin + opcode << std::endl;   
-        return imm_bin + rs1_bin + func3 + rd_bin + opcode;
-    }
-
-    std::string assemble_s_type(const std::string& instruction, const std::string& rs1, 
-                               const std::string& rs2, int imm) {
-        std::string opcode = instructions[instruction];
-        std::string func3 = funct3[instruction];
-        std::string rs1_bin = to_binary(registers[rs1], 5);
-        std::string rs2_bin = to_binary(registers[rs2], 5);
-        std::string imm_bin = to_binary(imm, 12);
-        std::string imm_high = imm_bin.substr(0, 7);
-        std::string imm_low = imm_bin.substr(7, 5);
-        return imm_high + rs2_bin + rs1_bin + func3 + imm_low + opcode;
+// Insert an overlay suffix before the file extension (pe0_binary.bin -> pe0_binary_ovl1.bin)
+std::string RISC_V_Assembler::overlay_path(const std::string& path, int overlay) {
+    if (overlay == 0) return path;
+    size_t last_slash = path.find_last_of("/\\");
+    size_t last_dot = path.find_last_of('.');
+    std::string suffix = "_ovl" + std::to_string(overlay);
+    if (last_dot == std::string::npos || (last_slash != std::string::npos && last_dot < last_slash)) {
+        return path + suffix;
     }
+    return path.substr(0, last_dot) + suffix + path.substr(last_dot);
+}
 
-    std::string assemble_b_type(const std::string& instruction, const std::string& rs1, 
-                               const std::string& rs2, int imm) {
-        std::string opcode = instructions[instruction];
-        std::string func3 = funct3[instruction];
-        std::string rs1_bin = to_binary(registers[rs1], 5);
-        std::string rs2_bin = to_binary(registers[rs2], 5);
-        std::string imm_bin = to_binary(imm, 13);
-        std::string imm_12 = imm_bin.substr(0, 1);
-        std::string imm_10_5 = imm_bin.substr(2, 6);
-        std::string imm_4_1 = imm_bin.substr(8, 4);
-        std::string imm_11 = imm_bin.substr(1, 1);
-        return imm_12 + imm_10_5 + rs2_bin + rs1_bin + func3 + imm_4_1 + imm_11 + opcode;
-    }
-
-    std::string assemble_psrf_lw_sw(const std::string& instruction, const std::string& rd, 
-                                   const std::string& rs1, int imm) {
-        std::string opcode = instructions[instruction];
-        std::string func3 = funct3[instruction];
-        std::string rd_bin = to_binary(registers[rd], 5);
-        std::string rs1_bin = to_binary(registers[rs1], 5);
-        std::string imm_bin = to_binary(imm, 12);
-        std::cout << "instruction: " << instruction << std::endl;
-        std::cout << "func3: " << func3 << std::endl;
-        std::cout << "opcode: " << opcode << std::endl; 
-        std::cout << "rd: " << rd << std::endl; 
-        std::cout << "rs1: " << rs1 << std::endl;
-        std::cout << "imm: " << imm << std::endl;
-        return imm_bin + rs1_bin + func3 + rd_bin + opcode;
-    }
-
-    std::string assemble_u_type(const std::string& instruction, const std::string& rd, int imm) {
-        std::string opcode = instructions[instruction];
-        std::string rd_bin = to_binary(registers[rd], 5);
-        std::string imm_bin = to_binary(imm, 20);
-        return imm_bin + rd_bin + opcode;
-    }
-
-    std::string assemble_lui(const std::string& op, const std::string& rd, int imm) {
-        std::string opcode = instructions[op];
-        std::string rd_bin = to_binary(registers[rd], 5);
-        std::string imm_bin = to_binary(imm & 0xFFFFF, 20); // Upper 20 bits of immediate
-        return imm_bin + rd_bin + opcode;
-    }
-
-    std::string assemble_corf_lui(const std::string& op, const std::string& rd, int imm) {
-        std::string opcode = instructions[op];
-        std::string rd_bin = to_binary(registers_c[rd], 5);
-        std::string imm_bin = to_binary(imm & 0xFFFFF, 20); // Upper 20 bits of immediate
-        return imm_bin + rd_bin + opcode;
-    }
-    std::string assemble_corf_addi(const std::string& op, const std::string& rd, const std::string& rs1, int imm) {
-        std::string opcode = instructions[op];
-        std::string func3 = funct3[op]; // This should be "000"
-        std::string rd_bin = to_binary(registers_c[rd], 5);  // Use registers_c for c-registers
-        std::string rs1_bin = to_binary(registers_c[rs1], 5); // Use registers_c for c-registers
-        std::string imm_bin = to_binary(imm, 12);
-        return imm_bin + rs1_bin + func3 + rd_bin + opcode;
-    }
-
-    std::string assemble_ppsrf_addi(const std::string& op, const std::string& rd, const std::string& rs1, int imm) {
-        std::cout << "op: " << op << std::endl; 
-        std::cout << "rd: " << rd << std::endl;
-        std::cout << "rs1: " << rs1 << std::endl;
-        std::cout << "imm: " << imm << std::endl;
-        std::string opcode = instructions[op];
-        std::string func3 = funct3[op]; // This should be "001"
-        std::string rd_bin = to_binary(registers_p[rd], 5);  // Use registers_p for v-registers
-        std::string rs1_bin = to_binary(registers_p[rs1], 5); // Use registers_p for v-registers
-        std::string imm_bin = to_binary(imm, 12);
-        return imm_bin + rs1_bin + func3 + rd_bin + opcode;
-    }
-
-    std::string assemble_hwlrf_lui(const std::string& rd, int imm) {
-        std::string opcode = instructions["hwlrf.lui"];
-        std::string rd_bin = to_binary(hwl_registers[rd], 5);
-        std::string imm_bin = to_binary(imm, 20);
-        return imm_bin + rd_bin + opcode;
-    }
-
-    std::string assemble_hwlrf_addi(const std::string& rd, const std::string& rs1, int imm) {
-        std::string opcode = instructions["hwlrf.addi"];
-        std::string func3 = funct3["hwlrf.addi"];
-        std::string rd_bin = to_binary(hwl_registers[rd], 5);
-        std::string rs1_bin = to_binary(hwl_registers[rs1], 5);
-        std::string imm_bin = to_binary(imm, 12);
-        return imm_bin + rs1_bin + func3 + rd_bin + opcode;
-    }
-
-    std::string assemble_j_type(const std::string& rd, int imm) {
-        std::string opcode = instructions["jal"];
-        std::string rd_bin = to_binary(registers[rd], 5);
-        
-        // J-type immediate format: [20|10:1|11|19:12]
-        std::string imm_bin = to_binary(imm, 21);
-        std::string imm_20 = imm_bin.substr(0, 1);
-        std::string imm_10_1 = imm_bin.substr(11, 10);
-        std::string imm_11 = imm_bin.substr(10, 1);
-        std::string imm_19_12 = imm_bin.substr(1, 8);
+// Split an operand list on commas that are outside parentheses
+std::vector<std::string> RISC_V_Assembler::split_arguments(const std::string& args_str) {
+    std::vector<std::string> args;
+    size_t pos = 0;
+    std::string token;
+    bool in_parentheses = false;
+    
+    for (size_t i = 0; i < args_str.length(); i++) {
+        char c = args_str[i];
+        if (c == '(') {
+            in_parentheses = true;
+        } else if (c == ')') {
+            in_parentheses = false;
+        }
         
-        return imm_20 + imm_10_1 + imm_11 + imm_19_12 + rd_bin + opcode;
+        if (c == ',' && !in_parentheses) {
+            // Found argument separator outside parentheses
+            token = trim_string(args_str.substr(pos, i - pos));
+            if (!token.empty()) {
+                args.push_back(token);
+            }
+            pos = i + 1;
+        }
     }
+    
+    // Add the last argument
+    if (pos < args_str.length()) {
+        token = trim_string(args_str.substr(pos));
+        if (!token.empty()) {
+            args.push_back(token);
+        }
+    }
+    return args;
+}
 
-    // Parse a single assembly instruction line
-    AssembledInstruction parse_instruction(const std::string& line) {
-        AssembledInstruction result;
-        
-        // Split the line into tokens (opcode and arguments)
-        std::istringstream iss(line);
-        std::string op, args_str;
-        iss >> op; // Extract opcode
-        
-        std::getline(iss, args_str); // Get the rest
-        args_str = trim_string(args_str);
-        
-        // Store original operation
-        result.op = op;
-        
-        // Parse arguments
-        std::vector<std::string> args;
-        size_t pos = 0;
-        std::string token;
-        bool in_parentheses = false;
-        
-        for (size_t i = 0; i < args_str.length(); i++) {
-            char c = args_str[i];
-            if (c == '(') {
-                in_parentheses = true;
-            } else if (c == ')') {
-                in_parentheses = false;
+// Check whether an operand is a numeric literal rather than a symbol
+bool RISC_V_Assembler::is_number(const std::string& operand) {
+    size_t i = (!operand.empty() && (operand[0] == '-' || operand[0] == '+')) ? 1 : 0;
+    return i < operand.size() && std::isdigit(static_cast<unsigned char>(operand[i]));
+}
+
+// Parse a decimal or 0x-prefixed hexadecimal constant
+int RISC_V_Assembler::parse_constant(const std::string& text) {
+    std::string digits = text;
+    bool negative = !digits.empty() && digits[0] == '-';
+    if (negative || (!digits.empty() && digits[0] == '+')) digits = digits.substr(1);
+    long long value = (digits.rfind("0x", 0) == 0 || digits.rfind("0X", 0) == 0)
+                          ? std::stoll(digits.substr(2), nullptr, 16)
+                          : std::stoll(digits);
+    return static_cast<int>(negative ? -value : value);
+}
+
+// Split a 32-bit constant into lui/addi parts; lower is the sign-extended low 12 bits
+std::pair<int, int> RISC_V_Assembler::split_constant(int value) {
+    int lower = value & 0xFFF;
+    if (lower & 0x800) lower -= 0x1000;
+    int upper = static_cast<int>(((static_cast<int64_t>(value) - lower) >> 12) & 0xFFFFF);
+    return {upper, lower};
+}
+
+// Number of instruction words `li` needs for a constant
+int RISC_V_Assembler::li_words(int value) {
+    if (value >= -2048 && value <= 2047) return 1;
+    return split_constant(value).second == 0 ? 1 : 2;
+}
+
+// Number of instruction words a source line expands to
+int RISC_V_Assembler::instruction_words(const std::string& op, const std::vector<std::string>& args, int value) {
+    if (op == "hwlrf.li") return 2;
+    if (op == "li" && args.size() >= 2) return li_words(value);
+    return 1;
+}
+
+// Expand .macro definitions, macro invocations and .rept blocks into plain source lines.
+// Each output line keeps the number of the source line it came from.
+bool RISC_V_Assembler::expand_block(const std::vector<std::pair<int, std::string>>& block,
+                                    std::vector<std::pair<int, std::string>>& out,
+                                    std::map<std::string, std::pair<std::vector<std::string>, std::vector<std::pair<int, std::string>>>>& macros,
+                                    int depth) {
+    if (depth > 64) {
+        errors() << "Error: macro or .rept nesting too deep" << std::endl;
+        return false;
+    }
+    for (size_t i = 0; i < block.size(); i++) {
+        const auto& [line_number, line] = block[i];
+        std::string code = trim_string(line.substr(0, line.find('#')));
+
+        // Peel off a leading label so the rest of the line can be a macro invocation
+        size_t colon = code.find(':');
+        if (colon != std::string::npos && code.find_first_of(" \t") > colon) {
+            out.push_back({line_number, code.substr(0, colon + 1)});
+            code = trim_string(code.substr(colon + 1));
+            if (code.empty()) continue;
+            if (macros.count(code.substr(0, code.find_first_of(" \t"))) == 0) {
+                out.push_back({line_number, code});
+                continue;
             }
-            
-            if (c == ',' && !in_parentheses) {
-                // Found argument separator outside parentheses
-                token = trim_string(args_str.substr(pos, i - pos));
-                if (!token.empty()) {
-                    args.push_back(token);
+        }
+        std::istringstream iss(code);
+        std::string first;
+        iss >> first;
+
+        if (first == ".macro" || first == ".rept") {
+            // Collect the body up to the matching terminator
+            std::string open = first, close = (first == ".macro") ? ".endm" : ".endr";
+            std::vector<std::pair<int, std::string>> body;
+            int nesting = 1;
+            size_t j = i + 1;
+            for (; j < block.size(); j++) {
+                std::istringstream body_iss(trim_string(block[j].second.substr(0, block[j].second.find('#'))));
+                std::string word;
+                body_iss >> word;
+                if (word == open) nesting++;
+                if (word == close && --nesting == 0) break;
+                body.push_back(block[j]);
+            }
+            if (j == block.size()) {
+                errors() << "Error: line " << line_number << ": " << open << " without " << close << std::endl;
+                return false;
+            }
+            i = j;
+
+            std::string rest;
+            std::getline(iss, rest);
+            if (first == ".macro") {
+                // .macro name param1, param2, ...
+                std::istringstream header(rest);
+                std::string name, params;
+                header >> name;
+                std::getline(header, params);
+                macros[name] = {split_arguments(trim_string(params)), body};
+            } else {
+                int count = std::stoi(trim_string(rest));
+                for (int k = 0; k < count; k++) {
+                    if (!expand_block(body, out, macros, depth + 1)) return false;
                 }
-                pos = i + 1;
             }
+            continue;
         }
-        
-        // Add the last argument
-        if (pos < args_str.length()) {
-            token = trim_string(args_str.substr(pos));
-            if (!token.empty()) {
-                args.push_back(token);
+
+        auto macro = macros.find(first);
+        if (macro != macros.end()) {
+            // Substitute \param references with the invocation arguments
+            std::string rest;
+            std::getline(iss, rest);
+            std::vector<std::string> args = split_arguments(trim_string(rest));
+            const auto& [params, body] = macro->second;
+            std::vector<std::pair<int, std::string>> substituted;
+            for (const auto& [body_line_number, body_line] : body) {
+                std::string text = body_line;
+                for (size_t k = 0; k < params.size(); k++) {
+                    std::string key = "\\" + params[k];
+                    std::string value = k < args.size() ? args[k] : "";
+                    for (size_t pos = text.find(key); pos != std::string::npos; pos = text.find(key, pos + value.size())) {
+                        text.replace(pos, key.size(), value);
+                    }
+                }
+                substituted.push_back({line_number, text});
             }
+            if (!expand_block(substituted, out, macros, depth + 1)) return false;
+            continue;
         }
 
-        // Handle HWLRF instructions
-        if (op == "hwlrf.lui") {
-            if (args.size() >= 2) {
-                result.binary = assemble_hwlrf_lui(args[0], std::stoi(args[1]));
+        out.push_back(block[i]);
+    }
+    return true;
+}
+
+// Pack the hardware loop immediate and split it into hwlrf.lui/hwlrf.addi parts
+std::pair<int, int> RISC_V_Assembler::hwl_immediate(int pc_start, int pc_stop, int hwl_index, int iterations) {
+    uint32_t imm = 0;
+    imm |= (static_cast<uint32_t>(pc_start & 0x1FF) << 23);               //  9 bits pc_start
+    imm |= (static_cast<uint32_t>((pc_stop - pc_start) & 0x3F) << 17);    //  6 bits pc_stop
+    imm |= (static_cast<uint32_t>(hwl_index & 0x1F) << 12);               //  5 bits hwl_index
+    imm |= (static_cast<uint32_t>(iterations & 0xFFF));                   // 12 bits iterations
+    uint32_t upper = (imm >> 12) & 0xFFFFF;
+    uint32_t lower = imm & 0xFFF;
+    if (lower & 0x800) {
+        upper += 1;  // Compensate for sign extension of the lower part
+    }
+    return {static_cast<int>(upper), static_cast<int>(lower)};
+}
+
+// First pass: strip comments, record labels and directives, and place each instruction
+bool RISC_V_Assembler::read_source(std::istream& in, std::vector<SourceLine>& lines,
+                                   std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                                   int& pe_number, bool& is_library, int& library_base, uint32_t& library_region) {
+    std::string line;
+    bool in_execution_section = false;
+    int overlay = 0;
+    int preload_word = 0, execution_word = 0;
+    int line_number = 0;
+
+    // Expand macros and repeat blocks before placing instructions
+    std::vector<std::pair<int, std::string>> raw, expanded;
+    while (std::getline(in, line)) {
+        raw.push_back({++line_number, line});
+    }
+    std::map<std::string, std::pair<std::vector<std::string>, std::vector<std::pair<int, std::string>>>> macros;
+    if (!expand_block(raw, expanded, macros, 0)) {
+        return false;
+    }
+
+    auto define = [&](const std::string& name, const Symbol& symbol) {
+        for (const auto& [defined_overlay, existing] : symbols[name]) {
+            if (defined_overlay == symbol.overlay) {
+                errors() << "Error: line " << line_number << ": symbol '" << name << "' redefined" << std::endl;
+                return false;
+            }
+        }
+        symbols[name].push_back({symbol.overlay, symbol});
+        return true;
+    };
+
+    for (const auto& [source_line_number, source_text] : expanded) {
+        line_number = source_line_number;
+        std::string trimmed = trim_string(source_text);
+
+        // Check for execution section marker
+        if (trimmed.find("Execution Section Begin") != std::string::npos) {
+            in_execution_section = true;
+            execution_word = library_base;
+            continue;
+        }
+
+        // Strip comments
+        size_t comment = trimmed.find('#');
+        if (comment != std::string::npos) {
+            trimmed = trim_string(trimmed.substr(0, comment));
+        }
+        if (trimmed.empty()) continue;
+
+        // Directives
+        if (trimmed[0] == '.' && trimmed.find(':') == std::string::npos) {
+            std::istringstream directive(trimmed);
+            std::string name;
+            directive >> name;
+            if (name == ".overlay") {
+                directive >> overlay;
+                execution_word = 0;
+            } else if (name == ".library") {
+                // .library <cluster> <base word> <region address>
+                int cluster = 0;
+                std::string region;
+                directive >> cluster >> library_base >> region;
+                unsigned long value = 0;
+                try {
+                    value = region.empty() ? 0 : std::stoul(region, nullptr, 0);
+                } catch (const std::exception&) {
+                    value = 0;
+                }
+                if (value == 0 || (value & LIBRARY_REGION_MASK) != 0 || value > 0xFFFFFFFFul) {
+                    errors() << "Error: line " << line_number << ": .library needs the address of the cluster "
+                             << "code region, a nonzero multiple of 0x" << std::hex << (LIBRARY_REGION_MASK + 1)
+                             << std::dec << std::endl;
+                    return false;
+                }
+                library_region = static_cast<uint32_t>(value);
+                is_library = true;
+                pe_number = cluster;
+            } else if (name == ".set" || name == ".equ") {
+                std::string rest;
+                std::getline(directive, rest);
+                std::vector<std::string> args = split_arguments(rest);
+                if (args.size() != 2 || !is_number(args[1])) {
+                    errors() << "Error: line " << line_number << ": malformed " << name << std::endl;
+                    return false;
+                }
+                if (!define(args[0], {true, overlay, parse_constant(args[1]), true})) return false;
             }
+            continue;
+        }
+
+        // Labels, optionally followed by an instruction on the same line
+        size_t colon = trimmed.find(':');
+        if (colon != std::string::npos) {
+            std::string label = trim_string(trimmed.substr(0, colon));
+            Symbol symbol{in_execution_section, overlay,
+                          in_execution_section ? execution_word : preload_word, false};
+            if (!define(label, symbol)) return false;
+            trimmed = trim_string(trimmed.substr(colon + 1));
+            if (trimmed.empty()) continue;
         }
-        else if (op == "hwlrf.addi") {
-            if (args.size() >= 3) {
-                result.binary = assemble_hwlrf_addi(args[0], args[1], std::stoi(args[2]));
+
+        std::istringstream iss(trimmed);
+        std::string op, args_str;
+        iss >> op;
+        std::getline(iss, args_str);
+        std::vector<std::string> args = split_arguments(trim_string(args_str));
+
+        // li needs its constant in the first pass to know its size
+        int value = 0;
+        if (op == "li" && args.size() >= 2) {
+            if (is_number(args[1])) {
+                value = parse_constant(args[1]);
+            } else if (symbols.count(args[1]) > 0 && symbols[args[1]].front().second.absolute) {
+                value = symbols[args[1]].front().second.word;
+            } else {
+                errors() << "Error: line " << line_number << ": li needs a constant or a .set symbol defined earlier" << std::endl;
+                return false;
             }
         }
-        // Handle standard LUI and AUIPC instructions
-        else if (op == "lui" || op == "auipc") {
-            if (args.size() >= 2) {
-                result.binary = assemble_u_type(op, args[0], std::stoi(args[1]));
+
+        int& word = in_execution_section ? execution_word : preload_word;
+        lines.push_back({trimmed, line_number, in_execution_section, overlay, word});
+        word += instruction_words(op, args, value);
+    }
+    return true;
+}
+
+// Look up a symbol visible from the given overlay (its own labels first, then absolute values)
+const Symbol* RISC_V_Assembler::find_symbol(const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                                            const std::string& name, int overlay) {
+    auto it = symbols.find(name);
+    if (it == symbols.end()) return nullptr;
+    const Symbol* fallback = nullptr;
+    for (const auto& [defined_overlay, symbol] : it->second) {
+        if (defined_overlay == overlay) return &symbol;
+        if (symbol.absolute || defined_overlay == 0) fallback = &symbol;
+    }
+    return fallback;
+}
+
+// Second pass: resolve symbolic operands, record relocations and expand hwlrf.li
+// With a halfword map (RVC layout), symbols resolve to halfword positions instead of words.
+bool RISC_V_Assembler::resolve_line(const SourceLine& source,
+                                    const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                                    std::vector<std::string>& expanded, std::vector<Relocation>& relocations,
+                                    const std::map<int, int>* halfword) {
+    std::istringstream iss(source.text);
+    std::string op, args_str;
+    iss >> op;
+    std::getline(iss, args_str);
+    std::vector<std::string> args = split_arguments(trim_string(args_str));
+
+    auto lookup = [&](const std::string& name, const std::string& type, int& value) {
+        const Symbol* symbol = find_symbol(symbols, name, source.overlay);
+        if (symbol == nullptr) {
+            errors() << "Error: line " << source.line_number << ": undefined symbol '" << name << "'" << std::endl;
+            return false;
+        }
+        if (!symbol->absolute && symbol->is_execution != source.is_execution) {
+            errors() << "Error: line " << source.line_number << ": symbol '" << name
+                      << "' is in a different section" << std::endl;
+            return false;
+        }
+        value = symbol->word;
+        relocations.push_back({source.word, source.is_execution, source.overlay, type, name, value});
+        return true;
+    };
+
+    // PC-relative byte offset from this instruction to a target word
+    auto offset_to = [&](int target) {
+        if (halfword != nullptr) {
+            return (halfword->at(target) - halfword->at(source.word)) * 2;
+        }
+        return (target - source.word) * 4;
+    };
+
+    auto join = [](const std::string& op, const std::vector<std::string>& args) {
+        std::string text = op;
+        for (size_t i = 0; i < args.size(); i++) {
+            text += (i == 0 ? " " : ", ") + args[i];
+        }
+        return text;
+    };
+
+    if (op == "beq" || op == "bne" || op == "blt" || op == "bge" || op == "bltu" || op == "bgeu") {
+        if (args.size() >= 3 && !is_number(args[2])) {
+            int target = 0;
+            if (!lookup(args[2], "R_BRANCH", target)) return false;
+            args[2] = std::to_string(offset_to(target));
+            relocations.back().value = std::stoi(args[2]);
+        }
+    } else if (op == "li") {
+        // li rd, imm: the shortest of addi, lui or lui + addi
+        if (args.size() != 2) {
+            errors() << "Error: line " << source.line_number << ": li expects 2 operands" << std::endl;
+            return false;
+        }
+        int value = 0;
+        if (is_number(args[1])) {
+            value = parse_constant(args[1]);
+        } else {
+            const Symbol* symbol = find_symbol(symbols, args[1], source.overlay);
+            value = symbol != nullptr ? symbol->word : 0;
+        }
+        if (value >= -2048 && value <= 2047) {
+            expanded.push_back("addi " + args[0] + ", x0, " + std::to_string(value));
+        } else {
+            auto [upper, lower] = split_constant(value);
+            expanded.push_back("lui " + args[0] + ", " + std::to_string(upper));
+            if (lower != 0) {
+                expanded.push_back("addi " + args[0] + ", " + args[0] + ", " + std::to_string(lower));
+            }
+        }
+        return true;
+    } else if (op == "mv") {
+        if (args.size() != 2) {
+            errors() << "Error: line " << source.line_number << ": mv expects 2 operands" << std::endl;
+            return false;
+        }
+        expanded.push_back("addi " + args[0] + ", " + args[1] + ", 0");
+        return true;
+    } else if (op == "j" || op == "call") {
+        // j target: jal x0; call target: jal through the PE return link x26
+        if (args.size() != 1) {
+            errors() << "Error: line " << source.line_number << ": " << op << " expects 1 operand" << std::endl;
+            return false;
+        }
+        SourceLine jump = source;
+        jump.text = std::string("jal ") + (op == "j" ? "x0" : "x26") + ", " + args[0];
+        return resolve_line(jump, symbols, expanded, relocations, halfword);
+    } else if (op == "jal") {
+        if (args.size() == 1) {
+            args.insert(args.begin(), "x1");  // jal <target> links through ra
+        }
+        if (args.size() >= 2 && !is_number(args[1])) {
+            int target = 0;
+            if (!lookup(args[1], "R_JAL", target)) return false;
+            args[1] = std::to_string(offset_to(target));
+            relocations.back().value = std::stoi(args[1]);
+        }
+    } else if (op == "hwlrf.li") {
+        // hwlrf.li Ln, pc_start, pc_stop, hwl_index, iterations
+        if (args.size() != 5) {
+            errors() << "Error: line " << source.line_number << ": hwlrf.li expects 5 operands" << std::endl;
+            return false;
+        }
+        int pc_start = 0, pc_stop = 0;
+        if (is_number(args[1])) {
+            pc_start = std::stoi(args[1]);
+        } else if (!lookup(args[1], "R_HWL_START", pc_start)) {
+            return false;
+        }
+        if (is_number(args[2])) {
+            pc_stop = std::stoi(args[2]);
+        } else if (!lookup(args[2], "R_HWL_STOP", pc_stop)) {
+            return false;
+        }
+        if (pc_start < 0 || pc_start > 0x1FF || pc_stop < pc_start || pc_stop - pc_start > 0x3F) {
+            errors() << "Error: line " << source.line_number << ": hardware loop " << pc_start << ".."
+                      << pc_stop << " does not fit the hwlrf pc fields" << std::endl;
+            return false;
+        }
+        auto [upper, lower] = hwl_immediate(pc_start, pc_stop, std::stoi(args[3]), std::stoi(args[4]));
+        expanded.push_back("hwlrf.lui " + args[0] + ", " + std::to_string(upper));
+        expanded.push_back("hwlrf.addi " + args[0] + ", " + args[0] + ", " + std::to_string(lower));
+        return true;
+    }
+
+    expanded.push_back(join(op, args));
+    return true;
+}
+
+// Register number of an x-register name, or -1
+int RISC_V_Assembler::register_number(const std::string& name) {
+    auto it = registers.find(name);
+    return it == registers.end() ? -1 : it->second;
+}
+
+// Split "offset(base)" into its parts
+bool RISC_V_Assembler::split_memory_operand(const std::string& operand, int& offset, std::string& base) {
+    size_t open_paren = operand.find('(');
+    size_t close_paren = operand.find(')', open_paren);
+    if (open_paren == std::string::npos || close_paren == std::string::npos) return false;
+    std::string offset_str = trim_string(operand.substr(0, open_paren));
+    offset = offset_str.empty() ? 0 : std::stoi(offset_str);
+    base = trim_string(operand.substr(open_paren + 1, close_paren - open_paren - 1));
+    return true;
+}
+
+// Encode a resolved base instruction as a 16-bit RVC instruction if its operands fit
+bool RISC_V_Assembler::compress_instruction(const std::string& text, uint16_t& encoded, std::string* name) {
+    std::string unused;
+    std::string& mnemonic = name != nullptr ? *name : unused;
+    std::istringstream iss(text);
+    std::string op, args_str;
+    iss >> op;
+    std::getline(iss, args_str);
+    std::vector<std::string> args = split_arguments(trim_string(args_str));
+    auto bits = [](int value, int hi, int lo) { return (static_cast<uint32_t>(value) >> lo) & ((1u << (hi - lo + 1)) - 1); };
+    auto is_compact = [](int reg) { return reg >= 8 && reg <= 15; };
+
+    if ((op == "nop" || op == "ret") && args.empty()) {
+        mnemonic = "c.nop";
+        encoded = 0x0001;  // c.nop
+        return true;
+    }
+    if (op == "addi" && args.size() == 3 && is_number(args[2])) {
+        int rd = register_number(args[0]), rs1 = register_number(args[1]);
+        int imm = std::stoi(args[2]);
+        if (rd < 0 || rs1 < 0) return false;
+        if (rd == 0 && rs1 == 0 && imm == 0) {
+            mnemonic = "c.nop";
+            encoded = 0x0001;  // c.nop
+            return true;
+        }
+        if (rd != 0 && imm == 0 && rs1 != 0) {
+            mnemonic = "c.mv";
+            encoded = static_cast<uint16_t>((0x8 << 12) | (rd << 7) | (rs1 << 2) | 0x2);  // c.mv
+            return true;
+        }
+        if (rd != 0 && imm >= -32 && imm <= 31 && (rs1 == 0 || (rs1 == rd && imm != 0))) {
+            uint32_t funct3 = (rs1 == 0) ? 0x2 : 0x0;  // c.li : c.addi
+            mnemonic = (rs1 == 0) ? "c.li" : "c.addi";
+            encoded = static_cast<uint16_t>((funct3 << 13) | (bits(imm, 5, 5) << 12) | (rd << 7) |
+                                            (bits(imm, 4, 0) << 2) | 0x1);
+            return true;
+        }
+        return false;
+    }
+    if (op == "add" && args.size() == 3) {
+        int rd = register_number(args[0]), rs1 = register_number(args[1]), rs2 = register_number(args[2]);
+        if (rd <= 0 || rs1 < 0 || rs2 < 0) return false;
+        int other = (rd == rs1) ? rs2 : (rd == rs2) ? rs1 : -1;
+        if (other > 0) {
+            mnemonic = "c.add";
+            encoded = static_cast<uint16_t>((0x9 << 12) | (rd << 7) | (other << 2) | 0x2);  // c.add
+            return true;
+        }
+        if (rs1 == 0 && rs2 != 0) {
+            mnemonic = "c.mv";
+            encoded = static_cast<uint16_t>((0x8 << 12) | (rd << 7) | (rs2 << 2) | 0x2);  // c.mv
+            return true;
+        }
+        return false;
+    }
+    if ((op == "lw" || op == "sw") && args.size() == 2) {
+        int reg = register_number(args[0]);
+        int offset = 0;
+        std::string base_name;
+        if (reg < 0 || !split_memory_operand(args[1], offset, base_name)) return false;
+        int base = register_number(base_name);
+        if (offset < 0 || offset % 4 != 0) return false;
+        if (base == 2 && offset <= 252 && (op == "sw" || reg != 0)) {
+            mnemonic = (op == "lw") ? "c.lwsp" : "c.swsp";
+            if (op == "lw") {  // c.lwsp
+                encoded = static_cast<uint16_t>((0x2 << 13) | (bits(offset, 5, 5) << 12) | (reg << 7) |
+                                                (bits(offset, 4, 2) << 4) | (bits(offset, 7, 6) << 2) | 0x2);
+            } else {           // c.swsp
+                encoded = static_cast<uint16_t>((0x6 << 13) | (bits(offset, 5, 2) << 9) | (bits(offset, 7, 6) << 7) |
+                                                (reg << 2) | 0x2);
             }
+            return true;
+        }
+        if (is_compact(base) && is_compact(reg) && offset <= 124) {
+            uint32_t funct3 = (op == "lw") ? 0x2 : 0x6;  // c.lw : c.sw
+            mnemonic = "c." + op;
+            encoded = static_cast<uint16_t>((funct3 << 13) | (bits(offset, 5, 3) << 10) | ((base - 8) << 7) |
+                                            (bits(offset, 2, 2) << 6) | (bits(offset, 6, 6) << 5) |
+                                            ((reg - 8) << 2) | 0x0);
+            return true;
+        }
+        return false;
+    }
+    if (op == "jal" && args.size() == 2 && args[0] == "x0" && is_number(args[1])) {
+        int offset = std::stoi(args[1]);
+        if (offset % 2 != 0 || offset < -2048 || offset > 2046) return false;
+        mnemonic = "c.j";
+        encoded = static_cast<uint16_t>((0x5 << 13) | (bits(offset, 11, 11) << 12) | (bits(offset, 4, 4) << 11) |
+                                        (bits(offset, 9, 8) << 9) | (bits(offset, 10, 10) << 8) |
+                                        (bits(offset, 6, 6) << 7) | (bits(offset, 7, 7) << 6) |
+                                        (bits(offset, 3, 1) << 3) | (bits(offset, 5, 5) << 2) | 0x1);  // c.j
+        return true;
+    }
+    return false;
+}
+
+// Check whether a group of source lines can be laid out as a mixed 16/32-bit stream.
+// Every 32-bit instruction must keep opcode bits [1:0] = 11 so the decoder can tell the
+// sizes apart, and every pc-dependent operand must be symbolic so it can be relocated.
+bool RISC_V_Assembler::rvc_compatible(const std::vector<SourceLine>& group,
+                                      const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                                      std::string& reason) {
+    for (const auto& source : group) {
+        std::istringstream iss(source.text);
+        std::string op, args_str;
+        iss >> op;
+        std::getline(iss, args_str);
+        std::vector<std::string> args = split_arguments(trim_string(args_str));
+        std::string base_op = (op == "hwlrf.li") ? "hwlrf.lui" : op;
+        auto it = instructions.find(base_op);
+        if (it != instructions.end() && it->second.substr(5) != "11" && base_op != "ret") {
+            reason = op + " has a non-RVC-safe opcode";
+            return false;
+        }
+        std::vector<std::string> targets;
+        if ((op == "jal" || op == "beq" || op == "bne" || op == "blt" || op == "bge" ||
+             op == "bltu" || op == "bgeu") && !args.empty()) {
+            targets.push_back(args.back());
+        } else if ((op == "j" || op == "call") && !args.empty()) {
+            targets.push_back(args[0]);
         }
-        // Handle R-type instructions
-        else if (op == "add" || op == "sub" || op == "sll" || op == "slt" || op == "sltu" || 
-                op == "xor" || op == "srl" || op == "sra" || op == "or" || op == "and" ||
-                op == "mul" || op == "slli" || op == "srli" || op == "srai") {
-            if (args.size() >= 3) {
-                result.binary = assemble_r_type(op, args[0], args[1], args[2]);
+        for (const auto& target : targets) {
+            const Symbol* symbol = is_number(target) ? nullptr : find_symbol(symbols, target, source.overlay);
+            if (symbol == nullptr || symbol->absolute || symbol->is_execution != source.is_execution ||
+                symbol->overlay != source.overlay) {
+                reason = op + " at line " + std::to_string(source.line_number) + " has a fixed offset";
+                return false;
             }
         }
-        // Handle I-type instructions
-        else if (op == "addi" || op == "slti" || op == "sltiu" || op == "xori" || op == "ori" || 
-                op == "andi"  || op == "jalr") {
-            if (args.size() >= 3) {
-                result.binary = assemble_i_type(op, args[0], args[1], std::stoi(args[2]));
+    }
+    return true;
+}
+
+// Lay out a group as a mixed 16/32-bit stream. Sizes start optimistic (16-bit) and
+// only grow, so the relaxation converges; the stream is packed into 32-bit words.
+bool RISC_V_Assembler::assemble_rvc_group(const std::vector<SourceLine>& group,
+                                          const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                                          std::vector<AssembledInstruction>& packed, std::vector<Relocation>& relocations) {
+    // Word range of the group as placed by the first pass
+    int first_word = group.front().word;
+    int end_word = first_word;
+    for (const auto& source : group) {
+        std::vector<std::string> expanded;
+        std::vector<Relocation> unused;
+        if (!resolve_line(source, symbols, expanded, unused)) return false;
+        end_word = source.word + static_cast<int>(expanded.size());
+    }
+    std::vector<int> size(end_word - first_word, 1);  // halfwords per pass-1 word
+
+    std::vector<std::pair<std::string, bool>> stream;  // resolved text, compressed
+    std::vector<Relocation> group_relocations;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::map<int, int> halfword;
+        int position = first_word * 2;
+        for (int w = first_word; w <= end_word; w++) {
+            halfword[w] = position;
+            if (w < end_word) position += size[w - first_word];
+        }
+
+        stream.clear();
+        group_relocations.clear();
+        for (const auto& source : group) {
+            std::vector<std::string> expanded;
+            if (!resolve_line(source, symbols, expanded, group_relocations, &halfword)) return false;
+            for (size_t k = 0; k < expanded.size(); k++) {
+                uint16_t encoded = 0;
+                int& slot = size[source.word + static_cast<int>(k) - first_word];
+                if (slot == 1 && !compress_instruction(expanded[k], encoded)) {
+                    slot = 2;
+                    changed = true;
+                }
+                stream.push_back({expanded[k], slot == 1});
             }
         }
-        // Handle S-type instructions
-        else if (op == "sb" || op == "sh" || op == "sw") {
+    }
+    // Relocations are placed at the halfword position of their instruction
+    for (auto& relocation : group_relocations) {
+        int position = first_word * 2;
+        for (int w = first_word; w < relocation.word; w++) position += size[w - first_word];
+        relocation.word = position;
+    }
+    relocations.insert(relocations.end(), group_relocations.begin(), group_relocations.end());
+
+    // Emit the halfword stream, then pack it little-endian into 32-bit memory words
+    std::vector<std::pair<uint16_t, std::string>> halfwords;
+    for (const auto& [text, compressed] : stream) {
+        std::string op = text.substr(0, text.find(' '));
+        std::string mnemonic;
+        uint16_t encoded = 0;
+        if (compressed && compress_instruction(text, encoded, &mnemonic)) {
+            halfwords.push_back({encoded, mnemonic});
+        } else {
+            uint32_t word = parse_instruction(text).word;
+            halfwords.push_back({static_cast<uint16_t>(word & 0xFFFF), op});
+            halfwords.push_back({static_cast<uint16_t>(word >> 16), ""});
+        }
+    }
+    if (halfwords.size() % 2 == 1) {
+        halfwords.push_back({0x0001, "c.nop"});  // pad the final memory word
+    }
+    for (size_t h = 0; h < halfwords.size(); h += 2) {
+        uint32_t word = halfwords[h].first | (static_cast<uint32_t>(halfwords[h + 1].first) << 16);
+        AssembledInstruction instr;
+        instr.op = halfwords[h].second.empty() ? "(cont)" : halfwords[h].second;
+        if (!halfwords[h + 1].second.empty()) instr.op += "+" + halfwords[h + 1].second;
+        instr.word = word;
+        instr.hex = to_hex(word);
+        instr.is_execution = group.front().is_execution;
+        instr.overlay = group.front().overlay;
+        packed.push_back(instr);
+    }
+    return true;
+}
+
+// Build the decode tables from the encoder's opcode/funct3/funct7 tables
+void RISC_V_Assembler::build_decode_tables() {
+    for (const auto& [name, opcode_bits] : instructions) {
+        if (name == "ret") continue;  // encoded as addi x0, x0, 0
+        uint32_t opcode = std::stoul(opcode_bits, nullptr, 2);
+        auto f3 = funct3.find(name);
+        auto f7 = funct7.find(name);
+        if (f3 == funct3.end()) {
+            decode_u[opcode] = name;
+        } else if (f7 == funct7.end()) {
+            decode_i[opcode | (std::stoul(f3->second, nullptr, 2) << 7)] = name;
+        } else {
+            decode_r[opcode | (std::stoul(f3->second, nullptr, 2) << 7) |
+                     (std::stoul(f7->second, nullptr, 2) << 10)] = name;
+        }
+    }
+}
+
+// Write the relocation records of one assembled file
+void RISC_V_Assembler::write_relocations(const std::string& path, const std::string& input_file,
+                                         const std::vector<Relocation>& relocations) {
+    std::ofstream reloc_file(path);
+    reloc_file << "# Relocations for " << input_file << std::endl;
+    reloc_file << "# section overlay word type symbol value" << std::endl;
+    for (const auto& reloc : relocations) {
+        reloc_file << (reloc.is_execution ? "exec" : "preload") << " " << reloc.overlay << " "
+                   << reloc.word << " " << reloc.type << " " << reloc.symbol << " " << reloc.value << std::endl;
+    }
+}
+
+RISC_V_Assembler::RISC_V_Assembler() {
+    // Initialize registers
+    for (int i = 0; i < 32; i++) {
+        registers["x" + std::to_string(i)] = i;
+        registers_c["c" + std::to_string(i)] = i;  // c0-c31 map to register numbers 0-31
+        registers_p["v" + std::to_string(i)] = i;  // v0-v31 map to register numbers 0-31
+    }
+
+    // Initialize hardware loop registers (L1-L7)
+    for (int i = 1; i <= 7; i++) {
+        hwl_registers["L" + std::to_string(i)] = i;
+    }
+
+    // Initialize instructions with their opcodes
+    instructions = {
+        {"lb", "0000011"}, {"lh", "0000011"}, {"lw", "0000011"}, 
+        {"lbu", "0000011"}, {"lhu", "0000011"},
+
+        {"addi", "0010011"}, {"slli", "0010011"}, {"slti", "0010011"}, {"sltiu", "0010011"},
+        {"xori", "0010011"}, {"srli", "0010011"}, {"srai", "0010011"}, {"ori", "0010011"}, 
+        {"andi", "0010011"}, {"auipc", "0010111"}, 
+
+        {"sb", "0100011"}, {"sh", "0100011"}, {"sw", "0100011"},
+
+        {"add", "0110011"}, {"sub", "0110011"}, {"sll", "0110011"}, {"slt", "0110011"},
+        {"sltu", "0110011"}, {"xor", "0110011"}, {"srl", "0110011"}, {"sra", "0110011"},
+        {"or", "0110011"}, {"and", "0110011"}, {"mul", "0110011"}, {"lui", "0110111"}, 
+         
+        {"beq", "1100011"}, {"bne", "1100011"}, {"blt", "1100011"}, 
+        {"bge", "1100011"}, {"bltu", "1100011"}, {"bgeu", "1100011"},
+
+        {"jalr", "1100111"}, {"jal", "1101111"},
+
+        {"psrf.lw", "0000100"}, {"psrf.sw", "0100100"},
+        {"psrf.lb", "0000100"}, {"psrf.sb", "0100100"},
+        {"psrf.zd.lw", "0000100"}, 
+        {"ppsrf.addi", "0010100"}, // opcode 0x14 for ppsrf.addi
+        {"corf.addi", "0010100"}, // opcode 0x14 for corf.addi
+        {"corf.lui", "0111011"}, // opcode 0x3B for corf.lui
+        {"hwlrf.lui", "0111100"}, // Updated to 0x3C
+        {"hwlrf.addi", "0010100"}, // Updated to 0x14
+        {"ret", "0000000"},
+    };
+
+    // Initialize function 3 values for I-type instructions
+    funct3 = {
+        {"lb", "000"}, {"lh", "001"}, {"lw", "010"}, 
+        {"lbu", "100"}, {"lhu", "101"},
+
+        {"addi", "000"}, {"slli", "001"}, {"slti", "010"}, {"sltiu", "011"},
+        {"xori", "100"}, {"srli", "101"}, {"srai", "101"}, {"ori", "110"}, 
+        {"andi", "111"}, 
+
+        {"sb", "000"}, {"sh", "001"}, {"sw", "010"},
+
+        {"add", "000"}, {"sub", "000"}, {"sll", "001"}, {"slt", "010"},
+        {"sltu", "011"}, {"xor", "100"}, {"srl", "101"}, {"sra", "101"},
+        {"or", "110"}, {"and", "111"}, {"mul", "000"}, 
+         
+        {"beq", "000"}, {"bne", "001"}, {"blt", "100"}, 
+        {"bge", "101"}, {"bltu", "110"}, {"bgeu", "111"},
+
+        {"jalr", "000"}, 
+
+        {"psrf.lw", "111"}, {"psrf.lb", "000"}, {"mul", "000"},
+        {"psrf.zd.lw", "110"}, 
+        {"psrf.sw", "100"}, {"psrf.sb", "000"}, 
+        {"ppsrf.addi", "001"}, // func3=1 for ppsrf.addi
+        {"corf.addi", "000"},  // func3=0 for corf.addi
+        {"hwlrf.addi", "010"}, // Updated to func3=2
+    };
+
+    // Initialize funct7
+    funct7 = {
+        {"slli", "0000000"}, {"srli", "0000000"}, {"srai", "0100000"},
+        {"add", "0000000"}, {"sub", "0100000"}, {"sll", "0000000"}, {"slt", "0000000"},
+        {"sltu", "0000000"}, {"xor", "0000000"}, {"srl", "0000000"}, {"sra", "0100000"},
+        {"or", "0000000"}, {"and", "0000000"}, {"mul", "0000001"}, 
+    };
+
+    build_decode_tables();
+}
+
+void RISC_V_Assembler::set_imem_capacity(int execution_words, int preload_words) {
+    imem_execution_words = execution_words;
+    imem_preload_words = preload_words;
+}
+
+void RISC_V_Assembler::set_mem_format(const MemFormat& format) {
+    mem_format = format;
+}
+
+void RISC_V_Assembler::set_rvc(bool enabled) {
+    rvc_enabled = enabled;
+}
+
+// Send progress messages and errors somewhere other than stdout/stderr
+void RISC_V_Assembler::set_log(std::ostream& out, std::ostream& err) {
+    log_stream = &out;
+    error_stream = &err;
+}
+
+const std::map<int, std::pair<int, int>>& RISC_V_Assembler::get_rvc_sizes() const {
+    return rvc_sizes;
+}
+
+// Decode one 32-bit instruction word to assembler syntax; empty if it is not a known encoding
+std::string RISC_V_Assembler::disassemble_word(uint32_t word) const {
+    uint32_t opcode = word & 0x7F;
+    uint32_t f3 = (word >> 12) & 0x7;
+    uint32_t f7 = word >> 25;
+    int rd = (word >> 7) & 0x1F, rs1 = (word >> 15) & 0x1F, rs2 = (word >> 20) & 0x1F;
+    int imm_i = static_cast<int32_t>(word) >> 20;
+    int imm_s = ((static_cast<int32_t>(word) >> 25) << 5) | rd;
+    int imm_b = ((static_cast<int32_t>(word) >> 31) << 12) | (((word >> 7) & 0x1) << 11) |
+                (((word >> 25) & 0x3F) << 5) | (((word >> 8) & 0xF) << 1);
+    int imm_j = ((static_cast<int32_t>(word) >> 31) << 20) | (((word >> 12) & 0xFF) << 12) |
+                (((word >> 20) & 0x1) << 11) | (((word >> 21) & 0x3FF) << 1);
+    uint32_t imm_u = word >> 12;
+    auto x = [](int reg) { return "x" + std::to_string(reg); };
+
+    std::string name;
+    auto r = decode_r.find(opcode | (f3 << 7) | (f7 << 10));
+    auto i = decode_i.find(opcode | (f3 << 7));
+    auto u = decode_u.find(opcode);
+    if (r != decode_r.end()) {
+        name = r->second;
+    } else if (i != decode_i.end()) {
+        name = i->second;
+    } else if (u != decode_u.end()) {
+        name = u->second;
+    } else {
+        return "";
+    }
+
+    std::ostringstream out;
+    out << name << " ";
+    if (name == "slli" || name == "srli" || name == "srai") {
+        out << x(rd) << ", " << x(rs1) << ", " << rs2;
+    } else if (funct7.count(name) > 0) {
+        out << x(rd) << ", " << x(rs1) << ", " << x(rs2);
+    } else if (name == "addi" && word == 0x00000013) {
+        return "nop";
+    } else if (name == "lb" || name == "lh" || name == "lw" || name == "lbu" || name == "lhu" ||
+               name == "psrf.lw" || name == "psrf.lb" || name == "psrf.zd.lw" ||
+               name == "psrf.sw" || name == "psrf.sb") {
+        // psrf stores keep the data register in the rd field and the full offset in imm[11:0]
+        out << x(rd) << ", " << imm_i << "(" << x(rs1) << ")";
+    } else if (name == "sb" || name == "sh" || name == "sw") {
+        out << x(rs2) << ", " << imm_s << "(" << x(rs1) << ")";
+    } else if (name == "beq" || name == "bne" || name == "blt" || name == "bge" ||
+               name == "bltu" || name == "bgeu") {
+        out << x(rs1) << ", " << x(rs2) << ", " << imm_b;
+    } else if (name == "jal") {
+        out << x(rd) << ", " << imm_j;
+    } else if (name == "lui" || name == "auipc") {
+        out << x(rd) << ", " << imm_u;
+    } else if (name == "corf.lui") {
+        out << "c" << rd << ", " << imm_u;
+    } else if (name == "hwlrf.lui") {
+        if (rd < 1 || rd > 7) return "";
+        out << "L" << rd << ", " << imm_u;
+    } else if (name == "hwlrf.addi") {
+        if (rd < 1 || rd > 7 || rs1 < 1 || rs1 > 7) return "";
+        out << "L" << rd << ", L" << rs1 << ", " << imm_i;
+    } else if (name == "corf.addi") {
+        out << "c" << rd << ", c" << rs1 << ", " << imm_i;
+    } else if (name == "ppsrf.addi") {
+        out << "v" << rd << ", v" << rs1 << ", " << imm_i;
+    } else {
+        out << x(rd) << ", " << x(rs1) << ", " << imm_i;
+    }
+    return out.str();
+}
+
+// Disassemble memory images ("@address word" entries, one list per overlay phase) back to
+// source the assembler accepts. Preload and execution sections and the cluster library
+// region are recovered from the address bits.
+bool RISC_V_Assembler::disassemble_image(const std::map<int, std::vector<MemWord>>& phases, std::ostream& out) const {
+    for (const auto& [phase, words] : phases) {
+        bool in_execution = false;
+        for (const auto& [address, word] : words) {
+            bool is_execution = (address & (1 << 9)) == 0;
+            if (is_execution && !in_execution) {
+                in_execution = true;
+                if ((address & ~LIBRARY_REGION_MASK) != 0 && phase == 0) {
+                    out << ".library " << ((address >> 10) & 0xFF) << " " << (address & 0x1FF) << " 0x" << std::hex
+                        << (address & ~LIBRARY_REGION_MASK) << std::dec << std::endl;
+                }
+                out << "# ========== Execution Section Begin ==========" << std::endl;
+                if (phase != 0) out << ".overlay " << phase << std::endl;
+            }
+            std::string text = disassemble_word(word);
+            if (text.empty()) {
+                errors() << "Error: cannot decode word 0x" << std::hex << std::setw(8) << std::setfill('0')
+                          << word << " at @" << std::setw(8) << address << std::dec << std::setfill(' ') << std::endl;
+                return false;
+            }
+            out << "    " << text << std::endl;
+        }
+    }
+    return true;
+}
+
+std::string RISC_V_Assembler::to_binary(int num, int length) {
+    if (num < 0) {
+        num = (1 << length) + num;
+    }
+    std::stringstream ss;
+    ss << std::setfill('0') << std::setw(length) << std::bitset<32>(num).to_string().substr(32 - length);
+    return ss.str();
+}
+
+std::string RISC_V_Assembler::to_hex(uint32_t word) {
+    std::string hex(8, '0');
+    format_hex8(word, &hex[0]);
+    return hex;
+}
+
+std::string RISC_V_Assembler::assemble_r_type(const std::string& instruction, const std::string& rd, 
+                                             const std::string& rs1, const std::string& rs2) {
+    std::string opcode = instructions[instruction];
+    std::string func3 = funct3[instruction];
+    std::string func7 = funct7[instruction];
+    std::string rd_bin = to_binary(registers[rd], 5);
+    std::string rs1_bin = to_binary(registers[rs1], 5);
+    std::string rs2_bin = "";
+    if (instruction == "slli" || instruction == "srli" || instruction == "srai") {
+        int imm = std::stoi(rs2);
+        std::string rs2_bin = to_binary(imm, 5); 
+        return func7 + rs2_bin + rs1_bin + func3 + rd_bin + opcode;
+
+    } else {
+        std::string rs2_bin = to_binary(registers[rs2], 5);
+        return func7 + rs2_bin + rs1_bin + func3 + rd_bin + opcode;
+    }
+}
+
+std::string RISC_V_Assembler::assemble_i_type(const std::string& instruction, const std::string& rd, 
+                                             const std::string& rs1, int imm) {
+    std::string opcode = instructions[instruction];
+    std::string func3 = funct3[instruction];
+    std::string rd_bin = to_binary(registers[rd], 5);
+    std::string rs1_bin = to_binary(registers[rs1], 5);
+    std::string imm_bin = to_binary(imm, 12);
+    log() << "instruction: " << instruction << std::endl;
+    log() << "opcode: " << opcode << std::endl; 
+    log() << "rd: " << rd << std::endl; 
+    log() << "rs1: " << rs1 << std::endl;
+    log() << "imm: " << imm << std::endl;
+    log() << "imm_bin: " << imm_bin << std::endl;
+    log() << "rs1_bin: " << rs1_bin << std::endl;
+    log() << "func3: " << func3 << std::endl;
+    log() << "rd_bin: " << rd_bin << std::endl;
+    log() << "opcode: " << opcode << std::endl;
+    log() << "imm_bin + rs1_bin + func3 + rd_bin + opcode: " << imm_bin + rs1_bin + func3 + rd_bin + opcode << std::endl;   
+    return imm_bin + rs1_bin + func3 + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_s_type(const std::string& instruction, const std::string& rs1, 
+                                             const std::string& rs2, int imm) {
+    std::string opcode = instructions[instruction];
+    std::string func3 = funct3[instruction];
+    std::string rs1_bin = to_binary(registers[rs1], 5);
+    std::string rs2_bin = to_binary(registers[rs2], 5);
+    std::string imm_bin = to_binary(imm, 12);
+    std::string imm_high = imm_bin.substr(0, 7);
+    std::string imm_low = imm_bin.substr(7, 5);
+    return imm_high + rs2_bin + rs1_bin + func3 + imm_low + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_b_type(const std::string& instruction, const std::string& rs1, 
+                                             const std::string& rs2, int imm) {
+    std::string opcode = instructions[instruction];
+    std::string func3 = funct3[instruction];
+    std::string rs1_bin = to_binary(registers[rs1], 5);
+    std::string rs2_bin = to_binary(registers[rs2], 5);
+    std::string imm_bin = to_binary(imm, 13);
+    std::string imm_12 = imm_bin.substr(0, 1);
+    std::string imm_10_5 = imm_bin.substr(2, 6);
+    std::string imm_4_1 = imm_bin.substr(8, 4);
+    std::string imm_11 = imm_bin.substr(1, 1);
+    return imm_12 + imm_10_5 + rs2_bin + rs1_bin + func3 + imm_4_1 + imm_11 + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_psrf_lw_sw(const std::string& instruction, const std::string& rd, 
+                                                 const std::string& rs1, int imm) {
+    std::string opcode = instructions[instruction];
+    std::string func3 = funct3[instruction];
+    std::string rd_bin = to_binary(registers[rd], 5);
+    std::string rs1_bin = to_binary(registers[rs1], 5);
+    std::string imm_bin = to_binary(imm, 12);
+    log() << "instruction: " << instruction << std::endl;
+    log() << "func3: " << func3 << std::endl;
+    log() << "opcode: " << opcode << std::endl; 
+    log() << "rd: " << rd << std::endl; 
+    log() << "rs1: " << rs1 << std::endl;
+    log() << "imm: " << imm << std::endl;
+    return imm_bin + rs1_bin + func3 + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_u_type(const std::string& instruction, const std::string& rd, int imm) {
+    std::string opcode = instructions[instruction];
+    std::string rd_bin = to_binary(registers[rd], 5);
+    std::string imm_bin = to_binary(imm, 20);
+    return imm_bin + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_lui(const std::string& op, const std::string& rd, int imm) {
+    std::string opcode = instructions[op];
+    std::string rd_bin = to_binary(registers[rd], 5);
+    std::string imm_bin = to_binary(imm & 0xFFFFF, 20); // Upper 20 bits of immediate
+    return imm_bin + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_corf_lui(const std::string& op, const std::string& rd, int imm) {
+    std::string opcode = instructions[op];
+    std::string rd_bin = to_binary(registers_c[rd], 5);
+    std::string imm_bin = to_binary(imm & 0xFFFFF, 20); // Upper 20 bits of immediate
+    return imm_bin + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_corf_addi(const std::string& op, const std::string& rd, const std::string& rs1, int imm) {
+    std::string opcode = instructions[op];
+    std::string func3 = funct3[op]; // This should be "000"
+    std::string rd_bin = to_binary(registers_c[rd], 5);  // Use registers_c for c-registers
+    std::string rs1_bin = to_binary(registers_c[rs1], 5); // Use registers_c for c-registers
+    std::string imm_bin = to_binary(imm, 12);
+    return imm_bin + rs1_bin + func3 + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_ppsrf_addi(const std::string& op, const std::string& rd, const std::string& rs1, int imm) {
+    log() << "op: " << op << std::endl; 
+    log() << "rd: " << rd << std::endl;
+    log() << "rs1: " << rs1 << std::endl;
+    log() << "imm: " << imm << std::endl;
+    std::string opcode = instructions[op];
+    std::string func3 = funct3[op]; // This should be "001"
+    std::string rd_bin = to_binary(registers_p[rd], 5);  // Use registers_p for v-registers
+    std::string rs1_bin = to_binary(registers_p[rs1], 5); // Use registers_p for v-registers
+    std::string imm_bin = to_binary(imm, 12);
+    return imm_bin + rs1_bin + func3 + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_hwlrf_lui(const std::string& rd, int imm) {
+    std::string opcode = instructions["hwlrf.lui"];
+    std::string rd_bin = to_binary(hwl_registers[rd], 5);
+    std::string imm_bin = to_binary(imm, 20);
+    return imm_bin + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_hwlrf_addi(const std::string& rd, const std::string& rs1, int imm) {
+    std::string opcode = instructions["hwlrf.addi"];
+    std::string func3 = funct3["hwlrf.addi"];
+    std::string rd_bin = to_binary(hwl_registers[rd], 5);
+    std::string rs1_bin = to_binary(hwl_registers[rs1], 5);
+    std::string imm_bin = to_binary(imm, 12);
+    return imm_bin + rs1_bin + func3 + rd_bin + opcode;
+}
+
+std::string RISC_V_Assembler::assemble_j_type(const std::string& rd, int imm) {
+    std::string opcode = instructions["jal"];
+    std::string rd_bin = to_binary(registers[rd], 5);
+    
+    // J-type immediate format: [20|10:1|11|19:12]
+    std::string imm_bin = to_binary(imm, 21);
+    std::string imm_20 = imm_bin.substr(0, 1);
+    std::string imm_10_1 = imm_bin.substr(10, 10);
+    std::string imm_11 = imm_bin.substr(9, 1);
+    std::string imm_19_12 = imm_bin.substr(1, 8);
+    
+    return imm_20 + imm_10_1 + imm_11 + imm_19_12 + rd_bin + opcode;
+}
+
+// Parse a single assembly instruction line
+AssembledInstruction RISC_V_Assembler::parse_instruction(const std::string& line) {
+    AssembledInstruction result;
+    
+    // Split the line into tokens (opcode and arguments)
+    std::istringstream iss(line);
+    std::string op, args_str;
+    iss >> op; // Extract opcode
+    
+    std::getline(iss, args_str); // Get the rest
+    args_str = trim_string(args_str);
+    
+    // Store original operation
+    result.op = op;
+    
+    // Parse arguments
+    std::vector<std::string> args = split_arguments(args_str);
+
+    // Handle HWLRF instructions
+    if (op == "hwlrf.lui") {
+        if (args.size() >= 2) {
+            result.binary = assemble_hwlrf_lui(args[0], std::stoi(args[1]));
+        }
+    }
+    else if (op == "hwlrf.addi") {
+        if (args.size() >= 3) {
+            result.binary = assemble_hwlrf_addi(args[0], args[1], std::stoi(args[2]));
+        }
+    }
+    // Handle standard LUI and AUIPC instructions
+    else if (op == "lui" || op == "auipc") {
+        if (args.size() >= 2) {
+            result.binary = assemble_u_type(op, args[0], std::stoi(args[1]));
+        }
+    }
+    // Handle R-type instructions
+    else if (op == "add" || op == "sub" || op == "sll" || op == "slt" || op == "sltu" || 
+            op == "xor" || op == "srl" || op == "sra" || op == "or" || op == "and" ||
+            op == "mul" || op == "slli" || op == "srli" || op == "srai") {
+        if (args.size() >= 3) {
+            result.binary = assemble_r_type(op, args[0], args[1], args[2]);
+        }
+    }
+    // Handle I-type instructions
+    else if (op == "addi" || op == "slti" || op == "sltiu" || op == "xori" || op == "ori" || 
+            op == "andi"  || op == "jalr") {
+        if (args.size() >= 3) {
+            result.binary = assemble_i_type(op, args[0], args[1], std::stoi(args[2]));
+        }
+    }
+    // Handle loads (I-type with an offset(base) operand)
+    else if (op == "lb" || op == "lh" || op == "lw" || op == "lbu" || op == "lhu") {
+        int offset = 0;
+        std::string base_reg;
+        if (args.size() >= 2 && split_memory_operand(args[1], offset, base_reg)) {
+            result.binary = assemble_i_type(op, args[0], base_reg, offset);
+        }
+    }
+    // Handle S-type instructions
+    else if (op == "sb" || op == "sh" || op == "sw") {
+        if (args.size() >= 2) {
+            std::string rs2 = args[0];
+            std::string offset_base = args[1];
+            
+            // Parse offset and base register
+            size_t open_paren = offset_base.find('(');
+            size_t close_paren = offset_base.find(')', open_paren);
+            
+            if (open_paren != std::string::npos && close_paren != std::string::npos) {
+                std::string offset_str = trim_string(offset_base.substr(0, open_paren));
+                std::string base_reg = trim_string(offset_base.substr(open_paren + 1, close_paren - open_paren - 1));
+                
+                int offset = 0;
+                if (!offset_str.empty()) {
+                    offset = std::stoi(offset_str);
+                }
+                
+                result.binary = assemble_s_type(op, base_reg, rs2, offset);
+            }
+        }
+    }
+    // Handle B-type instructions
+    else if (op == "beq" || op == "bne" || op == "blt" || op == "bge" || 
+            op == "bltu" || op == "bgeu") {
+        if (args.size() >= 3) {
+            result.binary = assemble_b_type(op, args[0], args[1], std::stoi(args[2]));
+        }
+    }
+    // Handle J-type instructions
+    else if (op == "jal") {
+        if (args.size() >= 2) {
+            std::string rd = args[0];
+            int offset = std::stoi(args[1]);
+            result.binary = assemble_j_type(rd, offset);
+        }
+    }
+
+    // Handle PPSRF instructions
+    else if (op == "ppsrf.addi") {
+        log() << "ppsrf.addiop: " << op << std::endl;
+        if (args.size() >= 3) {
+            result.binary = assemble_ppsrf_addi(op, args[0], args[1], std::stoi(args[2]));
+        }
+    }
+    // Handle CORF instructions
+    else if (op == "corf.addi") {
+        if (args.size() >= 3) {
+            result.binary = assemble_corf_addi(op, args[0], args[1], std::stoi(args[2]));
+        }
+    }
+    else if (op == "corf.lui") {
+        if (args.size() >= 2) {
+            result.binary = assemble_corf_lui(op, args[0], std::stoi(args[1]));
+        }
+    }
+    // Handle special instructions
+    else if (op == "ret") {
+        // result.binary = assemble_i_type("jalr", "x0", "x1", 0);
+        result.binary = assemble_i_type("addi", "x0", "x0", 0);
+    }
+    else if (op == "nop") {
+        result.binary = assemble_i_type("addi", "x0", "x0", 0);
+    }
+    
+
+    // Handle PSRF instructions
+    else if (op.find("psrf.") != std::string::npos) {
+        if (op == "psrf.lw" || op == "psrf.lb" || op == "psrf.zd.lw") {
             if (args.size() >= 2) {
-                std::string rs2 = args[0];
+                std::string rd = args[0];
                 std::string offset_base = args[1];
                 
-                // Parse offset and base register
                 size_t open_paren = offset_base.find('(');
                 size_t close_paren = offset_base.find(')', open_paren);
                 
@@ -385,346 +1265,410 @@ public:
                         offset = std::stoi(offset_str);
                     }
                     
-                    result.binary = assemble_s_type(op, base_reg, rs2, offset);
+                    result.binary = assemble_psrf_lw_sw(op, rd, base_reg, offset);
                 }
             }
         }
-        // Handle B-type instructions
-        else if (op == "beq" || op == "bne" || op == "blt" || op == "bge" || 
-                op == "bltu" || op == "bgeu") {
-            if (args.size() >= 3) {
-                result.binary = assemble_b_type(op, args[0], args[1], std::stoi(args[2]));
-            }
-        }
-        // Handle J-type instructions
-        else if (op == "jal") {
+        else if (op == "psrf.sw" || op == "psrf.sb") {
             if (args.size() >= 2) {
-                std::string rd = args[0];
-                int offset = std::stoi(args[1]);
-                result.binary = assemble_j_type(rd, offset);
-            }
-        }
-
-        // Handle PPSRF instructions
-        else if (op == "ppsrf.addi") {
-            std::cout << "ppsrf.addiop: " << op << std::endl;
-            if (args.size() >= 3) {
-                result.binary = assemble_ppsrf_addi(op, args[0], args[1], std::stoi(args[2]));
-            }
-        }
-        // Handle CORF instructions
-        else if (op == "corf.addi") {
-            if (args.size() >= 3) {
-                result.binary = assemble_corf_addi(op, args[0], args[1], std::stoi(args[2]));
-            }
-        }
-        else if (op == "corf.lui") {
-            if (args.size() >= 2) {
-                result.binary = assemble_corf_lui(op, args[0], std::stoi(args[1]));
-            }
-        }
-        // Handle special instructions
-        else if (op == "ret") {
-            // result.binary = assemble_i_type("jalr", "x0", "x1", 0);
-            result.binary = assemble_i_type("addi", "x0", "x0", 0);
-        }
-        else if (op == "nop") {
-            result.binary = assemble_i_type("addi", "x0", "x0", 0);
-        }
-        
-
-        // Handle PSRF instructions
-        else if (op.find("psrf.") != std::string::npos) {
-            if (op == "psrf.lw" || op == "psrf.lb" || op == "psrf.zd.lw") {
-                if (args.size() >= 2) {
-                    std::string rd = args[0];
-                    std::string offset_base = args[1];
-                    
-                    size_t open_paren = offset_base.find('(');
-                    size_t close_paren = offset_base.find(')', open_paren);
+                std::string rs2 = args[0];
+                std::string offset_base = args[1];
+                
+                size_t open_paren = offset_base.find('(');
+                size_t close_paren = offset_base.find(')', open_paren);
+                
+                if (open_paren != std::string::npos && close_paren != std::string::npos) {
+                    std::string offset_str = trim_string(offset_base.substr(0, open_paren));
+                    std::string base_reg = trim_string(offset_base.substr(open_paren + 1, close_paren - open_paren - 1));
                     
-                    if (open_paren != std::string::npos && close_paren != std::string::npos) {
-                        std::string offset_str = trim_string(offset_base.substr(0, open_paren));
-                        std::string base_reg = trim_string(offset_base.substr(open_paren + 1, close_paren - open_paren - 1));
-                        
-                        int offset = 0;
-                        if (!offset_str.empty()) {
-                            offset = std::stoi(offset_str);
-                        }
-                        
-                        result.binary = assemble_psrf_lw_sw(op, rd, base_reg, offset);
+                    int offset = 0;
+                    if (!offset_str.empty()) {
+                        offset = std::stoi(offset_str);
                     }
-                }
-            }
-            else if (op == "psrf.sw" || op == "psrf.sb") {
-                if (args.size() >= 2) {
-                    std::string rs2 = args[0];
-                    std::string offset_base = args[1];
                     
-                    size_t open_paren = offset_base.find('(');
-                    size_t close_paren = offset_base.find(')', open_paren);
-                    
-                    if (open_paren != std::string::npos && close_paren != std::string::npos) {
-                        std::string offset_str = trim_string(offset_base.substr(0, open_paren));
-                        std::string base_reg = trim_string(offset_base.substr(open_paren + 1, close_paren - open_paren - 1));
-                        
-                        int offset = 0;
-                        if (!offset_str.empty()) {
-                            offset = std::stoi(offset_str);
-                        }
-                        
-                        result.binary = assemble_psrf_lw_sw(op, rs2, base_reg, offset);
-                    }
+                    result.binary = assemble_psrf_lw_sw(op, rs2, base_reg, offset);
                 }
             }
         }
+    }
 
-        // Convert binary to hex
-        if (!result.binary.empty()) {
-            result.hex = to_hex(result.binary);
-        }
-        
-        return result;
+    // Encoded word and its hex text
+    if (!result.binary.empty()) {
+        result.word = static_cast<uint32_t>(std::bitset<32>(result.binary).to_ulong());
+        result.hex = to_hex(result.word);
     }
+    
+    return result;
+}
+
+// Assemble source text into placed instructions without touching the filesystem: every
+// instruction gets its memory address and word. Instructions following a ".overlay k"
+// directive (k > 0) form a separate load phase that reuses the execution window.
+// Returns 1 on an error, which is reported to the error stream.
+int RISC_V_Assembler::assemble_source(std::istream& in, int pe_number, std::vector<AssembledInstruction>& assembled,
+                                      std::vector<Relocation>& relocations) {
+    // Shared function libraries (".library <cluster> <base> <region>") are mapped at a fixed
+    // execution word of every PE in the cluster and stored in the configured code region
+    bool is_library = false;
+    int library_base = 0;
+    uint32_t library_region = 0;
 
-    // Main assembly function - reads input file, writes output files
-    int assemble(const std::string& input_file, const std::string& output_file, 
-                int pe_number = 0, const std::string& mem_file_path = "",
-                std::vector<std::string>* memory_entries = nullptr) {
-        // Read each line from input file
-        std::ifstream file(input_file);
-        if (!file) {
-            std::cerr << "Error: Cannot open input file" << std::endl;
+    // Pass 1: place instructions and build the symbol table
+    std::vector<SourceLine> lines;
+    std::map<std::string, std::vector<std::pair<int, Symbol>>> symbols;
+    {
+        ScopedTimer timer("read_source");
+        if (!read_source(in, lines, symbols, pe_number, is_library, library_base, library_region)) {
             return 1;
         }
-        
-        std::cout << "Input file: " << input_file << std::endl;
-        std::cout << "Output file: " << output_file << std::endl;
-        std::cout << "PE number: " << pe_number << " (will be encoded in bits [13:10])" << std::endl;
-        
-        // Use provided mem file path or create one based on output file
-        std::string actual_mem_file_path = mem_file_path.empty() ? 
-                                          output_file + ".mem" : mem_file_path;
-        
-        // Vectors to store opcodes and assembly instructions
-        std::vector<AssembledInstruction> assembled;
-        
-        std::string line;
-        bool in_execution_section = false;
-        
-        while (std::getline(file, line)) {
-            // Skip empty lines, comments, and labels
-            std::string trimmed = trim_string(line);
-            if (trimmed.empty() || trimmed[0] == '#' || trimmed[0] == '.' || 
-                trimmed[0] == '_' || trimmed.find(':') != std::string::npos) {
-                
-                // Check for execution section marker
-                if (trimmed.find("Execution Section Begin") != std::string::npos) {
-                    in_execution_section = true;
+    }
+
+    // Pass 2: resolve symbols and encode, one section/overlay group at a time
+    int words_before = 0;
+    {
+        ScopedTimer timer("encode");
+        for (size_t begin = 0; begin < lines.size();) {
+            size_t end = begin;
+            while (end < lines.size() && lines[end].is_execution == lines[begin].is_execution &&
+                   lines[end].overlay == lines[begin].overlay) {
+                end++;
+            }
+            std::vector<SourceLine> group(lines.begin() + begin, lines.begin() + end);
+            begin = end;
+
+            std::vector<AssembledInstruction> plain;
+            size_t relocation_mark = relocations.size();
+            for (const auto& source : group) {
+                std::vector<std::string> expanded;
+                if (!resolve_line(source, symbols, expanded, relocations)) {
+                    return 1;
+                }
+                for (const auto& text : expanded) {
+                    AssembledInstruction instr = parse_instruction(text);
+                    instr.is_execution = source.is_execution;
+                    instr.overlay = source.overlay;
+                    plain.push_back(instr);
                 }
-                continue;
             }
-            
-            // Parse the instruction
-            AssembledInstruction instr = parse_instruction(trimmed);
-            instr.is_execution = in_execution_section;
-            assembled.push_back(instr);
+            words_before += static_cast<int>(plain.size());
+
+            // The shared library layout is fixed by the .set symbols in every PE file
+            std::string reason = "shared library layout is fixed";
+            if (rvc_enabled && !is_library && rvc_compatible(group, symbols, reason)) {
+                std::vector<AssembledInstruction> packed;
+                std::vector<Relocation> group_relocations;
+                if (!assemble_rvc_group(group, symbols, packed, group_relocations)) {
+                    return 1;
+                }
+                if (packed.size() < plain.size()) {
+                    // Replace the relocations of the plain layout with the compressed ones
+                    relocations.resize(relocation_mark);
+                    relocations.insert(relocations.end(), group_relocations.begin(), group_relocations.end());
+                    plain = packed;
+                }
+            } else if (rvc_enabled) {
+                log() << "RVC: " << (group.front().is_execution ? "execution" : "preload")
+                          << " section (overlay " << group.front().overlay << ") left uncompressed: "
+                          << reason << std::endl;
+            }
+            assembled.insert(assembled.end(), plain.begin(), plain.end());
         }
-        
-        file.close();
-        
-        // Open output files
-        std::ofstream hex_file(output_file);
-        std::ofstream mem_file(actual_mem_file_path);
-        if (!hex_file || !mem_file) {
-            std::cerr << "Error: Cannot open output files" << std::endl;
-            return 1;
+    }
+    if (rvc_enabled && !is_library) {
+        rvc_sizes[pe_number] = {words_before, static_cast<int>(assembled.size())};
+        log() << "RVC: " << words_before << " -> " << assembled.size() << " words" << std::endl;
+    }
+
+
+    // Place each instruction in its section
+    int preload_count = 0, execution_count = library_base;
+    int current_overlay = 0;
+    for (auto& instr : assembled) {
+        // Each overlay phase is loaded from the start of the execution window
+        if (instr.overlay != current_overlay) {
+            current_overlay = instr.overlay;
+            execution_count = 0;
         }
-        
-        // Print and save each assembled instruction
-        int preload_count = 0, execution_count = 0;
-        for (size_t i = 0; i < assembled.size(); i++) {
-            const auto& instr = assembled[i];
-            
-            // Calculate memory address based on section
-            int address;
-            if (instr.is_execution) {
-                // Execution section: bit 10 = 0, PE number in bits [13:10]
-                address = ((pe_number & 0xFF) << 10) | execution_count;
-                execution_count++;
-            } else {
-                // Preload section: bit 10 = 1, PE number in bits [13:10]
-                // PE number occupies bits [13:10], bit 10 is set to 1 for preload
-                address = ((pe_number & 0xFF) << 10) | (1 << 9) | preload_count;
-                preload_count++;
+
+        if (instr.is_execution) {
+            if (execution_count >= imem_execution_words) {
+                errors() << "Error: execution section of PE " << pe_number << " overlay " << instr.overlay
+                         << " exceeds the " << imem_execution_words << "-word instruction memory" << std::endl;
+                return 1;
             }
-            
-            std::cout << std::setw(5) << i << ": " << instr.op 
-                      << " -> 0x" << instr.hex 
-                      << " (addr: 0x" << std::hex << address << std::dec << ")"
-                      << (instr.is_execution ? " [EXEC]" : " [PRELOAD]")
-                      << std::endl;
-            
-            // Write hex to file
-            hex_file << instr.hex << std::endl;
-            
-            // Create memory entry
-            std::stringstream mem_entry;
-            mem_entry << "@" << std::hex << std::setw(8) << std::setfill('0') << address << " " 
-                     << instr.hex;
-            
-            // Write to individual mem file
-            mem_file << mem_entry.str() << std::endl;
-            
-            // Store for combined file if requested
-            if (memory_entries != nullptr) {
-                memory_entries->push_back(mem_entry.str());
+            // Execution section: bit 10 = 0, PE number in bits [13:10]
+            instr.address = ((pe_number & 0xFF) << 10) | execution_count;
+            if (is_library) {
+                // Cluster code region: the region address, cluster number in place of the PE number
+                instr.address |= library_region;
+            }
+            execution_count++;
+        } else {
+            if (preload_count >= imem_preload_words) {
+                errors() << "Error: preload section of PE " << pe_number
+                         << " exceeds the " << imem_preload_words << "-word preload window" << std::endl;
+                return 1;
             }
+            // Preload section: bit 10 = 1, PE number in bits [13:10]
+            // PE number occupies bits [13:10], bit 10 is set to 1 for preload
+            instr.address = ((pe_number & 0xFF) << 10) | (1 << 9) | preload_count;
+            preload_count++;
         }
-        
-        hex_file.close();
-        mem_file.close();
-        
-        std::cout << "Assembly conversion complete." << std::endl;
-        std::cout << "Hex code written to: " << output_file << std::endl;
-        std::cout << "Memory initialization written to: " << actual_mem_file_path << std::endl;
-        std::cout << "Preload instructions: " << preload_count << ", Execution instructions: " << execution_count << std::endl;
-        
-        return 0;
     }
-};
+    return 0;
+}
 
-int main(int argc, char* argv[]) {
-    // Check if required arguments are provided
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <file_list> [output_directory]" << std::endl;
-        std::cerr << "  file_list: File containing a list of assembly files, one per line" << std::endl;
-        std::cerr << "  output_directory: Directory to store output files (default: current directory)" << std::endl;
+// Main assembly function - reads input file, writes output files.
+// Overlay phases are written to *_ovl<k> files and their memory entries are returned
+// through overlay_entries.
+int RISC_V_Assembler::assemble(const std::string& input_file, const std::string& output_file, 
+                              int pe_number, const std::string& mem_file_path,
+                              std::vector<MemWord>* memory_entries,
+                              std::map<int, std::vector<MemWord>>* overlay_entries) {
+    // Read each line from input file
+    std::ifstream file(input_file);
+    if (!file) {
+        errors() << "Error: Cannot open input file" << std::endl;
         return 1;
     }
     
-    // Parse arguments
-    std::string file_list_path = argv[1];
-    std::string output_dir = "./";
+    log() << "Input file: " << input_file << std::endl;
+    log() << "Output file: " << output_file << std::endl;
+    log() << "PE number: " << pe_number << " (will be encoded in bits [13:10])" << std::endl;
     
-    if (argc >= 3) {
-        output_dir = argv[2];
-        // Ensure output directory ends with a slash
-        if (output_dir.back() != '/' && output_dir.back() != '\\') {
-            output_dir += '/';
-        }
-    }
+    // Use provided mem file path or create one based on output file
+    std::string actual_mem_file_path = mem_file_path.empty() ? 
+                                      output_file + ".mem" : mem_file_path;
     
-    // Read the file list
-    std::ifstream file_list(file_list_path);
-    if (!file_list) {
-        std::cerr << "Error: Cannot open file list: " << file_list_path << std::endl;
+    std::vector<AssembledInstruction> assembled;
+    std::vector<Relocation> relocations;
+    if (assemble_source(file, pe_number, assembled, relocations) != 0) {
         return 1;
     }
+    file.close();
+
+    Profiler::count("instructions_encoded", assembled.size());
+
+    // Output files: relocations, then .bin/.mem per overlay phase
+    ScopedTimer write_timer("write_output");
+    if (!relocations.empty()) {
+        std::string reloc_path = output_file;
+        size_t last_dot = reloc_path.find_last_of('.');
+        size_t last_slash = reloc_path.find_last_of("/\\");
+        if (last_dot != std::string::npos && (last_slash == std::string::npos || last_dot > last_slash)) {
+            reloc_path = reloc_path.substr(0, last_dot);
+        }
+        reloc_path += ".reloc";
+        write_relocations(reloc_path, input_file, relocations);
+        log() << "Relocations: " << relocations.size() << " written to " << reloc_path << std::endl;
+    }
     
-    std::cout << "Processing file list: " << file_list_path << std::endl;
-    std::cout << "Output directory: " << output_dir << std::endl;
-    
-    RISC_V_Assembler assembler;
-    std::string assembly_file;
-    int result = 0;
-    
-    // For combined memory file
-    std::string combined_mem_file_path = output_dir + "combined_memory.mem";
-    std::ofstream combined_mem_file(combined_mem_file_path);
-    if (!combined_mem_file) {
-        std::cerr << "Error: Cannot create combined memory file: " << combined_mem_file_path << std::endl;
+    // Open output files, one pair per overlay phase
+    std::map<int, std::ofstream> hex_files;
+    std::map<int, std::ofstream> mem_files;
+    std::map<int, std::vector<MemWord>> mem_words;
+    hex_files[0].open(output_file);
+    mem_files[0].open(actual_mem_file_path);
+    if (!hex_files[0] || !mem_files[0]) {
+        errors() << "Error: Cannot open output files" << std::endl;
         return 1;
     }
-    
-    // Store memory entries for each PE to maintain order
-    std::map<int, std::vector<std::string>> all_memory_entries;
-    
-    // Process each assembly file in the list
-    while (std::getline(file_list, assembly_file)) {
-        // Skip empty lines and comments
-        if (assembly_file.empty() || assembly_file[0] == '#') {
-            continue;
+    for (const auto& instr : assembled) {
+        if (hex_files.count(instr.overlay) == 0) {
+            hex_files[instr.overlay].open(overlay_path(output_file, instr.overlay));
+            mem_files[instr.overlay].open(overlay_path(actual_mem_file_path, instr.overlay));
+            if (!hex_files[instr.overlay] || !mem_files[instr.overlay]) {
+                errors() << "Error: Cannot open output files" << std::endl;
+                return 1;
+            }
         }
-        
-        // Extract the PE number from the filename
-        std::string output_basename;
-        int pe_number = 0xFFFF; // Default if no PE number found
-        std::regex pe_pattern("pe(\\d+)_");
-        std::smatch matches;
-        
-        if (std::regex_search(assembly_file, matches, pe_pattern) && matches.size() > 1) {
-            std::string pe_num = matches[1].str();
-            pe_number = std::stoi(pe_num);
-            output_basename = "pe" + pe_num + "_binary";
+    }
+    
+    // Print and save each assembled instruction
+    int preload_count = 0;
+    std::map<int, int> execution_words;
+    for (size_t i = 0; i < assembled.size(); i++) {
+        const auto& instr = assembled[i];
+        if (instr.is_execution) {
+            execution_words[instr.overlay]++;
         } else {
-            // Use the basename of the input file if PE number can't be extracted
-            size_t last_slash = assembly_file.find_last_of("/\\");
-            size_t last_dot = assembly_file.find_last_of(".");
-            std::string basename = assembly_file.substr(
-                last_slash == std::string::npos ? 0 : last_slash + 1,
-                last_dot == std::string::npos ? assembly_file.length() : last_dot - (last_slash == std::string::npos ? 0 : last_slash + 1)
-            );
-            output_basename = basename + "_binary";
+            preload_count++;
         }
         
-        std::string output_file = output_dir + output_basename + ".bin";
-        std::string output_mem_file = output_dir + output_basename + ".mem";
-        
-        std::cout << "\n=== Processing assembly file: " << assembly_file << " ===\n";
-        std::cout << "PE number: " << (pe_number == 0xFFFF ? "Unknown (using 0xFFFF)" : std::to_string(pe_number)) << std::endl;
-        
-        // Store memory entries for this PE
-        all_memory_entries[pe_number] = std::vector<std::string>();
+        log() << std::setw(5) << i << ": " << instr.op 
+              << " -> 0x" << instr.hex 
+              << " (addr: 0x" << std::hex << instr.address << std::dec << ")"
+              << (instr.is_execution ? " [EXEC]" : " [PRELOAD]")
+              << std::endl;
         
-        // Assemble the file and collect memory entries
-        int file_result = assembler.assemble(assembly_file, output_file, pe_number, output_mem_file, &all_memory_entries[pe_number]);
+        // Write hex to file
+        hex_files[instr.overlay] << instr.hex << '\n';
         
-        if (file_result != 0) {
-            std::cerr << "Error processing file: " << assembly_file << std::endl;
-            result = file_result;
+        // Collect for the individual mem file
+        mem_words[instr.overlay].push_back({instr.address, instr.word});
+    }
+    
+    // Store for combined file if requested
+    for (auto& [phase, words] : mem_words) {
+        if (phase == 0 && memory_entries != nullptr) {
+            memory_entries->insert(memory_entries->end(), words.begin(), words.end());
+        } else if (phase != 0 && overlay_entries != nullptr) {
+            std::vector<MemWord>& entries = (*overlay_entries)[phase];
+            entries.insert(entries.end(), words.begin(), words.end());
         }
     }
     
-    // Write all memory entries to the combined file
-    combined_mem_file << "// Combined memory initialization file for all PEs" << std::endl;
-    combined_mem_file << "// Format: @ADDRESS HEX_INSTRUCTION" << std::endl;
+    for (auto& [phase, hex_file] : hex_files) {
+        Profiler::count("bytes_written", static_cast<uint64_t>(hex_file.tellp()));
+        hex_file.close();
+        {
+            MemWriter writer(mem_files[phase], mem_format);
+            writer.write(mem_words[phase]);
+        }
+        Profiler::count("bytes_written", static_cast<uint64_t>(mem_files[phase].tellp()));
+        mem_files[phase].close();
+    }
     
-    // Count the number of PEs
-    int total_pes = 0;
-    for (const auto& entry : all_memory_entries) {
-        if (entry.first != 0xFFFF) {  // Don't count unknown PEs
-            total_pes = std::max(total_pes, entry.first + 1);
+    log() << "Assembly conversion complete." << std::endl;
+    log() << "Hex code written to: " << output_file << std::endl;
+    log() << "Memory initialization written to: " << actual_mem_file_path << std::endl;
+    int total_execution = 0;
+    for (const auto& [phase, words] : execution_words) {
+        total_execution += words;
+        if (execution_words.size() > 1) {
+            log() << "Overlay " << phase << ": " << words << " execution words -> "
+                      << overlay_path(actual_mem_file_path, phase) << std::endl;
         }
     }
+    log() << "Preload instructions: " << preload_count << ", Execution instructions: " << total_execution << std::endl;
     
+    return 0;
+}
+
+int CombinedMemory::total_pes() const {
+    int total = 0;
+    for (const auto& entry : pe_entries) {
+        if (entry.first != 0xFFFF) {  // Don't count unknown PEs
+            total = std::max(total, entry.first + 1);
+        }
+    }
+    return total;
+}
+
+// Progress goes to log and failures to errors; callers pass their assembler's streams
+bool CombinedMemory::write(const std::string& output_dir, const MemFormat& mem_format, std::ostream& log,
+                           std::ostream& errors) const {
+    std::string combined_mem_file_path = output_dir + "combined_memory.mem";
+    std::ofstream combined_mem_file(combined_mem_file_path);
+    if (!combined_mem_file) {
+        errors << "Error: Cannot create combined memory file: " << combined_mem_file_path << std::endl;
+        return false;
+    }
+
+    // Write the words of one block through the configured .mem layout
+    auto write_entries = [&](std::ostream& out, const std::vector<MemWord>& entries) {
+        MemWriter writer(out, mem_format);
+        writer.write(entries);
+    };
+    // With --mem-merge every block (a source name and its words) is sorted into one
+    // address-ordered image. Identical words at one address are written once; different
+    // words at one address cannot both be loaded and fail the merge.
+    using Block = std::pair<std::string, const std::vector<MemWord>*>;
+    auto write_merged = [&](std::ostream& out, const std::vector<Block>& blocks) {
+        std::vector<MemWord> words;
+        for (const auto& block : blocks) words.insert(words.end(), block.second->begin(), block.second->end());
+        size_t first = 0, second = 0;
+        if (!sort_mem_words(words, first, second)) {
+            auto source = [&](size_t position) {
+                for (const auto& [name, entries] : blocks) {
+                    if (position < entries->size()) return name;
+                    position -= entries->size();
+                }
+                return std::string();
+            };
+            char text[64];
+            std::snprintf(text, sizeof(text), "address 0x%08x holds 0x%08x from ", words[first].address,
+                          words[first].word);
+            errors << "Error: cannot merge memory images: " << text << source(first);
+            std::snprintf(text, sizeof(text), " and 0x%08x from ", words[second].word);
+            errors << text << source(second) << std::endl;
+            return false;
+        }
+        out << std::endl << "// Merged memory entries sorted by address" << std::endl;
+        MemWriter writer(out, mem_format);
+        writer.write(words);
+        return true;
+    };
+    std::string format_line = mem_format.burst
+        ? "// Format: @ADDRESS then " + std::to_string(mem_format.words_per_line) + " HEX_INSTRUCTION per line"
+        : "// Format: @ADDRESS HEX_INSTRUCTION";
+
+    // Write all memory entries to the combined file
+    combined_mem_file << "// Combined memory initialization file for all PEs" << std::endl;
+    combined_mem_file << format_line << std::endl;
+
+    // Count the number of PEs
+    int total_pes = this->total_pes();
+
     // Write the total number of PEs
     combined_mem_file << "// Total PEs: " << total_pes << std::endl;
-    
-    // Write entries for each PE in order
-    for (int pe = 0; pe < total_pes; pe++) {
-        if (all_memory_entries.find(pe) != all_memory_entries.end()) {
-            combined_mem_file << std::endl << "// PE" << pe << " memory entries" << std::endl;
-            for (const auto& entry : all_memory_entries[pe]) {
-                combined_mem_file << entry << std::endl;
+
+    if (mem_format.merge) {
+        std::vector<Block> blocks;
+        for (const auto& [pe, entries] : pe_entries) blocks.push_back({"PE " + std::to_string(pe), &entries});
+        for (const auto& [cluster, entries] : library_entries) {
+            blocks.push_back({"cluster " + std::to_string(cluster) + " library", &entries});
+        }
+        if (!write_merged(combined_mem_file, blocks)) return false;
+    } else {
+        // Write entries for each PE in order
+        for (int pe = 0; pe < total_pes; pe++) {
+            if (pe_entries.find(pe) != pe_entries.end()) {
+                combined_mem_file << std::endl << "// PE" << pe << " memory entries" << std::endl;
+                write_entries(combined_mem_file, pe_entries.at(pe));
             }
         }
-    }
     
-    // Then write entries for unknown PEs (0xFFFF)
-    if (all_memory_entries.find(0xFFFF) != all_memory_entries.end()) {
-        combined_mem_file << std::endl << "// Unknown PE memory entries" << std::endl;
-        for (const auto& entry : all_memory_entries[0xFFFF]) {
-            combined_mem_file << entry << std::endl;
+        // Write the shared function library of each cluster
+        for (const auto& [cluster, entries] : library_entries) {
+            combined_mem_file << std::endl << "// Cluster" << cluster << " shared function library" << std::endl;
+            write_entries(combined_mem_file, entries);
         }
-    }
     
+        // Then write entries for unknown PEs (0xFFFF)
+        if (pe_entries.find(0xFFFF) != pe_entries.end()) {
+            combined_mem_file << std::endl << "// Unknown PE memory entries" << std::endl;
+            write_entries(combined_mem_file, pe_entries.at(0xFFFF));
+        }
+    }
+
+    Profiler::count("bytes_written", static_cast<uint64_t>(combined_mem_file.tellp()));
     combined_mem_file.close();
-    file_list.close();
-    
-    std::cout << "\nAll files processed." << std::endl;
-    std::cout << "Total PEs found: " << total_pes << std::endl;
-    std::cout << "Combined memory file created: " << combined_mem_file_path << std::endl;
-    
-    return result;
-}
\ No newline at end of file
+
+    // Write one combined file per overlay phase, loaded at the matching reload point
+    for (const auto& [phase, phase_entries] : overlay_entries) {
+        std::string overlay_mem_file_path = output_dir + "combined_memory_ovl" + std::to_string(phase) + ".mem";
+        std::ofstream overlay_mem_file(overlay_mem_file_path);
+        if (!overlay_mem_file) {
+            errors << "Error: Cannot create overlay memory file: " << overlay_mem_file_path << std::endl;
+            return false;
+        }
+        overlay_mem_file << "// Combined memory initialization file for overlay phase " << phase << std::endl;
+        overlay_mem_file << format_line << std::endl;
+        if (mem_format.merge) {
+            std::vector<Block> blocks;
+            for (const auto& [pe, entries] : phase_entries) {
+                blocks.push_back({"PE " + std::to_string(pe) + " overlay " + std::to_string(phase), &entries});
+            }
+            if (!write_merged(overlay_mem_file, blocks)) return false;
+        } else {
+            for (const auto& [pe, entries] : phase_entries) {
+                overlay_mem_file << std::endl << "// PE" << pe << " overlay " << phase << " memory entries" << std::endl;
+                write_entries(overlay_mem_file, entries);
+            }
+        }
+        Profiler::count("bytes_written", static_cast<uint64_t>(overlay_mem_file.tellp()));
+        log << "Overlay memory file created: " << overlay_mem_file_path << std::endl;
+    }
+    return true;
+}
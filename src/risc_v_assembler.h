@@ -0,0 +1,166 @@
+#ifndef RISC_V_ASSEMBLER_H
+#define RISC_V_ASSEMBLER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "mem_format.h"
+
+struct AssembledInstruction {
+    std::string op;
+    std::string binary;
+    std::string hex;
+    bool is_execution;
+    int overlay;  // Overlay phase the instruction is loaded in (0 = initial image)
+    uint32_t address = 0;  // Instruction memory address, set once the instruction is placed
+    uint32_t word = 0;
+};
+
+// A source instruction placed by the first pass
+struct SourceLine {
+    std::string text;   // Instruction text with labels and comments removed
+    int line_number;
+    bool is_execution;
+    int overlay;
+    int word;           // Word index within its section (execution words include the library base)
+};
+
+// Symbol table entry: a label placed by the first pass or an absolute .set/.equ value
+struct Symbol {
+    bool is_execution;
+    int overlay;
+    int word;
+    bool absolute;
+};
+
+// A symbolic operand resolved by the second pass
+struct Relocation {
+    int word;            // Word of the instruction that carries the operand
+    bool is_execution;
+    int overlay;
+    std::string type;    // R_BRANCH, R_JAL, R_HWL_START or R_HWL_STOP
+    std::string symbol;
+    int value;           // Resolved value written into the instruction
+};
+
+class RISC_V_Assembler {
+private:
+    std::ostream* log_stream = &std::cout;
+    std::ostream* error_stream = &std::cerr;
+
+    std::ostream& log() const { return *log_stream; }
+    std::ostream& errors() const { return *error_stream; }
+
+    std::map<std::string, int> registers;
+    std::map<std::string, int> registers_c;
+    std::map<std::string, int> registers_p;
+    std::map<std::string, int> hwl_registers; // Hardware loop registers (L1-L7)
+    std::map<std::string, std::string> instructions;
+    std::map<std::string, std::string> funct3;
+    std::map<std::string, std::string> funct7;
+
+    // Decode tables built from the opcode tables above: the key packs opcode, funct3 and
+    // funct7 so lookups go from most to least specific
+    std::map<uint32_t, std::string> decode_r;  // opcode | funct3 << 7 | funct7 << 10
+    std::map<uint32_t, std::string> decode_i;  // opcode | funct3 << 7
+    std::map<uint32_t, std::string> decode_u;  // opcode
+
+    // Instruction memory capacity per PE in words. Bit 9 of the address selects the
+    // preload window, so each section is limited to 512 words by default.
+    int imem_execution_words = 512;
+    int imem_preload_words = 512;
+
+    // RVC compression of the standard subset (addi/li/mv/nop, add, lw, sw, j)
+    MemFormat mem_format;  // Layout of the .mem files
+
+    bool rvc_enabled = false;
+    std::map<int, std::pair<int, int>> rvc_sizes;  // PE -> words before and after compression
+
+    std::string trim_string(const std::string& str);
+    std::string overlay_path(const std::string& path, int overlay);
+    std::vector<std::string> split_arguments(const std::string& args_str);
+    bool is_number(const std::string& operand);
+    int parse_constant(const std::string& text);
+    std::pair<int, int> split_constant(int value);
+    int li_words(int value);
+    int instruction_words(const std::string& op, const std::vector<std::string>& args, int value);
+    bool expand_block(const std::vector<std::pair<int, std::string>>& block,
+                      std::vector<std::pair<int, std::string>>& out,
+                      std::map<std::string, std::pair<std::vector<std::string>, std::vector<std::pair<int, std::string>>>>& macros,
+                      int depth);
+    std::pair<int, int> hwl_immediate(int pc_start, int pc_stop, int hwl_index, int iterations);
+    bool read_source(std::istream& in, std::vector<SourceLine>& lines,
+                     std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                     int& pe_number, bool& is_library, int& library_base, uint32_t& library_region);
+    const Symbol* find_symbol(const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                              const std::string& name, int overlay);
+    bool resolve_line(const SourceLine& source,
+                      const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                      std::vector<std::string>& expanded, std::vector<Relocation>& relocations,
+                      const std::map<int, int>* halfword = nullptr);
+    int register_number(const std::string& name);
+    bool split_memory_operand(const std::string& operand, int& offset, std::string& base);
+    bool compress_instruction(const std::string& text, uint16_t& encoded, std::string* name = nullptr);
+    bool rvc_compatible(const std::vector<SourceLine>& group,
+                        const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                        std::string& reason);
+    bool assemble_rvc_group(const std::vector<SourceLine>& group,
+                            const std::map<std::string, std::vector<std::pair<int, Symbol>>>& symbols,
+                            std::vector<AssembledInstruction>& packed, std::vector<Relocation>& relocations);
+    void build_decode_tables();
+    void write_relocations(const std::string& path, const std::string& input_file,
+                           const std::vector<Relocation>& relocations);
+
+public:
+    RISC_V_Assembler();
+    void set_imem_capacity(int execution_words, int preload_words);
+    void set_mem_format(const MemFormat& format);
+    void set_rvc(bool enabled);
+    void set_log(std::ostream& out, std::ostream& err);
+    const std::map<int, std::pair<int, int>>& get_rvc_sizes() const;
+    std::string disassemble_word(uint32_t word) const;
+    bool disassemble_image(const std::map<int, std::vector<MemWord>>& phases, std::ostream& out) const;
+    std::string to_binary(int num, int length);
+    std::string to_hex(uint32_t word);
+    std::string assemble_r_type(const std::string& instruction, const std::string& rd, 
+                               const std::string& rs1, const std::string& rs2);
+    std::string assemble_i_type(const std::string& instruction, const std::string& rd, 
+                               const std::string& rs1, int imm);
+    std::string assemble_s_type(const std::string& instruction, const std::string& rs1, 
+                               const std::string& rs2, int imm);
+    std::string assemble_b_type(const std::string& instruction, const std::string& rs1, 
+                               const std::string& rs2, int imm);
+    std::string assemble_psrf_lw_sw(const std::string& instruction, const std::string& rd, 
+                                   const std::string& rs1, int imm);
+    std::string assemble_u_type(const std::string& instruction, const std::string& rd, int imm);
+    std::string assemble_lui(const std::string& op, const std::string& rd, int imm);
+    std::string assemble_corf_lui(const std::string& op, const std::string& rd, int imm);
+    std::string assemble_corf_addi(const std::string& op, const std::string& rd, const std::string& rs1, int imm);
+    std::string assemble_ppsrf_addi(const std::string& op, const std::string& rd, const std::string& rs1, int imm);
+    std::string assemble_hwlrf_lui(const std::string& rd, int imm);
+    std::string assemble_hwlrf_addi(const std::string& rd, const std::string& rs1, int imm);
+    std::string assemble_j_type(const std::string& rd, int imm);
+    AssembledInstruction parse_instruction(const std::string& line);
+    int assemble_source(std::istream& in, int pe_number, std::vector<AssembledInstruction>& assembled,
+                        std::vector<Relocation>& relocations);
+    int assemble(const std::string& input_file, const std::string& output_file, 
+                int pe_number = 0, const std::string& mem_file_path = "",
+                std::vector<MemWord>* memory_entries = nullptr,
+                std::map<int, std::vector<MemWord>>* overlay_entries = nullptr);
+};
+
+// Memory words collected from every assembled file, written to combined_memory.mem and one
+// combined_memory_ovlK.mem per overlay phase
+struct CombinedMemory {
+    std::map<int, std::vector<MemWord>> pe_entries;                    // PE -> words
+    std::map<int, std::map<int, std::vector<MemWord>>> overlay_entries;  // Phase -> PE -> words
+    std::map<int, std::vector<MemWord>> library_entries;               // Cluster -> library words
+
+    int total_pes() const;
+    bool write(const std::string& output_dir, const MemFormat& mem_format, std::ostream& log,
+               std::ostream& errors) const;
+};
+
+#endif // RISC_V_ASSEMBLER_H
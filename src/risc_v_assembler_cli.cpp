@@ -0,0 +1,334 @@
+#include "risc_v_assembler.h"
+#include "null_stream.h"
+#include "profiler.h"
+#include <atomic>
+#include <regex>
+#include <thread>
+#include <filesystem>
+
+// Round-trip one assembly file (asm -> bin -> asm -> bin) and compare the two memory images.
+// Each call uses its own assembler so files can be verified in parallel.
+bool verify_round_trip(const std::string& assembly_file, const std::string& work_dir,
+                       int imem_exec, int imem_preload, std::string& message) {
+    std::smatch matches;
+    std::string basename = assembly_file.substr(assembly_file.find_last_of("/\\") + 1);
+    basename = basename.substr(0, basename.find_last_of('.'));
+    int pe_number = 0xFFFF;
+    if (std::regex_search(assembly_file, matches, std::regex("cluster(\\d+)_library")) ||
+        std::regex_search(assembly_file, matches, std::regex("pe(\\d+)_"))) {
+        pe_number = std::stoi(matches[1].str());
+    }
+    ScopedTimer timer("verify_file", pe_number);
+
+    // The assembler logs every instruction; its errors are reported with the result
+    NullStream quiet;
+    std::ostringstream errors;
+    RISC_V_Assembler assembler;
+    assembler.set_log(quiet, errors);
+    assembler.set_imem_capacity(imem_exec, imem_preload);
+    std::map<int, std::vector<MemWord>> original, round_trip;
+    auto failed = [&](const std::string& what) {
+        std::string detail = errors.str();
+        while (!detail.empty() && detail.back() == '\n') detail.pop_back();
+        for (char& c : detail) {
+            if (c == '\n') c = ' ';
+        }
+        message = detail.empty() ? what : what + ": " + detail;
+        return false;
+    };
+    if (assembler.assemble(assembly_file, work_dir + basename + ".bin", pe_number,
+                           work_dir + basename + ".mem", &original[0], &original) != 0) {
+        return failed("failed to assemble");
+    }
+
+    std::string disassembly_file = work_dir + basename + "_roundtrip.s";
+    std::ofstream disassembly(disassembly_file);
+    if (!disassembly || !assembler.disassemble_image(original, disassembly)) {
+        return failed("failed to disassemble");
+    }
+    disassembly.close();
+
+    if (assembler.assemble(disassembly_file, work_dir + basename + "_roundtrip.bin", pe_number,
+                           work_dir + basename + "_roundtrip.mem", &round_trip[0], &round_trip) != 0) {
+        return failed("failed to reassemble " + disassembly_file);
+    }
+    for (const auto& [phase, entries] : original) {
+        const auto& other = round_trip[phase];
+        auto text = [](const std::vector<MemWord>& words, size_t i) {
+            if (i >= words.size()) return std::string("<none>");
+            std::string entry = "@00000000 00000000";
+            format_hex8(words[i].address, &entry[1]);
+            format_hex8(words[i].word, &entry[10]);
+            return entry;
+        };
+        for (size_t i = 0; i < std::max(entries.size(), other.size()); i++) {
+            std::string a = text(entries, i);
+            std::string b = text(other, i);
+            if (a != b) {
+                message = "overlay " + std::to_string(phase) + " entry " + std::to_string(i) + ": " + a + " != " + b;
+                return false;
+            }
+        }
+    }
+    int words = 0;
+    for (const auto& [phase, entries] : original) words += static_cast<int>(entries.size());
+    message = std::to_string(words) + " words";
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // Check if required arguments are provided
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <file_list> [output_directory]" << std::endl;
+        std::cerr << "  file_list: File containing a list of assembly files, one per line" << std::endl;
+        std::cerr << "  output_directory: Directory to store output files (default: current directory)" << std::endl;
+        std::cerr << "  --imem-exec=N: Execution window size in words (default: 512)" << std::endl;
+        std::cerr << "  --imem-preload=N: Preload window size in words (default: 512)" << std::endl;
+        std::cerr << "  --rvc: Compress eligible sections with 16-bit RVC instructions" << std::endl;
+        std::cerr << "  --mem-format=line|burst: One @ADDRESS per word (default) or per contiguous region" << std::endl;
+        std::cerr << "  --mem-words-per-line=N: Words per line in burst format (default: 1)" << std::endl;
+        std::cerr << "  --mem-merge: Sort combined memory files by address and merge regions across PEs" << std::endl;
+        std::cerr << "       " << argv[0] << " --disasm <file.mem>..." << std::endl;
+        std::cerr << "  --disasm: Print the assembly of memory images (*_ovlK.mem files as overlay K)" << std::endl;
+        std::cerr << "       " << argv[0] << " --verify <file_list> [output_directory] [--jobs=N]" << std::endl;
+        std::cerr << "  --verify: Round-trip every file (asm -> bin -> asm -> bin) in parallel and compare" << std::endl;
+        std::cerr << "  --profile=out.json: Write per-phase and per-PE timings, counters and peak RSS" << std::endl;
+        return 1;
+    }
+    
+    // Parse arguments
+    std::vector<std::string> positional;
+    int imem_exec = 512, imem_preload = 512;
+    bool rvc = false, disasm = false, verify = false;
+    MemFormat mem_format;
+    std::string profile_path;
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--disasm") {
+            disasm = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        } else if (arg == "--mem-format=burst" || arg == "--mem-format=line") {
+            mem_format.burst = (arg == "--mem-format=burst");
+        } else if (arg.rfind("--mem-words-per-line=", 0) == 0) {
+            mem_format.words_per_line = std::stoi(arg.substr(21));
+        } else if (arg == "--mem-merge") {
+            mem_format.merge = true;
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            jobs = std::stoi(arg.substr(7));
+        } else if (arg.rfind("--imem-exec=", 0) == 0) {
+            imem_exec = std::stoi(arg.substr(12));
+        } else if (arg.rfind("--imem-preload=", 0) == 0) {
+            imem_preload = std::stoi(arg.substr(15));
+        } else if (arg == "--rvc") {
+            rvc = true;
+        } else if (arg.rfind("--profile=", 0) == 0) {
+            profile_path = arg.substr(10);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.empty()) {
+        std::cerr << "Error: missing file list" << std::endl;
+        return 1;
+    }
+    ProfileSession profile(profile_path, "risc_v_assembler");
+
+    // Disassemble memory images to stdout
+    if (disasm) {
+        RISC_V_Assembler assembler;
+        for (const auto& path : positional) {
+            std::ifstream image(path);
+            if (!image) {
+                std::cerr << "Error: Cannot open memory image: " << path << std::endl;
+                return 1;
+            }
+            std::smatch matches;
+            int phase = std::regex_search(path, matches, std::regex("_ovl(\\d+)\\.")) ? std::stoi(matches[1].str()) : 0;
+            std::map<int, std::vector<MemWord>> phases;
+            std::string line;
+            while (std::getline(image, line)) {
+                if (line.empty() || line[0] != '@') continue;
+                unsigned int address = 0, word = 0;
+                if (std::sscanf(line.c_str(), "@%x %x", &address, &word) != 2) {
+                    std::cerr << "Error: malformed memory entry '" << line << "' in " << path << std::endl;
+                    return 1;
+                }
+                phases[phase].push_back({address, word});
+            }
+            std::cout << "# Disassembly of " << path << std::endl;
+            if (!assembler.disassemble_image(phases, std::cout)) return 1;
+        }
+        return 0;
+    }
+
+    // Round-trip every file of the list on a pool of worker threads
+    if (verify) {
+        std::string work_dir = positional.size() >= 2 ? positional[1] : "./";
+        if (work_dir.back() != '/') work_dir += '/';
+        work_dir += "roundtrip/";
+        std::filesystem::create_directories(work_dir);
+
+        std::ifstream file_list(positional[0]);
+        if (!file_list) {
+            std::cerr << "Error: Cannot open file list: " << positional[0] << std::endl;
+            return 1;
+        }
+        std::vector<std::string> files;
+        std::string line;
+        while (std::getline(file_list, line)) {
+            if (!line.empty() && line[0] != '#') files.push_back(line);
+        }
+
+        std::vector<std::pair<bool, std::string>> results(files.size());
+        std::atomic<size_t> next{0};
+        // verify_round_trip keeps each assembler's log to itself; results are reported at the end
+        std::vector<std::thread> workers;
+        for (int t = 0; t < std::max(1, std::min(jobs, static_cast<int>(files.size()))); t++) {
+            workers.emplace_back([&]() {
+                for (size_t i = next++; i < files.size(); i = next++) {
+                    results[i].first = verify_round_trip(files[i], work_dir, imem_exec, imem_preload, results[i].second);
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+
+        int failures = 0;
+        for (size_t i = 0; i < files.size(); i++) {
+            std::cout << (results[i].first ? "OK   " : "FAIL ") << files[i] << ": " << results[i].second << std::endl;
+            if (!results[i].first) failures++;
+        }
+        std::cout << "Round trip: " << files.size() - failures << "/" << files.size() << " files identical" << std::endl;
+        return failures == 0 ? 0 : 1;
+    }
+
+    std::string file_list_path = positional[0];
+    std::string output_dir = "./";
+    
+    if (positional.size() >= 2) {
+        output_dir = positional[1];
+        // Ensure output directory ends with a slash
+        if (output_dir.back() != '/' && output_dir.back() != '\\') {
+            output_dir += '/';
+        }
+    }
+    
+    // Read the file list
+    std::ifstream file_list(file_list_path);
+    if (!file_list) {
+        std::cerr << "Error: Cannot open file list: " << file_list_path << std::endl;
+        return 1;
+    }
+    
+    std::cout << "Processing file list: " << file_list_path << std::endl;
+    std::cout << "Output directory: " << output_dir << std::endl;
+    
+    RISC_V_Assembler assembler;
+    assembler.set_imem_capacity(imem_exec, imem_preload);
+    assembler.set_rvc(rvc);
+    assembler.set_mem_format(mem_format);
+    std::string assembly_file;
+    int result = 0;
+    
+    // Memory entries of every file for the combined memory files
+    CombinedMemory combined;
+    std::regex library_pattern("cluster(\\d+)_library");
+    
+    // Process each assembly file in the list
+    while (std::getline(file_list, assembly_file)) {
+        // Skip empty lines and comments
+        if (assembly_file.empty() || assembly_file[0] == '#') {
+            continue;
+        }
+        
+        // Extract the PE number from the filename
+        std::string output_basename;
+        int pe_number = 0xFFFF; // Default if no PE number found
+        std::regex pe_pattern("pe(\\d+)_");
+        std::smatch matches;
+
+        // Shared function libraries are assembled into the cluster code region
+        if (std::regex_search(assembly_file, matches, library_pattern) && matches.size() > 1) {
+            int cluster = std::stoi(matches[1].str());
+            std::string library_basename = "cluster" + matches[1].str() + "_library";
+            std::cout << "\n=== Processing shared library: " << assembly_file << " ===\n";
+            ScopedTimer timer("assemble_library");
+            int file_result = assembler.assemble(assembly_file, output_dir + library_basename + ".bin", cluster,
+                                                 output_dir + library_basename + ".mem",
+                                                 &combined.library_entries[cluster]);
+            if (file_result != 0) {
+                std::cerr << "Error processing file: " << assembly_file << std::endl;
+                result = file_result;
+            }
+            continue;
+        }
+        
+        if (std::regex_search(assembly_file, matches, pe_pattern) && matches.size() > 1) {
+            std::string pe_num = matches[1].str();
+            pe_number = std::stoi(pe_num);
+            output_basename = "pe" + pe_num + "_binary";
+        } else {
+            // Use the basename of the input file if PE number can't be extracted
+            size_t last_slash = assembly_file.find_last_of("/\\");
+            size_t last_dot = assembly_file.find_last_of(".");
+            std::string basename = assembly_file.substr(
+                last_slash == std::string::npos ? 0 : last_slash + 1,
+                last_dot == std::string::npos ? assembly_file.length() : last_dot - (last_slash == std::string::npos ? 0 : last_slash + 1)
+            );
+            output_basename = basename + "_binary";
+        }
+        
+        std::string output_file = output_dir + output_basename + ".bin";
+        std::string output_mem_file = output_dir + output_basename + ".mem";
+        
+        std::cout << "\n=== Processing assembly file: " << assembly_file << " ===\n";
+        std::cout << "PE number: " << (pe_number == 0xFFFF ? "Unknown (using 0xFFFF)" : std::to_string(pe_number)) << std::endl;
+        
+        // Store memory entries for this PE
+        combined.pe_entries[pe_number] = std::vector<MemWord>();
+        
+        // Assemble the file and collect memory entries
+        std::map<int, std::vector<MemWord>> overlay_entries;
+        ScopedTimer timer("assemble_pe", pe_number);
+        int file_result = assembler.assemble(assembly_file, output_file, pe_number, output_mem_file,
+                                             &combined.pe_entries[pe_number], &overlay_entries);
+        for (auto& [phase, entries] : overlay_entries) {
+            combined.overlay_entries[phase][pe_number] = std::move(entries);
+        }
+        
+        if (file_result != 0) {
+            std::cerr << "Error processing file: " << assembly_file << std::endl;
+            result = file_result;
+        }
+    }
+    
+    file_list.close();
+    {
+        ScopedTimer timer("write_combined");
+        if (!combined.write(output_dir, mem_format, std::cout, std::cerr)) {
+            return 1;
+        }
+    }
+    int total_pes = combined.total_pes();
+    
+    std::cout << "\nAll files processed." << std::endl;
+    std::cout << "Total PEs found: " << total_pes << std::endl;
+    std::cout << "Combined memory file created: " << output_dir << "combined_memory.mem" << std::endl;
+
+    // Per-PE code size reduction from RVC compression
+    if (rvc) {
+        std::cout << "\nRVC code size per PE (words):" << std::endl;
+        int total_before = 0, total_after = 0;
+        for (const auto& [pe, sizes] : assembler.get_rvc_sizes()) {
+            const auto& [before, after] = sizes;
+            total_before += before;
+            total_after += after;
+            std::cout << "  PE" << pe << ": " << before << " -> " << after << " ("
+                      << (before > 0 ? 100 * (before - after) / before : 0) << "% smaller)" << std::endl;
+        }
+        std::cout << "  Total: " << total_before << " -> " << total_after << std::endl;
+    }
+    
+    return result;
+}
\ No newline at end of file
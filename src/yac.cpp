@@ -0,0 +1,541 @@
+#include "yac.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "autotuner.h"
+#include "config_formats.h"
+#include "dfg_processor.h"
+#include "null_stream.h"
+#include "risc_v_assembler.h"
+#include "toolchain_hash.h"  // YAC_SOURCE_HASH, generated by the Makefile
+
+namespace yac {
+
+namespace {
+
+// Assemble one source into an image; assembler errors become a yac::Error
+Image assemble_image(RISC_V_Assembler& assembler, std::ostringstream& errors, const std::string& source,
+                     int number, const std::string& name, bool keep_assembly) {
+    std::istringstream in(source);
+    std::vector<AssembledInstruction> assembled;
+    std::vector<Relocation> relocations;
+    errors.str("");
+    if (assembler.assemble_source(in, number, assembled, relocations) != 0) {
+        std::string message = errors.str();
+        while (!message.empty() && message.back() == '\n') message.pop_back();
+        if (message.rfind("Error: ", 0) == 0) message = message.substr(7);
+        throw Error(name + ": " + message);
+    }
+
+    Image image;
+    for (const auto& instr : assembled) {
+        MemWord word = {instr.address, instr.word};
+        if (!instr.is_execution) {
+            image.preload.push_back(word);
+        } else if (instr.overlay == 0) {
+            image.execution.push_back(word);
+        } else {
+            image.overlays[instr.overlay].push_back(word);
+        }
+    }
+    if (keep_assembly) image.assembly = source;
+    return image;
+}
+
+// Formatting-independent text of a configuration: scalars are length-prefixed, so no two
+// different trees give the same text. Map order is kept, as the processor may depend on it.
+void canonical_text(const YAML::Node& node, std::string& out) {
+    switch (node.Type()) {
+    case YAML::NodeType::Scalar:
+        out += 's';
+        out += std::to_string(node.Scalar().size());
+        out += ':';
+        out += node.Scalar();
+        break;
+    case YAML::NodeType::Sequence:
+        out += '[';
+        for (const auto& item : node) canonical_text(item, out);
+        out += ']';
+        break;
+    case YAML::NodeType::Map:
+        out += '{';
+        for (const auto& entry : node) {
+            canonical_text(entry.first, out);
+            canonical_text(entry.second, out);
+        }
+        out += '}';
+        break;
+    default:
+        out += '~';
+        break;
+    }
+}
+
+std::string key_prefix(const Options& options) {
+    return toolchain_id() + "\nrvc=" + (options.rvc ? "1" : "0") + " assembly=" + (options.keep_assembly ? "1" : "0") +
+           "\n";
+}
+
+std::string cache_key(const YAML::Node& config, const Options& options) {
+    return key_prefix(options) + normalized_config(config);
+}
+
+std::string binary_cache_key(const std::string& data, const Options& options) {
+    return key_prefix(options) + "binary\n" + data;
+}
+
+// 64-bit FNV-1a; the entry stores the full key, so a collision only costs a miss
+std::string key_hash(const std::string& key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    char text[17];
+    snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+    return text;
+}
+
+// flock on <directory>/lock for the lifetime of the object; LOCK_SH for readers, LOCK_EX for
+// writers. Each object opens its own descriptor, so threads of one process exclude each other too.
+class DirectoryLock {
+private:
+    int fd;
+
+public:
+    DirectoryLock(const std::string& directory, int operation) {
+        fd = open((directory + "/lock").c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd >= 0) flock(fd, operation);
+    }
+    ~DirectoryLock() {
+        if (fd >= 0) close(fd);
+    }
+    DirectoryLock(const DirectoryLock&) = delete;
+    DirectoryLock& operator=(const DirectoryLock&) = delete;
+};
+
+// Cache entries are "YACCACHE1\n", the key, a JSON manifest and the encoded kernel
+const char CACHE_MAGIC[] = "YACCACHE1\n";
+
+void put_u32(std::string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), 4); }
+
+void put_text(std::string& out, const std::string& text) {
+    put_u32(out, static_cast<uint32_t>(text.size()));
+    out += text;
+}
+
+void put_words(std::string& out, const std::vector<MemWord>& words) {
+    put_u32(out, static_cast<uint32_t>(words.size()));
+    for (const auto& word : words) {
+        put_u32(out, word.address);
+        put_u32(out, word.word);
+    }
+}
+
+struct EntryReader {
+    const std::string& data;
+    size_t at = 0;
+
+    bool u32(uint32_t& value) {
+        if (data.size() - at < 4) return false;
+        std::memcpy(&value, data.data() + at, 4);
+        at += 4;
+        return true;
+    }
+    bool text(std::string& value) {
+        uint32_t size = 0;
+        if (!u32(size) || data.size() - at < size) return false;
+        value.assign(data, at, size);
+        at += size;
+        return true;
+    }
+    bool words(std::vector<MemWord>& value) {
+        uint32_t count = 0;
+        if (!u32(count) || (data.size() - at) / 8 < count) return false;
+        value.resize(count);
+        for (auto& word : value) {
+            u32(word.address);
+            u32(word.word);
+        }
+        return true;
+    }
+};
+
+bool read_images(EntryReader& reader, Kernel& kernel) {
+    uint32_t count = 0;
+    if (!reader.u32(count)) return false;
+    Kernel result;
+    for (uint32_t i = 0; i < count; i++) {
+        Image image;
+        uint32_t pe = 0, cluster = 0, overlays = 0;
+        if (!reader.u32(pe) || !reader.u32(cluster) || !reader.words(image.preload) ||
+            !reader.words(image.execution) || !reader.u32(overlays)) {
+            return false;
+        }
+        for (uint32_t k = 0; k < overlays; k++) {
+            uint32_t phase = 0;
+            if (!reader.u32(phase) || !reader.words(image.overlays[static_cast<int>(phase)])) return false;
+        }
+        if (!reader.text(image.assembly)) return false;
+        image.pe = static_cast<int>(pe);
+        image.cluster = static_cast<int>(cluster);
+        (image.pe < 0 ? result.libraries : result.pes).push_back(std::move(image));
+    }
+    if (reader.at != reader.data.size()) return false;
+    kernel = std::move(result);
+    return true;
+}
+
+std::string manifest(const Kernel& kernel) {
+    std::ostringstream json;
+    json << "{\"toolchain\": \"" << toolchain_id() << "\", \"images\": [";
+    bool first = true;
+    for (const auto* images : {&kernel.libraries, &kernel.pes}) {
+        for (const auto& image : *images) {
+            json << (first ? "" : ", ") << "{\"pe\": " << image.pe << ", \"cluster\": " << image.cluster
+                 << ", \"preload_words\": " << image.preload.size() << ", \"execution_words\": "
+                 << image.execution.size() << ", \"overlays\": " << image.overlays.size() << "}";
+            first = false;
+        }
+    }
+    json << "]}";
+    return json.str();
+}
+
+} // namespace
+
+std::string normalized_config(const YAML::Node& config) {
+    std::string text;
+    canonical_text(config, text);
+    return text;
+}
+
+std::string toolchain_id() {
+    return std::string("libyac ") + TOOLCHAIN_VERSION + " sources " + YAC_SOURCE_HASH + " g++ " + __VERSION__;
+}
+
+std::string encode(const Kernel& kernel) {
+    std::string data;
+    put_u32(data, static_cast<uint32_t>(kernel.libraries.size() + kernel.pes.size()));
+    for (const auto* images : {&kernel.libraries, &kernel.pes}) {
+        for (const auto& image : *images) {
+            put_u32(data, static_cast<uint32_t>(image.pe));
+            put_u32(data, static_cast<uint32_t>(image.cluster));
+            put_words(data, image.preload);
+            put_words(data, image.execution);
+            put_u32(data, static_cast<uint32_t>(image.overlays.size()));
+            for (const auto& [phase, words] : image.overlays) {
+                put_u32(data, static_cast<uint32_t>(phase));
+                put_words(data, words);
+            }
+            put_text(data, image.assembly);
+        }
+    }
+    return data;
+}
+
+bool decode(const std::string& data, Kernel& kernel) {
+    EntryReader reader{data};
+    return read_images(reader, kernel);
+}
+
+// Reused between compiles: the assembler's tables are built once
+struct Compiler::State {
+    RISC_V_Assembler assembler;
+    std::ostringstream errors;
+};
+
+Compiler::Compiler() : state(new State) {}
+
+Compiler::~Compiler() = default;
+
+Kernel Compiler::compile(const YAML::Node& config, const Options& options) {
+    return build(options, [&](DFGProcessor& processor) { processor.loadConfig(YAML::Clone(config), ""); });
+}
+
+Kernel Compiler::compile_binary(const char* data, size_t size, const Options& options) {
+    return build(options, [&](DFGProcessor& processor) {
+        processor.loadConfig(BinaryConfigReader(data, size, "buffer"), "");
+    });
+}
+
+// Both stages on a processor that load has given its configuration
+Kernel Compiler::build(const Options& options, const std::function<void(DFGProcessor&)>& load) {
+    NullStream discard;
+    std::ostream& log = options.log != nullptr ? *options.log : discard;
+    std::ostringstream& errors = state->errors;
+    Kernel kernel;
+    try {
+        DFGProcessor processor("");
+        processor.setLog(log);
+        load(processor);
+
+        RISC_V_Assembler& assembler = state->assembler;
+        assembler.set_log(log, errors);
+        assembler.set_imem_capacity(processor.imemExecutionWords(), processor.imemPreloadWords());
+        assembler.set_rvc(options.rvc);
+
+        // Libraries are assembled with the cluster number in place of the PE number
+        for (const auto& [cluster, source] : processor.libraryAssembly()) {
+            Image image = assemble_image(assembler, errors, source, cluster, "cluster " + std::to_string(cluster) +
+                                         " library", options.keep_assembly);
+            image.cluster = cluster;
+            kernel.libraries.push_back(std::move(image));
+        }
+        for (int pe = 0; pe < processor.totalPEs(); pe++) {
+            std::string source = processor.generatePEAssembly(pe);
+            if (source.empty()) continue;
+            Image image = assemble_image(assembler, errors, source, pe, "PE " + std::to_string(pe),
+                                         options.keep_assembly);
+            image.pe = pe;
+            image.cluster = processor.clusterOf(pe);
+            kernel.pes.push_back(std::move(image));
+        }
+    } catch (const Error&) {
+        throw;
+    } catch (const std::exception& e) {
+        throw Error(e.what());
+    }
+    return kernel;
+}
+
+Kernel compile(const YAML::Node& config, const Options& options) {
+    Compiler compiler;
+    return compiler.compile(config, options);
+}
+
+Kernel compile_binary(const char* data, size_t size, const Options& options) {
+    Compiler compiler;
+    return compiler.compile_binary(data, size, options);
+}
+
+Kernel compile_yaml(const std::string& yaml_text, const Options& options) {
+    YAML::Node config;
+    try {
+        config = YAML::Load(yaml_text);
+    } catch (const YAML::Exception& e) {
+        throw Error(e.what());
+    }
+    return compile(config, options);
+}
+
+Cache::Cache(const std::string& directory, uint64_t max_bytes) : directory(directory), max_bytes(max_bytes) {
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (!std::filesystem::is_directory(directory)) throw Error("Cannot create cache directory " + directory);
+}
+
+std::string Cache::entry_path(const YAML::Node& config, const Options& options) const {
+    return directory + "/" + key_hash(cache_key(config, options)) + ".yac";
+}
+
+std::string Cache::binary_entry_path(const std::string& data, const Options& options) const {
+    return directory + "/" + key_hash(binary_cache_key(data, options)) + ".yac";
+}
+
+Cache::Stats Cache::stats() const {
+    Stats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.evictions = evictions;
+    return result;
+}
+
+Kernel Cache::compile(const YAML::Node& config, const Options& options, Compiler* compiler) {
+    return cached(cache_key(config, options), [&]() {
+        return compiler != nullptr ? compiler->compile(config, options) : yac::compile(config, options);
+    });
+}
+
+Kernel Cache::compile_binary(const std::string& data, const Options& options, Compiler* compiler) {
+    return cached(binary_cache_key(data, options), [&]() {
+        return compiler != nullptr ? compiler->compile_binary(data.data(), data.size(), options)
+                                   : yac::compile_binary(data.data(), data.size(), options);
+    });
+}
+
+// The entry of key, or compile and store it on a miss
+Kernel Cache::cached(const std::string& key, const std::function<Kernel()>& compile) {
+    std::string path = directory + "/" + key_hash(key) + ".yac";
+    Kernel kernel;
+    {
+        DirectoryLock lock(directory, LOCK_SH);
+        if (load(path, key, kernel)) {
+            // The modification time orders entries for eviction
+            utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+            hits++;
+            return kernel;
+        }
+    }
+    misses++;
+    kernel = compile();
+    store(path, key, kernel);
+    return kernel;
+}
+
+Kernel Cache::compile_yaml(const std::string& yaml_text, const Options& options, Compiler* compiler) {
+    YAML::Node config;
+    try {
+        config = YAML::Load(yaml_text);
+    } catch (const YAML::Exception& e) {
+        throw Error(e.what());
+    }
+    return compile(config, options, compiler);
+}
+
+bool Cache::load(const std::string& path, const std::string& key, Kernel& kernel) const {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    std::string data;
+    if (fstat(fd, &st) == 0) {
+        data.resize(static_cast<size_t>(st.st_size));
+        if (read(fd, &data[0], data.size()) != static_cast<ssize_t>(data.size())) data.clear();
+    }
+    close(fd);
+
+    // Anything short of a complete entry for this exact key is a miss
+    EntryReader reader{data};
+    std::string magic(CACHE_MAGIC), stored_key, stored_manifest;
+    if (data.compare(0, magic.size(), magic) != 0) return false;
+    reader.at = magic.size();
+    if (!reader.text(stored_key) || stored_key != key || !reader.text(stored_manifest)) return false;
+    return read_images(reader, kernel);
+}
+
+void Cache::store(const std::string& path, const std::string& key, const Kernel& kernel) {
+    std::string data(CACHE_MAGIC);
+    put_text(data, key);
+    put_text(data, manifest(kernel));
+    data += encode(kernel);
+
+    // Written under a unique name and renamed into place, so readers see all of an entry or none
+    static std::atomic<uint64_t> sequence{0};
+    std::string temporary = path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(sequence++);
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        out.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!out) {
+            out.close();
+            std::remove(temporary.c_str());
+            return;  // The kernel is still returned, just not cached
+        }
+    }
+
+    DirectoryLock lock(directory, LOCK_EX);
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return;
+    }
+
+    // Least recently used entries go first; the new entry stays even if it alone is too large.
+    // Temporary files left by writers that died are removed after an hour.
+    namespace fs = std::filesystem;
+    std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+    uint64_t total = 0;
+    std::error_code error;
+    auto now = fs::file_time_type::clock::now();
+    for (const auto& entry : fs::directory_iterator(directory, error)) {
+        std::string name = entry.path().filename().string();
+        fs::file_time_type modified = entry.last_write_time(error);
+        if (error) continue;
+        if (name.find(".yac.tmp") != std::string::npos) {
+            if (now - modified > std::chrono::hours(1)) fs::remove(entry.path(), error);
+            continue;
+        }
+        if (entry.path().extension() != ".yac") continue;
+        uint64_t size = entry.file_size(error);
+        if (error) continue;
+        total += size;
+        if (entry.path() != fs::path(path)) entries.push_back({modified, entry.path()});
+    }
+    std::sort(entries.begin(), entries.end());
+    for (const auto& [modified, entry] : entries) {
+        if (total <= max_bytes) break;
+        uint64_t size = fs::file_size(entry, error);
+        if (!error && fs::remove(entry, error)) {
+            total -= size;
+            evictions++;
+        }
+    }
+}
+
+ConfigBuilder::ConfigBuilder() {
+    root["scheduling"]["minimum_pes_required"] = 0;
+    root["scheduling"]["pe_assignments"] = YAML::Node(YAML::NodeType::Sequence);
+}
+
+ConfigBuilder& ConfigBuilder::hardware(int total_pes, int pes_per_cluster, int data_dup) {
+    if (pes_per_cluster < 1 || total_pes % pes_per_cluster != 0) {
+        throw Error("total_pes " + std::to_string(total_pes) + " is not a multiple of pes_per_cluster " +
+                    std::to_string(pes_per_cluster));
+    }
+    YAML::Node hardware = root["hardware_config"];
+    hardware["total_pes"] = total_pes;
+    hardware["data_dup"] = data_dup;
+    hardware["clusters"]["count"] = total_pes / pes_per_cluster;
+    hardware["clusters"]["pes_per_cluster"] = pes_per_cluster;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::memory(const std::string& base_register, int address, int slice_words) {
+    root["mem_config"][base_register] = address;
+    if (slice_words > 0) root["hardware_config"]["psrf_mem_offset"][base_register + "_offset"] = slice_words;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::minimum_pes(int count) {
+    root["scheduling"]["minimum_pes_required"] = count;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::instruction(int pe_id, const std::map<std::string, std::string>& fields) {
+    if (pe_id < 0) throw Error("negative pe_id " + std::to_string(pe_id));
+    YAML::Node assignments = root["scheduling"]["pe_assignments"];
+    while (static_cast<int>(assignments.size()) <= pe_id) {
+        YAML::Node assignment;
+        assignment["pe_id"] = static_cast<int>(assignments.size());
+        assignment["instructions"] = YAML::Node(YAML::NodeType::Sequence);
+        assignments.push_back(assignment);
+    }
+    YAML::Node instr(YAML::NodeType::Map);
+    for (const auto& [key, value] : fields) {
+        try {
+            set_config_path(instr, key, YAML::Node(value));
+        } catch (const std::exception& e) {
+            throw Error(e.what());
+        }
+    }
+    assignments[pe_id]["instructions"].push_back(instr);
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::hardware_loop(int pe_id, int loop_id, int pc_start, int pc_stop, int hwl_index,
+                                            int iterations) {
+    return instruction(pe_id, {{"operation", "HWL"},
+                               {"format", "hwl-type"},
+                               {"loop_id", std::to_string(loop_id)},
+                               {"pc_start", std::to_string(pc_start)},
+                               {"pc_stop", std::to_string(pc_stop)},
+                               {"hwl_index", std::to_string(hwl_index)},
+                               {"iterations", std::to_string(iterations)}});
+}
+
+ConfigBuilder& ConfigBuilder::set(const std::string& path, const std::string& value) {
+    try {
+        set_config_path(root, path, YAML::Node(value));
+    } catch (const std::exception& e) {
+        throw Error(e.what());
+    }
+    return *this;
+}
+
+} // namespace yac
@@ -0,0 +1,183 @@
+#ifndef YAC_H
+#define YAC_H
+
+// libyac: compiles kernel configurations to per-PE instruction memory images in memory, for
+// hosts that build kernels at run time. Nothing is read from or written to the filesystem and
+// every call works on its own processor and assembler, so kernels may be compiled concurrently
+// from any number of threads. Link with build/libyac.a and -lyaml-cpp.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <yaml-cpp/yaml.h>
+#include "mem_format.h"
+
+class DFGProcessor;
+
+namespace yac {
+
+// Instruction memory image of one PE program or of one cluster's shared function library
+struct Image {
+    int pe = -1;                                   // PE number; -1 for a cluster library
+    int cluster = 0;
+    std::vector<MemWord> preload;                  // Preload window
+    std::vector<MemWord> execution;                // Initial execution image
+    std::map<int, std::vector<MemWord>> overlays;  // Phase -> words loaded at its reload point
+    std::string assembly;                          // Generated source (Options::keep_assembly)
+};
+
+struct Kernel {
+    std::vector<Image> pes;        // PEs with a program, in PE order
+    std::vector<Image> libraries;  // Shared function libraries, in cluster order
+};
+
+struct Options {
+    bool rvc = false;              // Compress eligible sections with 16-bit RVC instructions
+    bool keep_assembly = false;    // Keep the generated assembly source in each image
+    std::ostream* log = nullptr;   // Progress messages of both stages; discarded when null
+};
+
+// Invalid configuration or a program that does not assemble or fit instruction memory
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Compiles kernels with an assembler whose instruction tables are built once. Not safe to
+// share between threads; give each thread its own Compiler.
+class Compiler {
+public:
+    Compiler();
+    ~Compiler();
+    Compiler(const Compiler&) = delete;
+    Compiler& operator=(const Compiler&) = delete;
+
+    // As yac::compile
+    Kernel compile(const YAML::Node& config, const Options& options = Options());
+    // As yac::compile_binary
+    Kernel compile_binary(const char* data, size_t size, const Options& options = Options());
+
+private:
+    struct State;
+    std::unique_ptr<State> state;
+
+    Kernel build(const Options& options, const std::function<void(DFGProcessor&)>& load);
+};
+
+// Compile a parsed configuration. The node is copied first and never modified, but it must
+// not be modified by another thread during the call. Throws yac::Error.
+Kernel compile(const YAML::Node& config, const Options& options = Options());
+
+// Compile configuration YAML text. Throws yac::Error.
+Kernel compile_yaml(const std::string& yaml_text, const Options& options = Options());
+
+// Compile a configuration in the binary format of config_formats.h (the bytes of a .yacb
+// file), read in place from the buffer. Throws yac::Error.
+Kernel compile_binary(const char* data, size_t size, const Options& options = Options());
+
+// Binary form of a kernel's images (host byte order), as kept in cache entries and sent by
+// the compile server. decode returns false on malformed data.
+std::string encode(const Kernel& kernel);
+bool decode(const std::string& data, Kernel& kernel);
+
+// Formatting-independent text of a configuration or any part of it: comments, quoting and
+// block or flow style do not change it. Configurations with the same text compile alike.
+std::string normalized_config(const YAML::Node& config);
+
+// Raised by hand when the cache entry format or the meaning of an option changes
+constexpr const char* TOOLCHAIN_VERSION = "1.0";
+
+// Identifies the compiler: TOOLCHAIN_VERSION, a hash of the code generator and assembler
+// sources taken at build time and the compiler version. Cached kernels are only reused by a
+// toolchain that compiles them alike; rebuilding unchanged sources keeps the entries valid.
+std::string toolchain_id();
+
+// Persistent kernel cache in a directory shared by threads and processes. Entries are keyed by
+// a hash of the normalized configuration (formatting and comments do not matter), the options
+// that change the images and toolchain_id(); each entry holds the encoded images and a
+// manifest of them. Entries are written to a temporary file and renamed into place, readers
+// and writers coordinate through flock on the directory's lock file, and the least recently
+// used entries are removed once the directory grows past max_bytes.
+class Cache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;  // Entries this object removed to stay under max_bytes
+    };
+
+    explicit Cache(const std::string& directory, uint64_t max_bytes = uint64_t(1) << 30);
+
+    // Cached yac::compile; a miss compiles (with compiler when given) and stores the kernel
+    Kernel compile(const YAML::Node& config, const Options& options = Options(), Compiler* compiler = nullptr);
+    Kernel compile_yaml(const std::string& yaml_text, const Options& options = Options(),
+                        Compiler* compiler = nullptr);
+    // Binary configurations are keyed by their bytes
+    Kernel compile_binary(const std::string& data, const Options& options = Options(), Compiler* compiler = nullptr);
+
+    // Entry file of a configuration, whether or not it is cached yet
+    std::string entry_path(const YAML::Node& config, const Options& options = Options()) const;
+    std::string binary_entry_path(const std::string& data, const Options& options = Options()) const;
+
+    Stats stats() const;
+
+private:
+    std::string directory;
+    uint64_t max_bytes;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+
+    Kernel cached(const std::string& key, const std::function<Kernel()>& compile);
+    bool load(const std::string& path, const std::string& key, Kernel& kernel) const;
+    void store(const std::string& path, const std::string& key, const Kernel& kernel);
+};
+
+// Builds a configuration in code instead of YAML text. Values are given as text, as they
+// would be written in the file; nested fields of an instruction use dotted keys:
+//
+//   yac::ConfigBuilder builder;
+//   builder.hardware(16, 1).memory("x18", 200, 1024).minimum_pes(1)
+//       .hardware_loop(0, 1, 2, 3, 10, 64)
+//       .instruction(0, {{"operation", "psrf.lw"}, {"format", "psrf-mem-type"}, {"ra1", "x1"},
+//                        {"base_address", "x18"}, {"var", "0"}, {"psrf_var.v0", "10"},
+//                        {"coefficients.c0", "4"}, {"offset", "0"}})
+//       .instruction(0, {{"operation", "ADD"}, {"format", "r-type"}, {"rd", "x3"},
+//                        {"ra1", "x1"}, {"ra2", "x1"}});
+//   yac::Kernel kernel = yac::compile(builder.node());
+class ConfigBuilder {
+private:
+    YAML::Node root;
+
+public:
+    ConfigBuilder();
+
+    // total_pes PEs in clusters of pes_per_cluster, data duplicated data_dup times
+    ConfigBuilder& hardware(int total_pes, int pes_per_cluster, int data_dup = 1);
+
+    // Base register of a data region; slice_words > 0 gives each cluster its own slice
+    ConfigBuilder& memory(const std::string& base_register, int address, int slice_words = 0);
+
+    ConfigBuilder& minimum_pes(int count);
+
+    // Append an instruction to the program of a base PE
+    ConfigBuilder& instruction(int pe_id, const std::map<std::string, std::string>& fields);
+
+    // Append a hardware loop over execution words pc_start..pc_stop (inclusive)
+    ConfigBuilder& hardware_loop(int pe_id, int loop_id, int pc_start, int pc_stop, int hwl_index, int iterations);
+
+    // Set any other key by its dotted path, e.g. set("optimization.inline.enabled", "true")
+    ConfigBuilder& set(const std::string& path, const std::string& value);
+
+    YAML::Node node() const { return YAML::Clone(root); }
+};
+
+} // namespace yac
+
+#endif // YAC_H
@@ -0,0 +1,161 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include "batch_compiler.h"
+#include "compile_server.h"
+#include "kernel_watcher.h"
+#include "mem_format.h"
+
+// Write each image as the assembler names its memory files
+static void write_images(const yac::Kernel& kernel, const std::string& output_folder) {
+    auto write = [&](const std::string& name, const std::vector<MemWord>& words) {
+        std::ofstream out(output_folder + name);
+        if (!out) throw yac::Error("Cannot write " + output_folder + name);
+        MemWriter writer(out, MemFormat());
+        for (const auto& word : words) writer.write(word.address, word.word);
+    };
+    for (const auto& image : kernel.libraries) {
+        std::vector<MemWord> words = image.preload;
+        words.insert(words.end(), image.execution.begin(), image.execution.end());
+        write("cluster" + std::to_string(image.cluster) + "_library.mem", words);
+    }
+    for (const auto& image : kernel.pes) {
+        std::string base = "pe" + std::to_string(image.pe) + "_binary";
+        std::vector<MemWord> words = image.preload;
+        words.insert(words.end(), image.execution.begin(), image.execution.end());
+        write(base + ".mem", words);
+        for (const auto& [phase, overlay] : image.overlays) {
+            write(base + "_ovl" + std::to_string(phase) + ".mem", overlay);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> positional;
+    std::string socket_path = default_socket_path();
+    std::string cache_dir;
+    uint64_t cache_mb = 1024;
+    int jobs = static_cast<int>(std::thread::hardware_concurrency());
+    int queue = 0;
+    std::string batch_output = "build/batch/";
+    bool serve = false, watch = false, batch = false, rvc = false, manifest = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--watch") {
+            watch = true;
+        } else if (arg == "--batch") {
+            batch = true;
+        } else if (arg.rfind("--output=", 0) == 0) {
+            batch_output = arg.substr(9);
+        } else if (arg.rfind("--socket=", 0) == 0) {
+            socket_path = arg.substr(9);
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            jobs = std::stoi(arg.substr(7));
+        } else if (arg.rfind("--queue=", 0) == 0) {
+            queue = std::stoi(arg.substr(8));
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            cache_dir = arg.substr(8);
+        } else if (arg.rfind("--cache-size=", 0) == 0) {
+            cache_mb = std::stoull(arg.substr(13));
+        } else if (arg == "--rvc") {
+            rvc = true;
+        } else if (arg == "--manifest") {
+            manifest = true;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (serve) {
+        try {
+            CompileServer server(socket_path, jobs, queue > 0 ? queue : 2 * std::max(1, jobs), cache_dir,
+                                 cache_mb << 20);
+            return server.run();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (batch && !positional.empty()) {
+        try {
+            if (batch_output.back() != '/') batch_output += '/';
+            std::vector<std::string> configs = expand_batch_inputs(positional);
+            BatchCompiler compiler(configs, batch_output, jobs, rvc);
+            return compiler.run() == 0 ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    if (positional.empty()) {
+        std::cerr << "Usage: " << argv[0] << " --serve [--socket=PATH] [--jobs=N] [--queue=N] [--cache=DIR] [--cache-size=MB]"
+                  << std::endl;
+        std::cerr << "       " << argv[0] << " <kernel.yaml> [output_folder] [--socket=PATH] [--rvc] [--manifest]" << std::endl;
+        std::cerr << "       " << argv[0] << " --watch <kernel.yaml> [output_folder]" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch <config|dir|glob|@list>... [--output=DIR] [--jobs=N] [--rvc]"
+                  << std::endl;
+        std::cerr << "  --serve: Run the compile server on a Unix socket (stop with SIGINT or SIGTERM)" << std::endl;
+        std::cerr << "  --socket=PATH: Server socket (default: " << default_socket_path() << ")" << std::endl;
+        std::cerr << "  --jobs=N: Worker threads (default: hardware threads)" << std::endl;
+        std::cerr << "  --queue=N: Connections waiting for a worker before new ones stay in the backlog (default: 2 x jobs)"
+                  << std::endl;
+        std::cerr << "  --cache=DIR: Keep compiled kernels in DIR across restarts" << std::endl;
+        std::cerr << "  --cache-size=MB: Evict least recently used entries past this size (default: 1024)" << std::endl;
+        std::cerr << "  kernel.yaml: Configuration sent to the server; images are written as .mem files" << std::endl;
+        std::cerr << "  --rvc: Compress eligible sections with 16-bit RVC instructions" << std::endl;
+        std::cerr << "  --manifest: Print the path of the server's cache entry instead of writing images" << std::endl;
+        std::cerr << "  --watch: Rebuild the outputs of make test whenever the YAML or a data_images input changes,"
+                  << std::endl;
+        std::cerr << "           regenerating only the PEs whose assignment changed (stop with SIGINT or SIGTERM)"
+                  << std::endl;
+        std::cerr << "  --batch: Compile every configuration named, found in a directory, matched by a glob or listed"
+                  << std::endl;
+        std::cerr << "           in a file, each into its own folder under --output (default: build/batch/)"
+                  << std::endl;
+        return 1;
+    }
+
+    if (watch) {
+        std::string output_folder = positional.size() >= 2 ? positional[1] : "build/";
+        if (output_folder.back() != '/') output_folder += '/';
+        std::filesystem::create_directories(output_folder);
+        KernelWatcher watcher(positional[0], output_folder);
+        return watcher.run();
+    }
+
+    std::ifstream file(positional[0], std::ios::binary);
+    if (!file) {
+        std::cerr << "Error: Cannot open " << positional[0] << std::endl;
+        return 1;
+    }
+    std::stringstream config;
+    config << file.rdbuf();
+    std::string output_folder = positional.size() >= 2 ? positional[1] : "build/";
+    if (output_folder.back() != '/') output_folder += '/';
+
+    try {
+        ConfigFormat input_format = detect_config_format(positional[0]);
+        std::string format = input_format == ConfigFormat::Binary ? "yacb"
+                             : input_format == ConfigFormat::Json ? "json"
+                                                                  : "yaml";
+        CompileClient client(socket_path);
+        if (manifest) {
+            std::cout << client.compile_manifest(config.str(), rvc, format) << std::endl;
+            return 0;
+        }
+        yac::Kernel kernel = client.compile(config.str(), rvc, format);
+        std::filesystem::create_directories(output_folder);
+        write_images(kernel, output_folder);
+        std::cout << "Wrote " << kernel.pes.size() << " PE images and " << kernel.libraries.size()
+                  << " libraries to " << output_folder << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+    addi x18, x0, 200
+    lui x19, 5
+    addi x19, x19, -480
+    lui x20, 10
+    addi x20, x20, -956
+    ppsrf.addi v0, v0, 10
+    ppsrf.addi v1, v0, 12
+    corf.addi c0, c0, 256
+    corf.addi c1, c0, 4
+    ppsrf.addi v6, v6, 12
+    ppsrf.addi v7, v6, 11
+    corf.addi c6, c6, 256
+    corf.addi c7, c6, 4
+    ppsrf.addi v12, v12, 10
+    ppsrf.addi v13, v12, 11
+    corf.addi c12, c12, 256
+    corf.addi c13, c12, 4
+    ppsrf.addi v12, v12, 10
+    ppsrf.addi v13, v12, 11
+    corf.addi c12, c12, 256
+    corf.addi c13, c12, 4
+# ========== Execution Section Begin ==========
+    hwlrf.lui L1, 4426
+    hwlrf.addi L1, L1, 4
+    hwlrf.lui L2, 8459
+    hwlrf.addi L2, L2, 64
+    hwlrf.lui L3, 12492
+    hwlrf.addi L3, L3, 64
+    psrf.lw x1, 0(x18)
+    psrf.lw x2, 1(x19)
+    psrf.lw x3, 2(x20)
+    mul x1, x1, x2
+    add x3, x3, x1
+    psrf.sw x3, 2(x20)
+    add x3, x0, x0
+    nop